@@ -112,14 +112,14 @@ void SendBundle (Ptr<Socket> sock, Ipv4Address dstaddr, uint16_t port)
   bph.SetDestinationEid (BpEndpointId("dtn://", "destNode"));
   bph.SetSourceEid (BpEndpointId("dtn://", "srcNode"));
 
+  // Create packet, the payload block data is the packet itself
+  char test_payload[] = "TEST PAYLOAD!!";
+  Ptr<Packet> packet = Create<Packet> ((const uint8_t *) test_payload, sizeof (test_payload));
+
   // Build bundle payload header
   BpPayloadHeader bpph;
-  char test_payload[] = "TEST PAYLOAD!!";
-  std::vector<uint8_t> payload(std::begin(test_payload), std::end(test_payload));
-  bpph.SetPayload(payload);
+  bpph.SetBlockLength (packet->GetSize ());
   bpph.SetLastBlock(true);
-  // Create packet
-  Ptr<Packet> packet = Create<Packet> ();
   packet->AddHeader (bpph);
   packet->AddHeader (bph);
 
@@ -0,0 +1,164 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "bp-bloom-filter.h"
+#include <cmath>
+#include <algorithm>
+
+NS_LOG_COMPONENT_DEFINE ("BpBloomFilter");
+
+namespace ns3 {
+
+// the number of bits and the number of hashes before the bits
+#define BP_BLOOM_FILTER_HEADER_SIZE 5
+
+BpBloomFilter::BpBloomFilter ()
+  : m_size (0),
+    m_hashes (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpBloomFilter::BpBloomFilter (uint32_t keys, double falsePositiveRate)
+{
+  NS_LOG_FUNCTION (this << " " << keys << " " << falsePositiveRate);
+  NS_ASSERT (falsePositiveRate > 0 && falsePositiveRate < 1);
+  if (keys == 0)
+    keys = 1;
+
+  double bits = std::ceil (-(double) keys * std::log (falsePositiveRate) / (std::log (2.0) * std::log (2.0)));
+  m_size = std::max ((uint32_t) bits, (uint32_t) 8);
+  m_hashes = std::max ((uint32_t) (m_size * std::log (2.0) / keys + 0.5), (uint32_t) 1);
+  m_hashes = std::min (m_hashes, (uint32_t) 255);
+  m_bits.assign ((m_size + 7) / 8, 0);
+}
+
+BpBloomFilter::~BpBloomFilter ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BpBloomFilter::Hash (const std::string &key, uint32_t &h1, uint32_t &h2)
+{
+  // FNV-1a and djb2, the second one is odd so that the k hashes differ
+  h1 = 2166136261u;
+  h2 = 5381;
+  for (uint32_t i = 0; i < key.size (); i++)
+    {
+      h1 = (h1 ^ (uint8_t) key[i]) * 16777619u;
+      h2 = h2 * 33 + (uint8_t) key[i];
+    }
+  h2 |= 1;
+}
+
+void
+BpBloomFilter::Add (const std::string &key)
+{
+  NS_LOG_FUNCTION (this << " " << key);
+  if (m_size == 0)
+    return;
+
+  uint32_t h1, h2;
+  Hash (key, h1, h2);
+  for (uint32_t i = 0; i < m_hashes; i++)
+    {
+      uint32_t bit = (h1 + i * h2) % m_size;
+      m_bits[bit / 8] |= (uint8_t) (1 << (bit % 8));
+    }
+}
+
+bool
+BpBloomFilter::Contains (const std::string &key) const
+{
+  NS_LOG_FUNCTION (this << " " << key);
+  if (m_size == 0)
+    return false;
+
+  uint32_t h1, h2;
+  Hash (key, h1, h2);
+  for (uint32_t i = 0; i < m_hashes; i++)
+    {
+      uint32_t bit = (h1 + i * h2) % m_size;
+      if ((m_bits[bit / 8] & (1 << (bit % 8))) == 0)
+        return false;
+    }
+
+  return true;
+}
+
+uint32_t
+BpBloomFilter::GetBits () const
+{
+  return m_size;
+}
+
+uint32_t
+BpBloomFilter::GetHashes () const
+{
+  return m_hashes;
+}
+
+uint32_t
+BpBloomFilter::GetSerializedSize () const
+{
+  return BP_BLOOM_FILTER_HEADER_SIZE + m_bits.size ();
+}
+
+void
+BpBloomFilter::Serialize (uint8_t *buffer) const
+{
+  NS_LOG_FUNCTION (this);
+  buffer[0] = (uint8_t) (m_size >> 24);
+  buffer[1] = (uint8_t) (m_size >> 16);
+  buffer[2] = (uint8_t) (m_size >> 8);
+  buffer[3] = (uint8_t) m_size;
+  buffer[4] = (uint8_t) m_hashes;
+  std::copy (m_bits.begin (), m_bits.end (), buffer + BP_BLOOM_FILTER_HEADER_SIZE);
+}
+
+bool
+BpBloomFilter::Deserialize (const uint8_t *buffer, uint32_t size)
+{
+  NS_LOG_FUNCTION (this << " " << size);
+  if (size < BP_BLOOM_FILTER_HEADER_SIZE)
+    return false;
+
+  uint32_t bits = ((uint32_t) buffer[0] << 24) | ((uint32_t) buffer[1] << 16) | ((uint32_t) buffer[2] << 8) | buffer[3];
+  uint32_t hashes = buffer[4];
+  if ((bits == 0) != (hashes == 0) || size != BP_BLOOM_FILTER_HEADER_SIZE + (bits + 7) / 8)
+    return false;
+
+  m_size = bits;
+  m_hashes = hashes;
+  m_bits.assign (buffer + BP_BLOOM_FILTER_HEADER_SIZE, buffer + size);
+  return true;
+}
+
+void
+BpBloomFilter::Clear ()
+{
+  NS_LOG_FUNCTION (this);
+  std::fill (m_bits.begin (), m_bits.end (), 0);
+}
+
+} // namespace ns3
@@ -0,0 +1,115 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+#ifndef BP_BLOOM_FILTER_H
+#define BP_BLOOM_FILTER_H
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+
+namespace ns3 {
+
+/**
+ * \brief A Bloom filter of strings
+ *
+ * A key is added by setting the bits of its k hashes. A key added is always
+ * found; a key not added is found with the false positive rate the filter
+ * is sized for, as long as it holds at most the number of keys it is sized
+ * for. For n keys and a false positive rate p, the filter has
+ * m = -n ln p / (ln 2)^2 bits and k = m / n ln 2 hashes, i.e. about 9.6
+ * bits per key for p = 1%, whatever the length of the keys.
+ *
+ * The k hashes are derived from two 32-bit hashes of the key by double
+ * hashing, so a key is read twice whatever k.
+ */
+class BpBloomFilter
+{
+public:
+  /**
+   * \brief An empty filter without bits, which contains no key
+   */
+  BpBloomFilter ();
+
+  /**
+   * \param keys the number of keys the filter is sized for
+   * \param falsePositiveRate the false positive rate for this number of keys, in (0, 1)
+   */
+  BpBloomFilter (uint32_t keys, double falsePositiveRate);
+
+  virtual ~BpBloomFilter ();
+
+  /**
+   * \brief Add a key
+   */
+  void Add (const std::string &key);
+
+  /**
+   * \return false if key is not in the filter, true if it is or for a false positive
+   */
+  bool Contains (const std::string &key) const;
+
+  /**
+   * \return the number of bits of the filter
+   */
+  uint32_t GetBits () const;
+
+  /**
+   * \return the number of hashes of each key
+   */
+  uint32_t GetHashes () const;
+
+  /**
+   * \return the size of the serialized filter in bytes
+   */
+  uint32_t GetSerializedSize () const;
+
+  /**
+   * \brief Write the filter: the number of bits and of hashes, then the bits
+   *
+   * \param buffer a buffer of GetSerializedSize () bytes
+   */
+  void Serialize (uint8_t *buffer) const;
+
+  /**
+   * \brief Read a serialized filter
+   *
+   * \return false if the buffer is not a filter, the filter is not changed
+   */
+  bool Deserialize (const uint8_t *buffer, uint32_t size);
+
+  /**
+   * \brief Remove all keys
+   */
+  void Clear ();
+
+private:
+  /**
+   * \brief Compute the two hashes the hashes of a key are derived from
+   */
+  static void Hash (const std::string &key, uint32_t &h1, uint32_t &h2);
+
+  std::vector<uint8_t> m_bits;   /// the bits, 8 per byte
+  uint32_t m_size;               /// number of bits
+  uint32_t m_hashes;             /// number of hashes of each key
+};
+
+} // namespace ns3
+
+#endif /* BP_BLOOM_FILTER_H */
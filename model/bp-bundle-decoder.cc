@@ -0,0 +1,328 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#include "ns3/log.h"
+#include "bp-bundle-decoder.h"
+#include "bp-payload-header.h"
+#include "sdnv.h"
+#include <algorithm>
+
+// number of bytes copied out of a segment at once to decode header fields
+#define BP_DECODER_WINDOW 32
+
+// bundle protocol version, section 4.5.1 of RFC 5050
+#define BP_VERSION 0x6
+
+NS_LOG_COMPONENT_DEFINE ("BpBundleDecoder");
+
+namespace ns3 {
+
+BpBundleDecoder::BpBundleDecoder ()
+  : m_state (PRIMARY_VERSION),
+    m_sdnvValue (0),
+    m_sdnvLength (0),
+    m_skip (0),
+    m_blockType (0),
+    m_blockFlags (0),
+    m_eidReferences (0),
+    m_discard (false),
+    m_pendingSize (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpBundleDecoder::~BpBundleDecoder ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+uint32_t
+BpBundleDecoder::Feed (Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << " " << packet);
+  uint32_t size = packet->GetSize ();
+  uint32_t offset = 0;    // bytes of the segment already decoded
+  uint32_t start = 0;     // start of the bundle under decoding in the segment
+  uint32_t completed = 0;
+  uint8_t window[BP_DECODER_WINDOW];
+
+  while (offset < size)
+    {
+      bool done = false;
+
+      if (m_state == PRIMARY_BODY || m_state == BLOCK_BODY)
+        {
+          // skip the block body without touching the data
+          uint32_t len = (uint32_t) std::min<uint64_t> (m_skip, size - offset);
+          offset += len;
+          m_skip -= len;
+          if (m_skip == 0)
+            done = EndOfBlock ();
+        }
+      else
+        {
+          // copy only the few bytes holding the next header fields
+          uint32_t len = std::min<uint32_t> (size - offset, BP_DECODER_WINDOW);
+          if (offset == 0)
+            packet->CopyData (window, len);
+          else
+            packet->CreateFragment (offset, len)->CopyData (window, len);
+
+          uint32_t k = 0;
+          while (k < len && !done && !m_discard && m_state != PRIMARY_BODY && m_state != BLOCK_BODY)
+            {
+              done = ProcessByte (window[k]);
+              k++;
+            }
+          offset += k;
+
+          if (m_discard)
+            {
+              // the bytes up to the corrupted byte are dropped, the next bundle
+              // starts right after it
+              start = offset;
+              m_discard = false;
+            }
+        }
+
+      if (done)
+        {
+          m_pending.push_back (packet->CreateFragment (start, offset - start));
+          m_pendingSize += offset - start;
+          CompleteBundle ();
+          start = offset;
+          completed++;
+        }
+    }
+
+  // keep the head of the next bundle until the rest of it is received
+  if (start < size)
+    {
+      if (start == 0)
+        m_pending.push_back (packet);
+      else
+        m_pending.push_back (packet->CreateFragment (start, size - start));
+      m_pendingSize += size - start;
+    }
+
+  return completed;
+}
+
+bool
+BpBundleDecoder::ProcessByte (uint8_t byte)
+{
+  switch (m_state)
+    {
+    case PRIMARY_VERSION:
+      if (byte != BP_VERSION)
+        NS_LOG_WARN ("BpBundleDecoder::ProcessByte (): unknown bundle protocol version " << (uint16_t) byte);
+      m_state = PRIMARY_FLAGS;
+      break;
+
+    case PRIMARY_FLAGS:
+      if (ConsumeSdnv (byte))
+        m_state = PRIMARY_LENGTH;
+      break;
+
+    case PRIMARY_LENGTH:
+      if (ConsumeSdnv (byte))
+        {
+          m_skip = m_sdnvValue;
+          m_state = PRIMARY_BODY;
+          if (m_skip == 0)
+            return EndOfBlock ();
+        }
+      break;
+
+    case BLOCK_TYPE:
+      m_blockType = byte;
+      m_state = BLOCK_FLAGS;
+      break;
+
+    case BLOCK_FLAGS:
+      if (ConsumeSdnv (byte))
+        {
+          m_blockFlags = m_sdnvValue;
+          if (m_blockFlags & BpPayloadHeader::EID_REFERENCE)
+            m_state = BLOCK_EID_COUNT;
+          else
+            m_state = BLOCK_LENGTH;
+        }
+      break;
+
+    case BLOCK_EID_COUNT:
+      if (ConsumeSdnv (byte))
+        {
+          // each reference is a pair of scheme and ssp offsets
+          m_eidReferences = 2 * m_sdnvValue;
+          m_state = (m_eidReferences > 0) ? BLOCK_EID_REFERENCE : BLOCK_LENGTH;
+        }
+      break;
+
+    case BLOCK_EID_REFERENCE:
+      if (ConsumeSdnv (byte))
+        {
+          m_eidReferences--;
+          if (m_eidReferences == 0)
+            m_state = BLOCK_LENGTH;
+        }
+      break;
+
+    case BLOCK_LENGTH:
+      if (ConsumeSdnv (byte))
+        {
+          m_skip = m_sdnvValue;
+          m_state = BLOCK_BODY;
+          if (m_skip == 0)
+            return EndOfBlock ();
+        }
+      break;
+
+    default:
+      NS_FATAL_ERROR ("BpBundleDecoder::ProcessByte (): block body is not decoded byte by byte");
+    }
+
+  return false;
+}
+
+bool
+BpBundleDecoder::ConsumeSdnv (uint8_t byte)
+{
+  if (m_sdnvLength == 0)
+    m_sdnvValue = 0;
+
+  m_sdnvValue = (m_sdnvValue << 7) | (byte & 0x7F);
+  m_sdnvLength++;
+
+  if (m_sdnvLength > SDNV_MAX_LENGTH)
+    {
+      // the stream is corrupted and cannot be resynchronized; the pending bytes and
+      // this byte are discarded, and the next byte is decoded as the start of a bundle
+      NS_LOG_WARN ("BpBundleDecoder::ConsumeSdnv (): SDNV is too long, drop " << m_pendingSize << " bytes");
+      m_pending.clear ();
+      m_pendingSize = 0;
+      m_discard = true;
+      ResetState ();
+      return false;
+    }
+
+  if ((byte & 0x80) == 0)
+    {
+      m_sdnvLength = 0;
+      return true;
+    }
+
+  return false;
+}
+
+bool
+BpBundleDecoder::EndOfBlock ()
+{
+  if (m_state == PRIMARY_BODY)
+    {
+      m_state = BLOCK_TYPE;
+      return false;
+    }
+
+  // this module always emits the payload block as the last block of a bundle
+  if ((m_blockFlags & BpPayloadHeader::LAST_BLOCK) || m_blockType == BP_PAYLOAD_BLOCK_TYPE)
+    {
+      ResetState ();
+      return true;
+    }
+
+  m_state = BLOCK_TYPE;
+  return false;
+}
+
+void
+BpBundleDecoder::CompleteBundle ()
+{
+  NS_LOG_FUNCTION (this << " " << m_pendingSize);
+  Ptr<Packet> bundle = m_pending.front ();
+
+  if (m_pending.size () > 1)
+    {
+      // a copy of the head is needed since it may be the caller's packet
+      bundle = bundle->Copy ();
+      for (std::vector<Ptr<Packet> >::iterator it = m_pending.begin () + 1;
+           it != m_pending.end ();
+           ++it)
+        {
+          bundle->AddAtEnd (*it);
+        }
+    }
+
+  m_bundles.push (bundle);
+  m_pending.clear ();
+  m_pendingSize = 0;
+}
+
+void
+BpBundleDecoder::ResetState ()
+{
+  m_state = PRIMARY_VERSION;
+  m_sdnvValue = 0;
+  m_sdnvLength = 0;
+  m_skip = 0;
+  m_blockType = 0;
+  m_blockFlags = 0;
+  m_eidReferences = 0;
+}
+
+Ptr<Packet>
+BpBundleDecoder::GetBundle ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_bundles.empty ())
+    return NULL;
+
+  Ptr<Packet> bundle = m_bundles.front ();
+  m_bundles.pop ();
+
+  return bundle;
+}
+
+bool
+BpBundleDecoder::HasBundle () const
+{
+  NS_LOG_FUNCTION (this);
+  return !m_bundles.empty ();
+}
+
+uint32_t
+BpBundleDecoder::GetPendingSize () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_pendingSize;
+}
+
+void
+BpBundleDecoder::Reset ()
+{
+  NS_LOG_FUNCTION (this);
+  m_pending.clear ();
+  m_pendingSize = 0;
+  while (!m_bundles.empty ())
+    m_bundles.pop ();
+  ResetState ();
+}
+
+} // namespace ns3
@@ -0,0 +1,157 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+#ifndef BP_BUNDLE_DECODER_H
+#define BP_BUNDLE_DECODER_H
+
+#include <stdint.h>
+#include <vector>
+#include <queue>
+#include "ns3/ptr.h"
+#include "ns3/packet.h"
+
+namespace ns3 {
+
+/**
+ * \brief Incremental decoder that extracts bundles from a byte stream
+ *
+ * The transport layer hands out segments whose boundaries have nothing to
+ * do with the bundle boundaries. This class walks the primary bundle block
+ * and the canonical blocks (section 4.5, RFC 5050) with a resumable state
+ * machine, so that every received byte is examined only once. The state of
+ * a partially received SDNV or block is kept across segments.
+ *
+ * The block bodies (dictionary, payload, ...) are skipped without copying.
+ * The segments of the bundle under decoding are kept as packet fragments and
+ * concatenated only once, when the last block of the bundle is complete.
+ */
+class BpBundleDecoder
+{
+public:
+  /**
+   * Constructor
+   */
+  BpBundleDecoder ();
+
+  /**
+   * Destroy
+   */
+  virtual ~BpBundleDecoder ();
+
+  /**
+   * \brief Decode the bytes newly received from the transport layer
+   *
+   * \param packet the received segment
+   *
+   * \return the number of bundles completed by this segment
+   */
+  uint32_t Feed (Ptr<Packet> packet);
+
+  /**
+   * \brief Get and delete the first completely received bundle
+   *
+   * \return the bundle, or NULL if there is no complete bundle
+   */
+  Ptr<Packet> GetBundle ();
+
+  /**
+   * \return true if at least one complete bundle can be fetched by GetBundle ()
+   */
+  bool HasBundle () const;
+
+  /**
+   * \return the number of bytes received for the bundle under decoding
+   */
+  uint32_t GetPendingSize () const;
+
+  /**
+   * \brief Drop the bundle under decoding and all complete bundles
+   */
+  void Reset ();
+
+private:
+  /**
+   * decoding states
+   */
+  typedef enum {
+    PRIMARY_VERSION,         /// version of the primary bundle block
+    PRIMARY_FLAGS,           /// bundle processing control flags (SDNV)
+    PRIMARY_LENGTH,          /// primary block length (SDNV)
+    PRIMARY_BODY,            /// rest of the primary block, skipped
+    BLOCK_TYPE,              /// block type of a canonical block
+    BLOCK_FLAGS,             /// block processing control flags (SDNV)
+    BLOCK_EID_COUNT,         /// EID reference count (SDNV)
+    BLOCK_EID_REFERENCE,     /// scheme and ssp offsets of EID references (SDNV)
+    BLOCK_LENGTH,            /// block data length (SDNV)
+    BLOCK_BODY               /// block data, skipped
+  } DecoderState;
+
+  /**
+   * \brief Process one byte of the header fields
+   *
+   * \param byte the next byte of the stream
+   *
+   * \return true if this byte completes the bundle
+   */
+  bool ProcessByte (uint8_t byte);
+
+  /**
+   * \brief Accumulate one byte of the SDNV under decoding
+   *
+   * \param byte the next byte of the stream
+   *
+   * \return true if the SDNV is complete; the value is in m_sdnvValue
+   */
+  bool ConsumeSdnv (uint8_t byte);
+
+  /**
+   * Move to the state after the body of a block
+   *
+   * \return true if the block was the last block of the bundle
+   */
+  bool EndOfBlock ();
+
+  /**
+   * Build the bundle from the stored fragments and queue it
+   */
+  void CompleteBundle ();
+
+  /**
+   * Restart the state machine at the primary block of next bundle
+   */
+  void ResetState ();
+
+private:
+  DecoderState m_state;                   /// current decoding state
+  uint64_t m_sdnvValue;                   /// value of the SDNV under decoding
+  uint32_t m_sdnvLength;                  /// bytes of the SDNV under decoding
+  uint64_t m_skip;                        /// bytes left in the block body
+  uint8_t m_blockType;                    /// type of the current canonical block
+  uint64_t m_blockFlags;                  /// flags of the current canonical block
+  uint64_t m_eidReferences;               /// SDNVs left in the EID reference list
+  bool m_discard;                         /// the stream was corrupted, drop the decoded bytes
+
+  uint32_t m_pendingSize;                 /// bytes of the bundle under decoding
+  std::vector<Ptr<Packet> > m_pending;    /// fragments of the bundle under decoding
+  std::queue<Ptr<Packet> > m_bundles;     /// completely received bundles
+};
+
+} // namespace ns3
+
+#endif /* BP_BUNDLE_DECODER_H */
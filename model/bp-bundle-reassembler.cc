@@ -0,0 +1,222 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "bp-bundle-reassembler.h"
+#include "bp-payload-header.h"
+#include <algorithm>
+
+NS_LOG_COMPONENT_DEFINE ("BpBundleReassembler");
+
+namespace ns3 {
+
+BpBundleReassembler::BpBundleReassembler ()
+  : m_timeout (Seconds (60)),
+    m_timeouts (0)
+{
+  NS_LOG_FUNCTION (this);
+  m_timers.SetExpireCallback (MakeCallback (&BpBundleReassembler::Expire, this));
+}
+
+BpBundleReassembler::~BpBundleReassembler ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+Ptr<Packet>
+BpBundleReassembler::Add (Ptr<Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << bundle);
+  BpHeader bph;
+  bundle->PeekHeader (bph);
+  if (!bph.IsFragment ())
+    return bundle;
+
+  // the payload keeps referencing the received buffer
+  Ptr<Packet> payload = bundle->Copy ();
+  BpPayloadHeader bpph;
+  payload->RemoveHeader (bph);
+  payload->RemoveHeader (bpph);
+  if (payload->GetSize () > bpph.GetBlockLength ())
+    payload->RemoveAtEnd (payload->GetSize () - bpph.GetBlockLength ());
+
+  uint32_t offset = bph.GetFragOffset ();
+  uint32_t end = offset + payload->GetSize ();
+  if (end < offset || end > bph.GetAduLength ())
+    {
+      NS_LOG_WARN ("BpBundleReassembler::Add (): fragment [" << offset << ", " << end << ") is out of ADU length " << bph.GetAduLength ());
+      return NULL;
+    }
+
+  Key key;
+  key.src = bph.GetSourceEid ().Handle ();
+  key.timestamp = bph.GetCreateTimestamp ();
+  key.seq = bph.GetSequenceNumber ().GetValue ();
+
+  std::map<Key, Partial>::iterator it = m_partials.find (key);
+  if (it == m_partials.end ())
+    {
+      // the first fragment of this ADU
+      it = m_partials.insert (std::make_pair (key, Partial ())).first;
+      it->second.header = bph;
+      it->second.aduLength = bph.GetAduLength ();
+      it->second.timer = m_timers.Add (Simulator::Now () + m_timeout, key);
+    }
+
+  Partial &partial = it->second;
+  if (bph.GetAduLength () != partial.aduLength)
+    {
+      NS_LOG_WARN ("BpBundleReassembler::Add (): ADU length " << bph.GetAduLength () << " differs from " << partial.aduLength);
+      return NULL;
+    }
+
+  uint32_t fresh = AddExtent (partial, offset, end);
+  if (fresh == 0)
+    return NULL;    // duplicated fragment
+
+  partial.data.insert (std::make_pair (offset, payload));
+  partial.received += fresh;
+  NS_LOG_DEBUG ("Fragment:" << " offset " << offset << " length " << payload->GetSize () <<
+                " received " << partial.received << " of " << partial.aduLength);
+
+  if (partial.received < partial.aduLength)
+    return NULL;
+
+  Ptr<Packet> adu = Assemble (partial);
+  m_timers.Cancel (partial.timer);
+  m_partials.erase (it);
+
+  return adu;
+}
+
+uint32_t
+BpBundleReassembler::AddExtent (Partial &partial, uint32_t start, uint32_t end)
+{
+  std::map<uint32_t, uint32_t> &extents = partial.extents;
+
+  // the first extent which may overlap or touch [start, end)
+  std::map<uint32_t, uint32_t>::iterator it = extents.upper_bound (start);
+  if (it != extents.begin ())
+    {
+      --it;
+      if (it->second < start)
+        ++it;
+    }
+
+  // merge the overlapping and adjacent extents
+  uint32_t merged = 0;
+  while (it != extents.end () && it->first <= end)
+    {
+      start = std::min (start, it->first);
+      end = std::max (end, it->second);
+      merged += it->second - it->first;
+      extents.erase (it++);
+    }
+  extents[start] = end;
+
+  return (end - start) - merged;
+}
+
+Ptr<Packet>
+BpBundleReassembler::Assemble (Partial &partial)
+{
+  NS_LOG_FUNCTION (this);
+  // the fragments are sorted by offset and cover the ADU, so the bytes after pos
+  // are always in the next fragment
+  Ptr<Packet> adu = Create<Packet> ();
+  uint32_t pos = 0;
+  std::multimap<uint32_t, Ptr<Packet> >::iterator it;
+  for (it = partial.data.begin (); it != partial.data.end () && pos < partial.aduLength; ++it)
+    {
+      uint32_t end = it->first + it->second->GetSize ();
+      if (end <= pos)
+        continue;
+
+      adu->AddAtEnd (it->second->CreateFragment (pos - it->first, end - pos));
+      pos = end;
+    }
+
+  BpPayloadHeader bpph;
+  bpph.SetBlockLength (adu->GetSize ());
+  bpph.SetLastBlock (true);
+
+  BpHeader bph = partial.header;
+  bph.SetIsFragment (false);
+  bph.SetFragOffset (0);
+  bph.SetAduLength (0);
+  bph.SetBlockLength (adu->GetSize ());
+
+  adu->AddHeader (bpph);
+  adu->AddHeader (bph);
+
+  return adu;
+}
+
+void
+BpBundleReassembler::Expire (Key key)
+{
+  NS_LOG_FUNCTION (this << " " << key.timestamp << " " << key.seq);
+  std::map<Key, Partial>::iterator it = m_partials.find (key);
+  if (it == m_partials.end ())
+    return;
+
+  NS_LOG_DEBUG ("Reassembly timeout:" << " received " << it->second.received << " of " << it->second.aduLength);
+  m_partials.erase (it);
+  m_timeouts++;
+}
+
+void
+BpBundleReassembler::SetTimeout (Time timeout)
+{
+  NS_LOG_FUNCTION (this << " " << timeout.GetSeconds ());
+  m_timeout = timeout;
+}
+
+Time
+BpBundleReassembler::GetTimeout () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_timeout;
+}
+
+uint32_t
+BpBundleReassembler::GetSize () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_partials.size ();
+}
+
+uint32_t
+BpBundleReassembler::GetTimeouts () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_timeouts;
+}
+
+void
+BpBundleReassembler::Clear ()
+{
+  NS_LOG_FUNCTION (this);
+  m_partials.clear ();
+  m_timers.Clear ();
+}
+
+} // namespace ns3
@@ -0,0 +1,162 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+#ifndef BP_BUNDLE_REASSEMBLER_H
+#define BP_BUNDLE_REASSEMBLER_H
+
+#include <stdint.h>
+#include <map>
+#include "ns3/ptr.h"
+#include "ns3/packet.h"
+#include "ns3/nstime.h"
+#include "bp-header.h"
+#include "bp-timing-wheel.h"
+
+namespace ns3 {
+
+/**
+ * \brief Reassembly of the fragmentary bundles, section 5.9 of RFC 5050
+ *
+ * The fragments of an application data unit (ADU) are identified by the
+ * source endpoint id, the creation timestamp and the sequence number of their
+ * primary bundle block. For each partially received ADU, the received byte
+ * ranges are kept in an interval map (an ordered map of disjoint intervals),
+ * so overlapping and duplicated fragments are accounted in O(log n), and the
+ * ADU is complete when a single interval covers it.
+ *
+ * The fragment payloads are kept as references into the received packets
+ * and concatenated once, when the ADU is complete. The state of an ADU which
+ * is not complete within the reassembly timeout is dropped.
+ */
+class BpBundleReassembler
+{
+public:
+  BpBundleReassembler ();
+  virtual ~BpBundleReassembler ();
+
+  /**
+   * \brief Add a received bundle
+   *
+   * \param bundle the bundle, starting with its primary bundle block and
+   * followed by its payload block
+   *
+   * \return the bundle itself if it is not a fragment, the reassembled bundle
+   * if this fragment completes its ADU, or NULL otherwise
+   */
+  Ptr<Packet> Add (Ptr<Packet> bundle);
+
+  /**
+   * \param timeout the time after the first fragment of an ADU when its
+   * partial state is dropped
+   */
+  void SetTimeout (Time timeout);
+
+  /**
+   * \return the reassembly timeout
+   */
+  Time GetTimeout () const;
+
+  /**
+   * \return the number of partially received ADUs
+   */
+  uint32_t GetSize () const;
+
+  /**
+   * \return the number of ADUs dropped because of the reassembly timeout
+   */
+  uint32_t GetTimeouts () const;
+
+  /**
+   * \brief Drop all partially received ADUs
+   */
+  void Clear ();
+
+private:
+  /**
+   * \brief the identifier of an ADU
+   */
+  struct Key
+  {
+    Key ()
+      : src (0),
+        timestamp (0),
+        seq (0)
+    {
+    }
+
+    bool operator < (const Key &other) const
+      {
+        if (src != other.src)
+          return src < other.src;
+        if (timestamp != other.timestamp)
+          return timestamp < other.timestamp;
+        return seq < other.seq;
+      }
+
+    uint32_t src;          /// interned handle of the source endpoint id
+    uint64_t timestamp;    /// creation timestamp
+    uint32_t seq;          /// creation timestamp sequence number
+  };
+
+  /**
+   * \brief a partially received ADU
+   */
+  struct Partial
+  {
+    Partial ()
+      : aduLength (0),
+        received (0),
+        timer (BpTimingWheel<Key>::NO_TIMER)
+    {
+    }
+
+    BpHeader header;                              /// primary bundle block of the first fragment
+    uint32_t aduLength;                           /// total length of the ADU
+    uint32_t received;                            /// bytes covered by the extents
+    std::map<uint32_t, uint32_t> extents;         /// received byte ranges: start -> end, disjoint and not adjacent
+    std::multimap<uint32_t, Ptr<Packet> > data;   /// the fragment payloads by offset
+    uint32_t timer;                               /// reassembly timer
+  };
+
+  /**
+   * \brief Add the byte range [start, end) to the extents
+   *
+   * \return the number of bytes which were not received yet
+   */
+  uint32_t AddExtent (Partial &partial, uint32_t start, uint32_t end);
+
+  /**
+   * \brief Build the bundle of a complete ADU
+   */
+  Ptr<Packet> Assemble (Partial &partial);
+
+  /**
+   * \brief Drop the partial state of an ADU whose reassembly timeout is over
+   */
+  void Expire (Key key);
+
+  std::map<Key, Partial> m_partials;    /// partially received ADUs
+  BpTimingWheel<Key> m_timers;          /// reassembly timers
+  Time m_timeout;                       /// reassembly timeout
+  uint32_t m_timeouts;                  /// number of ADUs dropped by the timeout
+};
+
+} // namespace ns3
+
+#endif /* BP_BUNDLE_REASSEMBLER_H */
@@ -0,0 +1,334 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "bp-bundle-scheduler.h"
+#include <algorithm>
+
+// default bytes credited to a source in each round of weighted fair queuing
+#define BP_WFQ_DEFAULT_QUANTUM 1500
+
+NS_LOG_COMPONENT_DEFINE ("BpBundleScheduler");
+
+namespace ns3 {
+
+BpBundleScheduler::Flow::Flow ()
+  : weight (1),
+    size (0)
+{
+  for (uint8_t c = 0; c < BP_PRIORITY_CLASSES; c++)
+    {
+      deficit[c] = 0;
+      active[c] = false;
+    }
+}
+
+BpBundleScheduler::BpBundleScheduler ()
+  : m_wfq (false),
+    m_quantum (BP_WFQ_DEFAULT_QUANTUM)
+{
+  NS_LOG_FUNCTION (this);
+  for (uint8_t c = 0; c < BP_PRIORITY_CLASSES; c++)
+    {
+      m_turn[c] = false;
+      m_backlog[c] = 0;
+    }
+}
+
+BpBundleScheduler::~BpBundleScheduler ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+uint32_t
+BpBundleScheduler::GetFlow (const BpEndpointId &src)
+{
+  uint32_t *index = m_flowIndex.Find (src);
+  if (index)
+    return *index;
+
+  // this is the first bundle sent by this source endpoint id
+  m_flows.push_back (Flow ());
+  m_flowIndex.Insert (src, m_flows.size () - 1);
+
+  return m_flows.size () - 1;
+}
+
+void
+BpBundleScheduler::Enqueue (Ptr<BpStoredBundle> record)
+{
+  NS_LOG_FUNCTION (this << " " << record->bundle << " " << record->eid.Uri () << " " << (uint16_t) record->priority);
+  if (record->priority >= BP_PRIORITY_CLASSES)
+    {
+      NS_LOG_WARN ("BpBundleScheduler::Enqueue (): unknown priority " << (uint16_t) record->priority << ", the bundle is sent as bulk");
+      record->priority = 0;
+    }
+
+  uint8_t priority = record->priority;
+  uint32_t index = GetFlow (record->eid);
+  Flow &flow = m_flows[index];
+
+  record->enqueued = Simulator::Now ();
+  flow.queues[priority].push_back (record);
+  flow.size++;
+  m_backlog[priority]++;
+
+  if (!flow.active[priority])
+    {
+      flow.active[priority] = true;
+      m_active[priority].push_back (index);
+    }
+}
+
+bool
+BpBundleScheduler::Purge (uint32_t index, uint8_t priority)
+{
+  std::deque<Ptr<BpStoredBundle> > &queue = m_flows[index].queues[priority];
+  while (!queue.empty () && !queue.front ()->IsStored ())
+    queue.pop_front ();
+
+  return !queue.empty ();
+}
+
+Ptr<BpStoredBundle>
+BpBundleScheduler::Pop (uint32_t index, uint8_t priority)
+{
+  Flow &flow = m_flows[index];
+  Ptr<BpStoredBundle> record = flow.queues[priority].front ();
+  flow.queues[priority].pop_front ();
+  flow.size--;
+  m_backlog[priority]--;
+
+  Time delay = Simulator::Now () - record->enqueued;
+  BpLatencyStats &stats = m_stats[priority];
+  stats.bundles++;
+  stats.total += delay;
+  if (delay > stats.max)
+    stats.max = delay;
+
+  return record;
+}
+
+Ptr<BpStoredBundle>
+BpBundleScheduler::Dequeue (const BpEndpointId &src)
+{
+  NS_LOG_FUNCTION (this << " " << src.Uri ());
+  uint32_t *index = m_flowIndex.Find (src);
+  if (index == NULL || m_flows[*index].size == 0)
+    return NULL;
+
+  // strict priority; the flow is left in the round robin lists, the empty
+  // queues are removed from them by Dequeue ()
+  for (int c = BP_PRIORITY_CLASSES - 1; c >= 0; c--)
+    {
+      if (Purge (*index, c))
+        return Pop (*index, c);
+    }
+
+  return NULL;
+}
+
+bool
+BpBundleScheduler::Remove (Ptr<BpStoredBundle> record)
+{
+  NS_LOG_FUNCTION (this << " " << record->eid.Uri ());
+  uint32_t *index = m_flowIndex.Find (record->eid);
+  if (index == NULL || !record->IsStored ())
+    return false;
+
+  // the record is left in its queue and dropped when it reaches the head
+  record->bundle = 0;
+  m_flows[*index].size--;
+  m_backlog[record->priority]--;
+
+  return true;
+}
+
+void
+BpBundleScheduler::Deactivate (uint8_t priority)
+{
+  Flow &flow = m_flows[m_active[priority].front ()];
+  flow.active[priority] = false;
+  flow.deficit[priority] = 0;
+  m_active[priority].pop_front ();
+  m_turn[priority] = false;
+}
+
+Ptr<BpStoredBundle>
+BpBundleScheduler::Dequeue ()
+{
+  NS_LOG_FUNCTION (this);
+  for (int c = BP_PRIORITY_CLASSES - 1; c >= 0; c--)
+    {
+      while (m_backlog[c] > 0)
+        {
+          uint32_t index = m_active[c].front ();
+          Flow &flow = m_flows[index];
+
+          if (!Purge (index, c))
+            {
+              // emptied by Dequeue (src) or Remove ()
+              Deactivate (c);
+              continue;
+            }
+
+          if (!m_wfq)
+            {
+              // round robin, one bundle per source
+              Ptr<BpStoredBundle> record = Pop (index, c);
+              Deactivate (c);
+              if (!flow.queues[c].empty ())
+                {
+                  flow.active[c] = true;
+                  m_active[c].push_back (index);
+                }
+              return record;
+            }
+
+          // deficit round robin
+          if (!m_turn[c])
+            {
+              flow.deficit[c] += flow.weight * m_quantum;
+              m_turn[c] = true;
+            }
+
+          uint32_t size = flow.queues[c].front ()->size;
+          if (flow.deficit[c] >= size)
+            {
+              flow.deficit[c] -= size;
+              Ptr<BpStoredBundle> record = Pop (index, c);
+              if (flow.queues[c].empty ())
+                Deactivate (c);
+              return record;
+            }
+
+          // the turn of this source is over
+          m_active[c].pop_front ();
+          m_active[c].push_back (index);
+          m_turn[c] = false;
+        }
+    }
+
+  return NULL;
+}
+
+void
+BpBundleScheduler::SetWeight (const BpEndpointId &src, uint32_t weight)
+{
+  NS_LOG_FUNCTION (this << " " << src.Uri () << " " << weight);
+  m_flows[GetFlow (src)].weight = std::max<uint32_t> (weight, 1);
+}
+
+void
+BpBundleScheduler::SetWeightedFairQueuing (bool enable)
+{
+  NS_LOG_FUNCTION (this << " " << enable);
+  m_wfq = enable;
+}
+
+bool
+BpBundleScheduler::GetWeightedFairQueuing () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_wfq;
+}
+
+void
+BpBundleScheduler::SetQuantum (uint32_t quantum)
+{
+  NS_LOG_FUNCTION (this << " " << quantum);
+  m_quantum = std::max<uint32_t> (quantum, 1);
+}
+
+uint32_t
+BpBundleScheduler::GetQuantum () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_quantum;
+}
+
+uint32_t
+BpBundleScheduler::GetSize () const
+{
+  NS_LOG_FUNCTION (this);
+  uint32_t size = 0;
+  for (uint8_t c = 0; c < BP_PRIORITY_CLASSES; c++)
+    size += m_backlog[c];
+
+  return size;
+}
+
+uint32_t
+BpBundleScheduler::GetSize (const BpEndpointId &src) const
+{
+  NS_LOG_FUNCTION (this << " " << src.Uri ());
+  const uint32_t *index = m_flowIndex.Find (src);
+  if (index == NULL)
+    return 0;
+
+  return m_flows[*index].size;
+}
+
+void
+BpBundleScheduler::GetRecords (std::vector<Ptr<BpStoredBundle> > &records) const
+{
+  NS_LOG_FUNCTION (this);
+  records.clear ();
+  for (uint32_t i = 0; i < m_flows.size (); i++)
+    {
+      for (uint8_t c = 0; c < BP_PRIORITY_CLASSES; c++)
+        {
+          // the removed bundles are left in the queues until they reach the head
+          const std::deque<Ptr<BpStoredBundle> > &queue = m_flows[i].queues[c];
+          for (uint32_t j = 0; j < queue.size (); j++)
+            {
+              if (queue[j]->IsStored ())
+                records.push_back (queue[j]);
+            }
+        }
+    }
+}
+
+BpLatencyStats
+BpBundleScheduler::GetLatencyStats (uint8_t priority) const
+{
+  NS_LOG_FUNCTION (this << " " << (uint16_t) priority);
+  if (priority >= BP_PRIORITY_CLASSES)
+    return BpLatencyStats ();
+
+  return m_stats[priority];
+}
+
+void
+BpBundleScheduler::Clear ()
+{
+  NS_LOG_FUNCTION (this);
+  m_flows.clear ();
+  m_flowIndex.Clear ();
+  for (uint8_t c = 0; c < BP_PRIORITY_CLASSES; c++)
+    {
+      m_active[c].clear ();
+      m_turn[c] = false;
+      m_backlog[c] = 0;
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,231 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+#ifndef BP_BUNDLE_SCHEDULER_H
+#define BP_BUNDLE_SCHEDULER_H
+
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include "ns3/ptr.h"
+#include "ns3/packet.h"
+#include "ns3/nstime.h"
+#include "bp-endpoint-id.h"
+#include "bp-endpoint-map.h"
+#include "bp-stored-bundle.h"
+
+namespace ns3 {
+
+/**
+ * \brief the queueing delay statistics of a class of service
+ */
+struct BpLatencyStats {
+  BpLatencyStats ()
+    : bundles (0),
+      total (Seconds (0)),
+      max (Seconds (0))
+    {
+    }
+
+  /**
+   * \return the mean queueing delay, or zero if no bundle was dequeued
+   */
+  Time GetMean () const
+    {
+      if (bundles == 0)
+        return Seconds (0);
+      return total / (int64_t) bundles;
+    }
+
+  uint64_t bundles;  /// number of dequeued bundles
+  Time total;        /// sum of the queueing delays
+  Time max;          /// largest queueing delay
+};
+
+/**
+ * \brief The class of service scheduler of the sent bundle storage
+ *
+ * The bundles are stored in one FIFO queue per source endpoint id and per
+ * class of service (bulk, normal and expedited, section 4.2 of RFC 5050).
+ * The classes are served in strict priority order, so an expedited bundle
+ * never waits behind normal or bulk bundles stored in this node.
+ *
+ * Dequeue (src) serves the bundles of a single source endpoint id. Dequeue (),
+ * which the convergence layers drain the storage with, serves the bundles of
+ * all sources: within a class, the sources are served in
+ * round robin order, or, if weighted fair queuing is enabled, by deficit round
+ * robin with a quantum of weight * quantum bytes per source. Both are O(1) as
+ * long as the quantum is not smaller than the bundles.
+ *
+ * A bundle removed before its turn (e.g., it is expired) is released at once
+ * and its empty record is skipped when it reaches the head of its queue.
+ */
+class BpBundleScheduler
+{
+public:
+  BpBundleScheduler ();
+  virtual ~BpBundleScheduler ();
+
+  /**
+   * \brief Store a bundle
+   *
+   * The bundle is queued by the source endpoint id and the class of service
+   * of the record.
+   *
+   * \param record the stored bundle
+   */
+  void Enqueue (Ptr<BpStoredBundle> record);
+
+  /**
+   * \brief Get and delete the most urgent bundle of a source endpoint id
+   *
+   * \param src the source endpoint id
+   *
+   * \return the stored bundle, or NULL if no bundle of src is stored
+   */
+  Ptr<BpStoredBundle> Dequeue (const BpEndpointId &src);
+
+  /**
+   * \brief Get and delete the next bundle of all source endpoint ids
+   *
+   * \return the stored bundle, or NULL if no bundle is stored
+   */
+  Ptr<BpStoredBundle> Dequeue ();
+
+  /**
+   * \brief Delete a stored bundle before its turn, in O(1)
+   *
+   * \param record the stored bundle
+   *
+   * \return false if the bundle is not in the storage
+   */
+  bool Remove (Ptr<BpStoredBundle> record);
+
+  /**
+   * \param src the source endpoint id
+   * \param weight the weight of src in weighted fair queuing, at least 1
+   */
+  void SetWeight (const BpEndpointId &src, uint32_t weight);
+
+  /**
+   * \param enable enable or disable weighted fair queuing across source endpoint ids
+   */
+  void SetWeightedFairQueuing (bool enable);
+
+  /**
+   * \return true if weighted fair queuing is enabled
+   */
+  bool GetWeightedFairQueuing () const;
+
+  /**
+   * \param quantum the bytes credited to a source of weight 1 in each round
+   */
+  void SetQuantum (uint32_t quantum);
+
+  /**
+   * \return the bytes credited to a source of weight 1 in each round
+   */
+  uint32_t GetQuantum () const;
+
+  /**
+   * \return the number of stored bundles
+   */
+  uint32_t GetSize () const;
+
+  /**
+   * \param src the source endpoint id
+   *
+   * \return the number of stored bundles of src
+   */
+  uint32_t GetSize (const BpEndpointId &src) const;
+
+  /**
+   * \brief Get the stored bundles, without removing them
+   *
+   * \param records set to the stored bundles, by source endpoint id and
+   * class of service, in FIFO order within a class
+   */
+  void GetRecords (std::vector<Ptr<BpStoredBundle> > &records) const;
+
+  /**
+   * \param priority the class of service, see BpHeader::PriorityClass
+   *
+   * \return the queueing delay statistics of the class
+   */
+  BpLatencyStats GetLatencyStats (uint8_t priority) const;
+
+  /**
+   * \brief Drop all stored bundles
+   */
+  void Clear ();
+
+private:
+  enum
+  {
+    BP_PRIORITY_CLASSES = 3   /// bulk, normal and expedited
+  };
+
+  /**
+   * \brief the queues of a source endpoint id
+   */
+  struct Flow {
+    Flow ();
+
+    std::deque<Ptr<BpStoredBundle> > queues[BP_PRIORITY_CLASSES];  /// FIFO queue of each class
+    uint32_t deficit[BP_PRIORITY_CLASSES];                         /// deficit counter of each class, in bytes
+    bool active[BP_PRIORITY_CLASSES];                              /// the flow is in the round robin list of the class
+    uint32_t weight;                                               /// weight in weighted fair queuing
+    uint32_t size;                                                 /// number of stored bundles
+  };
+
+  /**
+   * \return the index of the flow of src, the flow is created if it is new
+   */
+  uint32_t GetFlow (const BpEndpointId &src);
+
+  /**
+   * \brief Get and delete the head of a queue, and update the statistics
+   */
+  Ptr<BpStoredBundle> Pop (uint32_t flow, uint8_t priority);
+
+  /**
+   * \brief Drop the removed bundles at the head of a queue
+   *
+   * \return true if the queue holds a bundle
+   */
+  bool Purge (uint32_t flow, uint8_t priority);
+
+  /**
+   * \brief Remove the head of the round robin list of a class
+   */
+  void Deactivate (uint8_t priority);
+
+  std::vector<Flow> m_flows;                              /// the flows, indexed by flow index
+  BpEndpointMap<uint32_t> m_flowIndex;                    /// the flow index of each source endpoint id
+  std::deque<uint32_t> m_active[BP_PRIORITY_CLASSES];     /// round robin list of the flows that may have bundles in each class
+  bool m_turn[BP_PRIORITY_CLASSES];                       /// the head of the round robin list already got its quantum
+  uint32_t m_backlog[BP_PRIORITY_CLASSES];                /// number of stored bundles in each class
+  BpLatencyStats m_stats[BP_PRIORITY_CLASSES];            /// queueing delay statistics of each class
+  bool m_wfq;                                             /// weighted fair queuing is enabled
+  uint32_t m_quantum;                                     /// bytes credited to a source of weight 1 in each round
+};
+
+} // namespace ns3
+
+#endif /* BP_BUNDLE_SCHEDULER_H */
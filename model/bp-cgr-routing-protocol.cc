@@ -0,0 +1,468 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#include "bp-cgr-routing-protocol.h"
+#include "bp-header.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/string.h"
+#include <algorithm>
+#include <utility>
+
+NS_LOG_COMPONENT_DEFINE ("BpCgrRoutingProtocol");
+
+namespace ns3 {
+
+/**
+ * \return true if the cost of a is lower than the cost of b
+ */
+static bool
+CompareCost (const BpNextHop &a, const BpNextHop &b)
+{
+  return a.cost < b.cost;
+}
+
+TypeId
+BpCgrRoutingProtocol::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpCgrRoutingProtocol")
+    .SetParent<BpRoutingProtocol> ()
+    .AddConstructor<BpCgrRoutingProtocol> ()
+    .AddAttribute ("ContactPlan", "File of the contacts between the nodes, see BpContactPlan",
+           StringValue (""),
+           MakeStringAccessor (&BpCgrRoutingProtocol::SetContactPlanFile,
+                               &BpCgrRoutingProtocol::GetContactPlanFile),
+           MakeStringChecker ())
+    .AddAttribute ("Port", "Port of the convergence layer of the next hops",
+           UintegerValue (4556),
+           MakeUintegerAccessor (&BpCgrRoutingProtocol::m_port),
+           MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("MaxRoutes", "Max number of cached routes to a destination node",
+           UintegerValue (4),
+           MakeUintegerAccessor (&BpCgrRoutingProtocol::m_maxRoutes),
+           MakeUintegerChecker<uint32_t> (1))
+  ;
+  return tid;
+}
+
+BpCgrRoutingProtocol::BpCgrRoutingProtocol ()
+  : m_local (Ipv4Address::GetAny ()),
+    m_port (4556),
+    m_maxRoutes (4),
+    m_searches (0),
+    m_version (0),
+    m_bp (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpCgrRoutingProtocol::~BpCgrRoutingProtocol ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BpCgrRoutingProtocol::SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol)
+{
+  NS_LOG_FUNCTION (this << " " << bundleProtocol);
+  m_bp = bundleProtocol;
+}
+
+void
+BpCgrRoutingProtocol::SetLocalAddress (Ipv4Address address)
+{
+  NS_LOG_FUNCTION (this << " " << address);
+  m_local = address;
+  BuildGraph ();
+}
+
+void
+BpCgrRoutingProtocol::SetContactPlan (const BpContactPlan &plan)
+{
+  NS_LOG_FUNCTION (this);
+  std::vector<BpContact> contacts = plan.GetAllContacts ();
+  m_contacts.clear ();
+  for (uint32_t i = 0; i < contacts.size (); i++)
+    {
+      Contact contact;
+      contact.contact = contacts[i];
+      contact.residual = contacts[i].GetVolume ();
+      m_contacts.push_back (contact);
+    }
+
+  BuildGraph ();
+}
+
+void
+BpCgrRoutingProtocol::SetContactPlanFile (std::string fileName)
+{
+  NS_LOG_FUNCTION (this << " " << fileName);
+  m_contactPlanFile = fileName;
+  BpContactPlan plan;
+  if (!fileName.empty () && !plan.Load (fileName))
+    NS_FATAL_ERROR ("BpCgrRoutingProtocol::SetContactPlanFile (): invalid contact plan " << fileName);
+
+  SetContactPlan (plan);
+}
+
+std::string
+BpCgrRoutingProtocol::GetContactPlanFile (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_contactPlanFile;
+}
+
+void
+BpCgrRoutingProtocol::BuildGraph ()
+{
+  NS_LOG_FUNCTION (this);
+  m_outgoing.clear ();
+  m_routes.clear ();
+  m_users.clear ();
+  for (uint32_t i = 0; i < m_contacts.size (); i++)
+    {
+      Ipv4Address from = m_contacts[i].contact.from;
+      if (from == Ipv4Address::GetAny ())
+        from = m_local;
+
+      m_outgoing[from].push_back (i);
+    }
+}
+
+int
+BpCgrRoutingProtocol::AddEndpoint (BpEndpointId eid, Ipv4Address node)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri () << " " << node);
+  if (!m_nodes.Insert (eid, node))
+    return -1;
+
+  return 0;
+}
+
+bool
+BpCgrRoutingProtocol::GetNode (const BpEndpointId &dst, Ipv4Address &node) const
+{
+  NS_LOG_FUNCTION (this << " " << dst.Uri ());
+  const Ipv4Address *address = m_nodes.Find (dst);
+  if (address == NULL || *address == m_local)
+    return false;
+
+  node = *address;
+  return true;
+}
+
+bool
+BpCgrRoutingProtocol::SearchRoute (Ipv4Address node, const std::vector<bool> &excluded, Route &route)
+{
+  NS_LOG_FUNCTION (this << " " << node);
+  m_searches++;
+
+  // the earliest arrival time at the next hop of each contact, and the
+  // previous contact on the way
+  uint32_t none = m_contacts.size ();
+  std::vector<Time> arrival (m_contacts.size (), Time::Max ());
+  std::vector<uint32_t> previous (m_contacts.size (), none);
+  std::vector<bool> done (m_contacts.size (), false);
+  std::set<std::pair<Time, uint32_t> > queue;
+
+  Ipv4Address at = m_local;
+  Time time = Simulator::Now ();
+  uint32_t current = none;
+  while (true)
+    {
+      // the contacts from the node the bundle is at
+      std::map<Ipv4Address, std::vector<uint32_t> >::const_iterator it = m_outgoing.find (at);
+      for (uint32_t i = 0; it != m_outgoing.end () && i < it->second.size (); i++)
+        {
+          uint32_t next = it->second[i];
+          const BpContact &contact = m_contacts[next].contact;
+          if (done[next] || excluded[next] || m_contacts[next].residual == 0 || time >= contact.end)
+            continue;
+
+          Time start = time > contact.start ? time : contact.start;
+          if (start + contact.owlt < arrival[next])
+            {
+              if (arrival[next] != Time::Max ())
+                queue.erase (std::make_pair (arrival[next], next));
+              arrival[next] = start + contact.owlt;
+              previous[next] = current;
+              queue.insert (std::make_pair (arrival[next], next));
+            }
+        }
+
+      // the contact of earliest arrival, the routes do not go back through the local node
+      do
+        {
+          if (queue.empty ())
+            return false;
+
+          current = queue.begin ()->second;
+          queue.erase (queue.begin ());
+          done[current] = true;
+          at = m_contacts[current].contact.nextHop;
+        }
+      while (at == m_local);
+
+      if (at == node)
+        break;
+
+      time = arrival[current];
+    }
+
+  route.hops.clear ();
+  for (uint32_t hop = current; hop != none; hop = previous[hop])
+    route.hops.push_back (hop);
+  std::reverse (route.hops.begin (), route.hops.end ());
+
+  route.nextHop = m_contacts[route.hops[0]].contact.nextHop;
+  route.end = Time::Max ();
+  for (uint32_t i = 0; i < route.hops.size (); i++)
+    {
+      if (m_contacts[route.hops[i]].contact.end < route.end)
+        route.end = m_contacts[route.hops[i]].contact.end;
+    }
+
+  return true;
+}
+
+void
+BpCgrRoutingProtocol::ComputeRoutes (Ipv4Address node)
+{
+  NS_LOG_FUNCTION (this << " " << node);
+  RouteList &list = m_routes[node];
+  list.routes.clear ();
+  list.version = m_version;
+  list.expired = false;
+
+  // each next route is searched without the contact which ends first in the previous one
+  std::vector<bool> excluded (m_contacts.size (), false);
+  Route route;
+  while (list.routes.size () < m_maxRoutes && SearchRoute (node, excluded, route))
+    {
+      uint32_t limiting = route.hops[0];
+      for (uint32_t i = 0; i < route.hops.size (); i++)
+        {
+          m_users[route.hops[i]].insert (node);
+          if (m_contacts[route.hops[i]].contact.end < m_contacts[limiting].contact.end)
+            limiting = route.hops[i];
+        }
+
+      excluded[limiting] = true;
+      list.routes.push_back (route);
+    }
+
+  NS_LOG_DEBUG ("BpCgrRoutingProtocol::ComputeRoutes (): " << list.routes.size () << " routes to " << node);
+}
+
+bool
+BpCgrRoutingProtocol::GetArrival (const Route &route, uint32_t size, Time &arrival) const
+{
+  NS_LOG_FUNCTION (this << " " << size);
+  Time time = Simulator::Now ();
+  for (uint32_t i = 0; i < route.hops.size (); i++)
+    {
+      const Contact &contact = m_contacts[route.hops[i]];
+      if (contact.residual == 0 || contact.residual < size)
+        return false;
+
+      Time start = time > contact.contact.start ? time : contact.contact.start;
+      Time sent = start + Seconds (size * 8.0 / contact.contact.rate);
+      if (start >= contact.contact.end || sent > contact.contact.end)
+        return false;
+
+      time = sent + contact.contact.owlt;
+    }
+
+  arrival = time;
+  return true;
+}
+
+const BpCgrRoutingProtocol::Route*
+BpCgrRoutingProtocol::SelectRoute (Ipv4Address node, uint32_t size, const Ipv4Address *nextHop, Time &arrival)
+{
+  NS_LOG_FUNCTION (this << " " << node << " " << size);
+  std::map<Ipv4Address, RouteList>::iterator it = m_routes.find (node);
+  bool computed = false;
+  if (it == m_routes.end ())
+    {
+      ComputeRoutes (node);
+      it = m_routes.find (node);
+      computed = true;
+    }
+
+  RouteList &list = it->second;
+  while (true)
+    {
+      // the routes over are dropped
+      Time now = Simulator::Now ();
+      uint32_t kept = 0;
+      for (uint32_t i = 0; i < list.routes.size (); i++)
+        {
+          if (list.routes[i].end > now)
+            list.routes[kept++] = list.routes[i];
+        }
+
+      if (kept < list.routes.size ())
+        {
+          list.routes.resize (kept);
+          list.expired = true;
+        }
+
+      const Route *best = NULL;
+      for (uint32_t i = 0; i < list.routes.size (); i++)
+        {
+          Time time;
+          if ((nextHop == NULL || list.routes[i].nextHop == *nextHop) &&
+              GetArrival (list.routes[i], size, time) && (best == NULL || time < arrival))
+            {
+              best = &list.routes[i];
+              arrival = time;
+            }
+        }
+
+      // the contact graph may have other routes than the cached ones only
+      // if a route is over or volumes are consumed since they are computed
+      if (best || computed || (!list.expired && list.version == m_version))
+        return best;
+
+      ComputeRoutes (node);
+      computed = true;
+    }
+}
+
+void
+BpCgrRoutingProtocol::Invalidate (uint32_t contact)
+{
+  NS_LOG_FUNCTION (this << " " << contact);
+  std::map<uint32_t, std::set<Ipv4Address> >::iterator it = m_users.find (contact);
+  if (it == m_users.end ())
+    return;
+
+  for (std::set<Ipv4Address>::iterator node = it->second.begin (); node != it->second.end (); ++node)
+    m_routes.erase (*node);
+
+  m_users.erase (it);
+}
+
+bool
+BpCgrRoutingProtocol::GetNextHops (const BpEndpointId &dst, std::vector<BpNextHop> &nextHops)
+{
+  NS_LOG_FUNCTION (this << " " << dst.Uri ());
+  nextHops.clear ();
+  Ipv4Address node;
+  Time arrival;
+  if (!GetNode (dst, node) || SelectRoute (node, 0, NULL, arrival) == NULL)
+    return false;
+
+  // the best route through each next hop
+  Time now = Simulator::Now ();
+  const std::vector<Route> &routes = m_routes[node].routes;
+  for (uint32_t i = 0; i < routes.size (); i++)
+    {
+      if (!GetArrival (routes[i], 0, arrival))
+        continue;
+
+      uint32_t cost = (arrival - now).GetMilliSeconds ();
+      uint32_t j = 0;
+      while (j < nextHops.size () && nextHops[j].address.GetIpv4 () != routes[i].nextHop)
+        j++;
+
+      if (j == nextHops.size ())
+        nextHops.push_back (BpNextHop (InetSocketAddress (routes[i].nextHop, m_port), cost));
+      else if (cost < nextHops[j].cost)
+        nextHops[j].cost = cost;
+    }
+
+  std::stable_sort (nextHops.begin (), nextHops.end (), CompareCost);
+  return !nextHops.empty ();
+}
+
+bool
+BpCgrRoutingProtocol::GetNextHop (const BpEndpointId &dst, InetSocketAddress &address)
+{
+  NS_LOG_FUNCTION (this << " " << dst.Uri ());
+  return GetBundleNextHop (dst, 0, address);
+}
+
+bool
+BpCgrRoutingProtocol::GetBundleNextHop (const BpEndpointId &dst, uint32_t size, InetSocketAddress &address)
+{
+  NS_LOG_FUNCTION (this << " " << dst.Uri () << " " << size);
+  Ipv4Address node;
+  Time arrival;
+  const Route *route = NULL;
+  if (GetNode (dst, node))
+    route = SelectRoute (node, size, NULL, arrival);
+
+  if (route == NULL)
+    return false;
+
+  address = InetSocketAddress (route->nextHop, m_port);
+  return true;
+}
+
+void
+BpCgrRoutingProtocol::NotifyForward (Ptr<const Packet> bundle, const InetSocketAddress &nextHop)
+{
+  NS_LOG_FUNCTION (this << " " << bundle << " " << nextHop.GetIpv4 ());
+  BpHeader bph;
+  bundle->PeekHeader (bph);
+
+  Ipv4Address node;
+  Ipv4Address hop = nextHop.GetIpv4 ();
+  Time arrival;
+  const Route *route = NULL;
+  if (GetNode (bph.GetDestinationEid (), node))
+    route = SelectRoute (node, bundle->GetSize (), &hop, arrival);
+
+  if (route)
+    {
+      // the route may be dropped when one of its contacts runs out of volume
+      std::vector<uint32_t> hops = route->hops;
+      m_version++;
+      for (uint32_t i = 0; i < hops.size (); i++)
+        {
+          Contact &contact = m_contacts[hops[i]];
+          contact.residual -= std::min<uint64_t> (contact.residual, bundle->GetSize ());
+          if (contact.residual == 0)
+            Invalidate (hops[i]);
+        }
+    }
+
+  BpRoutingProtocol::NotifyForward (bundle, nextHop);
+}
+
+uint32_t
+BpCgrRoutingProtocol::GetRouteSearches () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_searches;
+}
+
+uint32_t
+BpCgrRoutingProtocol::GetCachedRoutes (Ipv4Address node) const
+{
+  NS_LOG_FUNCTION (this << " " << node);
+  std::map<Ipv4Address, RouteList>::const_iterator it = m_routes.find (node);
+  return it == m_routes.end () ? 0 : it->second.routes.size ();
+}
+
+} // namespace ns3
@@ -0,0 +1,245 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+#ifndef BP_CGR_ROUTING_PROTOCOL_H
+#define BP_CGR_ROUTING_PROTOCOL_H
+
+#include "bp-routing-protocol.h"
+#include "bundle-protocol.h"
+#include "bp-endpoint-map.h"
+#include "bp-contact-plan.h"
+#include "ns3/nstime.h"
+#include "ns3/ipv4-address.h"
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+
+namespace ns3 {
+
+/**
+ * \brief The contact graph routing (CGR) protocol
+ *
+ * The vertices of the contact graph are the contacts of a contact plan
+ * between any two nodes, each node being identified by one IPv4 address
+ * reachable from all its neighbors; a contact leads to the contacts which
+ * start from its next hop. A route to a destination node is a path of
+ * contacts, found by a Dijkstra search of the earliest arrival time from
+ * the local node: a bundle waits for the start of each contact, takes its
+ * size divided by the rate of the contact to be transmitted before the end
+ * of the contact, then the one-way light time to reach the next hop.
+ *
+ * The routes to a destination node are computed once and cached: the
+ * first one is the route of earliest arrival, each next one is found
+ * without the contact which ends first in the previous one. The bundles
+ * forwarded through a route consume the residual volume of its contacts;
+ * for each bundle, the cached route of earliest arrival whose contacts are
+ * not over and can still carry the bundle is selected. The routes are only
+ * recomputed when needed: the routes over are dropped, the routes of the
+ * destinations whose routes use a contact without residual volume left
+ * are recomputed, and so are the routes when none of them can carry a
+ * bundle.
+ *
+ * The destination endpoint ids are mapped to their node with AddEndpoint.
+ */
+class BpCgrRoutingProtocol : public BpRoutingProtocol
+{
+public:
+  static TypeId GetTypeId (void);
+
+  /**
+   * Constructor
+   */
+  BpCgrRoutingProtocol ();
+
+  /**
+   * Destroy
+   */
+  virtual ~BpCgrRoutingProtocol ();
+
+  /**
+   * \brief Set bundle protocol
+   *
+   * \param bundleProtocol bundle protocol
+   */
+  virtual void SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol);
+
+  /**
+   * \brief Set the address which identifies the local node in the contact plan
+   */
+  void SetLocalAddress (Ipv4Address address);
+
+  /**
+   * \brief Replace the contact graph by the contacts of a contact plan, the
+   * contacts of the local node in the plan start from the local address
+   */
+  void SetContactPlan (const BpContactPlan &plan);
+
+  /**
+   * \brief Map an endpoint id to the node it is registered on
+   *
+   * \return -1 if eid is already mapped, 0 otherwise
+   */
+  int AddEndpoint (BpEndpointId eid, Ipv4Address node);
+
+  /**
+   * \brief The candidate next hops are the first hops of the cached routes
+   * which are not over, with the delay until their arrival time in
+   * milliseconds as cost
+   */
+  virtual bool GetNextHops (const BpEndpointId &dst, std::vector<BpNextHop> &nextHops);
+
+  /**
+   * \brief The first hop of the route of earliest arrival
+   */
+  virtual bool GetNextHop (const BpEndpointId &dst, InetSocketAddress &address);
+
+  /**
+   * \brief The first hop of the route of earliest arrival of a bundle of size bytes
+   */
+  virtual bool GetBundleNextHop (const BpEndpointId &dst, uint32_t size, InetSocketAddress &address);
+
+  /**
+   * \brief Consume the volume of the bundle on the contacts of its route
+   * through nextHop, then call the forward callback
+   */
+  virtual void NotifyForward (Ptr<const Packet> bundle, const InetSocketAddress &nextHop);
+
+  /**
+   * \return the number of route searches in the contact graph so far
+   */
+  uint32_t GetRouteSearches () const;
+
+  /**
+   * \param node the address of a destination node
+   *
+   * \return the number of routes to node in the cache
+   */
+  uint32_t GetCachedRoutes (Ipv4Address node) const;
+
+private:
+  /**
+   * \brief a contact of the contact graph
+   */
+  struct Contact
+  {
+    BpContact contact;     /// the contact
+    uint64_t residual;     /// the bytes the contact can still carry
+  };
+
+  /**
+   * \brief a route to a destination node
+   */
+  struct Route
+  {
+    std::vector<uint32_t> hops;    /// the indexes of the contacts of the route, in order
+    Ipv4Address nextHop;           /// the next hop of the first contact
+    Time end;                      /// the end of the contact of the route which ends first
+  };
+
+  /**
+   * \brief the cached routes of a destination node
+   */
+  struct RouteList
+  {
+    std::vector<Route> routes;     /// the routes, the first one is the route of earliest arrival
+    uint32_t version;              /// the version of the residual volumes the routes are computed with
+    bool expired;                  /// true if a route is over since the routes are computed
+  };
+
+  /**
+   * \brief Set the contact plan from the file of the ContactPlan attribute
+   */
+  void SetContactPlanFile (std::string fileName);
+
+  /**
+   * \return the file of the contact plan
+   */
+  std::string GetContactPlanFile (void) const;
+
+  /**
+   * \brief Build the contacts from each node, and clear the cached routes
+   */
+  void BuildGraph ();
+
+  /**
+   * \brief Find the node of a destination endpoint id
+   *
+   * \return false if dst is not mapped, or is on the local node
+   */
+  bool GetNode (const BpEndpointId &dst, Ipv4Address &node) const;
+
+  /**
+   * \brief Search the route of earliest arrival to a node in the contact graph
+   *
+   * \param node the destination node
+   * \param excluded the contacts the route may not use
+   * \param route set to the route
+   *
+   * \return false if there is no route to node
+   */
+  bool SearchRoute (Ipv4Address node, const std::vector<bool> &excluded, Route &route);
+
+  /**
+   * \brief Compute the cached routes of a destination node
+   */
+  void ComputeRoutes (Ipv4Address node);
+
+  /**
+   * \brief Find the arrival time of a bundle forwarded now through a route
+   *
+   * \return false if a contact of the route is over or cannot carry the bundle
+   */
+  bool GetArrival (const Route &route, uint32_t size, Time &arrival) const;
+
+  /**
+   * \brief Select the cached route of earliest arrival of a bundle
+   *
+   * \param node the destination node
+   * \param size the size of the bundle
+   * \param nextHop if not NULL, only the routes through this next hop are considered
+   * \param arrival set to the arrival time of the bundle
+   *
+   * \return the route, or NULL if no route can carry the bundle
+   */
+  const Route* SelectRoute (Ipv4Address node, uint32_t size, const Ipv4Address *nextHop, Time &arrival);
+
+  /**
+   * \brief Drop the cached routes of the destinations whose routes use a contact
+   */
+  void Invalidate (uint32_t contact);
+
+  std::vector<Contact> m_contacts;                                /// the vertices of the contact graph
+  std::map<Ipv4Address, std::vector<uint32_t> > m_outgoing;       /// the contacts from each node
+  std::map<Ipv4Address, RouteList> m_routes;                      /// the cached routes of each destination node
+  std::map<uint32_t, std::set<Ipv4Address> > m_users;             /// the destination nodes whose cached routes use each contact
+  BpEndpointMap<Ipv4Address> m_nodes;                             /// the node of each endpoint id
+  std::string m_contactPlanFile;                                  /// the file of the contact plan
+  Ipv4Address m_local;                                            /// the address of the local node
+  uint16_t m_port;                                                /// the port of the convergence layer of the next hops
+  uint32_t m_maxRoutes;                                           /// max number of cached routes per destination node
+  uint32_t m_searches;                                            /// number of route searches
+  uint32_t m_version;                                             /// incremented each time residual volumes are consumed
+  Ptr<BundleProtocol> m_bp;                                       /// bundle protocol
+};
+
+
+}  // namespace ns3
+
+#endif /* BP_CGR_ROUTING_PROTOCOL_H */
@@ -48,5 +48,33 @@ BpClaProtocol::~BpClaProtocol ()
   NS_LOG_FUNCTION (this);
 }
 
+uint32_t
+BpClaProtocol::GetMaxBundleSize ()
+{
+  NS_LOG_FUNCTION (this);
+  return 0;
+}
+
+uint64_t
+BpClaProtocol::GetContactVolume (const BpEndpointId &dst)
+{
+  NS_LOG_FUNCTION (this);
+  return 0;
+}
+
+int
+BpClaProtocol::ForwardBundle (Ptr<Packet> bundle, const InetSocketAddress &nextHop)
+{
+  NS_LOG_FUNCTION (this << " " << bundle);
+  return -1;
+}
+
+uint16_t
+BpClaProtocol::GetDefaultPort ()
+{
+  NS_LOG_FUNCTION (this);
+  return 0;
+}
+
 } // namespace ns3
 
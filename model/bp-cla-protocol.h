@@ -31,6 +31,7 @@ class Packet;
 class BundleProtocol;
 class BpEndpointId;
 class BpRoutingProtocol;
+class InetSocketAddress;
 
 
 /**
@@ -99,6 +100,46 @@ public:
    */
   virtual Ptr<Socket> GetL4Socket (Ptr<Packet> packet) = 0;
 
+  /**
+   * Get the largest bundle carried by the transport layer, the bundle
+   * protocol fragments the ADUs so that their bundles fit it
+   *
+   * \return the size in bytes, or 0 if the size is unlimited
+   */
+  virtual uint32_t GetMaxBundleSize ();
+
+  /**
+   * Get the bytes the next contact to the next hop of a destination can
+   * still carry, the bundle protocol sizes the bundles so that they fit it
+   *
+   * \param dst the destination endpoint id
+   *
+   * \return the volume in bytes, or 0 if it is unlimited
+   */
+  virtual uint64_t GetContactVolume (const BpEndpointId &dst);
+
+  /**
+   * Send a bundle to a given next hop whatever its destination, for the
+   * routing protocols which replicate the bundles
+   *
+   * \param bundle the bundle
+   * \param nextHop the address of the next hop
+   *
+   * \return -1 if the convergence layer cannot send bundles to a given next
+   * hop, which is the default
+   */
+  virtual int ForwardBundle (Ptr<Packet> bundle, const InetSocketAddress &nextHop);
+
+  /**
+   * Get the port the convergence layer listens on for a local endpoint id
+   * without route, which is the port of the peers met by the routing
+   * protocols which replicate the bundles
+   *
+   * \return the port, or 0 if the convergence layer has no default port,
+   * which is the default
+   */
+  virtual uint16_t GetDefaultPort ();
+
   /**
    * Set the bundle routing protocol
    *
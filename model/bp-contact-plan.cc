@@ -0,0 +1,285 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#include "ns3/log.h"
+#include "bp-contact-plan.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+NS_LOG_COMPONENT_DEFINE ("BpContactPlan");
+
+namespace ns3 {
+
+/**
+ * \brief Parse a dotted-decimal IPv4 address
+ *
+ * \return false if str is not an IPv4 address
+ */
+static bool
+ParseIpv4 (const std::string &str, Ipv4Address &address)
+{
+  std::istringstream is (str);
+  uint32_t value = 0;
+  for (uint32_t i = 0; i < 4; i++)
+    {
+      uint32_t byte;
+      char dot;
+      if (!(is >> byte) || byte > 255 || (i < 3 && (!(is >> dot) || dot != '.')))
+        return false;
+      value = (value << 8) | byte;
+    }
+
+  if (is.peek () != std::istringstream::traits_type::eof ())
+    return false;
+
+  address = Ipv4Address (value);
+  return true;
+}
+
+uint64_t
+BpContact::GetVolume () const
+{
+  return GetVolume (start);
+}
+
+uint64_t
+BpContact::GetVolume (Time now) const
+{
+  if (now >= end)
+    return 0;
+
+  Time from = now > start ? now : start;
+  return (uint64_t) (rate * (end - from).GetSeconds () / 8);
+}
+
+BpContactPlan::BpContactPlan ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpContactPlan::~BpContactPlan ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+bool
+BpContactPlan::AddContact (const BpContact &contact)
+{
+  NS_LOG_FUNCTION (this << " " << contact.from << " " << contact.nextHop << " " << contact.start << " " << contact.end);
+  if (contact.end <= contact.start || contact.rate == 0 || contact.owlt < Seconds (0))
+    return false;
+
+  // the contacts of a link are sorted by start time
+  std::vector<BpContact> &contacts = m_contacts[Link (contact.from, contact.nextHop)];
+  std::vector<BpContact>::iterator it = contacts.begin ();
+  while (it != contacts.end () && it->start < contact.start)
+    ++it;
+
+  if ((it != contacts.end () && it->start < contact.end) ||
+      (it != contacts.begin () && (it - 1)->end > contact.start))
+    {
+      NS_LOG_WARN ("BpContactPlan::AddContact (): the contact overlaps another contact with " << contact.nextHop);
+      return false;
+    }
+
+  contacts.insert (it, contact);
+  return true;
+}
+
+bool
+BpContactPlan::Load (const std::string &fileName)
+{
+  NS_LOG_FUNCTION (this << " " << fileName);
+  std::ifstream file (fileName.c_str ());
+  if (!file)
+    {
+      NS_LOG_WARN ("BpContactPlan::Load (): cannot open " << fileName);
+      return false;
+    }
+
+  return Load (file);
+}
+
+bool
+BpContactPlan::Load (std::istream &is)
+{
+  NS_LOG_FUNCTION (this);
+  std::string line;
+  uint32_t number = 0;
+  while (std::getline (is, line))
+    {
+      number++;
+      std::istringstream fields (line);
+      std::string keyword;
+      if (!(fields >> keyword) || keyword[0] == '#')
+        continue;
+
+      // the start, end and nodes, then the rate and one-way light time
+      double start, end;
+      std::vector<std::string> tokens;
+      std::string token;
+      if (keyword == "contact" && (fields >> start >> end))
+        {
+          while (fields >> token)
+            tokens.push_back (token);
+        }
+
+      BpContact contact;
+      double owlt = 0;
+      bool valid = tokens.size () >= 2 && tokens.size () <= 4;
+      if (valid && tokens.size () >= 3)
+        valid = ParseIpv4 (tokens[0], contact.from);
+      if (valid)
+        {
+          uint32_t nodes = tokens.size () == 2 ? 1 : 2;
+          std::istringstream rate (tokens[nodes]);
+          valid = ParseIpv4 (tokens[nodes - 1], contact.nextHop) && (rate >> contact.rate) && rate.eof ();
+          if (valid && tokens.size () == 4)
+            {
+              std::istringstream delay (tokens[3]);
+              valid = (delay >> owlt) && delay.eof ();
+            }
+        }
+
+      if (!valid)
+        {
+          NS_LOG_WARN ("BpContactPlan::Load (): invalid contact at line " << number << ": " << line);
+          return false;
+        }
+
+      contact.start = Seconds (start);
+      contact.end = Seconds (end);
+      contact.owlt = Seconds (owlt);
+      if (!AddContact (contact))
+        {
+          NS_LOG_WARN ("BpContactPlan::Load (): invalid contact at line " << number << ": " << line);
+          return false;
+        }
+    }
+
+  return true;
+}
+
+void
+BpContactPlan::SetLocalAddresses (const std::vector<Ipv4Address> &addresses)
+{
+  NS_LOG_FUNCTION (this << " " << addresses.size ());
+  m_local = addresses;
+}
+
+std::vector<const std::vector<BpContact>*>
+BpContactPlan::FindLocal (Ipv4Address nextHop) const
+{
+  std::vector<const std::vector<BpContact>*> result;
+  std::map<Link, std::vector<BpContact> >::const_iterator it = m_contacts.find (Link (Ipv4Address::GetAny (), nextHop));
+  if (it != m_contacts.end ())
+    result.push_back (&it->second);
+
+  for (uint32_t i = 0; i < m_local.size (); i++)
+    {
+      it = m_contacts.find (Link (m_local[i], nextHop));
+      if (it != m_contacts.end () && m_local[i] != Ipv4Address::GetAny ())
+        result.push_back (&it->second);
+    }
+
+  return result;
+}
+
+/**
+ * \brief Order the contacts by start time
+ */
+static bool
+StartsBefore (const BpContact &a, const BpContact &b)
+{
+  return a.start < b.start;
+}
+
+const BpContact*
+BpContactPlan::GetContact (Ipv4Address nextHop, Time now) const
+{
+  NS_LOG_FUNCTION (this << " " << nextHop << " " << now);
+  std::vector<const std::vector<BpContact>*> links = FindLocal (nextHop);
+  for (uint32_t j = 0; j < links.size (); j++)
+    {
+      const std::vector<BpContact> &contacts = *links[j];
+      for (uint32_t i = 0; i < contacts.size () && contacts[i].start <= now; i++)
+        {
+          if (now < contacts[i].end)
+            return &contacts[i];
+        }
+    }
+
+  return NULL;
+}
+
+std::vector<BpContact>
+BpContactPlan::GetContacts (Ipv4Address nextHop, Time now) const
+{
+  NS_LOG_FUNCTION (this << " " << nextHop << " " << now);
+  std::vector<BpContact> result;
+  std::vector<const std::vector<BpContact>*> links = FindLocal (nextHop);
+  for (uint32_t j = 0; j < links.size (); j++)
+    {
+      for (uint32_t i = 0; i < links[j]->size (); i++)
+        {
+          if ((*links[j])[i].end > now)
+            result.push_back ((*links[j])[i]);
+        }
+    }
+
+  // the contacts keyed by the local addresses are merged with the others
+  if (links.size () > 1)
+    std::stable_sort (result.begin (), result.end (), StartsBefore);
+
+  return result;
+}
+
+bool
+BpContactPlan::HasContacts (Ipv4Address nextHop) const
+{
+  return !FindLocal (nextHop).empty ();
+}
+
+std::vector<BpContact>
+BpContactPlan::GetAllContacts () const
+{
+  NS_LOG_FUNCTION (this);
+  std::vector<BpContact> result;
+  for (std::map<Link, std::vector<BpContact> >::const_iterator it = m_contacts.begin (); it != m_contacts.end (); ++it)
+    result.insert (result.end (), it->second.begin (), it->second.end ());
+
+  return result;
+}
+
+bool
+BpContactPlan::IsEmpty () const
+{
+  return m_contacts.empty ();
+}
+
+void
+BpContactPlan::Clear ()
+{
+  NS_LOG_FUNCTION (this);
+  m_contacts.clear ();
+}
+
+} // namespace ns3
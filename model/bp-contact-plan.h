@@ -0,0 +1,180 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+#ifndef BP_CONTACT_PLAN_H
+#define BP_CONTACT_PLAN_H
+
+#include <stdint.h>
+#include <map>
+#include <utility>
+#include <vector>
+#include <string>
+#include <istream>
+#include "ns3/nstime.h"
+#include "ns3/ipv4-address.h"
+
+namespace ns3 {
+
+/**
+ * \brief a scheduled contact with a next hop
+ */
+struct BpContact
+{
+  BpContact ()
+    : from (Ipv4Address::GetAny ()),
+      rate (0)
+  {
+  }
+
+  /**
+   * \return the bytes the whole contact can carry
+   */
+  uint64_t GetVolume () const;
+
+  /**
+   * \param now the current time
+   *
+   * \return the bytes the contact can still carry from now on
+   */
+  uint64_t GetVolume (Time now) const;
+
+  Time start;             /// the time the link to the next hop is up
+  Time end;               /// the time the link to the next hop is down
+  Ipv4Address from;       /// the address of the sending node, any for the local node
+  Ipv4Address nextHop;    /// the address of the next hop
+  uint64_t rate;          /// the transmission rate of the contact, in bit/s
+  Time owlt;              /// the one-way light time from the sending node to the next hop
+};
+
+/**
+ * \brief The contact plan of a bundle node
+ *
+ * The contacts are the windows during which the link to a next hop is up,
+ * with the rate of the link during the window. The contacts of a next hop
+ * do not overlap; they are kept sorted by start time.
+ *
+ * A contact plan file has one contact per line:
+ *
+ *   contact <start> <end> <next hop> <rate>
+ *   contact <start> <end> <from> <next hop> <rate> [<owlt>]
+ *
+ * where start and end are in seconds from the start of the simulation, the
+ * nodes are IPv4 addresses, the rate is in bit/s and the one-way light time
+ * is in seconds, 0 by default. The first form is a contact of the local
+ * node; the second one is a contact between any two nodes, as used by
+ * contact graph routing. Empty lines and the lines starting with '#' are
+ * ignored.
+ *
+ * The next hop queries only consider the contacts of the local node: those
+ * of the first form, and those of the second form sent from one of the
+ * addresses given to SetLocalAddresses. So a single file describing the
+ * whole network drives both the convergence layer and the contact graph
+ * routing of every node.
+ */
+class BpContactPlan
+{
+public:
+  BpContactPlan ();
+  virtual ~BpContactPlan ();
+
+  /**
+   * \brief Add a contact
+   *
+   * \return false if the contact is empty, or overlaps a contact of the same
+   * node with the same next hop
+   */
+  bool AddContact (const BpContact &contact);
+
+  /**
+   * \brief Add the contacts of a contact plan file
+   *
+   * \param fileName the name of the file
+   *
+   * \return false if the file cannot be read or has an invalid line, the
+   * contacts of the lines before the invalid one are added
+   */
+  bool Load (const std::string &fileName);
+
+  /**
+   * \brief Add the contacts of a contact plan read from a stream
+   *
+   * \return false if the stream has an invalid line
+   */
+  bool Load (std::istream &is);
+
+  /**
+   * \brief Set the addresses of the local node, the contacts sent from them
+   * are contacts of the local node
+   */
+  void SetLocalAddresses (const std::vector<Ipv4Address> &addresses);
+
+  /**
+   * \param nextHop the address of a next hop
+   * \param now the current time
+   *
+   * \return the contact with the next hop at time now, or NULL
+   */
+  const BpContact* GetContact (Ipv4Address nextHop, Time now) const;
+
+  /**
+   * \param nextHop the address of a next hop
+   * \param now the current time
+   *
+   * \return the contacts with the next hop which are not over at time now, in order
+   */
+  std::vector<BpContact> GetContacts (Ipv4Address nextHop, Time now) const;
+
+  /**
+   * \param nextHop the address of a next hop
+   *
+   * \return false if the plan has no contact with the next hop, then the
+   * link to the next hop is always up
+   */
+  bool HasContacts (Ipv4Address nextHop) const;
+
+  /**
+   * \return all the contacts, those of the local node included
+   */
+  std::vector<BpContact> GetAllContacts () const;
+
+  /**
+   * \return true if the plan has no contact
+   */
+  bool IsEmpty () const;
+
+  /**
+   * \brief Remove all contacts
+   */
+  void Clear ();
+
+private:
+  typedef std::pair<Ipv4Address, Ipv4Address> Link;   /// the sending node and the next hop
+
+  /**
+   * \return the contacts of the links from the local node to the next hop
+   */
+  std::vector<const std::vector<BpContact>*> FindLocal (Ipv4Address nextHop) const;
+
+  std::map<Link, std::vector<BpContact> > m_contacts;   /// the contacts of each link, by start time
+  std::vector<Ipv4Address> m_local;                     /// the addresses of the local node
+};
+
+} // namespace ns3
+
+#endif /* BP_CONTACT_PLAN_H */
@@ -0,0 +1,133 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#include "ns3/log.h"
+#include "bp-copy-count-header.h"
+#include "bp-payload-header.h"
+#include "sdnv.h"
+
+NS_LOG_COMPONENT_DEFINE ("BpCopyCountHeader");
+
+namespace ns3 {
+
+BpCopyCountHeader::BpCopyCountHeader ()
+  : m_processingControlFlags (BpPayloadHeader::DISCARD_BLOCK),
+    m_copies (1)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpCopyCountHeader::BpCopyCountHeader (uint32_t copies)
+  : m_processingControlFlags (BpPayloadHeader::DISCARD_BLOCK),
+    m_copies (copies)
+{
+  NS_LOG_FUNCTION (this << " " << copies);
+}
+
+BpCopyCountHeader::~BpCopyCountHeader ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+BpCopyCountHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpCopyCountHeader")
+                      .SetParent<Header> ()
+                      .AddConstructor<BpCopyCountHeader> ();
+
+  return tid;
+}
+
+TypeId
+BpCopyCountHeader::GetInstanceTypeId (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return GetTypeId ();
+}
+
+void
+BpCopyCountHeader::SetCopies (uint32_t copies)
+{
+  NS_LOG_FUNCTION (this << " " << copies);
+  m_copies = copies;
+}
+
+uint32_t
+BpCopyCountHeader::GetCopies () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_copies;
+}
+
+void
+BpCopyCountHeader::Print (std::ostream &os) const
+{
+  NS_LOG_FUNCTION (this);
+  os << "copies " << m_copies;
+}
+
+uint32_t
+BpCopyCountHeader::GetSerializedSize (void) const
+{
+  NS_LOG_FUNCTION (this);
+  SDNV sdnv;
+
+  uint32_t length = sdnv.EncodingLength (m_copies);
+  uint32_t size = 1;
+  size += sdnv.EncodingLength (m_processingControlFlags);
+  size += sdnv.EncodingLength (length);
+  size += length;
+
+  return size;
+}
+
+void
+BpCopyCountHeader::Serialize (Buffer::Iterator start) const
+{
+  NS_LOG_FUNCTION (this);
+  Buffer::Iterator i = start;
+  SDNV sdnv;
+
+  i.WriteU8 (BP_COPY_COUNT_BLOCK_TYPE);
+  sdnv.Encode (m_processingControlFlags, i);
+  sdnv.Encode (sdnv.EncodingLength (m_copies), i);
+  sdnv.Encode (m_copies, i);
+}
+
+uint32_t
+BpCopyCountHeader::Deserialize (Buffer::Iterator start)
+{
+  NS_LOG_FUNCTION (this);
+  Buffer::Iterator i = start;
+  SDNV sdnv;
+
+  i.ReadU8 ();
+  m_processingControlFlags = (uint8_t) sdnv.Decode (i);
+  uint32_t length = (uint32_t) sdnv.Decode (i);
+  Buffer::Iterator data = i;
+  m_copies = (uint32_t) sdnv.Decode (i);
+
+  // the block data is skipped as a whole, whatever its encoding
+  data.Next (length);
+  return data.GetDistanceFrom (start);
+}
+
+} // namespace ns3
@@ -0,0 +1,78 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+#ifndef BP_COPY_COUNT_HEADER_H
+#define BP_COPY_COUNT_HEADER_H
+
+#include <stdint.h>
+#include "ns3/header.h"
+#include "ns3/buffer.h"
+
+// block type of the copy count block, in the private range of section 4.5.2 of RFC 5050
+#define BP_COPY_COUNT_BLOCK_TYPE 192
+
+namespace ns3 {
+
+/**
+ * \brief Copy count extension block
+ *
+ * The block carries the number of copies of a bundle the receiving node is
+ * in charge of, for the spray and wait routing protocol. It is a canonical
+ * block, section 4.5.2 of RFC 5050, whose data is a single SDNV: the block
+ * type, the processing control flags, the block length, then the number of
+ * copies. The block is sent before the payload block, and is discarded by
+ * the nodes which cannot process it.
+ */
+class BpCopyCountHeader : public Header
+{
+public:
+  BpCopyCountHeader ();
+
+  /**
+   * \param copies the number of copies
+   */
+  BpCopyCountHeader (uint32_t copies);
+
+  virtual ~BpCopyCountHeader ();
+
+  /**
+   * \brief set the number of copies
+   */
+  void SetCopies (uint32_t copies);
+
+  /**
+   * \return the number of copies
+   */
+  uint32_t GetCopies () const;
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual void Print (std::ostream &os) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+
+private:
+  uint8_t m_processingControlFlags;   /// block processing control flags
+  uint32_t m_copies;                  /// number of copies
+};
+
+} // namespace ns3
+
+#endif /* BP_COPY_COUNT_HEADER_H */
@@ -0,0 +1,134 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "bp-endpoint-id-table.h"
+
+// initial number of slots in the index, must be a power of 2
+#define BP_EID_TABLE_INITIAL_SIZE 64
+
+NS_LOG_COMPONENT_DEFINE ("BpEndpointIdTable");
+
+namespace ns3 {
+
+BpEndpointIdTable::BpEndpointIdTable ()
+  : m_index (BP_EID_TABLE_INITIAL_SIZE, 0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpEndpointIdTable&
+BpEndpointIdTable::Get ()
+{
+  static BpEndpointIdTable table;
+  return table;
+}
+
+uint32_t
+BpEndpointIdTable::Hash (const std::string &uri)
+{
+  // FNV-1a, followed by the murmur3 finalizer so that the low bits used
+  // to index the tables depend on all the characters
+  uint32_t h = 2166136261U;
+  for (std::string::const_iterator it = uri.begin (); it != uri.end (); ++it)
+    {
+      h ^= (uint8_t) *it;
+      h *= 16777619U;
+    }
+
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35U;
+  h ^= h >> 16;
+
+  return h;
+}
+
+uint32_t
+BpEndpointIdTable::Intern (const std::string &uri, uint32_t &hash)
+{
+  NS_LOG_FUNCTION (uri);
+  BpEndpointIdTable &table = Get ();
+  hash = Hash (uri);
+
+  uint32_t mask = table.m_index.size () - 1;
+  uint32_t slot = hash & mask;
+  while (table.m_index[slot] != 0)
+    {
+      uint32_t handle = table.m_index[slot] - 1;
+      if (table.m_hashes[handle] == hash && table.m_uris[handle] == uri)
+        return handle;
+
+      slot = (slot + 1) & mask;
+    }
+
+  // new uri
+  uint32_t handle = table.m_uris.size ();
+  table.m_uris.push_back (uri);
+  table.m_hashes.push_back (hash);
+  table.m_index[slot] = handle + 1;
+
+  // keep the load factor below 1/2
+  if (2 * table.m_uris.size () > table.m_index.size ())
+    table.Grow ();
+
+  return handle;
+}
+
+void
+BpEndpointIdTable::Grow ()
+{
+  NS_LOG_FUNCTION (this << " " << m_index.size ());
+  m_index.assign (2 * m_index.size (), 0);
+
+  uint32_t mask = m_index.size () - 1;
+  for (uint32_t handle = 0; handle < m_uris.size (); handle++)
+    {
+      uint32_t slot = m_hashes[handle] & mask;
+      while (m_index[slot] != 0)
+        slot = (slot + 1) & mask;
+
+      m_index[slot] = handle + 1;
+    }
+}
+
+const std::string&
+BpEndpointIdTable::GetUri (uint32_t handle)
+{
+  NS_ASSERT_MSG (handle < Get ().m_uris.size (), "BpEndpointIdTable::GetUri (): unknown handle " << handle);
+  return Get ().m_uris[handle];
+}
+
+uint32_t
+BpEndpointIdTable::GetHash (uint32_t handle)
+{
+  NS_ASSERT_MSG (handle < Get ().m_hashes.size (), "BpEndpointIdTable::GetHash (): unknown handle " << handle);
+  return Get ().m_hashes[handle];
+}
+
+uint32_t
+BpEndpointIdTable::GetSize ()
+{
+  return Get ().m_uris.size ();
+}
+
+} // namespace ns3
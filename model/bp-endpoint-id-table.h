@@ -0,0 +1,102 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+#ifndef BP_ENDPOINT_ID_TABLE_H
+#define BP_ENDPOINT_ID_TABLE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief The interning table of endpoint id uris
+ *
+ * Each distinct uri is stored once and identified by a compact 32-bit handle,
+ * which is the index of the uri in this table. The hash of the uri is computed
+ * once, when the uri is interned. Two endpoint ids are equal if and only if
+ * their handles are equal, so the storages of the bundle protocol never
+ * compare uri strings.
+ *
+ * The table is shared by all bundle nodes of a simulation. The handles are
+ * never released.
+ */
+class BpEndpointIdTable
+{
+public:
+  /**
+   * \brief Get the handle of an uri, the uri is inserted if it is new
+   *
+   * \param uri the uri of endpoint id
+   * \param hash the hash of the uri is returned here
+   *
+   * \return the handle of the uri
+   */
+  static uint32_t Intern (const std::string &uri, uint32_t &hash);
+
+  /**
+   * \param handle the handle returned by Intern ()
+   *
+   * \return the uri of the handle
+   */
+  static const std::string& GetUri (uint32_t handle);
+
+  /**
+   * \param handle the handle returned by Intern ()
+   *
+   * \return the hash of the uri of the handle
+   */
+  static uint32_t GetHash (uint32_t handle);
+
+  /**
+   * \return the number of interned uris
+   */
+  static uint32_t GetSize ();
+
+  /**
+   * \brief Hash function of uris
+   *
+   * \param uri the uri of endpoint id
+   *
+   * \return the hash of the uri
+   */
+  static uint32_t Hash (const std::string &uri);
+
+private:
+  BpEndpointIdTable ();
+
+  /**
+   * \return the single instance of the table
+   */
+  static BpEndpointIdTable& Get ();
+
+  /**
+   * Double the size of the index and insert all handles again
+   */
+  void Grow ();
+
+  std::vector<std::string> m_uris;    /// the interned uris, indexed by handle
+  std::vector<uint32_t> m_hashes;     /// the hash of the interned uris, indexed by handle
+  std::vector<uint32_t> m_index;      /// open addressing index of the uris: handle + 1, or 0 if the slot is empty
+};
+
+} // namespace ns3
+
+#endif /* BP_ENDPOINT_ID_TABLE_H */
@@ -22,11 +22,17 @@
 #include "ns3/log.h"
 #include "ns3/names.h"
 #include "bp-endpoint-id.h"
+#include "bp-endpoint-id-table.h"
 
 NS_LOG_COMPONENT_DEFINE ("BpEndpointId"); 
 
 namespace ns3 {
 
+BpEndpointId::BpEndpointId ()
+  : m_uri ("")
+{ 
+  Intern ();
+}
 
 BpEndpointId::BpEndpointId (const std::string scheme, const std::string ssp)
   : m_uri ("")
@@ -34,6 +40,7 @@ BpEndpointId::BpEndpointId (const std::string scheme, const std::string ssp)
   NS_LOG_FUNCTION (this << " " << scheme << " " << ssp);
   ParseComponent (scheme, ssp);
   m_uri = scheme + ":" + ssp;
+  Intern ();
 }
 
 BpEndpointId::BpEndpointId (const std::string uri)
@@ -42,6 +49,13 @@ BpEndpointId::BpEndpointId (const std::string uri)
   NS_LOG_FUNCTION (this << " " << uri);
   ParseUri (uri);
   m_uri = uri;
+  Intern ();
+}
+
+void
+BpEndpointId::Intern ()
+{
+  m_handle = BpEndpointIdTable::Intern (m_uri, m_hash);
 }
 
 void 
@@ -23,6 +23,7 @@
 
 #include<string>
 #include<iostream>
+#include<stdint.h>
 namespace ns3 {
 
 /**
@@ -47,6 +48,9 @@ struct Component {
  * The format of the endpoint id is defined at the section 4.4 in RFC 5050. An endpoint id
  * of a bundle node is represented as a string "scheme:ssp"
  *
+ * The uri is interned in BpEndpointIdTable when the endpoint id is built, so
+ * the endpoint ids are compared by their handles instead of their uris.
+ *
  * Part of methods in this class is referred from oasys/util/URI.h in DTN2 
  */
 class BpEndpointId 
@@ -56,10 +60,7 @@ public:
   /**
    * Build an empty URI
    */
-  BpEndpointId ()
-    : m_uri ("")
-    {
-    }
+  BpEndpointId ();
 
   /**
    * Build an URI as "scheme:ssp"
@@ -102,6 +103,25 @@ public:
    */
   std::string Uri () const;
 
+  /**
+   * Return the interned handle of the uri, see BpEndpointIdTable
+   *
+   * \return the handle of endpoint id
+   */
+  uint32_t Handle () const
+  {
+    return m_handle;
+  }
+
+  /**
+   * Return the hash of the uri, which is computed once when the endpoint id is built
+   *
+   * \return the hash of endpoint id
+   */
+  uint32_t Hash () const
+  {
+    return m_hash;
+  }
 
 private:
 
@@ -120,6 +140,11 @@ private:
    */
   void ParseUri (const std::string uri);
 
+  /**
+   * Intern the uri and store its handle and hash
+   */
+  void Intern ();
+
   /**
    * \brief operator ==
    */
@@ -140,16 +165,18 @@ private:
 
   Component m_scheme; /// the offset and the length of scheme part of URI
   Component m_ssp;    /// the offset and the length of ssp part of URI
+  uint32_t m_handle;  /// the handle of URI in BpEndpointIdTable
+  uint32_t m_hash;    /// the hash of URI
 };
 
 inline bool operator == (const BpEndpointId &a, const BpEndpointId &b)
 {
-  return (a.m_uri == b.m_uri);
+  return (a.m_handle == b.m_handle);
 }
 
 inline bool operator != (const BpEndpointId &a, const BpEndpointId &b)
 {
-  return (a.m_uri != b.m_uri);
+  return (a.m_handle != b.m_handle);
 }
 
 inline bool operator < (const BpEndpointId &a, const BpEndpointId &b)
@@ -0,0 +1,295 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+#ifndef BP_ENDPOINT_MAP_H
+#define BP_ENDPOINT_MAP_H
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include "bp-endpoint-id.h"
+
+namespace ns3 {
+
+/**
+ * \brief A hash table keyed by endpoint id
+ *
+ * The entries are stored in two dense arrays (keys and values). They are
+ * located by an open addressing index with linear probing, whose slots hold
+ * the interned handle of the key and the position of the entry, so a lookup
+ * compares 32-bit handles only and never touches the uri strings.
+ *
+ * Erase () moves the last entry into the erased position, so the positions
+ * of the entries, and the pointers returned by Find (), are only valid until
+ * the next Insert () or Erase (). The entries can be visited in position order
+ * with GetKey () and GetValue ().
+ */
+template <typename T>
+class BpEndpointMap
+{
+public:
+  BpEndpointMap ()
+    : m_size (0)
+  {
+    m_index.resize (BP_ENDPOINT_MAP_INITIAL_SIZE);
+  }
+
+  /**
+   * \param eid the endpoint id
+   *
+   * \return the value of eid, or NULL if eid is not in the table
+   */
+  T* Find (const BpEndpointId &eid)
+  {
+    uint32_t slot = Lookup (eid);
+    if (m_index[slot].position == EMPTY)
+      return NULL;
+
+    return &m_values[m_index[slot].position];
+  }
+
+  /**
+   * \param eid the endpoint id
+   *
+   * \return the value of eid, or NULL if eid is not in the table
+   */
+  const T* Find (const BpEndpointId &eid) const
+  {
+    uint32_t slot = Lookup (eid);
+    if (m_index[slot].position == EMPTY)
+      return NULL;
+
+    return &m_values[m_index[slot].position];
+  }
+
+  /**
+   * \brief Add an entry
+   *
+   * \param eid the endpoint id
+   * \param value the value of eid
+   *
+   * \return false if eid is already in the table, the table is not changed
+   */
+  bool Insert (const BpEndpointId &eid, const T &value)
+  {
+    uint32_t slot = Lookup (eid);
+    if (m_index[slot].position != EMPTY)
+      return false;
+
+    Add (slot, eid, value);
+    return true;
+  }
+
+  /**
+   * \brief Get the value of eid, a default value is inserted if eid is not in the table
+   *
+   * \param eid the endpoint id
+   *
+   * \return the value of eid
+   */
+  T& operator[] (const BpEndpointId &eid)
+  {
+    uint32_t slot = Lookup (eid);
+    if (m_index[slot].position == EMPTY)
+      return Add (slot, eid, T ());
+
+    return m_values[m_index[slot].position];
+  }
+
+  /**
+   * \brief Remove an entry
+   *
+   * \param eid the endpoint id
+   *
+   * \return false if eid is not in the table
+   */
+  bool Erase (const BpEndpointId &eid)
+  {
+    uint32_t slot = Lookup (eid);
+    uint32_t position = m_index[slot].position;
+    if (position == EMPTY)
+      return false;
+
+    // backward shift deletion: pull back the following entries of the probe sequence
+    uint32_t mask = m_index.size () - 1;
+    uint32_t hole = slot;
+    uint32_t next = (hole + 1) & mask;
+    while (m_index[next].position != EMPTY)
+      {
+        uint32_t home = GetHash (m_index[next].position) & mask;
+        // move the entry if its home slot is not in (hole, next]
+        if (((next - home) & mask) >= ((next - hole) & mask))
+          {
+            m_index[hole] = m_index[next];
+            hole = next;
+          }
+        next = (next + 1) & mask;
+      }
+    m_index[hole].position = EMPTY;
+
+    // keep the entries dense
+    uint32_t last = m_keys.size () - 1;
+    if (position != last)
+      {
+        m_index[Lookup (m_keys[last])].position = position;
+        m_keys[position] = m_keys[last];
+        std::swap (m_values[position], m_values[last]);
+      }
+    m_keys.pop_back ();
+    m_values.pop_back ();
+    m_size--;
+
+    return true;
+  }
+
+  /**
+   * \return the number of entries
+   */
+  uint32_t GetSize () const
+  {
+    return m_size;
+  }
+
+  /**
+   * \return true if there is no entry
+   */
+  bool IsEmpty () const
+  {
+    return m_size == 0;
+  }
+
+  /**
+   * \param i the position of entry, which is smaller than GetSize ()
+   *
+   * \return the endpoint id of entry i
+   */
+  const BpEndpointId& GetKey (uint32_t i) const
+  {
+    return m_keys[i];
+  }
+
+  /**
+   * \param i the position of entry, which is smaller than GetSize ()
+   *
+   * \return the value of entry i
+   */
+  T& GetValue (uint32_t i)
+  {
+    return m_values[i];
+  }
+
+  /**
+   * \brief Remove all entries
+   */
+  void Clear ()
+  {
+    m_keys.clear ();
+    m_values.clear ();
+    m_index.assign (BP_ENDPOINT_MAP_INITIAL_SIZE, Slot ());
+    m_size = 0;
+  }
+
+private:
+  enum
+  {
+    BP_ENDPOINT_MAP_INITIAL_SIZE = 16,    /// initial number of slots, must be a power of 2
+    EMPTY = 0xFFFFFFFF                    /// position of an empty slot
+  };
+
+  /**
+   * \brief A slot of the index
+   */
+  struct Slot
+  {
+    Slot ()
+      : handle (0),
+        position (EMPTY)
+    {
+    }
+
+    uint32_t handle;     /// interned handle of the key
+    uint32_t position;   /// position of the entry in the dense arrays, or EMPTY
+  };
+
+  /**
+   * \return the slot holding eid, or the empty slot where eid would be inserted
+   */
+  uint32_t Lookup (const BpEndpointId &eid) const
+  {
+    uint32_t mask = m_index.size () - 1;
+    uint32_t slot = eid.Hash () & mask;
+    while (m_index[slot].position != EMPTY && m_index[slot].handle != eid.Handle ())
+      slot = (slot + 1) & mask;
+
+    return slot;
+  }
+
+  /**
+   * \return the hash of the key of entry at position
+   */
+  uint32_t GetHash (uint32_t position) const
+  {
+    return m_keys[position].Hash ();
+  }
+
+  /**
+   * \brief Add an entry in the empty slot returned by Lookup ()
+   */
+  T& Add (uint32_t slot, const BpEndpointId &eid, const T &value)
+  {
+    m_index[slot].handle = eid.Handle ();
+    m_index[slot].position = m_keys.size ();
+    m_keys.push_back (eid);
+    m_values.push_back (value);
+    m_size++;
+
+    // keep the load factor below 1/2 so that the probe sequences are short
+    if (2 * m_size > m_index.size ())
+      Grow ();
+
+    return m_values.back ();
+  }
+
+  /**
+   * \brief Double the size of the index
+   */
+  void Grow ()
+  {
+    m_index.assign (2 * m_index.size (), Slot ());
+    uint32_t mask = m_index.size () - 1;
+    for (uint32_t i = 0; i < m_keys.size (); i++)
+      {
+        uint32_t slot = m_keys[i].Hash () & mask;
+        while (m_index[slot].position != EMPTY)
+          slot = (slot + 1) & mask;
+
+        m_index[slot].handle = m_keys[i].Handle ();
+        m_index[slot].position = i;
+      }
+  }
+
+  std::vector<Slot> m_index;            /// open addressing index
+  std::vector<BpEndpointId> m_keys;     /// dense array of keys
+  std::vector<T> m_values;              /// dense array of values, m_values[i] is the value of m_keys[i]
+  uint32_t m_size;                      /// number of entries
+};
+
+} // namespace ns3
+
+#endif /* BP_ENDPOINT_MAP_H */
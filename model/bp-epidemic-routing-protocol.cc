@@ -0,0 +1,411 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#include "bp-epidemic-routing-protocol.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/inet-socket-address.h"
+
+// the largest UDP payload of an IPv4 datagram
+#define EPIDEMIC_MAX_DATAGRAM_SIZE 65507
+
+// the index of the partition and the number of partitions before the filter of a summary vector
+#define EPIDEMIC_SUMMARY_HEADER_SIZE 4
+
+NS_LOG_COMPONENT_DEFINE ("BpEpidemicRoutingProtocol");
+
+namespace ns3 {
+
+TypeId
+BpEpidemicRoutingProtocol::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpEpidemicRoutingProtocol")
+    .SetParent<BpRoutingProtocol> ()
+    .AddConstructor<BpEpidemicRoutingProtocol> ()
+    .AddAttribute ("SummaryPort", "Udp port of the summary vectors",
+           UintegerValue (4557),
+           MakeUintegerAccessor (&BpEpidemicRoutingProtocol::m_summaryPort),
+           MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("Port", "Port of the convergence layer of the peers, 0 for the default port of the convergence layer in use",
+           UintegerValue (0),
+           MakeUintegerAccessor (&BpEpidemicRoutingProtocol::m_port),
+           MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("FalsePositiveRate", "False positive rate of the Bloom filter of the summary vectors",
+           DoubleValue (0.01),
+           MakeDoubleAccessor (&BpEpidemicRoutingProtocol::m_falsePositiveRate),
+           MakeDoubleChecker<double> (0.000001, 0.5))
+    .AddAttribute ("SummaryInterval", "Min time between two summary vectors sent to the same peer",
+           TimeValue (Seconds (1)),
+           MakeTimeAccessor (&BpEpidemicRoutingProtocol::m_summaryInterval),
+           MakeTimeChecker ())
+    .AddAttribute ("BeaconPort", "Udp port of the beacons of the peers",
+           UintegerValue (4558),
+           MakeUintegerAccessor (&BpEpidemicRoutingProtocol::m_beaconPort),
+           MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("BeaconInterval", "Time between two beacons, 0 to send none",
+           TimeValue (Seconds (1)),
+           MakeTimeAccessor (&BpEpidemicRoutingProtocol::m_beaconInterval),
+           MakeTimeChecker ())
+  ;
+  return tid;
+}
+
+BpEpidemicRoutingProtocol::BpEpidemicRoutingProtocol ()
+  : m_socket (0),
+    m_beaconPort (4558),
+    m_beaconInterval (Seconds (1)),
+    m_summaryPort (4557),
+    m_port (0),
+    m_falsePositiveRate (0.01),
+    m_summaryInterval (Seconds (1)),
+    m_summaries (0),
+    m_forwarded (0),
+    m_bp (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpEpidemicRoutingProtocol::~BpEpidemicRoutingProtocol ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BpEpidemicRoutingProtocol::SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol)
+{
+  NS_LOG_FUNCTION (this << " " << bundleProtocol);
+  m_bp = bundleProtocol;
+
+  // a beacon received is a link with its peer coming up, whose summary
+  // vector may come before this node sends its own
+  if (m_bp && m_bp->GetNode ())
+    {
+      OpenSocket ();
+      m_beacon.SetNeighborCallback (MakeCallback (&BpEpidemicRoutingProtocol::NotifyLinkUp, this));
+      m_beacon.Start (m_bp->GetNode (), m_beaconPort, m_beaconInterval);
+    }
+}
+
+void
+BpEpidemicRoutingProtocol::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_beacon.Stop ();
+  if (m_socket)
+    m_socket->Close ();
+  m_socket = 0;
+  m_bp = 0;
+  BpRoutingProtocol::DoDispose ();
+}
+
+uint32_t
+BpEpidemicRoutingProtocol::GetBeaconsSent () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_beacon.GetBeaconsSent ();
+}
+
+bool
+BpEpidemicRoutingProtocol::GetNextHops (const BpEndpointId &dst, std::vector<BpNextHop> &nextHops)
+{
+  NS_LOG_FUNCTION (this << " " << dst.Uri ());
+  nextHops.clear ();
+  return false;
+}
+
+bool
+BpEpidemicRoutingProtocol::NotifyReceive (Ptr<const Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << bundle);
+  BpHeader bph;
+  bundle->PeekHeader (bph);
+
+  // creation timestamps are counted from the start of the simulation
+  Time end = Time::Max ();
+  if (bph.GetLifeTime () > 0)
+    end = Seconds (bph.GetCreateTimestamp () + bph.GetLifeTime ());
+
+  return m_known.insert (std::make_pair (GetBundleId (bph), end)).second;
+}
+
+bool
+BpEpidemicRoutingProtocol::IsRelay () const
+{
+  NS_LOG_FUNCTION (this);
+  return true;
+}
+
+void
+BpEpidemicRoutingProtocol::PruneKnown ()
+{
+  NS_LOG_FUNCTION (this);
+  Time now = Simulator::Now ();
+  std::map<std::string, Time>::iterator it = m_known.begin ();
+  while (it != m_known.end ())
+    {
+      if (it->second <= now)
+        m_known.erase (it++);
+      else
+        ++it;
+    }
+}
+
+void
+BpEpidemicRoutingProtocol::GetBundleIds (std::vector<std::string> &ids)
+{
+  NS_LOG_FUNCTION (this);
+  PruneKnown ();
+
+  std::vector<Ptr<Packet> > bundles;
+  if (m_bp)
+    m_bp->GetStoredBundles (bundles);
+
+  // the relayed bundles are both received and stored, the filters are sized for both
+  ids.clear ();
+  ids.reserve (m_known.size () + bundles.size ());
+  for (std::map<std::string, Time>::const_iterator it = m_known.begin (); it != m_known.end (); ++it)
+    ids.push_back (it->first);
+
+  for (uint32_t i = 0; i < bundles.size (); i++)
+    {
+      BpHeader bph;
+      bundles[i]->PeekHeader (bph);
+      ids.push_back (GetBundleId (bph));
+    }
+}
+
+BpBloomFilter
+BpEpidemicRoutingProtocol::GetSummaryVector ()
+{
+  NS_LOG_FUNCTION (this);
+  std::vector<std::string> ids;
+  GetBundleIds (ids);
+
+  BpBloomFilter summary (ids.size (), m_falsePositiveRate);
+  for (uint32_t i = 0; i < ids.size (); i++)
+    summary.Add (ids[i]);
+
+  return summary;
+}
+
+uint32_t
+BpEpidemicRoutingProtocol::GetPartition (const std::string &id, uint32_t partitions)
+{
+  // FNV-1a, independent of the hashes of the filters
+  uint32_t hash = 2166136261u;
+  for (uint32_t i = 0; i < id.size (); i++)
+    hash = (hash ^ (uint8_t) id[i]) * 16777619u;
+
+  return hash % partitions;
+}
+
+void
+BpEpidemicRoutingProtocol::GetSummaryVectors (uint32_t maxSize, std::vector<BpBloomFilter> &summaries)
+{
+  NS_LOG_FUNCTION (this << " " << maxSize);
+  NS_ASSERT_MSG (maxSize >= BpBloomFilter (0, m_falsePositiveRate).GetSerializedSize (), "a summary vector cannot fit " << maxSize << " bytes");
+  std::vector<std::string> ids;
+  GetBundleIds (ids);
+
+  // the first guess splits the whole filter evenly, an uneven split takes one more partition
+  uint32_t size = BpBloomFilter (ids.size (), m_falsePositiveRate).GetSerializedSize ();
+  uint32_t partitions = (size + maxSize - 1) / maxSize;
+  while (true)
+    {
+      std::vector<std::vector<std::string> > parts (partitions);
+      for (uint32_t i = 0; i < ids.size (); i++)
+        parts[GetPartition (ids[i], partitions)].push_back (ids[i]);
+
+      summaries.clear ();
+      for (uint32_t p = 0; p < partitions; p++)
+        {
+          BpBloomFilter summary (parts[p].size (), m_falsePositiveRate);
+          if (summary.GetSerializedSize () > maxSize)
+            break;
+
+          for (uint32_t i = 0; i < parts[p].size (); i++)
+            summary.Add (parts[p][i]);
+          summaries.push_back (summary);
+        }
+
+      if (summaries.size () == partitions)
+        return;
+
+      partitions++;
+    }
+}
+
+uint32_t
+BpEpidemicRoutingProtocol::SendMissingBundles (Ipv4Address peer, const BpBloomFilter &summary, uint32_t partition, uint32_t partitions)
+{
+  NS_LOG_FUNCTION (this << " " << peer << " " << partition << " " << partitions);
+  if (!m_bp)
+    return 0;
+
+  // the peers listen on the default port of their convergence layer, e.g.,
+  // the LTP port, unless the port is set
+  uint16_t port = m_port;
+  if (port == 0 && m_bp->GetCla ())
+    port = m_bp->GetCla ()->GetDefaultPort ();
+
+  std::vector<Ptr<Packet> > bundles;
+  m_bp->GetStoredBundles (bundles);
+
+  uint32_t sent = 0;
+  for (uint32_t i = 0; i < bundles.size (); i++)
+    {
+      BpHeader bph;
+      bundles[i]->PeekHeader (bph);
+      std::string id = GetBundleId (bph);
+      if ((partitions > 1 && GetPartition (id, partitions) != partition) || summary.Contains (id))
+        continue;
+
+      if (m_bp->ForwardBundle (bundles[i], InetSocketAddress (peer, port)) < 0)
+        {
+          NS_LOG_WARN ("BpEpidemicRoutingProtocol::SendMissingBundles (): the convergence layer cannot forward bundles to " << peer);
+          break;
+        }
+
+      sent++;
+    }
+
+  m_forwarded += sent;
+  NS_LOG_DEBUG ("BpEpidemicRoutingProtocol::SendMissingBundles (): " << sent << " of " << bundles.size () << " bundles sent to " << peer);
+  return sent;
+}
+
+bool
+BpEpidemicRoutingProtocol::OpenSocket ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_socket)
+    return true;
+
+  if (!m_bp)
+    return false;
+
+  m_socket = Socket::CreateSocket (m_bp->GetNode (), UdpSocketFactory::GetTypeId ());
+  if (m_socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_summaryPort)) < 0)
+    {
+      NS_LOG_WARN ("BpEpidemicRoutingProtocol::OpenSocket (): socket error " << m_socket->GetErrno ());
+      m_socket = 0;
+      return false;
+    }
+
+  m_socket->SetRecvCallback (MakeCallback (&BpEpidemicRoutingProtocol::ReceiveSummary, this));
+  return true;
+}
+
+void
+BpEpidemicRoutingProtocol::NotifyLinkUp (Ipv4Address peer)
+{
+  NS_LOG_FUNCTION (this << " " << peer);
+  std::map<Ipv4Address, Time>::const_iterator it = m_lastSummary.find (peer);
+  if (it != m_lastSummary.end () && Simulator::Now () < it->second + m_summaryInterval)
+    return;
+
+  SendSummary (peer);
+}
+
+void
+BpEpidemicRoutingProtocol::SendSummary (Ipv4Address peer)
+{
+  NS_LOG_FUNCTION (this << " " << peer);
+  if (!OpenSocket ())
+    return;
+
+  std::vector<BpBloomFilter> summaries;
+  GetSummaryVectors (EPIDEMIC_MAX_DATAGRAM_SIZE - EPIDEMIC_SUMMARY_HEADER_SIZE, summaries);
+  if (summaries.size () > 1)
+    NS_LOG_INFO ("BpEpidemicRoutingProtocol::SendSummary (): summary vector split into " << summaries.size () << " datagrams to " << peer);
+
+  for (uint32_t p = 0; p < summaries.size (); p++)
+    {
+      std::vector<uint8_t> buffer (EPIDEMIC_SUMMARY_HEADER_SIZE + summaries[p].GetSerializedSize ());
+      buffer[0] = (uint8_t) (p >> 8);
+      buffer[1] = (uint8_t) p;
+      buffer[2] = (uint8_t) (summaries.size () >> 8);
+      buffer[3] = (uint8_t) summaries.size ();
+      summaries[p].Serialize (&buffer[EPIDEMIC_SUMMARY_HEADER_SIZE]);
+
+      Ptr<Packet> packet = Create<Packet> (&buffer[0], buffer.size ());
+      if (m_socket->SendTo (packet, 0, InetSocketAddress (peer, m_summaryPort)) < 0)
+        {
+          // the summary vector is sent again at the next link up
+          NS_LOG_WARN ("BpEpidemicRoutingProtocol::SendSummary (): socket error " << m_socket->GetErrno () << " for " << buffer.size () << " bytes to " << peer);
+          return;
+        }
+    }
+
+  m_lastSummary[peer] = Simulator::Now ();
+  m_summaries++;
+}
+
+void
+BpEpidemicRoutingProtocol::ReceiveSummary (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << " " << socket);
+  Ptr<Packet> packet;
+  Address from;
+  while ((packet = socket->RecvFrom (from)))
+    {
+      Ipv4Address peer = InetSocketAddress::ConvertFrom (from).GetIpv4 ();
+      std::vector<uint8_t> buffer (packet->GetSize ());
+      BpBloomFilter summary;
+      uint32_t partition = 0;
+      uint32_t partitions = 0;
+      if (buffer.size () > EPIDEMIC_SUMMARY_HEADER_SIZE && packet->CopyData (&buffer[0], buffer.size ()) == buffer.size ())
+        {
+          partition = (buffer[0] << 8) | buffer[1];
+          partitions = (buffer[2] << 8) | buffer[3];
+        }
+
+      if (partition >= partitions ||
+          !summary.Deserialize (&buffer[EPIDEMIC_SUMMARY_HEADER_SIZE], buffer.size () - EPIDEMIC_SUMMARY_HEADER_SIZE))
+        {
+          NS_LOG_WARN ("BpEpidemicRoutingProtocol::ReceiveSummary (): invalid summary vector from " << peer);
+          continue;
+        }
+
+      // the peer gets the summary vector of this node in return
+      NotifyLinkUp (peer);
+      SendMissingBundles (peer, summary, partition, partitions);
+    }
+}
+
+uint32_t
+BpEpidemicRoutingProtocol::GetSummariesSent () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_summaries;
+}
+
+uint32_t
+BpEpidemicRoutingProtocol::GetBundlesForwarded () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_forwarded;
+}
+
+} // namespace ns3
@@ -0,0 +1,201 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+#ifndef BP_EPIDEMIC_ROUTING_PROTOCOL_H
+#define BP_EPIDEMIC_ROUTING_PROTOCOL_H
+
+#include "bp-routing-protocol.h"
+#include "bundle-protocol.h"
+#include "bp-bloom-filter.h"
+#include "bp-neighbor-beacon.h"
+#include "bp-header.h"
+#include "ns3/socket.h"
+#include "ns3/nstime.h"
+#include "ns3/ipv4-address.h"
+#include <map>
+#include <string>
+
+namespace ns3 {
+
+/**
+ * \brief The epidemic bundle routing protocol
+ *
+ * Each node keeps the bundles of the other nodes it receives in its send
+ * storage, and replicates all its stored bundles to the peers it meets.
+ * When a link with a peer comes up, each side sends the peer its summary
+ * vector: a Bloom filter of the ids of the bundles it stores or has
+ * received, sized for the configured false positive rate. The other side
+ * sends back the bundles whose id is not in the summary vector, so only
+ * the missing bundles are transferred; a false positive leaves a bundle
+ * for a later contact, or for another peer. The summary vectors are sent
+ * over UDP, the bundles through the convergence layer. A summary vector
+ * larger than a UDP datagram is split: the bundle ids are hashed into
+ * partitions, and the filter of each partition is sent in a datagram of
+ * its own, with the index of the partition and the number of partitions.
+ * The peer answers each datagram with the missing bundles of its partition.
+ *
+ * A link with a peer comes up when the node receives a beacon of the peer
+ * (see BpNeighborBeacon), whatever the convergence layer; the TCP
+ * convergence layer also reports its connections coming up.
+ *
+ * There is no route to a destination: the bundles are only forwarded to
+ * the peers met, and a bundle stays stored until its lifetime is over or
+ * it is evicted by the storage quotas. The ids of the bundles received are
+ * kept until their lifetime is over, so a bundle is received once.
+ */
+class BpEpidemicRoutingProtocol : public BpRoutingProtocol
+{
+public:
+  static TypeId GetTypeId (void);
+
+  /**
+   * Constructor
+   */
+  BpEpidemicRoutingProtocol ();
+
+  /**
+   * Destroy
+   */
+  virtual ~BpEpidemicRoutingProtocol ();
+
+  /**
+   * \brief Set bundle protocol
+   *
+   * \param bundleProtocol bundle protocol
+   */
+  virtual void SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol);
+
+  /**
+   * \return the number of beacons sent
+   */
+  uint32_t GetBeaconsSent () const;
+
+  /**
+   * \brief There is no candidate next hop, the bundles are replicated to the peers met
+   */
+  virtual bool GetNextHops (const BpEndpointId &dst, std::vector<BpNextHop> &nextHops);
+
+  /**
+   * \brief Send the summary vector to the peer, unless it was sent less
+   * than SummaryInterval ago
+   */
+  virtual void NotifyLinkUp (Ipv4Address peer);
+
+  /**
+   * \brief A bundle whose id is already known is a duplicate
+   */
+  virtual bool NotifyReceive (Ptr<const Packet> bundle);
+
+  /**
+   * \brief The bundles of the other nodes are kept and replicated
+   */
+  virtual bool IsRelay () const;
+
+  /**
+   * \return the summary vector of the bundles stored or received by this node
+   */
+  BpBloomFilter GetSummaryVector ();
+
+  /**
+   * \brief Split the summary vector into the filters of partitions of the
+   * bundle ids, each one serialized in at most maxSize bytes
+   *
+   * \param maxSize the max serialized size of a filter
+   * \param summaries set to the filter of each partition, indexed by partition
+   */
+  void GetSummaryVectors (uint32_t maxSize, std::vector<BpBloomFilter> &summaries);
+
+  /**
+   * \return the partition of a bundle id among a number of partitions
+   */
+  static uint32_t GetPartition (const std::string &id, uint32_t partitions);
+
+  /**
+   * \brief Send a copy of the stored bundles of a partition which are not in
+   * the summary vector of a peer for this partition
+   *
+   * \param peer the address of the peer
+   * \param summary the filter of the partition
+   * \param partition the index of the partition
+   * \param partitions the number of partitions
+   *
+   * \return the number of bundles sent
+   */
+  uint32_t SendMissingBundles (Ipv4Address peer, const BpBloomFilter &summary, uint32_t partition = 0, uint32_t partitions = 1);
+
+  /**
+   * \return the number of summary vectors sent
+   */
+  uint32_t GetSummariesSent () const;
+
+  /**
+   * \return the number of bundle copies sent to the peers
+   */
+  uint32_t GetBundlesForwarded () const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * \brief Open the socket of the summary vectors
+   *
+   * \return false if the socket cannot be opened
+   */
+  bool OpenSocket ();
+
+  /**
+   * \brief Send the summary vector to a peer
+   */
+  void SendSummary (Ipv4Address peer);
+
+  /**
+   * \brief Receive the summary vectors of the peers
+   */
+  void ReceiveSummary (Ptr<Socket> socket);
+
+  /**
+   * \brief Forget the ids of the bundles whose lifetime is over
+   */
+  void PruneKnown ();
+
+  /**
+   * \brief Get the ids of the bundles stored or received by this node
+   */
+  void GetBundleIds (std::vector<std::string> &ids);
+
+  std::map<std::string, Time> m_known;           /// the ids of the bundles received, with the end of their lifetime
+  std::map<Ipv4Address, Time> m_lastSummary;     /// the time the summary vector was last sent to each peer
+  Ptr<Socket> m_socket;                          /// the socket of the summary vectors
+  BpNeighborBeacon m_beacon;                     /// the beacons of the peers met
+  uint16_t m_beaconPort;                         /// the udp port of the beacons
+  Time m_beaconInterval;                         /// time between two beacons
+  uint16_t m_summaryPort;                        /// the udp port of the summary vectors
+  uint16_t m_port;                               /// the port of the convergence layer of the peers, 0 for its default port
+  double m_falsePositiveRate;                    /// the false positive rate of the summary vectors
+  Time m_summaryInterval;                        /// min time between two summary vectors sent to a peer
+  uint32_t m_summaries;                          /// number of summary vectors sent
+  uint32_t m_forwarded;                          /// number of bundle copies sent
+  Ptr<BundleProtocol> m_bp;                      /// bundle protocol
+};
+
+
+}  // namespace ns3
+
+#endif /* BP_EPIDEMIC_ROUTING_PROTOCOL_H */
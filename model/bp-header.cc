@@ -29,8 +29,6 @@
 #include <vector>
 #include <ctime>
 
-#define RFC_DATE_2000 946684800
-
 NS_LOG_COMPONENT_DEFINE ("BpHeader");
 
 namespace ns3 {
@@ -48,6 +46,18 @@ BpHeader::AddDictionaryEntry(const std::string &entry)
 
   return offset;
 }
+void
+BpHeader::SetEntryLength (BpOffset &entry)
+{
+  // dictionary entries are null-terminated
+  std::string::size_type end = m_dictionary.find ('\0', entry.offset);
+  if (entry.offset >= m_dictionary.size ())
+    entry.length = 0;
+  else if (end == std::string::npos)
+    entry.length = m_dictionary.size () - entry.offset;
+  else
+    entry.length = end - entry.offset;
+}
 /* End private */
 
 
@@ -63,7 +73,8 @@ BpHeader::BpHeader ()
     m_dictLength (0),
     m_dictionary (""),
     m_fragOffset (0),
-    m_aduLength (0)
+    m_aduLength (0),
+    m_dirty (true)
 {
   NS_LOG_FUNCTION (this);
 
@@ -97,15 +108,13 @@ BpHeader::GetInstanceTypeId (void) const
   return GetTypeId ();
 }
 
-uint32_t
-BpHeader::GetSerializedSize (void) const
+uint64_t
+BpHeader::GetBodyLength (void) const
 {
   NS_LOG_FUNCTION (this);
   SDNV sdnv;
-  uint32_t size = 0;
   uint64_t headerLength = 0; // Length without Version and SDNV proc. flags
 
-  // Calculate header body length
   headerLength += sdnv.EncodingLength(m_dstSchemeOffset.offset);
   headerLength += sdnv.EncodingLength(m_dstSspOffset.offset);
   headerLength += sdnv.EncodingLength(m_srcSchemeOffset.offset);
@@ -124,119 +133,80 @@ BpHeader::GetSerializedSize (void) const
     headerLength += sdnv.EncodingLength(m_aduLength);
   }
 
-  // Calculate total length
-  size = 0;
-  size += sizeof(m_version);
-  size += sdnv.EncodingLength(m_processingFlags);
-  size += sdnv.EncodingLength(headerLength);
-  size += headerLength;
-
-  return size;
+  return headerLength;
 }
 
 void
-BpHeader::Print (std::ostream &os) const
-{
-  NS_LOG_FUNCTION (this);
-}
-
-void
-BpHeader::Serialize (Buffer::Iterator start) const
+BpHeader::Encode (void) const
 {
   NS_LOG_FUNCTION (this);
-  Buffer::Iterator i = start;
   SDNV sdnv;
-  uint64_t headerLength = 0; // Length without Version and SDNV proc. flags
-  std::vector<uint8_t> headerBody; // Body without
-
-  std::vector<uint8_t> dstSchemeOffset = sdnv.Encode (m_dstSchemeOffset.offset);
-  headerLength += dstSchemeOffset.size();
-  headerBody.insert (headerBody.end (), dstSchemeOffset.begin (), dstSchemeOffset.end ());
-
-  std::vector<uint8_t> dstSspOffset = sdnv.Encode (m_dstSspOffset.offset);
-  headerLength += dstSspOffset.size();
-  headerBody.insert (headerBody.end (), dstSspOffset.begin (), dstSspOffset.end ());
-
-  std::vector<uint8_t> srcSchemeOffset = sdnv.Encode (m_srcSchemeOffset.offset);
-  headerLength += srcSchemeOffset.size();
-  headerBody.insert (headerBody.end (), srcSchemeOffset.begin (), srcSchemeOffset.end ());
-
-  std::vector<uint8_t> srcSspOffset = sdnv.Encode (m_srcSspOffset.offset);
-  headerLength += srcSspOffset.size();
-  headerBody.insert (headerBody.end (), srcSspOffset.begin (), srcSspOffset.end ());
-
-  std::vector<uint8_t> reportSchemeOffset = sdnv.Encode (m_reportSchemeOffset.offset);
-  headerLength += reportSchemeOffset.size();
-  headerBody.insert (headerBody.end (), reportSchemeOffset.begin (), reportSchemeOffset.end ());
+  uint64_t headerLength = GetBodyLength ();
 
-  std::vector<uint8_t> reportSspOffset = sdnv.Encode (m_reportSspOffset.offset);
-  headerLength += reportSspOffset.size();
-  headerBody.insert (headerBody.end (), reportSspOffset.begin (), reportSspOffset.end ());
+  m_image.resize (sizeof(m_version)
+                  + sdnv.EncodingLength(m_processingFlags)
+                  + sdnv.EncodingLength(headerLength)
+                  + headerLength);
+  uint8_t *p = &m_image[0];
 
-  std::vector<uint8_t> custSchemeOffset = sdnv.Encode (m_custSchemeOffset.offset);
-  headerLength += custSchemeOffset.size();
-  headerBody.insert (headerBody.end (), custSchemeOffset.begin (), custSchemeOffset.end ());
-
-  std::vector<uint8_t> custSspOffset = sdnv.Encode (m_custSspOffset.offset);
-  headerLength += custSspOffset.size();
-  headerBody.insert (headerBody.end (), custSspOffset.begin (), custSspOffset.end ());
-
-  std::vector<uint8_t> createTimestamp = sdnv.Encode (m_createTimestamp);
-  headerLength += createTimestamp.size();
-  headerBody.insert (headerBody.end (), createTimestamp.begin (), createTimestamp.end ());
+  // Version
+  *p++ = m_version;
 
-  std::vector<uint8_t> timestampseqNum = sdnv.Encode (m_timestampSeqNum.GetValue ());
-  headerLength += timestampseqNum.size();
-  headerBody.insert (headerBody.end (), timestampseqNum.begin (), timestampseqNum.end ());
+  // Proc.flags
+  p += sdnv.Encode (m_processingFlags, p);
 
-  std::vector<uint8_t> lifeTime = sdnv.Encode (m_lifeTime);
-  headerLength += lifeTime.size();
-  headerBody.insert (headerBody.end (), lifeTime.begin (), lifeTime.end ());
+  // Header length, known in advance so the body is written in place
+  p += sdnv.Encode (headerLength, p);
 
-  std::vector<uint8_t> dictLength = sdnv.Encode (m_dictLength);
-  headerLength += dictLength.size();
-  headerBody.insert (headerBody.end (), dictLength.begin (), dictLength.end ());
+  // Header body
+  p += sdnv.Encode (m_dstSchemeOffset.offset, p);
+  p += sdnv.Encode (m_dstSspOffset.offset, p);
+  p += sdnv.Encode (m_srcSchemeOffset.offset, p);
+  p += sdnv.Encode (m_srcSspOffset.offset, p);
+  p += sdnv.Encode (m_reportSchemeOffset.offset, p);
+  p += sdnv.Encode (m_reportSspOffset.offset, p);
+  p += sdnv.Encode (m_custSchemeOffset.offset, p);
+  p += sdnv.Encode (m_custSspOffset.offset, p);
+  p += sdnv.Encode (m_createTimestamp, p);
+  p += sdnv.Encode (m_timestampSeqNum.GetValue (), p);
+  p += sdnv.Encode (m_lifeTime, p);
+  p += sdnv.Encode (m_dictLength, p);
+  m_dictionary.copy ((char *) p, m_dictLength);
+  p += m_dictLength;
 
-  headerLength += m_dictLength;
-  for (uint32_t k = 0; k < m_dictLength; k++) {
-    headerBody.push_back(m_dictionary.at(k));
+  if (m_processingFlags & BUNDLE_IS_FRAGMENT) {
+    p += sdnv.Encode (m_fragOffset, p);
+    p += sdnv.Encode (m_aduLength, p);
   }
 
-  if (m_processingFlags & BUNDLE_IS_FRAGMENT) {
-    std::vector<uint8_t> fragOffset = sdnv.Encode (m_fragOffset);
-    headerLength += fragOffset.size();
-    headerBody.insert (headerBody.end (), fragOffset.begin (), fragOffset.end ());
+  m_dirty = false;
+}
 
-    std::vector<uint8_t> aduLength = sdnv.Encode (m_aduLength);
-    headerLength += aduLength.size();
-    headerBody.insert (headerBody.end (), aduLength.begin (), aduLength.end ());
-  }
+uint32_t
+BpHeader::GetSerializedSize (void) const
+{
+  NS_LOG_FUNCTION (this);
+  if (m_dirty)
+    Encode ();
 
-  // Version
-  i.WriteU8 (m_version);
+  return m_image.size ();
+}
 
-  // Proc.flags
-  std::vector<uint8_t> processingFlags = sdnv.Encode (m_processingFlags);
-  for (std::vector<uint8_t>::iterator it = processingFlags.begin();
-       it != processingFlags.end();
-       ++it) {
-    i.WriteU8(*it);
-  }
+void
+BpHeader::Print (std::ostream &os) const
+{
+  NS_LOG_FUNCTION (this);
+}
 
-  // Header length
-  std::vector<uint8_t> headerLengthSDNV = sdnv.Encode(headerLength);
-  for (std::vector<uint8_t>::iterator it = headerLengthSDNV.begin();
-       it != headerLengthSDNV.end();
-       ++it) {
-    i.WriteU8(*it);
-  }
+void
+BpHeader::Serialize (Buffer::Iterator start) const
+{
+  NS_LOG_FUNCTION (this);
+  Buffer::Iterator i = start;
+  if (m_dirty)
+    Encode ();
 
-  // Header body
-  for (std::vector<uint8_t>::iterator it = headerBody.begin();
-       it != headerBody.end();
-       ++it) {
-    i.WriteU8(*it);
-  }
+  i.Write (&m_image[0], m_image.size ());
 }
 
 uint32_t
@@ -247,34 +217,80 @@ BpHeader::Deserialize (Buffer::Iterator start)
   SDNV sdnv;
 
   m_version = i.ReadU8 ();
-  m_processingFlags = (uint8_t) sdnv.Decode (i);
+  m_processingFlags = (uint32_t) sdnv.Decode (i);
   m_blockLength = (uint32_t) sdnv.Decode (i);
-  m_dstSchemeOffset.offset = (uint16_t) sdnv.Decode (i);
-  m_dstSspOffset.offset = (uint16_t) sdnv.Decode (i);
-  m_srcSchemeOffset.offset = (uint16_t) sdnv.Decode (i);
-  m_srcSspOffset.offset = (uint16_t) sdnv.Decode (i);
-  m_reportSchemeOffset.offset = (uint16_t) sdnv.Decode (i);
-  m_reportSspOffset.offset = (uint16_t) sdnv.Decode (i);
-  m_custSchemeOffset.offset = (uint16_t) sdnv.Decode (i);
-  m_custSspOffset.offset = (uint16_t) sdnv.Decode (i);
-  m_createTimestamp = (double) sdnv.Decode (i);
-  m_timestampSeqNum = (uint32_t) sdnv.Decode (i);
-  m_lifeTime = (uint64_t) sdnv.Decode (i);
-  m_dictLength = (uint32_t) sdnv.Decode (i);
-  char str[m_dictLength];
-  for (uint32_t k = 0; k < m_dictLength; k++) {
-    str[k] = i.ReadU8 ();
-  }
-  m_dictionary = std::string (str, m_dictLength);
+
+  // the received block is kept as the encoded image, so an unchanged header
+  // is serialized again by a single copy
+  uint32_t headLength = i.GetDistanceFrom (start);
+  if (m_blockLength > i.GetRemainingSize ())
+    {
+      NS_LOG_WARN ("BpHeader::Deserialize (): primary bundle block length " << m_blockLength << " exceeds the " << i.GetRemainingSize () << " bytes left");
+      m_blockLength = 0;
+      m_image.clear ();
+      m_dirty = true;
+      return headLength;
+    }
+
+  m_image.resize (headLength + m_blockLength);
+  start.Read (&m_image[0], headLength);
+  i.Read (&m_image[0] + headLength, m_blockLength);
+  m_dirty = false;
+
+  // the rest of the block is contiguous, so its SDNVs are decoded in one pass
+  const uint8_t *body = &m_image[0] + headLength;
+  uint64_t fields[12];
+  uint32_t pos = sdnv.Decode (body, m_blockLength, fields, 12);
+  if (pos == 0)
+    {
+      NS_LOG_WARN ("BpHeader::Deserialize (): malformed primary bundle block");
+      m_dirty = true;
+      return headLength + m_blockLength;
+    }
+
+  m_dstSchemeOffset.offset = (uint16_t) fields[0];
+  m_dstSspOffset.offset = (uint16_t) fields[1];
+  m_srcSchemeOffset.offset = (uint16_t) fields[2];
+  m_srcSspOffset.offset = (uint16_t) fields[3];
+  m_reportSchemeOffset.offset = (uint16_t) fields[4];
+  m_reportSspOffset.offset = (uint16_t) fields[5];
+  m_custSchemeOffset.offset = (uint16_t) fields[6];
+  m_custSspOffset.offset = (uint16_t) fields[7];
+  m_createTimestamp = (std::time_t) fields[8];
+  m_timestampSeqNum = (uint32_t) fields[9];
+  m_lifeTime = (double) fields[10];
+  m_dictLength = (uint32_t) fields[11];
+
+  if (pos + m_dictLength > m_blockLength)
+    {
+      NS_LOG_WARN ("BpHeader::Deserialize (): dictionary exceeds the primary bundle block");
+      m_dictLength = m_blockLength - pos;
+      m_dirty = true;
+    }
+  m_dictionary.assign ((const char *) body + pos, m_dictLength);
+  pos += m_dictLength;
+
+  SetEntryLength (m_dstSchemeOffset);
+  SetEntryLength (m_dstSspOffset);
+  SetEntryLength (m_srcSchemeOffset);
+  SetEntryLength (m_srcSspOffset);
+  SetEntryLength (m_reportSchemeOffset);
+  SetEntryLength (m_reportSspOffset);
+  SetEntryLength (m_custSchemeOffset);
+  SetEntryLength (m_custSspOffset);
+
   if (m_processingFlags & BUNDLE_IS_FRAGMENT) {
-    m_fragOffset = (uint32_t) sdnv.Decode (i);
-    m_aduLength = (uint32_t) sdnv.Decode (i);
+    uint64_t frag[2] = { 0, 0 };
+    if (sdnv.Decode (body + pos, m_blockLength - pos, frag, 2) == 0)
+      NS_LOG_WARN ("BpHeader::Deserialize (): malformed fragment fields");
+    m_fragOffset = (uint32_t) frag[0];
+    m_aduLength = (uint32_t) frag[1];
   } else {
     m_fragOffset = 0;
     m_aduLength = 0;
   }
 
-  return GetSerializedSize ();
+  return headLength + m_blockLength;
 }
 
 
@@ -286,6 +302,7 @@ BpHeader::SetIsFragment (const bool value)
     m_processingFlags |= BUNDLE_IS_FRAGMENT;
   else
     m_processingFlags &= (~(BUNDLE_IS_FRAGMENT));
+  m_dirty = true;
 }
 
 void
@@ -296,6 +313,7 @@ BpHeader::SetIsAdmin (const bool value)
     m_processingFlags |= BUNDLE_IS_ADMIN;
   else
     m_processingFlags &= (~(BUNDLE_IS_ADMIN));
+  m_dirty = true;
 }
 
 void
@@ -306,6 +324,7 @@ BpHeader::SetDonotFragment (const bool value)
     m_processingFlags |= BUNDLE_DO_NOT_FRAGMENT;
   else
     m_processingFlags &= (~(BUNDLE_DO_NOT_FRAGMENT));
+  m_dirty = true;
 }
 
 void
@@ -316,6 +335,7 @@ BpHeader::SetCustTxReq (const bool value)
     m_processingFlags |= BUNDLE_CUSTODY_XFER_REQUESTED;
   else
     m_processingFlags &= (~(BUNDLE_CUSTODY_XFER_REQUESTED));
+  m_dirty = true;
 }
 
 void
@@ -326,6 +346,7 @@ BpHeader::SetSingletonDest (const bool value)
     m_processingFlags |= BUNDLE_SINGLETON_DESTINATION;
   else
     m_processingFlags &= (~(BUNDLE_SINGLETON_DESTINATION));
+  m_dirty = true;
 }
 
 void
@@ -336,12 +357,17 @@ BpHeader::SetAckbyAppReq (const bool value)
     m_processingFlags |= BUNDLE_ACK_BY_APP;
   else
     m_processingFlags &= (~(BUNDLE_ACK_BY_APP));
+  m_dirty = true;
 }
 
 void
 BpHeader::SetPriority (const uint8_t pri)
 {
   NS_LOG_FUNCTION (this << " " << (uint16_t)pri);
+  // the class of service is held by bits 7 and 8 of the processing flags
+  m_processingFlags &= ~((uint32_t) (NORMAL | EXPEDITED));
+  m_processingFlags |= ((uint32_t) (pri & 0x3)) << 7;
+  m_dirty = true;
 }
 
 void
@@ -352,6 +378,7 @@ BpHeader::SetRecptionReport (const bool value)
     m_processingFlags |= REQ_REPORT_BUNDLE_RECEPTION;
   else
     m_processingFlags &= (~(REQ_REPORT_BUNDLE_RECEPTION));
+  m_dirty = true;
 }
 
 void
@@ -362,6 +389,7 @@ BpHeader::SetCustAcceptReport (const bool value)
     m_processingFlags |= REQ_REPORT_COSTODY_ACCEPT;
   else
     m_processingFlags &= (~(REQ_REPORT_COSTODY_ACCEPT));
+  m_dirty = true;
 }
 
 void
@@ -372,6 +400,7 @@ BpHeader::SetForwardReport (const bool value)
     m_processingFlags |= REQ_REPORT_BUNDLE_FORWARD;
   else
     m_processingFlags &= (~(REQ_REPORT_BUNDLE_FORWARD));
+  m_dirty = true;
 }
 
 void
@@ -382,6 +411,7 @@ BpHeader::SetDeliveryReport (const bool value)
     m_processingFlags |= REQ_REPORT_BUNDLE_DELIVERY;
   else
     m_processingFlags &= (~(REQ_REPORT_BUNDLE_DELIVERY));
+  m_dirty = true;
 }
 
 void
@@ -392,6 +422,7 @@ BpHeader::SetDeletionReport (const bool value)
     m_processingFlags |= REQ_REPORT_BUNDLE_DELETION;
   else
     m_processingFlags &= (~(REQ_REPORT_BUNDLE_DELETION));
+  m_dirty = true;
 }
 
 bool
@@ -441,7 +472,7 @@ uint8_t
 BpHeader::Priority () const
 {
   NS_LOG_FUNCTION (this);
-  return BULK;
+  return (m_processingFlags & (NORMAL | EXPEDITED)) >> 7;
 }
 
 bool
@@ -484,6 +515,7 @@ BpHeader::SetCreateTimestamp (const std::time_t &timestamp)
 {
   NS_LOG_FUNCTION (this << " " << timestamp);
   m_createTimestamp = timestamp - RFC_DATE_2000;
+  m_dirty = true;
 }
 
 void
@@ -491,6 +523,7 @@ BpHeader::SetSequenceNumber (const SequenceNumber32 &sequenceNumber)
 {
   NS_LOG_FUNCTION (this << " " << sequenceNumber.GetValue ());
   m_timestampSeqNum = sequenceNumber;
+  m_dirty = true;
 }
 
 
@@ -519,6 +552,7 @@ BpHeader::SetDestinationEid (const BpEndpointId &dst)
   std::string ssp = dst.Ssp();
   m_dstSspOffset.offset = AddDictionaryEntry(ssp);
   m_dstSspOffset.length = ssp.size ();
+  m_dirty = true;
 }
 
 void
@@ -532,6 +566,7 @@ BpHeader::SetSourceEid (const BpEndpointId &src)
   std::string ssp = src.Ssp();
   m_srcSspOffset.offset = AddDictionaryEntry(ssp);
   m_srcSspOffset.length = ssp.size ();
+  m_dirty = true;
 }
 
 void
@@ -545,6 +580,7 @@ BpHeader::SetReportEid (const BpEndpointId &report)
   std::string ssp = report.Ssp();
   m_reportSspOffset.offset = AddDictionaryEntry(ssp);
   m_reportSspOffset.length = ssp.size ();
+  m_dirty = true;
 }
 
 void
@@ -558,6 +594,7 @@ BpHeader::SetCustEid (const BpEndpointId &cust)
   std::string ssp = cust.Ssp();
   m_custSspOffset.offset = AddDictionaryEntry(ssp);
   m_custSspOffset.length = ssp.size ();
+  m_dirty = true;
 }
 
 BpEndpointId
@@ -610,6 +647,7 @@ BpHeader::SetLifeTime (double lifetime)
 {
   NS_LOG_FUNCTION (this << " " << lifetime);
   m_lifeTime = lifetime;
+  m_dirty = true;
 }
 
 double
@@ -625,6 +663,7 @@ BpHeader::SetFragOffset (uint32_t offset)
 {
   NS_LOG_FUNCTION (this << " " << offset);
   m_fragOffset = offset;
+  m_dirty = true;
 }
 
 void
@@ -632,6 +671,7 @@ BpHeader::SetAduLength (uint32_t len)
 {
   NS_LOG_FUNCTION (this << " " << len);
   m_aduLength = len;
+  m_dirty = true;
 }
 
 uint32_t
@@ -23,6 +23,7 @@
 
 #include <stdint.h>
 #include <string>
+#include <vector>
 #include <ctime>
 #include "ns3/header.h"
 #include "ns3/nstime.h"
@@ -30,6 +31,9 @@
 #include "ns3/sequence-number.h"
 #include "bp-endpoint-id.h"
 
+// seconds from 1970-01-01 to 2000-01-01, the epoch of bundle creation timestamps
+#define RFC_DATE_2000 946684800
+
 namespace ns3 {
 
 /**
@@ -93,7 +97,7 @@ public:
   /**
    * \brief Set priority field
    *
-   * \param pri priority of bundle
+   * \param pri priority of bundle, see PriorityClass
    */
   void SetPriority (const uint8_t pri);
 
@@ -237,7 +241,7 @@ public:
   /**
    * \brief Get priority of bundle
    *
-   * \return priority of bundle
+   * \return priority of bundle, see PriorityClass
    */
   uint8_t Priority () const;  
 
@@ -353,6 +357,16 @@ public:
     REQ_REPORT_UNUSED              = 1 << 19   
   } ProcessingFlags;  
 
+  /**
+   * class of service of bundle, i.e., the value of the priority bits in the
+   * processing flags
+   */
+  typedef enum {
+    PRIORITY_BULK                  = 0,
+    PRIORITY_NORMAL                = 1,
+    PRIORITY_EXPEDITED             = 2
+  } PriorityClass;
+
 
 
 private:
@@ -378,7 +392,30 @@ private:
   uint32_t m_fragOffset;                  /// fragementation offset
   uint32_t m_aduLength;                   /// application data unit length
 
+  mutable bool m_dirty;                   /// a field changed since the image was encoded
+  mutable std::vector<uint8_t> m_image;   /// encoded primary bundle block
+
   uint32_t AddDictionaryEntry(const std::string &entry);
+
+  /**
+   * \return the length of the primary block after the block length field
+   */
+  uint64_t GetBodyLength (void) const;
+
+  /**
+   * \brief Encode the primary bundle block into m_image
+   *
+   * Every setter marks the image as dirty, so the block is only encoded again
+   * when a field changes; size queries and serialization just reuse the image.
+   */
+  void Encode (void) const;
+
+  /**
+   * \brief Set the length of a dictionary entry from its null terminator
+   *
+   * \param entry the entry with a valid offset
+   */
+  void SetEntryLength (BpOffset &entry);
 };
 
 
@@ -0,0 +1,363 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#include "ns3/log.h"
+#include "ns3/packet.h"
+#include "ns3/nstime.h"
+#include "ns3/uinteger.h"
+#include "ns3/node.h"
+#include "ns3/simulator.h"
+#include "ns3/socket.h"
+#include "ns3/socket-factory.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/inet-socket-address.h"
+#include <algorithm>
+
+#include "bp-ltp-cla-protocol.h"
+#include "bundle-protocol.h"
+#include "bp-header.h"
+#include "bp-endpoint-id.h"
+
+// port number of LTP over UDP, RFC 5326
+#define LTP_UDP_PORT 1113
+
+// IPv4 and UDP headers
+#define UDP_IPV4_HEADER_SIZE 28
+
+// worst case header of a data segment: version and type, session id,
+// extension counts, client service id, offset, length, checkpoint and
+// report serial numbers
+#define LTP_DATA_HEADER_SIZE 64
+
+NS_LOG_COMPONENT_DEFINE ("BpLtpClaProtocol");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (BpLtpClaProtocol);
+
+TypeId
+BpLtpClaProtocol::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpLtpClaProtocol")
+    .SetParent<BpClaProtocol> ()
+    .AddConstructor<BpLtpClaProtocol> ()
+    .AddAttribute ("Mtu", "Path MTU, which bounds the size of the segments with the IPv4 and UDP headers",
+           UintegerValue (1500),
+           MakeUintegerAccessor (&BpLtpClaProtocol::m_mtu),
+           MakeUintegerChecker<uint32_t> (UDP_IPV4_HEADER_SIZE + LTP_DATA_HEADER_SIZE + 1))
+    .AddAttribute ("GreenLength", "Bytes at the end of a bundle sent as the green part of its block, without retransmission",
+           UintegerValue (0),
+           MakeUintegerAccessor (&BpLtpClaProtocol::m_greenLength),
+           MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("RetransmissionTimeout", "Time after which an unanswered checkpoint or report is sent again, larger than the round trip time",
+           TimeValue (Seconds (1.0)),
+           MakeTimeAccessor (&BpLtpClaProtocol::m_rto),
+           MakeTimeChecker ())
+    .AddAttribute ("MaxRetransmissions", "Retransmissions of a checkpoint or a report after which the session is cancelled",
+           UintegerValue (5),
+           MakeUintegerAccessor (&BpLtpClaProtocol::m_maxRetransmissions),
+           MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Rate", "Rate in bit/s at which the segments are written, 0 to write them at once",
+           UintegerValue (0),
+           MakeUintegerAccessor (&BpLtpClaProtocol::m_rate),
+           MakeUintegerChecker<uint64_t> ())
+  ;
+  return tid;
+}
+
+BpLtpClaProtocol::BpLtpClaProtocol ()
+  : m_bp (0),
+    m_bpRouting (0),
+    m_socket (0)
+{
+  NS_LOG_FUNCTION (this);
+  m_engine.SetSendCallback (MakeCallback (&BpLtpClaProtocol::Transmit, this));
+  m_engine.SetReceiveCallback (MakeCallback (&BpLtpClaProtocol::Deliver, this));
+}
+
+BpLtpClaProtocol::~BpLtpClaProtocol ()
+{
+  NS_LOG_FUNCTION (this);
+  m_sendEvent.Cancel ();
+  m_engine.Clear ();
+}
+
+void
+BpLtpClaProtocol::SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol)
+{
+  NS_LOG_FUNCTION (this << " " << bundleProtocol);
+  m_bp = bundleProtocol;
+  m_engine.SetEngineId (m_bp->GetNode ()->GetId ());
+}
+
+void
+BpLtpClaProtocol::ConfigureEngine ()
+{
+  NS_LOG_FUNCTION (this);
+  m_engine.SetSegmentSize (m_mtu - UDP_IPV4_HEADER_SIZE - LTP_DATA_HEADER_SIZE);
+  m_engine.SetRetransmissionTimeout (m_rto);
+  m_engine.SetMaxRetransmissions (m_maxRetransmissions);
+}
+
+uint64_t
+BpLtpClaProtocol::GetKey (const InetSocketAddress &address)
+{
+  return ((uint64_t) address.GetIpv4 ().Get () << 16) | address.GetPort ();
+}
+
+bool
+BpLtpClaProtocol::GetRoute (const BpEndpointId &dst, InetSocketAddress &address, uint32_t size)
+{
+  NS_LOG_FUNCTION (this << " " << dst.Uri () << " " << size);
+  if (!m_bpRouting)
+    NS_FATAL_ERROR ("BpLtpClaProtocol::GetRoute (): cannot find bundle routing protocol");
+
+  if (!m_bpRouting->GetBundleNextHop (dst, size, address))
+    {
+      NS_LOG_DEBUG ("BpLtpClaProtocol::GetRoute (): cannot find route for destination endpoint id " << dst.Uri ());
+      return false;
+    }
+
+  return true;
+}
+
+Ptr<Socket>
+BpLtpClaProtocol::GetL4Socket (Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << " " << packet);
+  BpHeader bph;
+  packet->PeekHeader (bph);
+
+  InetSocketAddress address (Ipv4Address::GetAny (), 0);
+  if (!GetRoute (bph.GetDestinationEid (), address) || !OpenSocket ())
+    return NULL;
+
+  return m_socket;
+}
+
+bool
+BpLtpClaProtocol::OpenSocket ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_socket)
+    return true;
+
+  m_socket = Socket::CreateSocket (m_bp->GetNode (), UdpSocketFactory::GetTypeId ());
+  if (m_socket->Bind () < 0)
+    {
+      NS_LOG_WARN ("BpLtpClaProtocol::OpenSocket (): socket error " << m_socket->GetErrno ());
+      m_socket = 0;
+      return false;
+    }
+
+  // the reports and the acknowledgments come back to the sender socket
+  m_socket->SetRecvCallback (MakeCallback (&BpLtpClaProtocol::DataRecv, this));
+  ConfigureEngine ();
+  return true;
+}
+
+int
+BpLtpClaProtocol::SendPacket (Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << " " << packet);
+  BpHeader bph;
+  packet->PeekHeader (bph);
+
+  if (GetL4Socket (packet) == 0)
+    return -1;
+
+  // each stored bundle is a block, sent without waiting for the previous ones
+  Ptr<Packet> bundle;
+  while ((bundle = m_bp->GetBundle ()))
+    {
+      BpHeader header;
+      bundle->PeekHeader (header);
+
+      InetSocketAddress address (Ipv4Address::GetAny (), 0);
+      if (!GetRoute (header.GetDestinationEid (), address, bundle->GetSize ()))
+        {
+          NS_LOG_WARN ("BpLtpClaProtocol::SendPacket (): drop bundle without route to " << header.GetDestinationEid ().Uri ());
+          continue;
+        }
+
+      m_bpRouting->NotifyForward (bundle, address);
+      uint64_t peer = GetKey (address);
+      m_peers.insert (std::make_pair (peer, address));
+
+      uint32_t size = bundle->GetSize ();
+      m_engine.Send (peer, bundle, size - std::min (m_greenLength, size));
+    }
+
+  return 0;
+}
+
+uint16_t
+BpLtpClaProtocol::GetDefaultPort ()
+{
+  NS_LOG_FUNCTION (this);
+  return LTP_UDP_PORT;
+}
+
+int
+BpLtpClaProtocol::ForwardBundle (Ptr<Packet> bundle, const InetSocketAddress &nextHop)
+{
+  NS_LOG_FUNCTION (this << " " << bundle << " " << nextHop.GetIpv4 ());
+  if (!m_bpRouting)
+    NS_FATAL_ERROR ("BpLtpClaProtocol::ForwardBundle (): cannot find bundle routing protocol");
+
+  if (!OpenSocket ())
+    return -1;
+
+  m_bpRouting->NotifyForward (bundle, nextHop);
+  uint64_t peer = GetKey (nextHop);
+  m_peers.insert (std::make_pair (peer, nextHop));
+
+  uint32_t size = bundle->GetSize ();
+  m_engine.Send (peer, bundle->Copy (), size - std::min (m_greenLength, size));
+  return 0;
+}
+
+void
+BpLtpClaProtocol::Transmit (uint64_t peer, Ptr<Packet> segment)
+{
+  NS_LOG_FUNCTION (this << " " << peer << " " << segment);
+  m_queue.push_back (std::make_pair (peer, segment));
+  if (!m_sendEvent.IsRunning ())
+    SendSegments ();
+}
+
+void
+BpLtpClaProtocol::SendSegments ()
+{
+  NS_LOG_FUNCTION (this);
+  while (!m_queue.empty ())
+    {
+      uint64_t peer = m_queue.front ().first;
+      Ptr<Packet> segment = m_queue.front ().second;
+      m_queue.pop_front ();
+
+      std::map<uint64_t, InetSocketAddress>::iterator it = m_peers.find (peer);
+      if (it == m_peers.end () || !OpenSocket ())
+        {
+          NS_LOG_WARN ("BpLtpClaProtocol::SendSegments (): drop segment to unknown peer " << peer);
+          continue;
+        }
+
+      uint32_t size = segment->GetSize ();
+      if (m_socket->SendTo (segment, 0, it->second) < 0)
+        NS_LOG_WARN ("BpLtpClaProtocol::SendSegments (): socket error " << m_socket->GetErrno ());
+
+      if (m_rate > 0)
+        {
+          // the next segment waits for the transmission time of this one
+          Time delay = Seconds ((size + UDP_IPV4_HEADER_SIZE) * 8.0 / m_rate);
+          m_sendEvent = Simulator::Schedule (delay, &BpLtpClaProtocol::SendSegments, this);
+          return;
+        }
+    }
+}
+
+void
+BpLtpClaProtocol::Deliver (uint64_t peer, Ptr<Packet> block)
+{
+  NS_LOG_FUNCTION (this << " " << peer << " " << block);
+  m_bp->ReceiveBundle (block);
+}
+
+int
+BpLtpClaProtocol::EnableReceive (const BpEndpointId &local)
+{
+  NS_LOG_FUNCTION (this << " " << local.Uri ());
+  InetSocketAddress addr (Ipv4Address::GetAny (), 0);
+  uint16_t port;
+  if (GetRoute (local, addr))
+    port = addr.GetPort ();
+  else
+    port = GetDefaultPort ();
+
+  Ptr<Socket> socket = Socket::CreateSocket (m_bp->GetNode (), UdpSocketFactory::GetTypeId ());
+  if (socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), port)) < 0)
+    return -1;
+
+  socket->SetRecvCallback (MakeCallback (&BpLtpClaProtocol::DataRecv, this));
+
+  if (!m_l4RecvSockets.Insert (local, socket))
+    return -1;
+
+  ConfigureEngine ();
+  return 0;
+}
+
+int
+BpLtpClaProtocol::DisableReceive (const BpEndpointId &local)
+{
+  NS_LOG_FUNCTION (this << " " << local.Uri ());
+  Ptr<Socket> *socket = m_l4RecvSockets.Find (local);
+  if (socket == NULL)
+    return -1;
+
+  return (*socket)->Close ();
+}
+
+int
+BpLtpClaProtocol::EnableSend (const BpEndpointId &src, const BpEndpointId &dst)
+{
+  NS_LOG_FUNCTION (this << " " << src.Uri () << " " << dst.Uri ());
+  InetSocketAddress address (Ipv4Address::GetAny (), 0);
+  if (!GetRoute (dst, address) || !OpenSocket ())
+    return -1;
+
+  return 0;
+}
+
+void
+BpLtpClaProtocol::DataRecv (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << " " << socket);
+  Ptr<Packet> packet;
+  Address from;
+  while ((packet = socket->RecvFrom (from)))
+    {
+      if (!InetSocketAddress::IsMatchingType (from))
+        continue;
+
+      // the answers of the engine go back to the sender of the segment
+      InetSocketAddress address = InetSocketAddress::ConvertFrom (from);
+      uint64_t peer = GetKey (address);
+      m_peers.insert (std::make_pair (peer, address));
+      m_engine.Receive (peer, packet);
+    }
+}
+
+void
+BpLtpClaProtocol::SetRoutingProtocol (Ptr<BpRoutingProtocol> route)
+{
+  NS_LOG_FUNCTION (this << " " << route);
+  m_bpRouting = route;
+}
+
+Ptr<BpRoutingProtocol>
+BpLtpClaProtocol::GetRoutingProtocol ()
+{
+  NS_LOG_FUNCTION (this);
+  return m_bpRouting;
+}
+
+} // namespace ns3
@@ -0,0 +1,217 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#ifndef BP_LTP_CLA_PROTOCOL_H
+#define BP_LTP_CLA_PROTOCOL_H
+
+#include "ns3/ptr.h"
+#include "bp-cla-protocol.h"
+#include "bp-endpoint-id.h"
+#include "ns3/socket.h"
+#include "ns3/packet.h"
+#include "bundle-protocol.h"
+#include "bp-routing-protocol.h"
+#include "bp-endpoint-map.h"
+#include "bp-ltp-engine.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include <deque>
+#include <map>
+
+namespace ns3 {
+
+/**
+ * \brief The LTP convergence layer adapter
+ *
+ * Each bundle is sent as one LTP block by a BpLtpEngine over UDP, so a
+ * bundle is not bounded by the MTU: the engine cuts it into data segments
+ * which fit in one datagram. All the bundle is red by default; the last
+ * GreenLength bytes of a larger bundle are sent green.
+ *
+ * LTP does not wait for acknowledgments before sending: the segments of all
+ * the stored bundles are written at once, or paced at the Rate attribute,
+ * so that the throughput of a long-delay link does not depend on its round
+ * trip time. The RetransmissionTimeout attribute must be larger than the
+ * round trip time.
+ *
+ * The engine id is the node id. The segments are sent and received by one
+ * UDP socket, and the peers are the socket addresses: the next hop of the
+ * route of a destination endpoint id, or the sender of a received segment.
+ */
+class BpLtpClaProtocol : public BpClaProtocol
+{
+public:
+
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief Constructor
+   */
+  BpLtpClaProtocol ();
+
+  /**
+   * Destroy
+   */
+  virtual ~BpLtpClaProtocol ();
+
+  /**
+   * \brief Send the stored bundles of the source endpoint id of a bundle,
+   * each in an LTP block
+   *
+   * \param packet the stored bundle
+   *
+   * \return -1 if there is no route for the destination endpoint id of the bundle
+   */
+  virtual int SendPacket (Ptr<Packet> packet);
+
+  /**
+   * Bind a UDP socket to the port of the local endpoint id
+   *
+   * \param local the local endpoint id
+   */
+  virtual int EnableReceive (const BpEndpointId &local);
+
+  /**
+   * Close the UDP socket of the local endpoint id
+   *
+   * \param local the endpoint id of registration
+   */
+  virtual int DisableReceive (const BpEndpointId &local);
+
+  /**
+   * Open the sender socket, there is no connection setup
+   *
+   * \param src the source endpoint id
+   * \param dst the destination endpoint id
+   */
+  virtual int EnableSend (const BpEndpointId &src, const BpEndpointId &dst);
+
+  /**
+   * \brief Get the sender socket, which is shared by all the bundles
+   *
+   * \param packet the bundle required to be transmitted
+   *
+   * \return NULL if there is no route for the destination endpoint id of the bundle
+   */
+  virtual Ptr<Socket> GetL4Socket (Ptr<Packet> packet);
+
+  /**
+   * \brief Send a copy of a bundle to a next hop chosen by the routing
+   * protocol, as a block of its own
+   *
+   * \return -1 if the socket cannot be opened
+   */
+  virtual int ForwardBundle (Ptr<Packet> bundle, const InetSocketAddress &nextHop);
+
+  /**
+   * \return the port listened on for a local endpoint id without route, LTP_UDP_PORT
+   */
+  virtual uint16_t GetDefaultPort ();
+
+  /**
+   * Connect to routing protocol
+   *
+   * \param route routing protocol
+   */
+  void SetRoutingProtocol (Ptr<BpRoutingProtocol> route);
+
+  /**
+   * Get routing protocol
+   *
+   * \return routing protocol
+   */
+  virtual Ptr<BpRoutingProtocol> GetRoutingProtocol ();
+
+  /**
+   * Connect to bundle protocol, the engine id is the node id
+   *
+   * \param bundleProtocol bundle protocol
+   */
+  void SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol);
+
+  /**
+   * \brief data receive callback, each datagram holds one segment
+   */
+  void DataRecv (Ptr<Socket> socket);
+
+private:
+  /**
+   * \brief Find the address of the next hop of a destination endpoint id
+   *
+   * \param dst the destination endpoint id
+   * \param address set to the address of the next hop
+   * \param size the size of the bundle to route, 0 if the route is not for a bundle
+   *
+   * \return false if there is no route for dst
+   */
+  bool GetRoute (const BpEndpointId &dst, InetSocketAddress &address, uint32_t size = 0);
+
+  /**
+   * \brief Open the sender socket if it is not open yet
+   *
+   * \return false on socket error
+   */
+  bool OpenSocket ();
+
+  /**
+   * \brief Configure the engine from the attributes
+   */
+  void ConfigureEngine ();
+
+  /**
+   * \return the handle of a peer, which is its socket address
+   */
+  static uint64_t GetKey (const InetSocketAddress &address);
+
+  /**
+   * \brief Engine send callback: queue a segment to a peer
+   */
+  void Transmit (uint64_t peer, Ptr<Packet> segment);
+
+  /**
+   * \brief Engine receive callback: deliver a block to the bundle protocol
+   */
+  void Deliver (uint64_t peer, Ptr<Packet> block);
+
+  /**
+   * \brief Write the queued segments, one at a time at the Rate attribute
+   */
+  void SendSegments ();
+
+  Ptr<BundleProtocol> m_bp;                                    /// bundle protocol
+  Ptr<BpRoutingProtocol> m_bpRouting;                          /// bundle routing protocol
+  Ptr<Socket> m_socket;                                        /// the sender socket
+  BpEndpointMap<Ptr<Socket> > m_l4RecvSockets;                 /// the receiver sockets
+  BpLtpEngine m_engine;                                        /// the LTP engine
+  std::map<uint64_t, InetSocketAddress> m_peers;               /// socket address by peer handle
+  std::deque<std::pair<uint64_t, Ptr<Packet> > > m_queue;      /// segments waiting for the pacing
+  EventId m_sendEvent;                                         /// the next paced send event
+
+  uint32_t m_mtu;                /// path MTU
+  uint32_t m_greenLength;        /// bytes at the end of a bundle sent green
+  Time m_rto;                    /// retransmission timeout of the checkpoints and the reports
+  uint32_t m_maxRetransmissions; /// retransmissions before a session is cancelled
+  uint64_t m_rate;               /// pacing rate in bit/s, 0 if not paced
+};
+
+} // namespace ns3
+
+#endif /* BP_LTP_CLA_PROTOCOL_H */
@@ -0,0 +1,757 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "bp-ltp-engine.h"
+#include "sdnv.h"
+#include <algorithm>
+
+NS_LOG_COMPONENT_DEFINE ("BpLtpEngine");
+
+// client service id of the bundle protocol, RFC 7122
+#define LTP_CLIENT_SERVICE_BUNDLE 1
+
+// the header of a data or report segment is parsed in a copy of this many
+// leading bytes; a report segment is copied whole
+#define LTP_MAX_HEADER_SIZE 256
+
+// reason code of a cancel segment: retransmission limit exceeded
+#define LTP_CANCEL_RLEXC 0x01
+
+namespace ns3 {
+
+BpLtpEngine::BpLtpEngine ()
+  : m_engineId (0),
+    m_segmentSize (1400),
+    m_rto (Seconds (1.0)),
+    m_maxRetransmissions (5),
+    m_sessionNumber (0),
+    m_retransmissions (0),
+    m_completed (0),
+    m_cancelled (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpLtpEngine::~BpLtpEngine ()
+{
+  NS_LOG_FUNCTION (this);
+  Clear ();
+}
+
+void
+BpLtpEngine::SetEngineId (uint64_t id)
+{
+  NS_LOG_FUNCTION (this << " " << id);
+  m_engineId = id;
+}
+
+uint64_t
+BpLtpEngine::GetEngineId () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_engineId;
+}
+
+void
+BpLtpEngine::SetSegmentSize (uint32_t size)
+{
+  NS_LOG_FUNCTION (this << " " << size);
+  m_segmentSize = std::max<uint32_t> (size, 1);
+}
+
+void
+BpLtpEngine::SetRetransmissionTimeout (Time timeout)
+{
+  NS_LOG_FUNCTION (this << " " << timeout);
+  m_rto = timeout;
+}
+
+void
+BpLtpEngine::SetMaxRetransmissions (uint32_t retransmissions)
+{
+  NS_LOG_FUNCTION (this << " " << retransmissions);
+  m_maxRetransmissions = retransmissions;
+}
+
+void
+BpLtpEngine::SetSendCallback (Callback<void, uint64_t, Ptr<Packet> > callback)
+{
+  NS_LOG_FUNCTION (this);
+  m_send = callback;
+}
+
+void
+BpLtpEngine::SetReceiveCallback (Callback<void, uint64_t, Ptr<Packet> > callback)
+{
+  NS_LOG_FUNCTION (this);
+  m_receive = callback;
+}
+
+uint32_t
+BpLtpEngine::GetExportSessions () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_exports.size ();
+}
+
+uint32_t
+BpLtpEngine::GetImportSessions () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_imports.size ();
+}
+
+uint32_t
+BpLtpEngine::GetRetransmissions () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_retransmissions;
+}
+
+uint32_t
+BpLtpEngine::GetCompleted () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_completed;
+}
+
+uint32_t
+BpLtpEngine::GetCancelled () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_cancelled;
+}
+
+void
+BpLtpEngine::Clear ()
+{
+  NS_LOG_FUNCTION (this);
+  while (!m_exports.empty ())
+    CloseExport (m_exports.begin ()->first);
+
+  while (!m_imports.empty ())
+    CloseImport (m_imports.begin ()->first);
+}
+
+Ptr<Packet>
+BpLtpEngine::BuildSegment (uint8_t type, const SessionId &session, const std::vector<uint64_t> &fields,
+                           Ptr<Packet> data)
+{
+  NS_LOG_FUNCTION (this << " " << (uint32_t) type);
+  // version 0, type, session id, no header and trailer extensions
+  std::vector<uint8_t> buf;
+  buf.reserve (2 + SDNV_MAX_LENGTH * (2 + fields.size ()));
+  buf.push_back (type & 0x0F);
+
+  SDNV sdnv;
+  uint8_t value[SDNV_MAX_LENGTH];
+  uint32_t len = sdnv.Encode (session.first, value);
+  buf.insert (buf.end (), value, value + len);
+  len = sdnv.Encode (session.second, value);
+  buf.insert (buf.end (), value, value + len);
+  buf.push_back (0);
+
+  for (uint32_t i = 0; i < fields.size (); i++)
+    {
+      len = sdnv.Encode (fields[i], value);
+      buf.insert (buf.end (), value, value + len);
+    }
+
+  Ptr<Packet> segment = Create<Packet> (&buf[0], buf.size ());
+  if (data)
+    segment->AddAtEnd (data);
+
+  return segment;
+}
+
+bool
+BpLtpEngine::ReadSdnv (Segment &segment, uint64_t &value)
+{
+  NS_LOG_FUNCTION (this);
+  if (segment.pos >= segment.bytes.size ())
+    return false;
+
+  SDNV sdnv;
+  uint32_t len = sdnv.Decode (&segment.bytes[segment.pos], segment.bytes.size () - segment.pos, &value, 1);
+  segment.pos += len;
+  return len > 0;
+}
+
+uint64_t
+BpLtpEngine::Send (uint64_t peer, Ptr<Packet> block, uint32_t redLength)
+{
+  NS_LOG_FUNCTION (this << " " << peer << " " << block << " " << redLength);
+  uint64_t number = ++m_sessionNumber;
+  ExportSession &session = m_exports[number];
+  session.peer = peer;
+  session.block = block;
+  session.redLength = std::min (redLength, block->GetSize ());
+
+  // an empty block is a single empty red segment
+  if (session.redLength > 0 || block->GetSize () == 0)
+    SendRed (number, 0, session.redLength, true, 0);
+
+  SendGreen (number);
+
+  // a green block is not acknowledged
+  if (block->GetSize () > 0 && session.redLength == 0)
+    {
+      m_completed++;
+      CloseExport (number);
+    }
+
+  return number;
+}
+
+void
+BpLtpEngine::SendRed (uint64_t number, uint32_t start, uint32_t end, bool checkpoint, uint64_t reportSerial)
+{
+  NS_LOG_FUNCTION (this << " " << number << " " << start << " " << end << " " << checkpoint << " " << reportSerial);
+  ExportSession &session = m_exports[number];
+  SessionId id (m_engineId, number);
+
+  uint32_t offset = start;
+  do
+    {
+      uint32_t length = std::min (m_segmentSize, end - offset);
+      bool last = offset + length == end;
+
+      std::vector<uint64_t> fields;
+      fields.push_back (LTP_CLIENT_SERVICE_BUNDLE);
+      fields.push_back (offset);
+      fields.push_back (length);
+
+      uint8_t type = RED_DATA;
+      if (last && checkpoint)
+        {
+          if (end < session.redLength)
+            type = RED_CHECKPOINT;
+          else if (session.redLength < session.block->GetSize ())
+            type = RED_EORP;
+          else
+            type = RED_EOB;
+
+          fields.push_back (++session.checkpointSerial);
+          fields.push_back (reportSerial);
+        }
+
+      Ptr<Packet> segment = BuildSegment (type, id, fields, session.block->CreateFragment (offset, length));
+      if (type != RED_DATA)
+        {
+          Pending &pending = session.checkpoints[session.checkpointSerial];
+          pending.segment = segment;
+          pending.timer = Simulator::Schedule (m_rto, &BpLtpEngine::CheckpointTimeout, this,
+                                               number, session.checkpointSerial);
+        }
+
+      m_send (session.peer, segment->Copy ());
+      offset += length;
+    }
+  while (offset < end);
+}
+
+void
+BpLtpEngine::SendGreen (uint64_t number)
+{
+  NS_LOG_FUNCTION (this << " " << number);
+  ExportSession &session = m_exports[number];
+  SessionId id (m_engineId, number);
+  uint32_t size = session.block->GetSize ();
+
+  for (uint32_t offset = session.redLength; offset < size; )
+    {
+      uint32_t length = std::min (m_segmentSize, size - offset);
+      std::vector<uint64_t> fields;
+      fields.push_back (LTP_CLIENT_SERVICE_BUNDLE);
+      fields.push_back (offset);
+      fields.push_back (length);
+
+      uint8_t type = offset + length == size ? GREEN_EOB : GREEN_DATA;
+      m_send (session.peer, BuildSegment (type, id, fields, session.block->CreateFragment (offset, length)));
+      offset += length;
+    }
+}
+
+void
+BpLtpEngine::Receive (uint64_t peer, Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << " " << peer << " " << packet);
+  Segment segment;
+  segment.size = packet->GetSize ();
+  segment.pos = 0;
+  segment.bytes.resize (std::min<uint32_t> (segment.size, LTP_MAX_HEADER_SIZE));
+  if (segment.bytes.empty ())
+    return;
+
+  packet->CopyData (&segment.bytes[0], segment.bytes.size ());
+  if ((segment.bytes[0] >> 4) != 0)
+    {
+      NS_LOG_DEBUG ("BpLtpEngine::Receive (): drop segment of version " << (segment.bytes[0] >> 4));
+      return;
+    }
+
+  segment.type = segment.bytes[0] & 0x0F;
+  if (segment.type == REPORT && segment.size > segment.bytes.size ())
+    {
+      segment.bytes.resize (segment.size);
+      packet->CopyData (&segment.bytes[0], segment.size);
+    }
+
+  segment.pos = 1;
+  if (!ReadSdnv (segment, segment.session.first) || !ReadSdnv (segment, segment.session.second)
+      || segment.pos >= segment.bytes.size ())
+    {
+      NS_LOG_DEBUG ("BpLtpEngine::Receive (): drop truncated segment");
+      return;
+    }
+
+  // skip the header extensions: tag, length, value
+  uint8_t extensions = segment.bytes[segment.pos] >> 4;
+  segment.pos++;
+  for (uint8_t i = 0; i < extensions; i++)
+    {
+      uint64_t length;
+      segment.pos++;
+      if (!ReadSdnv (segment, length) || segment.pos + length > segment.bytes.size ())
+        return;
+      segment.pos += length;
+    }
+
+  if (segment.type <= GREEN_EOB)
+    ReceiveData (peer, segment, packet);
+  else if (segment.type == REPORT)
+    ReceiveReport (peer, segment);
+  else if (segment.type == REPORT_ACK)
+    ReceiveReportAck (segment);
+  else
+    ReceiveCancel (peer, segment);
+}
+
+void
+BpLtpEngine::ReceiveData (uint64_t peer, Segment &segment, Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << " " << peer << " " << (uint32_t) segment.type);
+  uint64_t service, offset, length;
+  uint64_t checkpointSerial = 0, reportSerial = 0;
+  bool checkpoint = segment.type >= RED_CHECKPOINT && segment.type <= RED_EOB;
+  if (!ReadSdnv (segment, service) || !ReadSdnv (segment, offset) || !ReadSdnv (segment, length)
+      || (checkpoint && (!ReadSdnv (segment, checkpointSerial) || !ReadSdnv (segment, reportSerial)))
+      || segment.pos + length > segment.size || offset + length > 0xFFFFFFFF)
+    {
+      NS_LOG_DEBUG ("BpLtpEngine::ReceiveData (): drop malformed data segment");
+      return;
+    }
+
+  std::map<SessionId, ImportSession>::iterator it = m_imports.find (segment.session);
+  if (it == m_imports.end ())
+    {
+      it = m_imports.insert (std::make_pair (segment.session, ImportSession ())).first;
+      it->second.timeout = Simulator::Schedule (GetImportTimeout (), &BpLtpEngine::ImportTimeout, this, segment.session);
+    }
+
+  // the reports are sent to the handle of the last data segment
+  ImportSession &session = it->second;
+  session.peer = peer;
+  session.lastActivity = Simulator::Now ();
+  if (session.delivered)
+    {
+      // the last report is lost, answer the checkpoint again
+      if (checkpoint)
+        SendReport (segment.session, checkpointSerial, offset + length);
+      return;
+    }
+
+  uint32_t end = offset + length;
+  if (length > 0 && AddExtent (session.extents, offset, end) > 0)
+    session.data[offset] = packet->CreateFragment (segment.pos, length);
+
+  if (segment.type == RED_EOB || segment.type == GREEN_EOB)
+    {
+      session.blockEnd = true;
+      session.blockLength = end;
+    }
+
+  if (checkpoint)
+    SendReport (segment.session, checkpointSerial, end);
+
+  CheckImport (segment.session);
+}
+
+void
+BpLtpEngine::SendReport (const SessionId &id, uint64_t checkpointSerial, uint32_t upper)
+{
+  NS_LOG_FUNCTION (this << " " << checkpointSerial << " " << upper);
+  ImportSession &session = m_imports[id];
+
+  // the report claims all the bytes received below the checkpoint
+  std::vector<uint64_t> fields;
+  fields.push_back (++session.reportSerial);
+  fields.push_back (checkpointSerial);
+  fields.push_back (upper);
+  fields.push_back (0);
+
+  std::vector<uint64_t> claims;
+  for (Extents::const_iterator it = session.extents.begin ();
+       it != session.extents.end () && it->first < upper; ++it)
+    {
+      claims.push_back (it->first);
+      claims.push_back (std::min (it->second, upper) - it->first);
+    }
+
+  fields.push_back (claims.size () / 2);
+  fields.insert (fields.end (), claims.begin (), claims.end ());
+
+  Pending &pending = session.reports[session.reportSerial];
+  pending.segment = BuildSegment (REPORT, id, fields);
+  pending.timer = Simulator::Schedule (m_rto, &BpLtpEngine::ReportTimeout, this, id, session.reportSerial);
+  m_send (session.peer, pending.segment->Copy ());
+}
+
+void
+BpLtpEngine::CheckImport (const SessionId &id)
+{
+  NS_LOG_FUNCTION (this);
+  std::map<SessionId, ImportSession>::iterator it = m_imports.find (id);
+  if (it == m_imports.end ())
+    return;
+
+  ImportSession &session = it->second;
+  if (!session.delivered && session.blockEnd && Covers (session.extents, session.blockLength))
+    {
+      Ptr<Packet> block = Create<Packet> ();
+      for (std::map<uint32_t, Ptr<Packet> >::const_iterator d = session.data.begin (); d != session.data.end (); ++d)
+        {
+          uint32_t end = block->GetSize ();
+          uint32_t dataEnd = d->first + d->second->GetSize ();
+          if (dataEnd <= end)
+            continue;
+          block->AddAtEnd (d->second->CreateFragment (end - d->first, dataEnd - end));
+        }
+
+      session.delivered = true;
+      session.data.clear ();
+      NS_LOG_DEBUG ("BpLtpEngine::CheckImport (): block of " << block->GetSize () << " bytes from engine " << id.first);
+      if (!m_receive.IsNull ())
+        m_receive (session.peer, block);
+
+      // the receive callback may clear the engine
+      it = m_imports.find (id);
+      if (it == m_imports.end ())
+        return;
+    }
+
+  if (it->second.delivered && it->second.reports.empty ())
+    CloseImport (id);
+}
+
+void
+BpLtpEngine::ReceiveReport (uint64_t peer, Segment &segment)
+{
+  NS_LOG_FUNCTION (this << " " << peer);
+  uint64_t reportSerial, checkpointSerial, upper, lower, count;
+  if (!ReadSdnv (segment, reportSerial) || !ReadSdnv (segment, checkpointSerial) || !ReadSdnv (segment, upper)
+      || !ReadSdnv (segment, lower) || !ReadSdnv (segment, count))
+    {
+      NS_LOG_DEBUG ("BpLtpEngine::ReceiveReport (): drop malformed report segment");
+      return;
+    }
+
+  std::vector<std::pair<uint64_t, uint64_t> > claims;
+  for (uint64_t i = 0; i < count; i++)
+    {
+      uint64_t offset, length;
+      if (!ReadSdnv (segment, offset) || !ReadSdnv (segment, length))
+        {
+          NS_LOG_DEBUG ("BpLtpEngine::ReceiveReport (): drop malformed report segment");
+          return;
+        }
+      claims.push_back (std::make_pair (offset, length));
+    }
+
+  if (segment.session.first != m_engineId)
+    return;
+
+  // every report is acknowledged, also the one of a closed session
+  std::vector<uint64_t> fields;
+  fields.push_back (reportSerial);
+  m_send (peer, BuildSegment (REPORT_ACK, segment.session, fields));
+
+  std::map<uint64_t, ExportSession>::iterator it = m_exports.find (segment.session.second);
+  if (it == m_exports.end ())
+    {
+      NS_LOG_DEBUG ("BpLtpEngine::ReceiveReport (): report of closed session " << segment.session.second);
+      return;
+    }
+
+  ExportSession &session = it->second;
+  std::map<uint64_t, Pending>::iterator cp = session.checkpoints.find (checkpointSerial);
+  if (cp != session.checkpoints.end ())
+    {
+      cp->second.timer.Cancel ();
+      session.checkpoints.erase (cp);
+    }
+
+  // a report sent again is answered only once
+  if (!session.reports.insert (reportSerial).second)
+    return;
+
+  upper = std::min<uint64_t> (upper, session.redLength);
+  for (uint32_t i = 0; i < claims.size (); i++)
+    {
+      uint64_t start = lower + claims[i].first;
+      uint64_t end = std::min (start + claims[i].second, upper);
+      if (start < end)
+        AddExtent (session.claimed, start, end);
+    }
+
+  if (Covers (session.claimed, session.redLength))
+    {
+      NS_LOG_DEBUG ("BpLtpEngine::ReceiveReport (): red part of session " << segment.session.second << " acknowledged");
+      m_completed++;
+      CloseExport (segment.session.second);
+      return;
+    }
+
+  // send again the gaps of the report scope, the last one ends with a checkpoint
+  std::vector<std::pair<uint32_t, uint32_t> > gaps;
+  uint32_t offset = lower;
+  for (Extents::const_iterator e = session.claimed.begin (); e != session.claimed.end () && offset < upper; ++e)
+    {
+      if (e->second <= offset)
+        continue;
+      if (e->first > offset)
+        gaps.push_back (std::make_pair (offset, std::min<uint32_t> (e->first, upper)));
+      offset = e->second;
+    }
+  if (offset < upper)
+    gaps.push_back (std::make_pair (offset, (uint32_t) upper));
+
+  for (uint32_t i = 0; i < gaps.size (); i++)
+    {
+      m_retransmissions += (gaps[i].second - gaps[i].first + m_segmentSize - 1) / m_segmentSize;
+      SendRed (segment.session.second, gaps[i].first, gaps[i].second, i + 1 == gaps.size (), reportSerial);
+    }
+}
+
+void
+BpLtpEngine::ReceiveReportAck (Segment &segment)
+{
+  NS_LOG_FUNCTION (this);
+  uint64_t reportSerial;
+  if (!ReadSdnv (segment, reportSerial))
+    return;
+
+  std::map<SessionId, ImportSession>::iterator it = m_imports.find (segment.session);
+  if (it == m_imports.end ())
+    return;
+
+  std::map<uint64_t, Pending>::iterator report = it->second.reports.find (reportSerial);
+  if (report != it->second.reports.end ())
+    {
+      report->second.timer.Cancel ();
+      it->second.reports.erase (report);
+    }
+
+  CheckImport (segment.session);
+}
+
+void
+BpLtpEngine::ReceiveCancel (uint64_t peer, Segment &segment)
+{
+  NS_LOG_FUNCTION (this << " " << peer << " " << (uint32_t) segment.type);
+  if (segment.type == CANCEL_FROM_SENDER)
+    {
+      std::map<SessionId, ImportSession>::iterator it = m_imports.find (segment.session);
+      if (it == m_imports.end ())
+        return;
+
+      SendCancel (CANCEL_ACK_TO_SENDER, segment.session, peer);
+      CloseImport (segment.session);
+    }
+  else if (segment.type == CANCEL_FROM_RECEIVER && segment.session.first == m_engineId)
+    {
+      std::map<uint64_t, ExportSession>::iterator it = m_exports.find (segment.session.second);
+      if (it == m_exports.end ())
+        return;
+
+      NS_LOG_DEBUG ("BpLtpEngine::ReceiveCancel (): session " << segment.session.second << " cancelled by the receiver");
+      SendCancel (CANCEL_ACK_TO_RECEIVER, segment.session, peer);
+      m_cancelled++;
+      CloseExport (segment.session.second);
+    }
+}
+
+void
+BpLtpEngine::SendCancel (uint8_t type, const SessionId &id, uint64_t peer)
+{
+  NS_LOG_FUNCTION (this << " " << (uint32_t) type << " " << peer);
+  std::vector<uint64_t> fields;
+  Ptr<Packet> segment = BuildSegment (type, id, fields);
+  if (type == CANCEL_FROM_SENDER || type == CANCEL_FROM_RECEIVER)
+    {
+      uint8_t reason = LTP_CANCEL_RLEXC;
+      segment->AddAtEnd (Create<Packet> (&reason, 1));
+    }
+  m_send (peer, segment);
+}
+
+void
+BpLtpEngine::CheckpointTimeout (uint64_t number, uint64_t serial)
+{
+  NS_LOG_FUNCTION (this << " " << number << " " << serial);
+  ExportSession &session = m_exports[number];
+  Pending &pending = session.checkpoints[serial];
+  if (++pending.retransmissions > m_maxRetransmissions)
+    {
+      NS_LOG_DEBUG ("BpLtpEngine::CheckpointTimeout (): cancel session " << number);
+      SendCancel (CANCEL_FROM_SENDER, SessionId (m_engineId, number), session.peer);
+      m_cancelled++;
+      CloseExport (number);
+      return;
+    }
+
+  pending.timer = Simulator::Schedule (m_rto, &BpLtpEngine::CheckpointTimeout, this, number, serial);
+  m_send (session.peer, pending.segment->Copy ());
+}
+
+void
+BpLtpEngine::ReportTimeout (SessionId id, uint64_t serial)
+{
+  NS_LOG_FUNCTION (this << " " << serial);
+  ImportSession &session = m_imports[id];
+  Pending &pending = session.reports[serial];
+  if (++pending.retransmissions > m_maxRetransmissions)
+    {
+      NS_LOG_DEBUG ("BpLtpEngine::ReportTimeout (): cancel session " << id.second << " from engine " << id.first);
+      SendCancel (CANCEL_FROM_RECEIVER, id, session.peer);
+      CloseImport (id);
+      return;
+    }
+
+  pending.timer = Simulator::Schedule (m_rto, &BpLtpEngine::ReportTimeout, this, id, serial);
+  m_send (session.peer, pending.segment->Copy ());
+}
+
+void
+BpLtpEngine::ImportTimeout (SessionId id)
+{
+  NS_LOG_FUNCTION (this << " " << id.second);
+  ImportSession &session = m_imports[id];
+
+  // a session waiting for a report acknowledgment is closed by the report timer
+  Time timeout = GetImportTimeout ();
+  Time idle = Simulator::Now () - session.lastActivity;
+  if (idle < timeout || !session.reports.empty ())
+    {
+      session.timeout = Simulator::Schedule (std::max (timeout - idle, m_rto), &BpLtpEngine::ImportTimeout, this, id);
+      return;
+    }
+
+  if (!session.delivered)
+    NS_LOG_DEBUG ("BpLtpEngine::ImportTimeout (): drop incomplete block of session " << id.second
+                  << " from engine " << id.first);
+  CloseImport (id);
+}
+
+Time
+BpLtpEngine::GetImportTimeout () const
+{
+  NS_LOG_FUNCTION (this);
+  return Seconds (m_rto.GetSeconds () * (m_maxRetransmissions + 1));
+}
+
+void
+BpLtpEngine::CloseExport (uint64_t number)
+{
+  NS_LOG_FUNCTION (this << " " << number);
+  std::map<uint64_t, ExportSession>::iterator it = m_exports.find (number);
+  if (it == m_exports.end ())
+    return;
+
+  for (std::map<uint64_t, Pending>::iterator cp = it->second.checkpoints.begin ();
+       cp != it->second.checkpoints.end (); ++cp)
+    cp->second.timer.Cancel ();
+
+  m_exports.erase (it);
+}
+
+void
+BpLtpEngine::CloseImport (const SessionId &id)
+{
+  NS_LOG_FUNCTION (this << " " << id.second);
+  std::map<SessionId, ImportSession>::iterator it = m_imports.find (id);
+  if (it == m_imports.end ())
+    return;
+
+  for (std::map<uint64_t, Pending>::iterator report = it->second.reports.begin ();
+       report != it->second.reports.end (); ++report)
+    report->second.timer.Cancel ();
+
+  it->second.timeout.Cancel ();
+  m_imports.erase (it);
+}
+
+uint32_t
+BpLtpEngine::AddExtent (Extents &extents, uint32_t start, uint32_t end)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  uint32_t covered = 0;
+  Extents::iterator it = extents.upper_bound (start);
+  if (it != extents.begin ())
+    {
+      Extents::iterator prev = it;
+      --prev;
+      if (prev->second >= start)
+        {
+          it = prev;
+        }
+    }
+
+  // merge all the extents overlapping or adjacent to [start, end)
+  uint32_t newStart = start;
+  uint32_t newEnd = end;
+  while (it != extents.end () && it->first <= end)
+    {
+      uint32_t lo = std::max (it->first, start);
+      uint32_t hi = std::min (it->second, end);
+      if (hi > lo)
+        covered += hi - lo;
+      newStart = std::min (newStart, it->first);
+      newEnd = std::max (newEnd, it->second);
+      extents.erase (it++);
+    }
+
+  extents[newStart] = newEnd;
+  return (end - start) - covered;
+}
+
+bool
+BpLtpEngine::Covers (const Extents &extents, uint32_t length)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  if (length == 0)
+    return true;
+
+  return !extents.empty () && extents.begin ()->first == 0 && extents.begin ()->second >= length;
+}
+
+} // namespace ns3
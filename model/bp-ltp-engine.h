@@ -0,0 +1,365 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+#ifndef BP_LTP_ENGINE_H
+#define BP_LTP_ENGINE_H
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <vector>
+#include "ns3/ptr.h"
+#include "ns3/packet.h"
+#include "ns3/callback.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+
+namespace ns3 {
+
+/**
+ * \brief An engine of the Licklider Transmission Protocol, RFC 5326
+ *
+ * A block is sent in an export session as data segments of at most the
+ * segment size: its first red part reliably, its last green part without
+ * acknowledgement. The last segment of the red part is a checkpoint, which
+ * the receiver answers with a report segment claiming the received red byte
+ * ranges; the sender acknowledges the report and sends again only the gaps
+ * of the report, ending with a new checkpoint, until the whole red part is
+ * claimed. The checkpoints and the reports are retransmitted after the
+ * retransmission timeout, and a session whose retransmissions exceed the
+ * limit is cancelled.
+ *
+ * There is no handshake and no congestion window: all the segments of a
+ * block are sent at once, so the throughput does not depend on the round
+ * trip time, which only delays the retransmissions.
+ *
+ * The engine is independent of the transport layer: the segments are
+ * written with the send callback to an opaque peer handle, and the received
+ * segments are given to Receive with the handle of their sender. A block is
+ * delivered once all its bytes are received; a block whose green part is
+ * lost is dropped after the retransmission timeout.
+ */
+class BpLtpEngine
+{
+public:
+  /**
+   * segment types, section 3.1 of RFC 5326
+   */
+  typedef enum {
+    RED_DATA = 0x0,                   /// red data, not a checkpoint
+    RED_CHECKPOINT = 0x1,             /// red data, checkpoint
+    RED_EORP = 0x2,                   /// red data, checkpoint, end of red part
+    RED_EOB = 0x3,                    /// red data, checkpoint, end of red part, end of block
+    GREEN_DATA = 0x4,                 /// green data
+    GREEN_EOB = 0x7,                  /// green data, end of block
+    REPORT = 0x8,                     /// report segment
+    REPORT_ACK = 0x9,                 /// report-acknowledgment segment
+    CANCEL_FROM_SENDER = 0xC,         /// cancel segment from the block sender
+    CANCEL_ACK_TO_SENDER = 0xD,       /// cancel-acknowledgment segment to the block sender
+    CANCEL_FROM_RECEIVER = 0xE,       /// cancel segment from the block receiver
+    CANCEL_ACK_TO_RECEIVER = 0xF      /// cancel-acknowledgment segment to the block receiver
+  } SegmentType;
+
+  BpLtpEngine ();
+  virtual ~BpLtpEngine ();
+
+  /**
+   * \param id the engine id of this engine, which originates the export sessions
+   */
+  void SetEngineId (uint64_t id);
+
+  /**
+   * \return the engine id
+   */
+  uint64_t GetEngineId () const;
+
+  /**
+   * \param size the maximum data bytes of a data segment
+   */
+  void SetSegmentSize (uint32_t size);
+
+  /**
+   * \param timeout the time after which an unanswered checkpoint or report
+   * is sent again, which must be larger than the round trip time
+   */
+  void SetRetransmissionTimeout (Time timeout);
+
+  /**
+   * \param retransmissions the retransmissions of a checkpoint or a report
+   * after which its session is cancelled
+   */
+  void SetMaxRetransmissions (uint32_t retransmissions);
+
+  /**
+   * \param callback writes a segment to the peer of the given handle
+   */
+  void SetSendCallback (Callback<void, uint64_t, Ptr<Packet> > callback);
+
+  /**
+   * \param callback called with the handle of the sender and each received block
+   */
+  void SetReceiveCallback (Callback<void, uint64_t, Ptr<Packet> > callback);
+
+  /**
+   * \brief Start an export session
+   *
+   * \param peer the handle of the receiver
+   * \param block the block
+   * \param redLength the bytes of the red part, the rest of the block is green
+   *
+   * \return the session number
+   */
+  uint64_t Send (uint64_t peer, Ptr<Packet> block, uint32_t redLength);
+
+  /**
+   * \brief Handle a received segment
+   *
+   * \param peer the handle of the sender of the segment
+   * \param segment the segment
+   */
+  void Receive (uint64_t peer, Ptr<Packet> segment);
+
+  /**
+   * \return the number of open export sessions
+   */
+  uint32_t GetExportSessions () const;
+
+  /**
+   * \return the number of open import sessions
+   */
+  uint32_t GetImportSessions () const;
+
+  /**
+   * \return the number of red data segments sent again
+   */
+  uint32_t GetRetransmissions () const;
+
+  /**
+   * \return the number of export sessions whose red part is completely acknowledged
+   */
+  uint32_t GetCompleted () const;
+
+  /**
+   * \return the number of cancelled export sessions
+   */
+  uint32_t GetCancelled () const;
+
+  /**
+   * \brief Close all sessions without sending anything
+   */
+  void Clear ();
+
+private:
+  /**
+   * \brief the id of a session: the engine id of its originator and its number
+   */
+  typedef std::pair<uint64_t, uint64_t> SessionId;
+
+  /**
+   * \brief received byte ranges, start -> end, disjoint and not adjacent
+   */
+  typedef std::map<uint32_t, uint32_t> Extents;
+
+  /**
+   * \brief a checkpoint or a report waiting for its answer
+   */
+  struct Pending
+  {
+    Pending ()
+      : retransmissions (0)
+    {
+    }
+
+    Ptr<Packet> segment;        /// the segment, sent again on timeout
+    EventId timer;              /// retransmission timer
+    uint32_t retransmissions;   /// retransmissions so far
+  };
+
+  /**
+   * \brief the state of a sent block
+   */
+  struct ExportSession
+  {
+    ExportSession ()
+      : peer (0),
+        redLength (0),
+        checkpointSerial (0)
+    {
+    }
+
+    uint64_t peer;                             /// handle of the receiver
+    Ptr<Packet> block;                         /// the block
+    uint32_t redLength;                        /// bytes of the red part
+    uint64_t checkpointSerial;                 /// serial number of the last checkpoint
+    std::map<uint64_t, Pending> checkpoints;   /// checkpoints not answered, by serial number
+    std::set<uint64_t> reports;                /// serial numbers of the handled reports
+    Extents claimed;                           /// red byte ranges claimed by the reports
+  };
+
+  /**
+   * \brief the state of a received block
+   */
+  struct ImportSession
+  {
+    ImportSession ()
+      : peer (0),
+        blockLength (0),
+        blockEnd (false),
+        delivered (false),
+        reportSerial (0)
+    {
+    }
+
+    uint64_t peer;                             /// handle of the sender
+    uint32_t blockLength;                      /// length of the block, once the end of block is received
+    bool blockEnd;                             /// the end of block is received
+    bool delivered;                            /// the block is delivered
+    Extents extents;                           /// received byte ranges
+    std::map<uint32_t, Ptr<Packet> > data;     /// received data segments by offset
+    uint64_t reportSerial;                     /// serial number of the last report
+    std::map<uint64_t, Pending> reports;       /// reports not acknowledged, by serial number
+    Time lastActivity;                         /// the last time a segment was received
+    EventId timeout;                           /// inactivity timer
+  };
+
+  /**
+   * \brief a parsed segment header
+   */
+  struct Segment
+  {
+    uint8_t type;                 /// segment type
+    SessionId session;            /// session id
+    std::vector<uint8_t> bytes;   /// the copied bytes of the segment
+    uint32_t pos;                 /// the next byte to parse
+    uint32_t size;                /// size of the whole segment
+  };
+
+  /**
+   * \brief Build a segment
+   *
+   * \param fields the integers of the segment content, encoded as SDNVs
+   * \param data the data of a data segment, or NULL
+   */
+  Ptr<Packet> BuildSegment (uint8_t type, const SessionId &session, const std::vector<uint64_t> &fields,
+                            Ptr<Packet> data = NULL);
+
+  /**
+   * \brief Read the next SDNV of a segment
+   *
+   * \return false if the segment is truncated
+   */
+  bool ReadSdnv (Segment &segment, uint64_t &value);
+
+  /**
+   * \brief Send the red byte range [start, end) of an export session
+   *
+   * \param checkpoint true if the last segment is a checkpoint
+   * \param reportSerial the serial number of the report answered by the checkpoint
+   */
+  void SendRed (uint64_t number, uint32_t start, uint32_t end, bool checkpoint, uint64_t reportSerial);
+
+  /**
+   * \brief Send the green part of an export session
+   */
+  void SendGreen (uint64_t number);
+
+  /**
+   * \brief Handle a data segment, \p peer is the handle of the sender
+   */
+  void ReceiveData (uint64_t peer, Segment &segment, Ptr<Packet> packet);
+
+  /**
+   * \brief Handle a report segment, \p peer is the handle of the sender
+   */
+  void ReceiveReport (uint64_t peer, Segment &segment);
+
+  /**
+   * \brief Handle a report-acknowledgment segment
+   */
+  void ReceiveReportAck (Segment &segment);
+
+  /**
+   * \brief Handle a cancel segment, \p peer is the handle of the sender
+   */
+  void ReceiveCancel (uint64_t peer, Segment &segment);
+
+  /**
+   * \brief Send a report of the red byte ranges received up to a checkpoint
+   */
+  void SendReport (const SessionId &id, uint64_t checkpointSerial, uint32_t upper);
+
+  /**
+   * \brief Deliver a block which is complete, close its session when
+   * all its reports are acknowledged
+   */
+  void CheckImport (const SessionId &id);
+
+  /**
+   * \brief Send a cancel segment, which is not retransmitted
+   */
+  void SendCancel (uint8_t type, const SessionId &id, uint64_t peer);
+
+  void CheckpointTimeout (uint64_t number, uint64_t serial);
+  void ReportTimeout (SessionId id, uint64_t serial);
+  void ImportTimeout (SessionId id);
+
+  /**
+   * \return the time after which an import session without segments is closed
+   */
+  Time GetImportTimeout () const;
+
+  /**
+   * \brief Close an export session
+   */
+  void CloseExport (uint64_t number);
+
+  /**
+   * \brief Close an import session
+   */
+  void CloseImport (const SessionId &id);
+
+  /**
+   * \brief Add the byte range [start, end) to extents
+   *
+   * \return the number of bytes which were not in extents yet
+   */
+  static uint32_t AddExtent (Extents &extents, uint32_t start, uint32_t end);
+
+  /**
+   * \return true if extents cover [0, length)
+   */
+  static bool Covers (const Extents &extents, uint32_t length);
+
+  uint64_t m_engineId;                              /// engine id
+  uint32_t m_segmentSize;                           /// maximum data bytes of a data segment
+  Time m_rto;                                       /// retransmission timeout
+  uint32_t m_maxRetransmissions;                    /// retransmissions before a session is cancelled
+  uint64_t m_sessionNumber;                         /// number of the last export session
+  std::map<uint64_t, ExportSession> m_exports;      /// export sessions by number
+  std::map<SessionId, ImportSession> m_imports;     /// import sessions by id
+  uint32_t m_retransmissions;                       /// red data segments sent again
+  uint32_t m_completed;                             /// completed export sessions
+  uint32_t m_cancelled;                             /// cancelled export sessions
+  Callback<void, uint64_t, Ptr<Packet> > m_send;    /// send callback
+  Callback<void, uint64_t, Ptr<Packet> > m_receive; /// received block callback
+};
+
+} // namespace ns3
+
+#endif /* BP_LTP_ENGINE_H */
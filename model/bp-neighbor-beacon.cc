@@ -0,0 +1,143 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#include "bp-neighbor-beacon.h"
+#include "ns3/log.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+#include "ns3/ipv4.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/inet-socket-address.h"
+#include <algorithm>
+
+NS_LOG_COMPONENT_DEFINE ("BpNeighborBeacon");
+
+namespace ns3 {
+
+BpNeighborBeacon::BpNeighborBeacon ()
+  : m_socket (0),
+    m_port (0),
+    m_sent (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpNeighborBeacon::~BpNeighborBeacon ()
+{
+  NS_LOG_FUNCTION (this);
+  Stop ();
+}
+
+void
+BpNeighborBeacon::SetNeighborCallback (Callback<void, Ipv4Address> callback)
+{
+  NS_LOG_FUNCTION (this);
+  m_neighbor = callback;
+}
+
+bool
+BpNeighborBeacon::Start (Ptr<Node> node, uint16_t port, Time interval)
+{
+  NS_LOG_FUNCTION (this << " " << node << " " << port << " " << interval.GetSeconds ());
+  Stop ();
+  m_port = port;
+  m_interval = interval;
+
+  m_local.clear ();
+  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+  if (ipv4)
+    {
+      for (uint32_t i = 0; i < ipv4->GetNInterfaces (); i++)
+        {
+          for (uint32_t j = 0; j < ipv4->GetNAddresses (i); j++)
+            m_local.push_back (ipv4->GetAddress (i, j).GetLocal ());
+        }
+    }
+
+  m_socket = Socket::CreateSocket (node, UdpSocketFactory::GetTypeId ());
+  if (m_socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_port)) < 0)
+    {
+      NS_LOG_WARN ("BpNeighborBeacon::Start (): socket error " << m_socket->GetErrno ());
+      m_socket = 0;
+      return false;
+    }
+
+  m_socket->SetAllowBroadcast (true);
+  m_socket->SetRecvCallback (MakeCallback (&BpNeighborBeacon::ReceiveBeacon, this));
+  if (m_interval > Seconds (0))
+    m_beaconEvent = Simulator::ScheduleNow (&BpNeighborBeacon::SendBeacon, this);
+
+  return true;
+}
+
+void
+BpNeighborBeacon::Stop ()
+{
+  NS_LOG_FUNCTION (this);
+  m_beaconEvent.Cancel ();
+  if (!m_socket)
+    return;
+
+  m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+  m_socket->Close ();
+  m_socket = 0;
+}
+
+void
+BpNeighborBeacon::SendBeacon ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_socket->SendTo (Create<Packet> (), 0, InetSocketAddress (Ipv4Address::GetBroadcast (), m_port)) < 0)
+    NS_LOG_WARN ("BpNeighborBeacon::SendBeacon (): socket error " << m_socket->GetErrno ());
+  else
+    m_sent++;
+
+  m_beaconEvent = Simulator::Schedule (m_interval, &BpNeighborBeacon::SendBeacon, this);
+}
+
+void
+BpNeighborBeacon::ReceiveBeacon (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << " " << socket);
+  Ptr<Packet> packet;
+  Address from;
+  while ((packet = socket->RecvFrom (from)))
+    {
+      if (!InetSocketAddress::IsMatchingType (from))
+        continue;
+
+      Ipv4Address neighbor = InetSocketAddress::ConvertFrom (from).GetIpv4 ();
+      if (std::find (m_local.begin (), m_local.end (), neighbor) != m_local.end ())
+        continue;
+
+      NS_LOG_DEBUG ("BpNeighborBeacon::ReceiveBeacon (): beacon of " << neighbor);
+      if (!m_neighbor.IsNull ())
+        m_neighbor (neighbor);
+    }
+}
+
+uint32_t
+BpNeighborBeacon::GetBeaconsSent () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_sent;
+}
+
+} // namespace ns3
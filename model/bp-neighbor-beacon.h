@@ -0,0 +1,100 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#ifndef BP_NEIGHBOR_BEACON_H
+#define BP_NEIGHBOR_BEACON_H
+
+#include "ns3/ptr.h"
+#include "ns3/node.h"
+#include "ns3/socket.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/callback.h"
+#include "ns3/ipv4-address.h"
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief The neighbor discovery of the opportunistic routing protocols
+ *
+ * A node broadcasts an empty UDP datagram, the beacon, on all its
+ * interfaces every beacon interval. A node which receives the beacon of a
+ * neighbor reports it to the neighbor callback; as both sides beacon, both
+ * report each other, e.g. to start the exchange of a contact. The neighbor
+ * is reported at each beacon received, the callback rate limits its
+ * exchanges with a neighbor if needed.
+ */
+class BpNeighborBeacon
+{
+public:
+  BpNeighborBeacon ();
+  virtual ~BpNeighborBeacon ();
+
+  /**
+   * \param callback called with the address of the neighbor of each beacon received
+   */
+  void SetNeighborCallback (Callback<void, Ipv4Address> callback);
+
+  /**
+   * \brief Open the beacon socket and send the first beacon now
+   *
+   * \param node the node
+   * \param port the udp port of the beacons
+   * \param interval the time between two beacons, no beacon is sent if it is 0,
+   * the beacons of the neighbors are still received
+   *
+   * \return false if the socket cannot be opened
+   */
+  bool Start (Ptr<Node> node, uint16_t port, Time interval);
+
+  /**
+   * \brief Stop sending and receiving the beacons
+   */
+  void Stop ();
+
+  /**
+   * \return the number of beacons sent
+   */
+  uint32_t GetBeaconsSent () const;
+
+private:
+  /**
+   * \brief Broadcast a beacon and schedule the next one
+   */
+  void SendBeacon ();
+
+  /**
+   * \brief Receive the beacons of the neighbors
+   */
+  void ReceiveBeacon (Ptr<Socket> socket);
+
+  Ptr<Socket> m_socket;                  /// the socket of the beacons
+  uint16_t m_port;                       /// the udp port of the beacons
+  Time m_interval;                       /// the time between two beacons
+  EventId m_beaconEvent;                 /// the next beacon
+  std::vector<Ipv4Address> m_local;      /// the addresses of the node, its own beacons are ignored
+  Callback<void, Ipv4Address> m_neighbor;   /// neighbor callback
+  uint32_t m_sent;                       /// number of beacons sent
+};
+
+} // namespace ns3
+
+#endif /* BP_NEIGHBOR_BEACON_H */
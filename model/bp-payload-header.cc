@@ -22,7 +22,7 @@
 #include "bp-payload-header.h"
 #include "sdnv.h"
 #include <stdio.h>
-#include <vector>
+#include <algorithm>
 
 NS_LOG_COMPONENT_DEFINE ("BpPayloadHeader");
 
@@ -30,7 +30,7 @@ namespace ns3 {
 
 BpPayloadHeader::BpPayloadHeader ()
   : m_length (0),
-    m_blockType (1),
+    m_blockType (BP_PAYLOAD_BLOCK_TYPE),
     m_processingControlFlags (0),
     m_payloadLength (0)
 {
@@ -69,7 +69,6 @@ BpPayloadHeader::GetSerializedSize (void) const
   size += sizeof(m_blockType);
   size += sdnv.EncodingLength(m_processingControlFlags);
   size += sdnv.EncodingLength(m_payloadLength);
-  size += m_payloadLength;
 
   return size;
 }
@@ -86,33 +85,15 @@ BpPayloadHeader::Serialize (Buffer::Iterator start) const
   NS_LOG_FUNCTION (this);
   Buffer::Iterator i = start;
   SDNV sdnv;
-  std::vector<uint8_t> result; // store encoded results
 
   // Block Type
   i.WriteU8 (m_blockType);
 
   // Block Processing Control Flags
-  std::vector<uint8_t> processingControlFlags = sdnv.Encode (m_processingControlFlags);
-  for (std::vector<uint8_t>::iterator it = processingControlFlags.begin();
-       it != processingControlFlags.end();
-       ++it) {
-    i.WriteU8(*it);
-  }
+  sdnv.Encode (m_processingControlFlags, i);
 
   // Block length
-  std::vector<uint8_t> payloadLength = sdnv.Encode (m_payloadLength);
-  for (std::vector<uint8_t>::iterator it = payloadLength.begin();
-       it != payloadLength.end();
-       ++it) {
-    i.WriteU8(*it);
-  }
-
-  // Payload
-  for (std::vector<uint8_t>::const_iterator it = m_payload.begin();
-       it != m_payload.end();
-       ++it) {
-    i.WriteU8(*it);
-  }
+  sdnv.Encode (m_payloadLength, i);
 }
 
 uint32_t
@@ -125,18 +106,9 @@ BpPayloadHeader::Deserialize (Buffer::Iterator start)
   m_blockType = i.ReadU8 ();
   m_processingControlFlags = (uint8_t) sdnv.Decode (i);
   m_payloadLength = (uint32_t) sdnv.Decode (i);
-  for (uint32_t k = 0; k < m_payloadLength; k++) {
-    m_payload.push_back(i.ReadU8 ());
-  }
 
-  return GetSerializedSize ();
-}
-
-void
-BpPayloadHeader::SetPayload (std::vector<uint8_t> payload)
-{
-  m_payload = payload;
-  SetBlockLength(m_payload.size());
+  // the block data is left in the packet
+  return i.GetDistanceFrom (start);
 }
 
 
@@ -217,10 +189,21 @@ BpPayloadHeader::SetBlockLength (uint32_t len)
   m_payloadLength = len;
 }
 
-std::vector<uint8_t>
-BpPayloadHeader::GetPayload()
+void
+BpPayloadHeader::SetBlockType (uint8_t type)
 {
-  return m_payload;
+  NS_LOG_FUNCTION (this << " " << (uint16_t) type);
+  m_blockType = type;
+}
+
+Ptr<Packet>
+BpPayloadHeader::GetPayload (Ptr<const Packet> packet) const
+{
+  NS_LOG_FUNCTION (this << " " << packet);
+  uint32_t offset = GetSerializedSize ();
+  uint32_t len = std::min (m_payloadLength, packet->GetSize () - std::min (offset, packet->GetSize ()));
+
+  return packet->CreateFragment (offset, len);
 }
 
 bool
@@ -279,5 +262,12 @@ BpPayloadHeader::GetBlockLength () const
   return m_payloadLength;
 }
 
+uint8_t
+BpPayloadHeader::GetBlockType () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_blockType;
+}
+
 
 } // namespace ns3
@@ -23,6 +23,10 @@
 #include <stdint.h>
 #include "ns3/header.h"
 #include "ns3/buffer.h"
+#include "ns3/packet.h"
+
+// block type of the bundle payload block, section 4.5.2 of RFC 5050
+#define BP_PAYLOAD_BLOCK_TYPE 1
 
 namespace ns3 {
 
@@ -31,6 +35,10 @@ namespace ns3 {
  *
  * The format of bundle payload block header, which is defined in section 4.5 of RFC 5050.
  *
+ * The header only holds the block type, flags and length. The block data is
+ * never copied into the header: it stays in the packet right after the
+ * header, so the payload of a bundle is a (offset, length) reference into
+ * the packet buffer until the application asks for it.
  */
 class BpPayloadHeader : public Header
 {
@@ -54,12 +62,6 @@ public:
 
   // Setters
 
-  /**
-   * [SetPayload  description]
-   * @param payload [description]
-   */
-  void SetPayload (std::vector<uint8_t> payload); 
-
   /**
    * \brief Block must or mustn't be replicated in every fragment
    */
@@ -100,12 +102,25 @@ public:
    */
   void SetBlockLength (uint32_t len);
 
+  /**
+   * \brief set the block type, the header of an extension block has the
+   * same format as the one of the payload block
+   */
+  void SetBlockType (uint8_t type);
+
   // Getters
 
   /**
-   * [GetPayload  description]
+   * \brief Get the block data of a packet starting with this header
+   *
+   * The returned packet is a fragment sharing the buffer of the bundle, the
+   * payload bytes are not copied.
+   *
+   * \param packet the packet whose first bytes were deserialized by this header
+   *
+   * \return the block data
    */
-  std::vector<uint8_t> GetPayload();
+  Ptr<Packet> GetPayload (Ptr<const Packet> packet) const;
 
   /**
    * \return Must block be replicated in every fragment?
@@ -147,6 +162,11 @@ public:
    */
   uint32_t GetBlockLength () const;
 
+  /**
+   * \return the block type, BP_PAYLOAD_BLOCK_TYPE for the payload block
+   */
+  uint8_t GetBlockType () const;
+
   static TypeId GetTypeId (void);
   virtual TypeId GetInstanceTypeId (void) const;
   virtual void Print (std::ostream &os) const;
@@ -158,8 +178,7 @@ private:
   uint16_t m_length;                  /// the length of the header
   uint8_t m_blockType;                /// block type
   uint8_t m_processingControlFlags;   /// block processing control flags
-  uint32_t m_payloadLength;           /// block length
-  std::vector<uint8_t> m_payload;     /// block body data
+  uint32_t m_payloadLength;           /// block length, the block data follows the header in the packet
 };
 
 } // namespace ns3
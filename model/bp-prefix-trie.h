@@ -0,0 +1,311 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+#ifndef BP_PREFIX_TRIE_H
+#define BP_PREFIX_TRIE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief A compressed radix trie keyed by string prefixes
+ *
+ * Each edge of the trie is labeled with a string, and a node without value
+ * has at least two children, so the number of nodes is at most twice the
+ * number of prefixes whatever their length. The children of a node are
+ * sorted by the first byte of their label.
+ *
+ * FindLongestPrefix walks the key once from the root and returns the value
+ * of the longest inserted prefix of the key, so a lookup is O(key length)
+ * and does not depend on the number of prefixes. The empty prefix matches
+ * every key.
+ */
+template <typename T>
+class BpPrefixTrie
+{
+public:
+  BpPrefixTrie ()
+    : m_root (new Node ()),
+      m_size (0),
+      m_nodes (1)
+  {
+  }
+
+  ~BpPrefixTrie ()
+  {
+    Delete (m_root);
+  }
+
+  /**
+   * \brief Add a prefix
+   *
+   * \param prefix the prefix
+   * \param value the value of prefix
+   *
+   * \return false if prefix is already in the trie, the trie is not changed
+   */
+  bool Insert (const std::string &prefix, const T &value)
+  {
+    Node *node = m_root;
+    uint32_t pos = 0;
+    while (pos < prefix.size ())
+      {
+        uint32_t index;
+        if (!FindChild (node, prefix[pos], index))
+          {
+            // a new leaf holds the rest of the prefix
+            Node *leaf = new Node ();
+            leaf->label = prefix.substr (pos);
+            node->children.insert (node->children.begin () + index, leaf);
+            m_nodes++;
+            node = leaf;
+            pos = prefix.size ();
+            break;
+          }
+
+        Node *child = node->children[index];
+        uint32_t common = 0;
+        while (common < child->label.size () && pos + common < prefix.size () &&
+               child->label[common] == prefix[pos + common])
+          common++;
+
+        if (common < child->label.size ())
+          {
+            // split the edge at the end of the common part
+            Node *middle = new Node ();
+            middle->label = child->label.substr (0, common);
+            child->label.erase (0, common);
+            middle->children.push_back (child);
+            node->children[index] = middle;
+            m_nodes++;
+          }
+
+        node = node->children[index];
+        pos += common;
+      }
+
+    if (node->value)
+      return false;
+
+    node->value = new T (value);
+    m_size++;
+    return true;
+  }
+
+  /**
+   * \brief Remove a prefix
+   *
+   * \param prefix the prefix
+   *
+   * \return false if prefix is not in the trie
+   */
+  bool Erase (const std::string &prefix)
+  {
+    // the path from the root to the node of prefix
+    std::vector<Node*> path;
+    std::vector<uint32_t> indexes;
+    Node *node = m_root;
+    uint32_t pos = 0;
+    while (pos < prefix.size ())
+      {
+        uint32_t index;
+        if (!FindChild (node, prefix[pos], index) ||
+            prefix.compare (pos, node->children[index]->label.size (), node->children[index]->label) != 0)
+          return false;
+
+        path.push_back (node);
+        indexes.push_back (index);
+        pos += node->children[index]->label.size ();
+        node = node->children[index];
+      }
+
+    if (node->value == NULL)
+      return false;
+
+    delete node->value;
+    node->value = NULL;
+    m_size--;
+
+    // remove the node if it is a leaf, then merge the node left with a
+    // single child and no value into its child
+    if (node != m_root && node->children.empty ())
+      {
+        Node *parent = path.back ();
+        parent->children.erase (parent->children.begin () + indexes.back ());
+        delete node;
+        m_nodes--;
+        node = parent;
+        path.pop_back ();
+        indexes.pop_back ();
+      }
+
+    if (node != m_root && node->value == NULL && node->children.size () == 1)
+      {
+        Node *child = node->children[0];
+        child->label = node->label + child->label;
+        path.back ()->children[indexes.back ()] = child;
+        node->children.clear ();
+        delete node;
+        m_nodes--;
+      }
+
+    return true;
+  }
+
+  /**
+   * \param key the key
+   * \param length set to the length of the matched prefix, if not NULL
+   *
+   * \return the value of the longest prefix of key in the trie, or NULL
+   */
+  const T* FindLongestPrefix (const std::string &key, uint32_t *length = NULL) const
+  {
+    const Node *node = m_root;
+    const Node *best = m_root->value ? m_root : NULL;
+    uint32_t bestLength = 0;
+    uint32_t pos = 0;
+    while (pos < key.size ())
+      {
+        uint32_t index;
+        if (!FindChild (node, key[pos], index))
+          break;
+
+        const Node *child = node->children[index];
+        if (key.compare (pos, child->label.size (), child->label) != 0)
+          break;
+
+        pos += child->label.size ();
+        node = child;
+        if (node->value)
+          {
+            best = node;
+            bestLength = pos;
+          }
+      }
+
+    if (best == NULL)
+      return NULL;
+
+    if (length)
+      *length = bestLength;
+    return best->value;
+  }
+
+  /**
+   * \return the number of prefixes
+   */
+  uint32_t GetSize () const
+  {
+    return m_size;
+  }
+
+  /**
+   * \return the number of nodes, the root included
+   */
+  uint32_t GetNodes () const
+  {
+    return m_nodes;
+  }
+
+  /**
+   * \return true if there is no prefix
+   */
+  bool IsEmpty () const
+  {
+    return m_size == 0;
+  }
+
+  /**
+   * \brief Remove all prefixes
+   */
+  void Clear ()
+  {
+    Delete (m_root);
+    m_root = new Node ();
+    m_size = 0;
+    m_nodes = 1;
+  }
+
+private:
+  /**
+   * \brief A node of the trie
+   */
+  struct Node
+  {
+    Node ()
+      : value (NULL)
+    {
+    }
+
+    ~Node ()
+    {
+      delete value;
+    }
+
+    std::string label;              /// the bytes of the edge from the parent
+    T *value;                       /// the value of the prefix ending at this node, or NULL
+    std::vector<Node*> children;    /// the children, by the first byte of their label
+  };
+
+  // the nodes are owned by the trie
+  BpPrefixTrie (const BpPrefixTrie &);
+  BpPrefixTrie& operator= (const BpPrefixTrie &);
+
+  /**
+   * \param node a node
+   * \param first the first byte of the label of the child
+   * \param index set to the position of the child, or where to insert it
+   *
+   * \return false if node has no child whose label starts with first
+   */
+  static bool FindChild (const Node *node, char first, uint32_t &index)
+  {
+    uint32_t low = 0;
+    uint32_t high = node->children.size ();
+    while (low < high)
+      {
+        uint32_t middle = (low + high) / 2;
+        if ((uint8_t) node->children[middle]->label[0] < (uint8_t) first)
+          low = middle + 1;
+        else
+          high = middle;
+      }
+
+    index = low;
+    return low < node->children.size () && node->children[low]->label[0] == first;
+  }
+
+  static void Delete (Node *node)
+  {
+    for (uint32_t i = 0; i < node->children.size (); i++)
+      Delete (node->children[i]);
+    delete node;
+  }
+
+  Node *m_root;          /// the root, whose label is empty
+  uint32_t m_size;       /// number of prefixes
+  uint32_t m_nodes;      /// number of nodes
+};
+
+} // namespace ns3
+
+#endif /* BP_PREFIX_TRIE_H */
@@ -20,6 +20,7 @@
 
 #include "bp-routing-protocol.h"
 #include "ns3/log.h"
+#include <sstream>
 
 NS_LOG_COMPONENT_DEFINE ("BpRoutingProtocol");
 
@@ -44,4 +45,76 @@ BpRoutingProtocol::~BpRoutingProtocol ()
   NS_LOG_FUNCTION (this);
 }
 
+bool
+BpRoutingProtocol::GetNextHop (const BpEndpointId &dst, InetSocketAddress &address)
+{ 
+  NS_LOG_FUNCTION (this << " " << dst.Uri ());
+  std::vector<BpNextHop> nextHops;
+  if (!GetNextHops (dst, nextHops) || nextHops.empty ())
+    return false;
+
+  uint32_t best = 0;
+  for (uint32_t i = 1; i < nextHops.size (); i++)
+    {
+      if (nextHops[i].cost < nextHops[best].cost)
+        best = i;
+    }
+
+  address = nextHops[best].address;
+  return true;
+}
+
+bool
+BpRoutingProtocol::GetBundleNextHop (const BpEndpointId &dst, uint32_t size, InetSocketAddress &address)
+{ 
+  NS_LOG_FUNCTION (this << " " << dst.Uri () << " " << size);
+  return GetNextHop (dst, address);
+}
+
+void
+BpRoutingProtocol::SetForwardCallback (Callback<void, Ptr<const Packet>, const InetSocketAddress &> callback)
+{ 
+  NS_LOG_FUNCTION (this);
+  m_forward = callback;
+}
+
+void
+BpRoutingProtocol::NotifyForward (Ptr<const Packet> bundle, const InetSocketAddress &nextHop)
+{ 
+  NS_LOG_FUNCTION (this << " " << bundle << " " << nextHop.GetIpv4 ());
+  if (!m_forward.IsNull ())
+    m_forward (bundle, nextHop);
+}
+
+void
+BpRoutingProtocol::NotifyLinkUp (Ipv4Address peer)
+{ 
+  NS_LOG_FUNCTION (this << " " << peer);
+}
+
+bool
+BpRoutingProtocol::NotifyReceive (Ptr<const Packet> bundle)
+{ 
+  NS_LOG_FUNCTION (this << " " << bundle);
+  return true;
+}
+
+bool
+BpRoutingProtocol::IsRelay () const
+{ 
+  NS_LOG_FUNCTION (this);
+  return false;
+}
+
+std::string
+BpRoutingProtocol::GetBundleId (const BpHeader &bph)
+{
+  std::ostringstream id;
+  id << bph.GetSourceEid ().Uri () << " " << bph.GetCreateTimestamp () << " " << bph.GetSequenceNumber ().GetValue ();
+  if (bph.IsFragment ())
+    id << " " << bph.GetFragOffset ();
+
+  return id.str ();
+}
+
 } // namespace ns3
@@ -21,14 +21,49 @@
 #define BP_ROUTING_PROTOCOL_H
 
 #include "ns3/object.h"
+#include "ns3/packet.h"
+#include "ns3/callback.h"
+#include "ns3/inet-socket-address.h"
+#include "bp-endpoint-id.h"
+#include "bp-header.h"
+#include <vector>
+#include <string>
 
 namespace ns3 {
 
 class BundleProtocol;
 
+/**
+ * \brief a candidate next hop of a destination endpoint id
+ */
+struct BpNextHop
+{
+  BpNextHop ()
+    : address (Ipv4Address::GetAny (), 0),
+      cost (0)
+  {
+  }
+
+  BpNextHop (const InetSocketAddress &nextHop, uint32_t routeCost)
+    : address (nextHop),
+      cost (routeCost)
+  {
+  }
+
+  InetSocketAddress address;   /// the address of the next hop
+  uint32_t cost;               /// the cost of the route through the next hop, the lowest is preferred
+};
+
 /**
  * \brief This is an abstract base class of bundle routing protocol
  *
+ * The convergence layers resolve the next hop of each bundle with
+ * GetBundleNextHop, a single virtual call; a routing protocol only has to
+ * list the candidate next hops of a destination in GetNextHops, and may
+ * override GetNextHop with a faster lookup, and GetBundleNextHop if its
+ * routes depend on the size of the bundle. The convergence layers report
+ * each forwarding decision with NotifyForward, which calls the forward
+ * callback.
  */
 class BpRoutingProtocol : public Object
 {
@@ -51,6 +86,81 @@ public:
    * \param bundleProtocol bundle protocol
    */
   virtual void SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol) = 0;
+
+  /**
+   * \brief Find the candidate next hops of a destination endpoint id
+   *
+   * \param dst the destination endpoint id
+   * \param nextHops set to the candidate next hops, by increasing cost
+   *
+   * \return false if there is no route for dst
+   */
+  virtual bool GetNextHops (const BpEndpointId &dst, std::vector<BpNextHop> &nextHops) = 0;
+
+  /**
+   * \brief Find the next hop of a destination endpoint id
+   *
+   * \param dst the destination endpoint id
+   * \param address set to the address of the candidate next hop with the lowest cost
+   *
+   * \return false if there is no route for dst
+   */
+  virtual bool GetNextHop (const BpEndpointId &dst, InetSocketAddress &address);
+
+  /**
+   * \brief Find the next hop of a bundle, by default the next hop of its destination
+   *
+   * \param dst the destination endpoint id
+   * \param size the size of the bundle, 0 if the next hop is not looked up for a bundle
+   * \param address set to the address of the next hop
+   *
+   * \return false if there is no route for dst
+   */
+  virtual bool GetBundleNextHop (const BpEndpointId &dst, uint32_t size, InetSocketAddress &address);
+
+  /**
+   * \param callback called with each bundle and the next hop the convergence layer sends it to
+   */
+  void SetForwardCallback (Callback<void, Ptr<const Packet>, const InetSocketAddress &> callback);
+
+  /**
+   * \brief Report a forwarding decision of the convergence layer
+   *
+   * \param bundle the bundle
+   * \param nextHop the address of the next hop the bundle is sent to
+   */
+  virtual void NotifyForward (Ptr<const Packet> bundle, const InetSocketAddress &nextHop);
+
+  /**
+   * \brief Report a link with a peer which comes up, e.g. a connection of the
+   * convergence layer which is established or accepted; ignored by default
+   *
+   * \param peer the address of the peer
+   */
+  virtual void NotifyLinkUp (Ipv4Address peer);
+
+  /**
+   * \brief Report a bundle received from the convergence layer
+   *
+   * \return false to drop the bundle as a duplicate, true by default
+   */
+  virtual bool NotifyReceive (Ptr<const Packet> bundle);
+
+  /**
+   * \return true if the bundles received for the endpoint ids of the other
+   * nodes are kept in the send storage, where the routing protocol forwards
+   * them from; false by default, they are dropped
+   */
+  virtual bool IsRelay () const;
+
+  /**
+   * \return the id of a bundle: its source endpoint id, creation timestamp,
+   * sequence number and fragment offset
+   */
+  static std::string GetBundleId (const BpHeader &bph);
+
+private:
+  Callback<void, Ptr<const Packet>, const InetSocketAddress &> m_forward;   /// forwarding decision callback
 };
 
 
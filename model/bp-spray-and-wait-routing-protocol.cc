@@ -0,0 +1,336 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#include "bp-spray-and-wait-routing-protocol.h"
+#include "bp-copy-count-header.h"
+#include "bp-payload-header.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/inet-socket-address.h"
+
+NS_LOG_COMPONENT_DEFINE ("BpSprayAndWaitRoutingProtocol");
+
+namespace ns3 {
+
+TypeId
+BpSprayAndWaitRoutingProtocol::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpSprayAndWaitRoutingProtocol")
+    .SetParent<BpRoutingProtocol> ()
+    .AddConstructor<BpSprayAndWaitRoutingProtocol> ()
+    .AddAttribute ("Copies", "Number of copies of a bundle created by this node",
+           UintegerValue (8),
+           MakeUintegerAccessor (&BpSprayAndWaitRoutingProtocol::m_initialCopies),
+           MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("Port", "Port of the convergence layer of the peers, 0 for the default port of the convergence layer in use",
+           UintegerValue (0),
+           MakeUintegerAccessor (&BpSprayAndWaitRoutingProtocol::m_port),
+           MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("BeaconPort", "Udp port of the beacons of the peers",
+           UintegerValue (4558),
+           MakeUintegerAccessor (&BpSprayAndWaitRoutingProtocol::m_beaconPort),
+           MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("BeaconInterval", "Time between two beacons, 0 to send none",
+           TimeValue (Seconds (1)),
+           MakeTimeAccessor (&BpSprayAndWaitRoutingProtocol::m_beaconInterval),
+           MakeTimeChecker ())
+  ;
+  return tid;
+}
+
+BpSprayAndWaitRoutingProtocol::BpSprayAndWaitRoutingProtocol ()
+  : m_beaconPort (4558),
+    m_beaconInterval (Seconds (1)),
+    m_initialCopies (8),
+    m_port (0),
+    m_forwarded (0),
+    m_bp (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpSprayAndWaitRoutingProtocol::~BpSprayAndWaitRoutingProtocol ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BpSprayAndWaitRoutingProtocol::SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol)
+{
+  NS_LOG_FUNCTION (this << " " << bundleProtocol);
+  m_bp = bundleProtocol;
+
+  // a beacon received is a link with its peer coming up
+  if (m_bp && m_bp->GetNode ())
+    {
+      m_beacon.SetNeighborCallback (MakeCallback (&BpSprayAndWaitRoutingProtocol::NotifyLinkUp, this));
+      m_beacon.Start (m_bp->GetNode (), m_beaconPort, m_beaconInterval);
+    }
+}
+
+void
+BpSprayAndWaitRoutingProtocol::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_beacon.Stop ();
+  m_bp = 0;
+  BpRoutingProtocol::DoDispose ();
+}
+
+uint32_t
+BpSprayAndWaitRoutingProtocol::GetBeaconsSent () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_beacon.GetBeaconsSent ();
+}
+
+int
+BpSprayAndWaitRoutingProtocol::AddEndpoint (BpEndpointId eid, Ipv4Address node)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri () << " " << node);
+  if (!m_nodes.Insert (eid, node))
+    return -1;
+
+  return 0;
+}
+
+bool
+BpSprayAndWaitRoutingProtocol::GetNextHops (const BpEndpointId &dst, std::vector<BpNextHop> &nextHops)
+{
+  NS_LOG_FUNCTION (this << " " << dst.Uri ());
+  nextHops.clear ();
+  return false;
+}
+
+bool
+BpSprayAndWaitRoutingProtocol::GetCopyCount (Ptr<const Packet> bundle, uint32_t &copies)
+{
+  Ptr<Packet> packet = bundle->Copy ();
+  BpHeader bph;
+  BpPayloadHeader block;
+  packet->RemoveHeader (bph);
+  packet->PeekHeader (block);
+  if (block.GetBlockType () != BP_COPY_COUNT_BLOCK_TYPE)
+    return false;
+
+  BpCopyCountHeader cch;
+  packet->PeekHeader (cch);
+  copies = cch.GetCopies ();
+  return true;
+}
+
+Ptr<Packet>
+BpSprayAndWaitRoutingProtocol::SetCopyCount (Ptr<const Packet> bundle, uint32_t copies)
+{
+  Ptr<Packet> packet = bundle->Copy ();
+  BpHeader bph;
+  BpPayloadHeader block;
+  packet->RemoveHeader (bph);
+  packet->PeekHeader (block);
+
+  BpCopyCountHeader cch;
+  if (block.GetBlockType () == BP_COPY_COUNT_BLOCK_TYPE)
+    packet->RemoveHeader (cch);
+
+  cch.SetCopies (copies);
+  packet->AddHeader (cch);
+  packet->AddHeader (bph);
+  return packet;
+}
+
+bool
+BpSprayAndWaitRoutingProtocol::NotifyReceive (Ptr<const Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << bundle);
+  BpHeader bph;
+  bundle->PeekHeader (bph);
+
+  uint32_t copies = 1;
+  GetCopyCount (bundle, copies);
+
+  std::string id = GetBundleId (bph);
+  std::map<std::string, Copies>::iterator it = m_bundles.find (id);
+  if (it != m_bundles.end ())
+    {
+      // the copies are not lost when a peer already has the bundle
+      if (it->second.copies > 0)
+        it->second.copies += copies;
+      return false;
+    }
+
+  Copies entry;
+  entry.copies = copies;
+  // creation timestamps are counted from the start of the simulation
+  entry.end = Time::Max ();
+  if (bph.GetLifeTime () > 0)
+    entry.end = Seconds (bph.GetCreateTimestamp () + bph.GetLifeTime ());
+
+  m_bundles.insert (std::make_pair (id, entry));
+  return true;
+}
+
+bool
+BpSprayAndWaitRoutingProtocol::IsRelay () const
+{
+  NS_LOG_FUNCTION (this);
+  return true;
+}
+
+BpSprayAndWaitRoutingProtocol::Copies&
+BpSprayAndWaitRoutingProtocol::GetEntry (const BpHeader &bph)
+{
+  NS_LOG_FUNCTION (this);
+  std::string id = GetBundleId (bph);
+  std::map<std::string, Copies>::iterator it = m_bundles.find (id);
+  if (it != m_bundles.end ())
+    return it->second;
+
+  // a bundle created by this node
+  Copies entry;
+  entry.copies = m_initialCopies;
+  entry.end = Time::Max ();
+  if (bph.GetLifeTime () > 0)
+    entry.end = Seconds (bph.GetCreateTimestamp () + bph.GetLifeTime ());
+
+  return m_bundles.insert (std::make_pair (id, entry)).first->second;
+}
+
+void
+BpSprayAndWaitRoutingProtocol::PruneBundles ()
+{
+  NS_LOG_FUNCTION (this);
+  Time now = Simulator::Now ();
+  std::map<std::string, Copies>::iterator it = m_bundles.begin ();
+  while (it != m_bundles.end ())
+    {
+      if (it->second.end <= now)
+        m_bundles.erase (it++);
+      else
+        ++it;
+    }
+}
+
+uint32_t
+BpSprayAndWaitRoutingProtocol::TakeCopies (const BpHeader &bph, Ipv4Address peer)
+{
+  NS_LOG_FUNCTION (this << " " << peer);
+  Copies &entry = GetEntry (bph);
+  if (entry.copies == 0)
+    return 0;
+
+  // direct delivery, this node stops forwarding the bundle
+  const Ipv4Address *node = m_nodes.Find (bph.GetDestinationEid ());
+  if (node != NULL && *node == peer)
+    {
+      uint32_t copies = entry.copies;
+      entry.copies = 0;
+      return copies;
+    }
+
+  // the source node has the bundle, the copies are not handed back to it
+  const Ipv4Address *source = m_nodes.Find (bph.GetSourceEid ());
+  if (source != NULL && *source == peer)
+    return 0;
+
+  // wait phase, or a peer which already has half of the copies
+  if (entry.copies == 1 || !entry.peers.insert (peer).second)
+    return 0;
+
+  uint32_t copies = entry.copies / 2;
+  entry.copies -= copies;
+  return copies;
+}
+
+uint32_t
+BpSprayAndWaitRoutingProtocol::SendBundles (Ipv4Address peer)
+{
+  NS_LOG_FUNCTION (this << " " << peer);
+  if (!m_bp)
+    return 0;
+
+  // the peers listen on the default port of their convergence layer, e.g.,
+  // the LTP port, unless the port is set
+  uint16_t port = m_port;
+  if (port == 0 && m_bp->GetCla ())
+    port = m_bp->GetCla ()->GetDefaultPort ();
+
+  PruneBundles ();
+  std::vector<Ptr<Packet> > bundles;
+  m_bp->GetStoredBundles (bundles);
+
+  uint32_t sent = 0;
+  for (uint32_t i = 0; i < bundles.size (); i++)
+    {
+      BpHeader bph;
+      bundles[i]->PeekHeader (bph);
+      uint32_t copies = TakeCopies (bph, peer);
+      if (copies > 0)
+        {
+          if (m_bp->ForwardBundle (SetCopyCount (bundles[i], copies), InetSocketAddress (peer, port)) < 0)
+            {
+              // the copies are handed to a later peer
+              Copies &entry = GetEntry (bph);
+              entry.copies += copies;
+              entry.peers.erase (peer);
+              NS_LOG_WARN ("BpSprayAndWaitRoutingProtocol::SendBundles (): the convergence layer cannot forward bundles to " << peer);
+              break;
+            }
+
+          sent++;
+        }
+
+      // a bundle delivered to its destination node is never sent again, it
+      // leaves the storage even if it never expires
+      if (GetEntry (bph).copies == 0)
+        m_bp->RemoveBundle (bundles[i]);
+    }
+
+  m_forwarded += sent;
+  NS_LOG_DEBUG ("BpSprayAndWaitRoutingProtocol::SendBundles (): " << sent << " of " << bundles.size () << " bundles sent to " << peer);
+  return sent;
+}
+
+void
+BpSprayAndWaitRoutingProtocol::NotifyLinkUp (Ipv4Address peer)
+{
+  NS_LOG_FUNCTION (this << " " << peer);
+  SendBundles (peer);
+}
+
+uint32_t
+BpSprayAndWaitRoutingProtocol::GetCopies (const BpHeader &bph) const
+{
+  NS_LOG_FUNCTION (this);
+  std::map<std::string, Copies>::const_iterator it = m_bundles.find (GetBundleId (bph));
+  if (it == m_bundles.end ())
+    return m_initialCopies;
+
+  return it->second.copies;
+}
+
+uint32_t
+BpSprayAndWaitRoutingProtocol::GetBundlesForwarded () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_forwarded;
+}
+
+} // namespace ns3
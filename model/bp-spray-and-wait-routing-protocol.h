@@ -0,0 +1,199 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+#ifndef BP_SPRAY_AND_WAIT_ROUTING_PROTOCOL_H
+#define BP_SPRAY_AND_WAIT_ROUTING_PROTOCOL_H
+
+#include "bp-routing-protocol.h"
+#include "bundle-protocol.h"
+#include "bp-endpoint-map.h"
+#include "bp-neighbor-beacon.h"
+#include "bp-header.h"
+#include "ns3/nstime.h"
+#include "ns3/ipv4-address.h"
+#include <map>
+#include <set>
+#include <string>
+
+namespace ns3 {
+
+/**
+ * \brief The binary spray and wait bundle routing protocol
+ *
+ * The source of a bundle is in charge of Copies copies of it. In the spray
+ * phase, a node with more than one copy hands half of its copies to each
+ * new peer it meets, with a copy of the bundle; the number of copies the
+ * peer is in charge of is carried in a copy count extension block. In the
+ * wait phase, a node with a single copy only forwards the bundle to its
+ * destination node. At most Copies copies of a bundle are spread in the
+ * network, whatever the number of nodes met, instead of a copy per node
+ * for the epidemic routing protocol.
+ *
+ * The peers are met through their beacons (see BpNeighborBeacon), whatever
+ * the convergence layer; the TCP convergence layer also reports its
+ * connections coming up. The endpoint ids are mapped to their node with
+ * AddEndpoint: a bundle is delivered directly to the node of its
+ * destination, and its copies are never handed back to the node of its
+ * source. A node does not forward a bundle any more once it was delivered
+ * to its destination node; the bundle stays stored until its lifetime is
+ * over or it is evicted by the storage quotas.
+ */
+class BpSprayAndWaitRoutingProtocol : public BpRoutingProtocol
+{
+public:
+  static TypeId GetTypeId (void);
+
+  /**
+   * Constructor
+   */
+  BpSprayAndWaitRoutingProtocol ();
+
+  /**
+   * Destroy
+   */
+  virtual ~BpSprayAndWaitRoutingProtocol ();
+
+  /**
+   * \brief Set bundle protocol
+   *
+   * \param bundleProtocol bundle protocol
+   */
+  virtual void SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol);
+
+  /**
+   * \return the number of beacons sent
+   */
+  uint32_t GetBeaconsSent () const;
+
+  /**
+   * \brief Map an endpoint id to the address of its node
+   *
+   * \param eid the endpoint id
+   * \param node the address of the node of the endpoint id
+   *
+   * \return -1 if the endpoint id is already mapped
+   */
+  int AddEndpoint (BpEndpointId eid, Ipv4Address node);
+
+  /**
+   * \brief There is no candidate next hop, the bundles are handed to the peers met
+   */
+  virtual bool GetNextHops (const BpEndpointId &dst, std::vector<BpNextHop> &nextHops);
+
+  /**
+   * \brief Hand the stored bundles to the peer
+   */
+  virtual void NotifyLinkUp (Ipv4Address peer);
+
+  /**
+   * \brief Take charge of the copies of the copy count block of a bundle,
+   * one if it has none; the copies of a duplicate are added to the ones of
+   * the bundle already received
+   */
+  virtual bool NotifyReceive (Ptr<const Packet> bundle);
+
+  /**
+   * \brief The bundles of the other nodes are kept and handed to the peers
+   */
+  virtual bool IsRelay () const;
+
+  /**
+   * \brief Send a copy of the stored bundles to a peer, with the number
+   * of copies it takes charge of; the bundles this node is in charge of no
+   * copy of are removed from the storage
+   *
+   * \return the number of bundles sent
+   */
+  uint32_t SendBundles (Ipv4Address peer);
+
+  /**
+   * \brief Take the copies of a bundle a peer is in charge of: half of the
+   * copies of this node if the peer is met for the first time in the spray
+   * phase, all of them if the peer is the destination node of the bundle,
+   * none otherwise, e.g. for the source node of the bundle
+   *
+   * \param bph the primary bundle header of the bundle
+   * \param peer the address of the peer
+   *
+   * \return the number of copies, 0 if the bundle is not sent to the peer
+   */
+  uint32_t TakeCopies (const BpHeader &bph, Ipv4Address peer);
+
+  /**
+   * \return the number of copies of a bundle this node is in charge of,
+   * Copies for a bundle created by this node and not handed yet
+   */
+  uint32_t GetCopies (const BpHeader &bph) const;
+
+  /**
+   * \return the number of bundle copies sent to the peers
+   */
+  uint32_t GetBundlesForwarded () const;
+
+  /**
+   * \brief Get the number of copies of the copy count block of a bundle
+   *
+   * \return false if the bundle has no copy count block
+   */
+  static bool GetCopyCount (Ptr<const Packet> bundle, uint32_t &copies);
+
+  /**
+   * \return a copy of a bundle whose copy count block carries a number of copies
+   */
+  static Ptr<Packet> SetCopyCount (Ptr<const Packet> bundle, uint32_t copies);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * \brief the copies of a bundle this node is in charge of
+   */
+  struct Copies
+  {
+    uint32_t copies;                 /// number of copies, 0 once the bundle is delivered
+    Time end;                        /// end of the lifetime of the bundle
+    std::set<Ipv4Address> peers;     /// the peers the bundle was handed to
+  };
+
+  /**
+   * \return the copies of a bundle, Copies for a bundle not received
+   */
+  Copies& GetEntry (const BpHeader &bph);
+
+  /**
+   * \brief Forget the bundles whose lifetime is over
+   */
+  void PruneBundles ();
+
+  std::map<std::string, Copies> m_bundles;   /// the copies of each bundle id
+  BpEndpointMap<Ipv4Address> m_nodes;        /// the node of each endpoint id
+  BpNeighborBeacon m_beacon;                 /// the beacons of the peers met
+  uint16_t m_beaconPort;                     /// the udp port of the beacons
+  Time m_beaconInterval;                     /// time between two beacons
+  uint32_t m_initialCopies;                  /// number of copies of a bundle created by this node
+  uint16_t m_port;                           /// the port of the convergence layer of the peers, 0 for its default port
+  uint32_t m_forwarded;                      /// number of bundle copies sent
+  Ptr<BundleProtocol> m_bp;                  /// bundle protocol
+};
+
+
+}  // namespace ns3
+
+#endif /* BP_SPRAY_AND_WAIT_ROUTING_PROTOCOL_H */
@@ -57,13 +57,26 @@ int
 BpStaticRoutingProtocol::AddRoute (BpEndpointId eid, InetSocketAddress address)
 { 
   NS_LOG_FUNCTION (this << " " << eid.Uri () << " " << address.GetIpv4 () << " " << address.GetPort ());
-  std::map <BpEndpointId, InetSocketAddress>::iterator it = m_routeMap.end ();
-  it = m_routeMap.find (eid);
-  if (it == m_routeMap.end ())
+  if (!m_routeMap.Insert (eid, address))
     {
-      m_routeMap.insert (std::pair<BpEndpointId, InetSocketAddress>(eid, address));
+      // duplicate routing
+      return -1;
     }
-  else
+
+  return 0;
+}
+
+int
+BpStaticRoutingProtocol::AddPrefixRoute (const std::string &pattern, InetSocketAddress address)
+{ 
+  NS_LOG_FUNCTION (this << " " << pattern << " " << address.GetIpv4 () << " " << address.GetPort ());
+  if (pattern.empty () || pattern[pattern.size () - 1] != '*')
+    {
+      NS_LOG_WARN ("BpStaticRoutingProtocol::AddPrefixRoute (): the pattern " << pattern << " does not end with '*'");
+      return -1;
+    }
+
+  if (!m_prefixRoutes.Insert (pattern.substr (0, pattern.size () - 1), address))
     {
       // duplicate routing
       return -1;
@@ -72,21 +85,86 @@ BpStaticRoutingProtocol::AddRoute (BpEndpointId eid, InetSocketAddress address)
   return 0;
 }
 
+int
+BpStaticRoutingProtocol::SetDefaultRoute (InetSocketAddress address)
+{ 
+  NS_LOG_FUNCTION (this << " " << address.GetIpv4 () << " " << address.GetPort ());
+  return AddPrefixRoute ("*", address);
+}
+
+int
+BpStaticRoutingProtocol::RemovePrefixRoute (const std::string &pattern)
+{ 
+  NS_LOG_FUNCTION (this << " " << pattern);
+  if (pattern.empty () || pattern[pattern.size () - 1] != '*' ||
+      !m_prefixRoutes.Erase (pattern.substr (0, pattern.size () - 1)))
+    return -1;
+
+  return 0;
+}
+
+const InetSocketAddress*
+BpStaticRoutingProtocol::Lookup (const BpEndpointId &eid) const
+{ 
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  const InetSocketAddress *address = m_routeMap.Find (eid);
+  if (address == NULL && !m_prefixRoutes.IsEmpty ())
+    address = m_prefixRoutes.FindLongestPrefix (eid.Uri ());
+
+  return address;
+}
+
 InetSocketAddress 
 BpStaticRoutingProtocol::GetRoute (BpEndpointId eid)
 { 
   NS_LOG_FUNCTION (this << " " << eid.Uri ());
-  std::map <BpEndpointId, InetSocketAddress>::iterator it = m_routeMap.end ();
-  it = m_routeMap.find (eid);
-  if (it == m_routeMap.end ())
+  const InetSocketAddress *address = Lookup (eid);
+  if (address == NULL)
     {
-      InetSocketAddress address("127.0.0.1", 0);
-      return address;
+      InetSocketAddress defaultAddress ("127.0.0.1", 0);
+      return defaultAddress;
     }
   else
     {
-      return (*it).second;
+      return *address;
     }
 }
 
+bool
+BpStaticRoutingProtocol::GetNextHops (const BpEndpointId &dst, std::vector<BpNextHop> &nextHops)
+{ 
+  NS_LOG_FUNCTION (this << " " << dst.Uri ());
+  nextHops.clear ();
+  const InetSocketAddress *address = Lookup (dst);
+  if (address == NULL)
+    return false;
+
+  nextHops.push_back (BpNextHop (*address, 0));
+  return true;
+}
+
+bool
+BpStaticRoutingProtocol::GetNextHop (const BpEndpointId &dst, InetSocketAddress &address)
+{ 
+  NS_LOG_FUNCTION (this << " " << dst.Uri ());
+  const InetSocketAddress *route = Lookup (dst);
+  if (route == NULL)
+    return false;
+
+  address = *route;
+  return true;
+}
+
+bool
+BpStaticRoutingProtocol::GetBundleNextHop (const BpEndpointId &dst, uint32_t size, InetSocketAddress &address)
+{ 
+  NS_LOG_FUNCTION (this << " " << dst.Uri () << " " << size);
+  const InetSocketAddress *route = Lookup (dst);
+  if (route == NULL)
+    return false;
+
+  address = *route;
+  return true;
+}
+
 } // namespace ns3
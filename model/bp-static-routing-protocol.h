@@ -22,13 +22,22 @@
 
 #include "bp-routing-protocol.h"
 #include "bundle-protocol.h"
+#include "bp-endpoint-map.h"
+#include "bp-prefix-trie.h"
 #include "ns3/inet-socket-address.h"
 
 namespace ns3 {
 
 /**
- * \brief This is an abstract base class of bundle routing protocol
+ * \brief The static bundle routing protocol
  *
+ * A route is either an exact endpoint id, or an endpoint id pattern ending
+ * with '*' (e.g. "ipn:42.*") which matches all the uris starting with the
+ * part before the '*'. The default route is the
+ * pattern "*". An exact route is preferred, then the longest matching
+ * pattern. The patterns are kept in a compressed radix trie, so a lookup is
+ * O(uri length) and the routing table grows with the number of patterns,
+ * not with the number of endpoints they cover.
  */
 class BpStaticRoutingProtocol : public BpRoutingProtocol
 {
@@ -57,14 +66,60 @@ public:
    */
   virtual int AddRoute (BpEndpointId eid, InetSocketAddress address);
 
+  /**
+   * \brief Add a route for all the endpoint ids matching a pattern
+   *
+   * \param pattern an endpoint id uri prefix followed by '*'
+   * \param address the address of the next hop
+   *
+   * \return -1 if the pattern does not end with '*' or is already routed, 0 otherwise
+   */
+  virtual int AddPrefixRoute (const std::string &pattern, InetSocketAddress address);
+
+  /**
+   * \brief Add the route of the endpoint ids without any other route, same as the pattern "*"
+   *
+   * \return -1 if there is already a default route, 0 otherwise
+   */
+  virtual int SetDefaultRoute (InetSocketAddress address);
+
+  /**
+   * \brief Remove the route of a pattern
+   *
+   * \return -1 if the pattern is not routed, 0 otherwise
+   */
+  virtual int RemovePrefixRoute (const std::string &pattern);
+
   /**
    *  \return the internet socket address of matched eid; If there is no 
    *  match route, return the 127.0.0.1 with port 0
    */
   virtual InetSocketAddress GetRoute (BpEndpointId eid);
 
+  /**
+   * \brief The static route of dst is its only candidate next hop, with cost 0
+   */
+  virtual bool GetNextHops (const BpEndpointId &dst, std::vector<BpNextHop> &nextHops);
+
+  /**
+   * \brief Look up the static route of dst, without building the list of candidates
+   */
+  virtual bool GetNextHop (const BpEndpointId &dst, InetSocketAddress &address);
+
+  /**
+   * \brief The static route of dst, whatever the size of the bundle
+   */
+  virtual bool GetBundleNextHop (const BpEndpointId &dst, uint32_t size, InetSocketAddress &address);
+
 private:
-  std::map <BpEndpointId, InetSocketAddress> m_routeMap; /// routing table
+  /**
+   * \return the route of eid: the exact route, or the route of the longest
+   * matching pattern, or NULL
+   */
+  const InetSocketAddress* Lookup (const BpEndpointId &eid) const;
+
+  BpEndpointMap<InetSocketAddress> m_routeMap;          /// routing table
+  BpPrefixTrie<InetSocketAddress> m_prefixRoutes;       /// routes of the patterns, by uri prefix
   Ptr<BundleProtocol> m_bp;                              /// bundle protocol
 };
 
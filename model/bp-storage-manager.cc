@@ -0,0 +1,296 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#include "ns3/log.h"
+#include "bp-storage-manager.h"
+#include <vector>
+#include <limits>
+
+NS_LOG_COMPONENT_DEFINE ("BpStorageManager");
+
+namespace ns3 {
+
+BpStorageManager::BpStorageManager ()
+  : m_policy (DROP_OLDEST),
+    m_maxBytes (0),
+    m_maxBundles (0),
+    m_eidMaxBytes (0),
+    m_eidMaxBundles (0),
+    m_serial (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpStorageManager::~BpStorageManager ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BpStorageManager::SetEvictCallback (Callback<void, Ptr<BpStoredBundle> > callback)
+{
+  NS_LOG_FUNCTION (this);
+  m_evict = callback;
+}
+
+BpStorageManager::Key
+BpStorageManager::GetKey (Ptr<BpStoredBundle> record) const
+{
+  Key key;
+  key.serial = record->serial;
+  switch (m_policy)
+    {
+    case DROP_LOWEST_PRIORITY:
+      key.rank = record->priority;
+      break;
+    case DROP_SOONEST_EXPIRING:
+      // the bundles which never expire are evicted last
+      if (record->expiration.IsZero ())
+        key.rank = std::numeric_limits<int64_t>::max ();
+      else
+        key.rank = record->expiration.GetTimeStep ();
+      break;
+    default:
+      key.rank = 0;
+      break;
+    }
+
+  return key;
+}
+
+bool
+BpStorageManager::Fits (const Usage &usage, uint64_t maxBytes, uint32_t maxBundles) const
+{
+  return (maxBytes == 0 || usage.bytes <= maxBytes) && (maxBundles == 0 || usage.bundles <= maxBundles);
+}
+
+void
+BpStorageManager::Insert (Ptr<BpStoredBundle> record)
+{
+  Key key = GetKey (record);
+  Usage &eid = m_eids[record->eid];
+  eid.bytes += record->size;
+  eid.bundles++;
+  eid.index.insert (std::make_pair (key, record));
+
+  m_node.bytes += record->size;
+  m_node.bundles++;
+  m_node.index.insert (std::make_pair (key, record));
+}
+
+void
+BpStorageManager::Remove (Ptr<BpStoredBundle> record)
+{
+  Key key = GetKey (record);
+  Usage *eid = m_eids.Find (record->eid);
+  if (eid == NULL || m_node.index.erase (key) == 0)
+    return;
+
+  eid->index.erase (key);
+  eid->bytes -= record->size;
+  eid->bundles--;
+  // forget the endpoint ids without stored bundles, so that the table does
+  // not grow with every endpoint id ever seen
+  if (eid->bundles == 0)
+    m_eids.Erase (record->eid);
+
+  m_node.bytes -= record->size;
+  m_node.bundles--;
+}
+
+bool
+BpStorageManager::Evict (Usage &usage, uint64_t maxBytes, uint32_t maxBundles, Ptr<BpStoredBundle> record)
+{
+  while (!Fits (usage, maxBytes, maxBundles))
+    {
+      Ptr<BpStoredBundle> victim = usage.index.begin ()->second;
+      Remove (victim);
+      if (victim == record)
+        return false;
+
+      NS_LOG_DEBUG ("Evict bundle:" << " eid " << victim->eid.Uri () << " size " << victim->size);
+      if (!m_evict.IsNull ())
+        m_evict (victim);
+    }
+
+  return true;
+}
+
+bool
+BpStorageManager::Admit (Ptr<BpStoredBundle> record)
+{
+  NS_LOG_FUNCTION (this << " " << record->eid.Uri () << " " << record->size);
+  // a bundle larger than a quota never fits, keep the stored bundles
+  if ((m_maxBytes > 0 && record->size > m_maxBytes) ||
+      (m_eidMaxBytes > 0 && record->size > m_eidMaxBytes))
+    return false;
+
+  record->serial = m_serial++;
+  Insert (record);
+
+  // the endpoint id quotas first, so that the bundles of the other endpoint ids
+  // are only evicted for the node quotas
+  if (!Evict (m_eids[record->eid], m_eidMaxBytes, m_eidMaxBundles, record))
+    return false;
+
+  return Evict (m_node, m_maxBytes, m_maxBundles, record);
+}
+
+void
+BpStorageManager::Release (Ptr<BpStoredBundle> record)
+{
+  NS_LOG_FUNCTION (this << " " << record->eid.Uri () << " " << record->size);
+  Remove (record);
+}
+
+void
+BpStorageManager::SetPolicy (EvictionPolicy policy)
+{
+  NS_LOG_FUNCTION (this << " " << policy);
+  if (policy == m_policy)
+    return;
+
+  // the keys depend on the policy, rebuild the indexes
+  std::vector<Ptr<BpStoredBundle> > records;
+  for (Index::iterator it = m_node.index.begin (); it != m_node.index.end (); ++it)
+    records.push_back (it->second);
+
+  m_node = Usage ();
+  m_eids.Clear ();
+  m_policy = policy;
+  for (uint32_t i = 0; i < records.size (); i++)
+    Insert (records[i]);
+}
+
+BpStorageManager::EvictionPolicy
+BpStorageManager::GetPolicy () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_policy;
+}
+
+void
+BpStorageManager::SetMaxBytes (uint64_t bytes)
+{
+  NS_LOG_FUNCTION (this << " " << bytes);
+  m_maxBytes = bytes;
+}
+
+uint64_t
+BpStorageManager::GetMaxBytes () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_maxBytes;
+}
+
+void
+BpStorageManager::SetMaxBundles (uint32_t bundles)
+{
+  NS_LOG_FUNCTION (this << " " << bundles);
+  m_maxBundles = bundles;
+}
+
+uint32_t
+BpStorageManager::GetMaxBundles () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_maxBundles;
+}
+
+void
+BpStorageManager::SetEidMaxBytes (uint64_t bytes)
+{
+  NS_LOG_FUNCTION (this << " " << bytes);
+  m_eidMaxBytes = bytes;
+}
+
+uint64_t
+BpStorageManager::GetEidMaxBytes () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_eidMaxBytes;
+}
+
+void
+BpStorageManager::SetEidMaxBundles (uint32_t bundles)
+{
+  NS_LOG_FUNCTION (this << " " << bundles);
+  m_eidMaxBundles = bundles;
+}
+
+uint32_t
+BpStorageManager::GetEidMaxBundles () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_eidMaxBundles;
+}
+
+uint64_t
+BpStorageManager::GetBytes () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_node.bytes;
+}
+
+uint32_t
+BpStorageManager::GetBundles () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_node.bundles;
+}
+
+uint64_t
+BpStorageManager::GetBytes (const BpEndpointId &eid) const
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  const Usage *usage = m_eids.Find (eid);
+  if (usage == NULL)
+    return 0;
+
+  return usage->bytes;
+}
+
+uint32_t
+BpStorageManager::GetBundles (const BpEndpointId &eid) const
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  const Usage *usage = m_eids.Find (eid);
+  if (usage == NULL)
+    return 0;
+
+  return usage->bundles;
+}
+
+uint32_t
+BpStorageManager::GetEids () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_eids.GetSize ();
+}
+
+void
+BpStorageManager::Clear ()
+{
+  NS_LOG_FUNCTION (this);
+  m_node = Usage ();
+  m_eids.Clear ();
+}
+
+} // namespace ns3
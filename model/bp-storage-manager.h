@@ -0,0 +1,241 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+#ifndef BP_STORAGE_MANAGER_H
+#define BP_STORAGE_MANAGER_H
+
+#include <stdint.h>
+#include <map>
+#include "ns3/ptr.h"
+#include "ns3/callback.h"
+#include "bp-endpoint-id.h"
+#include "bp-endpoint-map.h"
+#include "bp-stored-bundle.h"
+
+namespace ns3 {
+
+/**
+ * \brief The quotas of the persistant bundle storages
+ *
+ * The manager accounts the bundles held by the sent and received bundle
+ * storages of a node, in bytes and in number of bundles, for the whole node
+ * and for each endpoint id (the source endpoint id of a sent bundle and the
+ * destination endpoint id of a received bundle). A quota of 0 is unlimited.
+ *
+ * When a new bundle would exceed a quota, the stored bundles are evicted in
+ * the order of the eviction policy until the bundle fits. If the new bundle
+ * itself comes first in that order, it is rejected instead. The bundles are
+ * kept in ordered indexes, one for the node and one per endpoint id, so an
+ * eviction is O(log n).
+ */
+class BpStorageManager
+{
+public:
+  /**
+   * the order in which the stored bundles are evicted
+   */
+  typedef enum {
+    DROP_OLDEST = 0,             /// the bundle stored first
+    DROP_LOWEST_PRIORITY,        /// the bundle of the lowest class of service, the oldest first
+    DROP_SOONEST_EXPIRING        /// the bundle whose lifetime is over first, the oldest first
+  } EvictionPolicy;
+
+  BpStorageManager ();
+  virtual ~BpStorageManager ();
+
+  /**
+   * \param callback the function called with each evicted bundle, which
+   * must be removed from its storage by the callee
+   */
+  void SetEvictCallback (Callback<void, Ptr<BpStoredBundle> > callback);
+
+  /**
+   * \brief Account a new bundle, evicting stored bundles if needed
+   *
+   * \param record the bundle to be stored
+   *
+   * \return false if the bundle is rejected and must not be stored
+   */
+  bool Admit (Ptr<BpStoredBundle> record);
+
+  /**
+   * \brief Stop accounting a bundle which leaves its storage
+   *
+   * \param record the stored bundle
+   */
+  void Release (Ptr<BpStoredBundle> record);
+
+  /**
+   * \param policy the eviction policy
+   */
+  void SetPolicy (EvictionPolicy policy);
+
+  /**
+   * \return the eviction policy
+   */
+  EvictionPolicy GetPolicy () const;
+
+  /**
+   * \param bytes the maximum bytes stored by the node, 0 if unlimited
+   */
+  void SetMaxBytes (uint64_t bytes);
+
+  /**
+   * \return the maximum bytes stored by the node
+   */
+  uint64_t GetMaxBytes () const;
+
+  /**
+   * \param bundles the maximum number of bundles stored by the node, 0 if unlimited
+   */
+  void SetMaxBundles (uint32_t bundles);
+
+  /**
+   * \return the maximum number of bundles stored by the node
+   */
+  uint32_t GetMaxBundles () const;
+
+  /**
+   * \param bytes the maximum bytes stored for an endpoint id, 0 if unlimited
+   */
+  void SetEidMaxBytes (uint64_t bytes);
+
+  /**
+   * \return the maximum bytes stored for an endpoint id
+   */
+  uint64_t GetEidMaxBytes () const;
+
+  /**
+   * \param bundles the maximum number of bundles stored for an endpoint id, 0 if unlimited
+   */
+  void SetEidMaxBundles (uint32_t bundles);
+
+  /**
+   * \return the maximum number of bundles stored for an endpoint id
+   */
+  uint32_t GetEidMaxBundles () const;
+
+  /**
+   * \return the bytes stored by the node
+   */
+  uint64_t GetBytes () const;
+
+  /**
+   * \return the number of bundles stored by the node
+   */
+  uint32_t GetBundles () const;
+
+  /**
+   * \param eid the endpoint id
+   *
+   * \return the bytes stored for eid
+   */
+  uint64_t GetBytes (const BpEndpointId &eid) const;
+
+  /**
+   * \param eid the endpoint id
+   *
+   * \return the number of bundles stored for eid
+   */
+  uint32_t GetBundles (const BpEndpointId &eid) const;
+
+  /**
+   * \return the number of endpoint ids with stored bundles
+   */
+  uint32_t GetEids () const;
+
+  /**
+   * \brief Stop accounting all bundles, no callback is called
+   */
+  void Clear ();
+
+private:
+  /**
+   * \brief the position of a bundle in the eviction order
+   */
+  struct Key
+  {
+    int64_t rank;       /// the rank given by the eviction policy
+    uint64_t serial;    /// the admission order, which breaks the ties
+
+    bool operator < (const Key &other) const
+      {
+        return rank < other.rank || (rank == other.rank && serial < other.serial);
+      }
+  };
+
+  typedef std::map<Key, Ptr<BpStoredBundle> > Index;
+
+  /**
+   * \brief the stored bundles of the node or of an endpoint id
+   */
+  struct Usage
+  {
+    Usage ()
+      : bytes (0),
+        bundles (0)
+    {
+    }
+
+    uint64_t bytes;     /// stored bytes
+    uint32_t bundles;   /// number of stored bundles
+    Index index;        /// the stored bundles in eviction order
+  };
+
+  /**
+   * \return the key of record in the current eviction policy
+   */
+  Key GetKey (Ptr<BpStoredBundle> record) const;
+
+  /**
+   * \return true if the usage is within the quotas
+   */
+  bool Fits (const Usage &usage, uint64_t maxBytes, uint32_t maxBundles) const;
+
+  /**
+   * \brief Add a bundle to the node and the endpoint id usages
+   */
+  void Insert (Ptr<BpStoredBundle> record);
+
+  /**
+   * \brief Remove a bundle from the node and the endpoint id usages
+   */
+  void Remove (Ptr<BpStoredBundle> record);
+
+  /**
+   * \brief Evict bundles from usage until it fits the quotas
+   *
+   * \return false if record is evicted
+   */
+  bool Evict (Usage &usage, uint64_t maxBytes, uint32_t maxBundles, Ptr<BpStoredBundle> record);
+
+  EvictionPolicy m_policy;                    /// the eviction policy
+  uint64_t m_maxBytes;                        /// maximum bytes of the node
+  uint32_t m_maxBundles;                      /// maximum number of bundles of the node
+  uint64_t m_eidMaxBytes;                     /// maximum bytes of an endpoint id
+  uint32_t m_eidMaxBundles;                   /// maximum number of bundles of an endpoint id
+  uint64_t m_serial;                          /// the admission order of the next bundle
+  Usage m_node;                               /// the bundles of the node
+  BpEndpointMap<Usage> m_eids;                /// the bundles of each endpoint id
+  Callback<void, Ptr<BpStoredBundle> > m_evict; /// evict callback
+};
+
+} // namespace ns3
+
+#endif /* BP_STORAGE_MANAGER_H */
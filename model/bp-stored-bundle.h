@@ -0,0 +1,84 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+#ifndef BP_STORED_BUNDLE_H
+#define BP_STORED_BUNDLE_H
+
+#include <stdint.h>
+#include "ns3/ptr.h"
+#include "ns3/packet.h"
+#include "ns3/nstime.h"
+#include "ns3/simple-ref-count.h"
+#include "bp-endpoint-id.h"
+
+namespace ns3 {
+
+/**
+ * \brief A bundle kept in the persistant storages of the bundle protocol
+ *
+ * The storages queue references to this record. A bundle that leaves the
+ * storage before it reaches the head of its queue (e.g., it is expired)
+ * releases its packet at once, and its record is left in the queue as an
+ * empty record, which is skipped when the queue is served.
+ */
+struct BpStoredBundle : public SimpleRefCount<BpStoredBundle>
+{
+  /**
+   * the storage holding the bundle
+   */
+  typedef enum {
+    SEND_STORE,       /// BundleProtocol sent bundle storage
+    RECV_STORE,       /// BundleProtocol received bundle storage
+    HELD_STORE        /// held by a convergence layer until a contact, out of the queues
+  } Storage;
+
+  BpStoredBundle (Ptr<Packet> p, const BpEndpointId &id, uint8_t pri, Storage s)
+    : bundle (p),
+      eid (id),
+      priority (pri),
+      storage (s),
+      size (p->GetSize ()),
+      expiration (Seconds (0)),
+      timer (0xFFFFFFFF),
+      serial (0)
+    {
+    }
+
+  /**
+   * \return true if the bundle has not left the storage
+   */
+  bool IsStored () const
+    {
+      return bundle != 0;
+    }
+
+  Ptr<Packet> bundle;     /// the bundle, or NULL if the bundle has left the storage
+  BpEndpointId eid;       /// the endpoint id of the queue: source eid in send storage, destination eid in receive storage
+  uint8_t priority;       /// class of service, see BpHeader::PriorityClass
+  Storage storage;        /// the storage holding the bundle
+  uint32_t size;          /// the size of bundle in bytes
+  Time enqueued;          /// the time when the bundle was stored
+  Time expiration;        /// the time when the lifetime of bundle is over, or zero if it never expires
+  uint32_t timer;         /// the expiration timer of bundle, see BpTimingWheel
+  uint64_t serial;        /// the admission order of bundle, see BpStorageManager
+};
+
+} // namespace ns3
+
+#endif /* BP_STORED_BUNDLE_H */
@@ -21,8 +21,11 @@
 #include "ns3/log.h"
 #include "ns3/packet.h"
 #include "ns3/assert.h"
+#include <algorithm>
 #include "ns3/nstime.h"
 #include "ns3/boolean.h"
+#include "ns3/uinteger.h"
+#include "ns3/string.h"
 #include "ns3/object-vector.h"
 
 #include "ns3/packet.h"
@@ -34,10 +37,10 @@
 #include "bp-tcp-cla-protocol.h"
 #include "bp-cla-protocol.h"
 #include "bundle-protocol.h"
-#include "bp-static-routing-protocol.h"
 #include "bp-header.h"
 #include "bp-endpoint-id.h"
 #include "ns3/tcp-socket-factory.h"
+#include "ns3/ipv4.h"
 #include "ns3/inet-socket-address.h"
 #include "ns3/packet.h"
 
@@ -57,13 +60,92 @@ BpTcpClaProtocol::GetTypeId (void)
   static TypeId tid = TypeId ("ns3::BpTcpClaProtocol")
     .SetParent<BpClaProtocol> ()
     .AddConstructor<BpTcpClaProtocol> ()
+    .AddAttribute ("MaxConnections", "Max number of tcp connections to the next hops",
+           UintegerValue (64),
+           MakeUintegerAccessor (&BpTcpClaProtocol::m_maxConnections),
+           MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("IdleTimeout", "Time after which a tcp connection without bundles to send is closed",
+           TimeValue (Seconds (30.0)),
+           MakeTimeAccessor (&BpTcpClaProtocol::m_idleTimeout),
+           MakeTimeChecker ())
+    .AddAttribute ("ReconnectDelay", "Delay before reopening a failed tcp connection, multiplied by the number of attempts",
+           TimeValue (Seconds (1.0)),
+           MakeTimeAccessor (&BpTcpClaProtocol::m_reconnectDelay),
+           MakeTimeChecker ())
+    .AddAttribute ("MaxReconnects", "Number of reconnections of a failed tcp connection before its bundles are dropped",
+           UintegerValue (3),
+           MakeUintegerAccessor (&BpTcpClaProtocol::m_maxReconnects),
+           MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Stripes", "Number of parallel tcp connections to each next hop, the bundles are striped across them",
+           UintegerValue (1),
+           MakeUintegerAccessor (&BpTcpClaProtocol::m_stripes),
+           MakeUintegerChecker<uint32_t> (1, 0xFFFF))
+    .AddAttribute ("AggregationSize", "Bytes of raw bundles coalesced into one socket send, 0 sends each bundle alone",
+           UintegerValue (0),
+           MakeUintegerAccessor (&BpTcpClaProtocol::m_aggregationSize),
+           MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("AggregationDelay", "Time the bundles of a connection wait for an aggregation unit to fill up",
+           TimeValue (Seconds (0.01)),
+           MakeTimeAccessor (&BpTcpClaProtocol::m_aggregationDelay),
+           MakeTimeChecker ())
+    .AddAttribute ("Tcpcl", "Run a TCPCLv4 session (RFC 9174) on each tcp connection",
+           BooleanValue (false),
+           MakeBooleanAccessor (&BpTcpClaProtocol::m_tcpcl),
+           MakeBooleanChecker ())
+    .AddAttribute ("SegmentMru", "Largest TCPCL segment received and sent, in bytes",
+           UintegerValue (65536),
+           MakeUintegerAccessor (&BpTcpClaProtocol::m_segmentMru),
+           MakeUintegerChecker<uint64_t> (1))
+    .AddAttribute ("TransferMru", "Largest TCPCL transfer received, in bytes",
+           UintegerValue (0xFFFFFFFF),
+           MakeUintegerAccessor (&BpTcpClaProtocol::m_transferMru),
+           MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("SessionWindow", "Number of TCPCL segments sent without acknowledgement",
+           UintegerValue (8),
+           MakeUintegerAccessor (&BpTcpClaProtocol::m_sessionWindow),
+           MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("KeepaliveInterval", "Proposed TCPCL keepalive interval, in whole seconds, 0 disables the keepalive",
+           TimeValue (Seconds (15.0)),
+           MakeTimeAccessor (&BpTcpClaProtocol::m_keepaliveInterval),
+           MakeTimeChecker ())
+    .AddAttribute ("ContactPlan", "File of the contacts with the next hops, see BpContactPlan, empty if the links are always up",
+           StringValue (""),
+           MakeStringAccessor (&BpTcpClaProtocol::SetContactPlanFile,
+                               &BpTcpClaProtocol::GetContactPlanFile),
+           MakeStringChecker ())
   ;
   return tid;
 }
 
 
+BpTcpClaProtocol::Connection::Connection ()
+  : address (Ipv4Address::GetAny (), 0),
+    stripe (0),
+    socket (0),
+    offset (0),
+    queued (0),
+    bufferSize (0),
+    busy (false),
+    flush (false),
+    waiting (false),
+    reconnects (0)
+{
+}
+
+BpTcpClaProtocol::ContactQueue::ContactQueue ()
+  : queued (0),
+    open (false),
+    sent (0)
+{
+}
+
 BpTcpClaProtocol::BpTcpClaProtocol ()
   :m_bp (0),
+   m_sockets (0),
+   m_stripes (1),
+   m_aggregationSize (0),
+   m_tcpcl (false),
+   m_transferId (0),
    m_bpRouting (0)
 { 
   NS_LOG_FUNCTION (this);
@@ -79,6 +161,161 @@ BpTcpClaProtocol::SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol)
 { 
   NS_LOG_FUNCTION (this << " " << bundleProtocol);
   m_bp = bundleProtocol;
+  SetLocalAddresses ();
+}
+
+uint64_t
+BpTcpClaProtocol::GetKey (const InetSocketAddress &address, uint32_t stripe)
+{
+  return ((uint64_t) stripe << 48) | ((uint64_t) address.GetIpv4 ().Get () << 16) | address.GetPort ();
+}
+
+bool
+BpTcpClaProtocol::GetRoute (const BpEndpointId &dst, InetSocketAddress &address, uint32_t size)
+{ 
+  NS_LOG_FUNCTION (this << " " << dst.Uri () << " " << size);
+  if (!m_bpRouting)
+    NS_FATAL_ERROR ("BpTcpClaProtocol::GetRoute (): cannot find bundle routing protocol");
+
+  if (!m_bpRouting->GetBundleNextHop (dst, size, address))
+    {
+      NS_LOG_DEBUG ("BpTcpClaProtocol::GetRoute (): cannot find route for destination endpoint id " << dst.Uri ());
+      return false;
+    }
+
+  return true;
+}
+
+BpTcpClaProtocol::Connection*
+BpTcpClaProtocol::GetConnection (const BpEndpointId &dst, uint64_t &key)
+{ 
+  NS_LOG_FUNCTION (this << " " << dst.Uri ());
+  InetSocketAddress address (Ipv4Address::GetAny (), 0);
+  if (!GetRoute (dst, address))
+    return NULL;
+
+  return OpenConnection (address, 0, key);
+}
+
+BpTcpClaProtocol::Connection*
+BpTcpClaProtocol::SelectConnection (const BpEndpointId &src, const BpEndpointId &dst, uint32_t size, uint64_t &key)
+{ 
+  NS_LOG_FUNCTION (this << " " << src.Uri () << " " << dst.Uri () << " " << size);
+  InetSocketAddress address (Ipv4Address::GetAny (), 0);
+  if (!GetRoute (dst, address, size))
+    return NULL;
+
+  uint32_t stripe = 0;
+  if (m_stripes > 1 && m_bp->IsOrdered (src))
+    {
+      // the bundles of a flow keep the order of their single connection, the
+      // interned handles of its endpoint ids identify it without building a string
+      uint64_t flow = ((uint64_t) src.Handle () << 32) | dst.Handle ();
+      stripe = (uint32_t) ((flow * 0x9E3779B97F4A7C15ULL) >> 32) % m_stripes;
+    }
+  else if (m_stripes > 1)
+    {
+      // least outstanding bytes, a stripe not opened yet has none
+      uint64_t least = 0;
+      for (uint32_t i = 0; i < m_stripes; i++)
+        {
+          ConnectionMap::const_iterator it = m_connections.find (GetKey (address, i));
+          uint64_t outstanding = it == m_connections.end () ? 0 : GetOutstanding (it->second);
+          if (i == 0 || outstanding < least)
+            {
+              least = outstanding;
+              stripe = i;
+            }
+          if (least == 0)
+            break;
+        }
+    }
+
+  return OpenConnection (address, stripe, key);
+}
+
+BpTcpClaProtocol::Connection*
+BpTcpClaProtocol::OpenConnection (const InetSocketAddress &address, uint32_t stripe, uint64_t &key)
+{ 
+  NS_LOG_FUNCTION (this << " " << address.GetIpv4 () << " " << stripe);
+  key = GetKey (address, stripe);
+  ConnectionMap::iterator it = m_connections.find (key);
+  if (it == m_connections.end ())
+    {
+      // this is the first bundle to this stripe of the next hop
+      it = m_connections.insert (std::make_pair (key, Connection ())).first;
+      it->second.address = address;
+      it->second.stripe = stripe;
+      Connect (key);
+
+      // the connection is removed if its socket cannot be opened
+      it = m_connections.find (key);
+      if (it == m_connections.end ())
+        return NULL;
+    }
+
+  return &it->second;
+}
+
+uint64_t
+BpTcpClaProtocol::GetOutstanding (const Connection &connection) const
+{ 
+  NS_LOG_FUNCTION (this);
+  uint64_t bytes = connection.queued - connection.offset;
+  for (uint32_t i = 0; i < connection.resume.size (); i++)
+    bytes += connection.resume[i].bundle->GetSize () - connection.resume[i].length;
+
+  if (connection.session)
+    bytes += connection.session->GetOutgoingBytes ();
+  else if (connection.socket)
+    bytes += connection.bufferSize - std::min (connection.bufferSize, connection.socket->GetTxAvailable ());
+
+  return bytes;
+}
+
+void
+BpTcpClaProtocol::SetBusy (uint64_t key, bool busy)
+{ 
+  NS_LOG_FUNCTION (this << " " << key << " " << busy);
+  ConnectionMap::iterator it = m_connections.find (key);
+  if (it == m_connections.end () || it->second.busy == busy)
+    return;
+
+  it->second.busy = busy;
+  if (busy)
+    it->second.busySince = Simulator::Now ();
+  else
+    m_stripeStats[key].busy += Simulator::Now () - it->second.busySince;
+}
+
+void
+BpTcpClaProtocol::CountBundle (uint64_t key, Ptr<Packet> bundle)
+{ 
+  NS_LOG_FUNCTION (this << " " << key << " " << bundle);
+  StripeStats &stats = m_stripeStats[key];
+  stats.bytes += bundle->GetSize ();
+  stats.bundles++;
+}
+
+std::vector<BpTcpClaProtocol::StripeStats>
+BpTcpClaProtocol::GetStripeStats (const InetSocketAddress &nextHop) const
+{ 
+  NS_LOG_FUNCTION (this << " " << nextHop.GetIpv4 ());
+  std::vector<StripeStats> stats (m_stripes);
+  for (uint32_t i = 0; i < m_stripes; i++)
+    {
+      uint64_t key = GetKey (nextHop, i);
+      std::map<uint64_t, StripeStats>::const_iterator it = m_stripeStats.find (key);
+      if (it != m_stripeStats.end ())
+        stats[i] = it->second;
+
+      // the current busy period is not accounted yet
+      ConnectionMap::const_iterator conn = m_connections.find (key);
+      if (conn != m_connections.end () && conn->second.busy)
+        stats[i].busy += Simulator::Now () - conn->second.busySince;
+    }
+
+  return stats;
 }
 
 Ptr<Socket>
@@ -87,22 +324,13 @@ BpTcpClaProtocol::GetL4Socket (Ptr<Packet> packet)
   NS_LOG_FUNCTION (this << " " << packet);
   BpHeader bph;
   packet->PeekHeader (bph);
-  BpEndpointId dst = bph.GetDestinationEid ();
-  BpEndpointId src = bph.GetSourceEid ();
-
-  std::map<BpEndpointId, Ptr<Socket> >::iterator it = m_l4SendSockets.end ();
-  it = m_l4SendSockets.find (src);
-  if (it == m_l4SendSockets.end ())
-    {
-      // enable a tcp connection from the src endpoint id to the dst endpoint id
-      if (EnableSend (src, dst) < 0)
-        return NULL;
-    }
 
-  // update because EnableSende () add new socket into m_l4SendSockets
-  it = m_l4SendSockets.find (src);
+  uint64_t key;
+  Connection *connection = GetConnection (bph.GetDestinationEid (), key);
+  if (connection == NULL)
+    return NULL;
 
-  return ((*it).second);
+  return connection->socket;
 }
 
 
@@ -110,40 +338,702 @@ int
 BpTcpClaProtocol::SendPacket (Ptr<Packet> packet)
 { 
   NS_LOG_FUNCTION (this << " " << packet);
-  Ptr<Socket> socket = GetL4Socket (packet);
+  BpHeader bph;
+  packet->PeekHeader (bph);
 
-  if ( socket == NULL)
+  InetSocketAddress address (Ipv4Address::GetAny (), 0);
+  if (!GetRoute (bph.GetDestinationEid (), address, packet->GetSize ()))
     return -1;
 
+  // a next hop with contacts is connected when its contact starts
+  uint64_t key;
+  if (!m_contactPlan.HasContacts (address.GetIpv4 ()) &&
+      SelectConnection (bph.GetSourceEid (), bph.GetDestinationEid (), packet->GetSize (), key) == NULL)
+    return -1;
 
   // retreive bundles from queue in BundleProtocol
+  PullBundles ();
+
+  return 0;
+}
+
+void
+BpTcpClaProtocol::PullBundles ()
+{ 
+  NS_LOG_FUNCTION (this);
+  Ptr<BpStoredBundle> record;
+  while ((record = m_bp->HoldBundle ()))
+    {
+      BpHeader bph;
+      record->bundle->PeekHeader (bph);
+      BpEndpointId src = bph.GetSourceEid ();
+
+      // a bundle held for a contact stays in the storage, within the quotas
+      // and its lifetime
+      InetSocketAddress address (Ipv4Address::GetAny (), 0);
+      if (!m_contactPlan.IsEmpty () && GetRoute (bph.GetDestinationEid (), address, record->size) &&
+          HoldBundle (address.GetIpv4 (), record))
+        continue;
+
+      Ptr<Packet> bundle = m_bp->ReleaseBundle (record);
+      uint64_t key;
+      if (!QueueBundle (src, bundle, key))
+        continue;
+
+      // the connection may be closed while the stored bundles are dequeued, and
+      // a backlog smaller than an aggregation unit only waits for more bundles
+      ConnectionMap::iterator it = m_connections.find (key);
+      if (it != m_connections.end () && !it->second.backlog.empty () &&
+          it->second.queued - it->second.offset >= m_aggregationSize)
+        {
+          // the transmission buffer is full, resumed by the Sent callback
+          it->second.waiting = true;
+          return;
+        }
+    }
+}
+
+bool
+BpTcpClaProtocol::QueueBundle (const BpEndpointId &src, Ptr<Packet> bundle, uint64_t &key)
+{ 
+  NS_LOG_FUNCTION (this << " " << src.Uri () << " " << bundle);
   BpHeader bph;
-  packet->PeekHeader (bph);
-  BpEndpointId src = bph.GetSourceEid ();
-  Ptr<Packet> pkt = m_bp->GetBundle (src);
- 
-  if (pkt)
+  bundle->PeekHeader (bph);
+
+  Connection *connection = SelectConnection (src, bph.GetDestinationEid (), bundle->GetSize (), key);
+  if (connection == NULL)
+    {
+      NS_LOG_WARN ("BpTcpClaProtocol::QueueBundle (): drop bundle without route to " << bph.GetDestinationEid ().Uri ());
+      return false;
+    }
+
+  AppendBundle (key, bundle);
+  return true;
+}
+
+void
+BpTcpClaProtocol::AppendBundle (uint64_t key, Ptr<Packet> bundle)
+{ 
+  NS_LOG_FUNCTION (this << " " << key << " " << bundle);
+  Connection &connection = m_connections[key];
+  m_bpRouting->NotifyForward (bundle, connection.address);
+  connection.idleEvent.Cancel ();
+  connection.backlog.push_back (bundle);
+  connection.queued += bundle->GetSize ();
+  SetBusy (key, true);
+  SendBundles (key);
+}
+
+uint16_t
+BpTcpClaProtocol::GetDefaultPort ()
+{ 
+  NS_LOG_FUNCTION (this);
+  return DTN_BUNDLE_TCP_PORT;
+}
+
+int
+BpTcpClaProtocol::ForwardBundle (Ptr<Packet> bundle, const InetSocketAddress &nextHop)
+{ 
+  NS_LOG_FUNCTION (this << " " << bundle << " " << nextHop.GetIpv4 ());
+  if (!m_bpRouting)
+    NS_FATAL_ERROR ("BpTcpClaProtocol::ForwardBundle (): cannot find bundle routing protocol");
+
+  uint64_t key;
+  if (OpenConnection (nextHop, 0, key) == NULL)
+    return -1;
+
+  AppendBundle (key, bundle->Copy ());
+  return 0;
+}
+
+bool
+BpTcpClaProtocol::HoldBundle (Ipv4Address nextHop, Ptr<BpStoredBundle> record)
+{ 
+  NS_LOG_FUNCTION (this << " " << nextHop << " " << record->bundle);
+  if (!m_contactPlan.HasContacts (nextHop))
+    return false;
+
+  ContactQueue &queue = m_contactQueues[nextHop];
+  if (queue.open && queue.bundles.empty ())
+    {
+      uint64_t left = std::min (queue.contact.GetVolume (Simulator::Now ()), queue.contact.GetVolume () - queue.sent);
+      if (record->size <= left)
+        {
+          queue.sent += record->size;
+          return false;
+        }
+    }
+
+  queue.bundles.push_back (record);
+  queue.queued += record->size;
+  ScheduleContact (nextHop);
+  return true;
+}
+
+void
+BpTcpClaProtocol::ScheduleContact (Ipv4Address nextHop)
+{ 
+  NS_LOG_FUNCTION (this << " " << nextHop);
+  ContactQueue &queue = m_contactQueues[nextHop];
+  if (queue.open || queue.startEvent.IsRunning () || queue.bundles.empty ())
+    return;
+
+  std::vector<BpContact> contacts = m_contactPlan.GetContacts (nextHop, Simulator::Now ());
+  if (contacts.empty ())
+    {
+      // the bundles can not be forwarded before the end of the contact plan
+      NS_LOG_WARN ("BpTcpClaProtocol::ScheduleContact (): drop " << queue.bundles.size () << " bundles without a later contact with " << nextHop);
+      std::deque<Ptr<BpStoredBundle> > dropped;
+      dropped.swap (queue.bundles);
+      queue.queued = 0;
+      for (uint32_t i = 0; i < dropped.size (); i++)
+        m_bp->DropBundle (dropped[i]);
+      return;
+    }
+
+  Time delay = contacts[0].start > Simulator::Now () ? contacts[0].start - Simulator::Now () : Seconds (0);
+  queue.startEvent = Simulator::Schedule (delay, &BpTcpClaProtocol::ContactStart, this, nextHop);
+}
+
+void
+BpTcpClaProtocol::ContactStart (Ipv4Address nextHop)
+{ 
+  NS_LOG_FUNCTION (this << " " << nextHop);
+  const BpContact *contact = m_contactPlan.GetContact (nextHop, Simulator::Now ());
+  if (contact == NULL)
+    {
+      ScheduleContact (nextHop);
+      return;
+    }
+
+  ContactQueue &queue = m_contactQueues[nextHop];
+  queue.open = true;
+  queue.contact = *contact;
+  queue.sent = 0;
+  queue.endEvent = Simulator::Schedule (contact->end - Simulator::Now (), &BpTcpClaProtocol::ContactEnd, this, nextHop);
+  DrainContact (nextHop);
+}
+
+void
+BpTcpClaProtocol::DrainContact (Ipv4Address nextHop)
+{ 
+  NS_LOG_FUNCTION (this << " " << nextHop);
+  ContactQueue &queue = m_contactQueues[nextHop];
+  while (queue.open && !queue.bundles.empty ())
+    {
+      // the bundles expired or evicted while they were held are skipped
+      Ptr<BpStoredBundle> record = queue.bundles.front ();
+      if (!record->IsStored ())
+        {
+          queue.bundles.pop_front ();
+          queue.queued -= record->size;
+          continue;
+        }
+
+      // the bundles which do not fit the contact wait for the next one
+      uint64_t left = std::min (queue.contact.GetVolume (Simulator::Now ()), queue.contact.GetVolume () - queue.sent);
+      if (record->size > left)
+        return;
+
+      queue.bundles.pop_front ();
+      queue.queued -= record->size;
+      queue.sent += record->size;
+
+      Ptr<Packet> bundle = m_bp->ReleaseBundle (record);
+      BpHeader bph;
+      bundle->PeekHeader (bph);
+      uint64_t key;
+      QueueBundle (bph.GetSourceEid (), bundle, key);
+    }
+}
+
+void
+BpTcpClaProtocol::ContactEnd (Ipv4Address nextHop)
+{ 
+  NS_LOG_FUNCTION (this << " " << nextHop);
+  ContactQueue &queue = m_contactQueues[nextHop];
+  queue.open = false;
+
+  std::vector<uint64_t> keys;
+  for (ConnectionMap::iterator it = m_connections.begin (); it != m_connections.end (); ++it)
+    {
+      if (it->second.address.GetIpv4 () == nextHop)
+        keys.push_back (it->first);
+    }
+
+  // the bundles not delivered in this contact go first in the next one
+  std::deque<Ptr<Packet> > held;
+  bool waiting = false;
+  for (uint32_t i = 0; i < keys.size (); i++)
+    {
+      Connection &connection = m_connections[keys[i]];
+      for (uint32_t j = 0; j < connection.resume.size (); j++)
+        held.push_back (connection.resume[j].bundle);
+      if (connection.session)
+        {
+          std::vector<BpTcpclSession::Transfer> transfers = connection.session->TakeOutgoing ();
+          for (uint32_t j = 0; j < transfers.size (); j++)
+            held.push_back (transfers[j].bundle);
+        }
+      held.insert (held.end (), connection.backlog.begin (), connection.backlog.end ());
+      waiting = waiting || connection.waiting;
+      CloseConnection (keys[i]);
+    }
+
+  // they are stored again, so they are accounted by the storage quotas and
+  // expire while they wait
+  std::vector<Ptr<BpStoredBundle> > records;
+  for (uint32_t i = 0; i < held.size (); i++)
+    {
+      Ptr<BpStoredBundle> record = m_bp->HoldBundle (held[i]);
+      if (record)
+        records.push_back (record);
+    }
+
+  while (!records.empty ())
+    {
+      queue.bundles.push_front (records.back ());
+      queue.queued += records.back ()->size;
+      records.pop_back ();
+    }
+
+  OpenParkedConnections ();
+
+  // the bundles waiting for the closed connections are held for the next contact
+  if (waiting)
+    PullBundles ();
+
+  ScheduleContact (nextHop);
+}
+
+uint64_t
+BpTcpClaProtocol::GetContactVolume (const BpEndpointId &dst)
+{ 
+  NS_LOG_FUNCTION (this << " " << dst.Uri ());
+  InetSocketAddress address (Ipv4Address::GetAny (), 0);
+  if (m_contactPlan.IsEmpty () || !GetRoute (dst, address))
+    return 0;
+
+  Ipv4Address nextHop = address.GetIpv4 ();
+  std::map<Ipv4Address, ContactQueue>::const_iterator it = m_contactQueues.find (nextHop);
+  uint64_t claimed = it == m_contactQueues.end () ? 0 : it->second.queued;
+
+  // the held bundles take the volume of the contacts first
+  std::vector<BpContact> contacts = m_contactPlan.GetContacts (nextHop, Simulator::Now ());
+  for (uint32_t i = 0; i < contacts.size (); i++)
+    {
+      uint64_t volume = contacts[i].GetVolume (Simulator::Now ());
+      if (it != m_contactQueues.end () && it->second.open && contacts[i].start == it->second.contact.start)
+        volume = std::min (volume, contacts[i].GetVolume () - it->second.sent);
+
+      if (claimed < volume)
+        return volume - claimed;
+      claimed -= volume;
+    }
+
+  return 0;
+}
+
+void
+BpTcpClaProtocol::SetContactPlan (const BpContactPlan &plan)
+{ 
+  NS_LOG_FUNCTION (this);
+  m_contactPlan = plan;
+  SetLocalAddresses ();
+}
+
+void
+BpTcpClaProtocol::SetContactPlanFile (std::string fileName)
+{ 
+  NS_LOG_FUNCTION (this << " " << fileName);
+  m_contactPlanFile = fileName;
+  m_contactPlan.Clear ();
+  if (!fileName.empty () && !m_contactPlan.Load (fileName))
+    NS_FATAL_ERROR ("BpTcpClaProtocol::SetContactPlanFile (): invalid contact plan " << fileName);
+}
+
+void
+BpTcpClaProtocol::SetLocalAddresses ()
+{ 
+  NS_LOG_FUNCTION (this);
+  if (!m_bp || !m_bp->GetNode ())
+    return;
+
+  Ptr<Ipv4> ipv4 = m_bp->GetNode ()->GetObject<Ipv4> ();
+  if (!ipv4)
+    return;
+
+  std::vector<Ipv4Address> addresses;
+  for (uint32_t i = 0; i < ipv4->GetNInterfaces (); i++)
+    {
+      for (uint32_t j = 0; j < ipv4->GetNAddresses (i); j++)
+        addresses.push_back (ipv4->GetAddress (i, j).GetLocal ());
+    }
+
+  m_contactPlan.SetLocalAddresses (addresses);
+}
+
+std::string
+BpTcpClaProtocol::GetContactPlanFile () const
+{ 
+  return m_contactPlanFile;
+}
+
+uint32_t
+BpTcpClaProtocol::GetHeldBundles (Ipv4Address nextHop) const
+{ 
+  NS_LOG_FUNCTION (this << " " << nextHop);
+  std::map<Ipv4Address, ContactQueue>::const_iterator it = m_contactQueues.find (nextHop);
+  if (it == m_contactQueues.end ())
+    return 0;
+
+  uint32_t held = 0;
+  for (uint32_t i = 0; i < it->second.bundles.size (); i++)
+    {
+      if (it->second.bundles[i]->IsStored ())
+        held++;
+    }
+
+  return held;
+}
+
+void
+BpTcpClaProtocol::SendBundles (uint64_t key)
+{ 
+  NS_LOG_FUNCTION (this << " " << key);
+  ConnectionMap::iterator it = m_connections.find (key);
+  if (it == m_connections.end () || it->second.socket == 0)
+    return;
+
+  Connection &connection = it->second;
+  if (connection.session)
+    {
+      // the session keeps each bundle until it is acknowledged
+      while (!connection.backlog.empty () && connection.session->GetOutgoing () < m_sessionWindow)
+        {
+          Ptr<Packet> bundle = connection.backlog.front ();
+          connection.session->Send (bundle, m_transferId++);
+          connection.backlog.pop_front ();
+          connection.queued -= bundle->GetSize ();
+          connection.lastUsed = Simulator::Now ();
+          CountBundle (key, bundle);
+        }
+    }
+
+  uint32_t available = connection.session ? 0 : connection.socket->GetTxAvailable ();
+  while (available > 0 && !connection.backlog.empty ())
+    {
+      // a unit smaller than the aggregation size waits for more bundles until the flush timer
+      if (connection.queued - connection.offset < m_aggregationSize && !connection.flush)
+        {
+          if (!connection.flushEvent.IsRunning ())
+            connection.flushEvent = Simulator::Schedule (m_aggregationDelay, &BpTcpClaProtocol::FlushTimeout, this, key);
+          break;
+        }
+
+      // the stored packets are never modified, the bytes left of a bundle are
+      // sent as a fragment; without aggregation a unit is the first bundle
+      uint32_t budget = m_aggregationSize > 0 ? std::min (available, m_aggregationSize) : available;
+      uint32_t bundles = m_aggregationSize > 0 ? connection.backlog.size () : 1;
+      std::vector<Ptr<Packet> > pieces;
+      uint32_t size = 0;
+      uint32_t offset = connection.offset;
+      for (uint32_t i = 0; i < bundles && size < budget; i++)
+        {
+          Ptr<Packet> bundle = connection.backlog[i];
+          uint32_t left = bundle->GetSize () - offset;
+          uint32_t piece = std::min (left, budget - size);
+          pieces.push_back ((offset == 0 && piece == left) ? bundle : bundle->CreateFragment (offset, piece));
+          size += piece;
+          offset = 0;
+        }
+
+      Ptr<Packet> unit = pieces[0];
+      if (pieces.size () > 1)
+        {
+          unit = Create<Packet> ();
+          for (uint32_t i = 0; i < pieces.size (); i++)
+            unit->AddAtEnd (pieces[i]);
+        }
+
+      if (connection.socket->Send (unit) < 0)
+        {
+          NS_LOG_DEBUG ("BpTcpClaProtocol::SendBundles (): socket error " << connection.socket->GetErrno ());
+          return;
+        }
+
+      connection.lastUsed = Simulator::Now ();
+      while (size > 0)
+        {
+          Ptr<Packet> bundle = connection.backlog.front ();
+          uint32_t piece = std::min (size, bundle->GetSize () - connection.offset);
+          connection.offset += piece;
+          size -= piece;
+          if (connection.offset == bundle->GetSize ())
+            {
+              connection.backlog.pop_front ();
+              connection.queued -= bundle->GetSize ();
+              connection.offset = 0;
+              CountBundle (key, bundle);
+            }
+        }
+
+      available = connection.socket->GetTxAvailable ();
+    }
+
+  if (connection.backlog.empty ())
+    {
+      connection.flush = false;
+      connection.flushEvent.Cancel ();
+    }
+  else if (available == 0)
+    return;
+
+  // resume the stored bundles waiting for this connection
+  if (connection.waiting)
+    {
+      connection.waiting = false;
+      PullBundles ();
+    }
+
+  it = m_connections.find (key);
+  if (it != m_connections.end () && IsIdle (it->second))
+    {
+      SetBusy (key, false);
+      it->second.idleEvent.Cancel ();
+      it->second.idleEvent = Simulator::Schedule (m_idleTimeout, &BpTcpClaProtocol::IdleTimeout, this, key);
+    }
+}
+
+void
+BpTcpClaProtocol::FlushTimeout (uint64_t key)
+{ 
+  NS_LOG_FUNCTION (this << " " << key);
+  ConnectionMap::iterator it = m_connections.find (key);
+  if (it == m_connections.end ())
+    return;
+
+  // the bundles waiting for the unit to fill up are sent as they are
+  it->second.flush = true;
+  SendBundles (key);
+}
+
+void
+BpTcpClaProtocol::Connect (uint64_t key)
+{ 
+  NS_LOG_FUNCTION (this << " " << key);
+  if (m_sockets >= m_maxConnections && !CloseIdleConnection (key))
+    {
+      NS_LOG_DEBUG ("BpTcpClaProtocol::Connect (): all " << m_maxConnections << " connections are busy");
+      m_parked.push_back (key);
+      return;
+    }
+
+  // start a tcp connection
+  Connection &connection = m_connections[key];
+  Ptr<Socket> socket = Socket::CreateSocket (m_bp->GetNode (), TcpSocketFactory::GetTypeId ());
+  if (socket->Bind () < 0 || socket->Connect (connection.address) < 0 || (!m_tcpcl && socket->ShutdownRecv () < 0))
+    {
+      NS_LOG_DEBUG ("BpTcpClaProtocol::Connect (): socket error " << socket->GetErrno ());
+      socket->Close ();
+      Retry (key);
+      return;
+    }
+
+  SetL4SocketCallbacks (socket);
+
+  connection.socket = socket;
+  connection.offset = 0;
+  connection.bufferSize = socket->GetTxAvailable ();
+  connection.lastUsed = Simulator::Now ();
+  m_socketKeys[socket] = key;
+  m_sockets++;
+
+  if (m_tcpcl)
+    {
+      // the transfers of the lost session are resumed first
+      connection.session = CreateSession (socket, true);
+      for (uint32_t i = 0; i < connection.resume.size (); i++)
+        connection.session->Send (connection.resume[i].bundle, connection.resume[i].id, connection.resume[i].length);
+      connection.resume.clear ();
+    }
+}
+
+bool
+BpTcpClaProtocol::IsIdle (const Connection &connection) const
+{
+  return connection.backlog.empty () && !connection.waiting && connection.resume.empty () &&
+         (connection.session == 0 || connection.session->GetOutgoing () == 0);
+}
+
+bool
+BpTcpClaProtocol::CloseIdleConnection (uint64_t exclude)
+{ 
+  NS_LOG_FUNCTION (this << " " << exclude);
+  ConnectionMap::iterator lru = m_connections.end ();
+  for (ConnectionMap::iterator it = m_connections.begin (); it != m_connections.end (); ++it)
+    {
+      Connection &connection = it->second;
+      if (it->first == exclude || connection.socket == 0 || !IsIdle (connection))
+        continue;
+
+      if (lru == m_connections.end () || connection.lastUsed < lru->second.lastUsed)
+        lru = it;
+    }
+
+  if (lru == m_connections.end ())
+    return false;
+
+  CloseConnection (lru->first);
+  return true;
+}
+
+void
+BpTcpClaProtocol::CloseConnection (uint64_t key)
+{ 
+  NS_LOG_FUNCTION (this << " " << key);
+  ConnectionMap::iterator it = m_connections.find (key);
+  if (it == m_connections.end ())
+    return;
+
+  Connection &connection = it->second;
+  connection.idleEvent.Cancel ();
+  connection.reconnectEvent.Cancel ();
+  connection.flushEvent.Cancel ();
+  if (connection.socket)
+    {
+      // the close callbacks of this socket are ignored from now on
+      m_socketKeys.erase (connection.socket);
+      if (connection.session)
+        connection.session->Terminate (BpTcpclSession::TERM_IDLE_TIMEOUT);
+      RemoveSession (connection.socket);
+      connection.socket->Close ();
+      m_sockets--;
+    }
+
+  SetBusy (key, false);
+  m_connections.erase (it);
+}
+
+void
+BpTcpClaProtocol::OpenParkedConnections ()
+{ 
+  NS_LOG_FUNCTION (this);
+  while (!m_parked.empty () && m_sockets < m_maxConnections)
+    {
+      uint64_t key = m_parked.front ();
+      m_parked.pop_front ();
+      ConnectionMap::iterator it = m_connections.find (key);
+      if (it == m_connections.end () || it->second.socket)
+        continue;
+
+      Connect (key);
+      SendBundles (key);
+    }
+}
+
+void
+BpTcpClaProtocol::IdleTimeout (uint64_t key)
+{ 
+  NS_LOG_FUNCTION (this << " " << key);
+  ConnectionMap::iterator it = m_connections.find (key);
+  if (it == m_connections.end () || !IsIdle (it->second))
+    return;
+
+  CloseConnection (key);
+  OpenParkedConnections ();
+}
+
+void
+BpTcpClaProtocol::ConnectionLost (Ptr<Socket> socket)
+{ 
+  NS_LOG_FUNCTION (this << " " << socket);
+  CloseRecvContext (socket);
+  Ptr<BpTcpclSession> session = RemoveSession (socket);
+  std::map<Ptr<Socket>, uint64_t>::iterator it = m_socketKeys.find (socket);
+  if (it == m_socketKeys.end ())
+    {
+      // a receiver socket, or a socket closed by this node
+      if (session)
+        RetainIncoming (session);
+      return;
+    }
+
+  uint64_t key = it->second;
+  m_socketKeys.erase (it);
+  m_sockets--;
+
+  ConnectionMap::iterator conn = m_connections.find (key);
+  if (conn != m_connections.end ())
+    {
+      if (session)
+        {
+          // the transfers not acknowledged wait for the next session
+          std::vector<BpTcpclSession::Transfer> transfers = session->TakeOutgoing ();
+          conn->second.resume.insert (conn->second.resume.end (), transfers.begin (), transfers.end ());
+        }
+      conn->second.session = 0;
+      conn->second.socket = 0;
+      conn->second.idleEvent.Cancel ();
+      Retry (key);
+    }
+
+  OpenParkedConnections ();
+}
+
+void
+BpTcpClaProtocol::Retry (uint64_t key)
+{ 
+  NS_LOG_FUNCTION (this << " " << key);
+  ConnectionMap::iterator it = m_connections.find (key);
+  if (it == m_connections.end ())
+    return;
+
+  // the peer did not get the whole partially written bundle, it is sent again
+  Connection &connection = it->second;
+  connection.offset = 0;
+  if (IsIdle (connection))
     {
-      socket->Send (pkt);
-      return 0;
+      SetBusy (key, false);
+      m_connections.erase (it);
+      return;
     }
 
-  return -1;
+  if (connection.reconnects >= m_maxReconnects)
+    {
+      NS_LOG_WARN ("BpTcpClaProtocol::Retry (): drop " << connection.backlog.size () + connection.resume.size () << " bundles to unreachable next hop " << 
+                   connection.address.GetIpv4 ());
+      SetBusy (key, false);
+      m_connections.erase (it);
+      return;
+    }
+
+  connection.reconnects++;
+  Time delay = Seconds (m_reconnectDelay.GetSeconds () * connection.reconnects);
+  connection.reconnectEvent = Simulator::Schedule (delay, &BpTcpClaProtocol::Reconnect, this, key);
+}
+
+void
+BpTcpClaProtocol::Reconnect (uint64_t key)
+{ 
+  NS_LOG_FUNCTION (this << " " << key);
+  if (m_connections.find (key) == m_connections.end ())
+    return;
+
+  Connect (key);
+  SendBundles (key);
 }
 
 int
 BpTcpClaProtocol::EnableReceive (const BpEndpointId &local)
 { 
   NS_LOG_FUNCTION (this << " " << local.Uri ());
-  Ptr<BpStaticRoutingProtocol> route = DynamicCast <BpStaticRoutingProtocol> (m_bpRouting);
-  InetSocketAddress addr = route->GetRoute (local);
-
+  InetSocketAddress addr (Ipv4Address::GetAny (), 0);
   uint16_t port;
-  InetSocketAddress defaultAddr ("127.0.0.1", 0);
-  if (addr == defaultAddr)
-    port = DTN_BUNDLE_TCP_PORT;
-  else
+  if (GetRoute (local, addr))
     port = addr.GetPort ();
+  else
+    port = GetDefaultPort ();
 
   InetSocketAddress address (Ipv4Address::GetAny (), port);
 
@@ -153,17 +1043,13 @@ BpTcpClaProtocol::EnableReceive (const BpEndpointId &local)
     return -1;
   if (socket->Listen () < 0)
     return -1;
-  if (socket->ShutdownSend () < 0)
-    return -1; 
+  if (!m_tcpcl && socket->ShutdownSend () < 0)
+    return -1;     // the sessions of the accepted sockets send acknowledgements
 
   SetL4SocketCallbacks (socket);
  
   // store the sending socket so that the convergence layer can dispatch the hundles to different tcp connections
-  std::map<BpEndpointId, Ptr<Socket> >::iterator it = m_l4RecvSockets.end ();
-  it = m_l4RecvSockets.find (local);
-  if (it == m_l4RecvSockets.end ())
-    m_l4RecvSockets.insert (std::pair<BpEndpointId, Ptr<Socket> >(local, socket));  
-  else
+  if (!m_l4RecvSockets.Insert (local, socket))
     return -1;
 
 
@@ -174,16 +1060,15 @@ int
 BpTcpClaProtocol::DisableReceive (const BpEndpointId &local)
 { 
   NS_LOG_FUNCTION (this << " " << local.Uri ());
-   std::map<BpEndpointId, Ptr<Socket> >::iterator it = m_l4RecvSockets.end ();
-  it = m_l4RecvSockets.find (local);
-  if (it == m_l4RecvSockets.end ())
+  Ptr<Socket> *socket = m_l4RecvSockets.Find (local);
+  if (socket == NULL)
     {
       return -1;
     }
   else
     {
       // close the tcp conenction
-      return ((*it).second)->Close ();
+      return (*socket)->Close ();
     }
 
   return 0;
@@ -194,38 +1079,9 @@ int
 BpTcpClaProtocol::EnableSend (const BpEndpointId &src, const BpEndpointId &dst)
 { 
   NS_LOG_FUNCTION (this << " " << src.Uri () << " " << dst.Uri ());
-  if (!m_bpRouting)
-    NS_FATAL_ERROR ("BpTcpClaProtocol::SendPacket (): cannot find bundle routing protocol");
-
-  // TBD: do not use dynamicast here
-  // check route for destination endpoint id
-  Ptr<BpStaticRoutingProtocol> route = DynamicCast <BpStaticRoutingProtocol> (m_bpRouting);
-  InetSocketAddress address = route->GetRoute (dst);
-
-  InetSocketAddress defaultAddr ("127.0.0.1", 0);
-  if (address == defaultAddr)
-    {
-      NS_LOG_DEBUG ("BpTcpClaProtocol::EnableSend (): cannot find route for destination endpoint id " << dst.Uri ());
-      return -1;
-    }
-
-  // start a tcp connection
-  Ptr<Socket> socket = Socket::CreateSocket (m_bp->GetNode (), TcpSocketFactory::GetTypeId ());
-  if (socket->Bind () < 0)
-    return -1;
-  if (socket->Connect (address) < 0)
-    return -1;
-  if (socket->ShutdownRecv () < 0)
-    return -1;
-
-  SetL4SocketCallbacks (socket);
-
-  // store the sending socket so that the convergence layer can dispatch the hundles to different tcp connections
-  std::map<BpEndpointId, Ptr<Socket> >::iterator it = m_l4SendSockets.end ();
-  it = m_l4SendSockets.find (src);
-  if (it == m_l4SendSockets.end ())
-    m_l4SendSockets.insert (std::pair<BpEndpointId, Ptr<Socket> >(src, socket));  
-  else
+  // the connections are shared by all source endpoint ids
+  uint64_t key;
+  if (GetConnection (dst, key) == NULL)
     return -1;
 
   return 0;
@@ -261,24 +1117,38 @@ void
 BpTcpClaProtocol::ConnectionSucceeded (Ptr<Socket> socket)
 { 
   NS_LOG_FUNCTION (this << " " << socket);
+  std::map<Ptr<Socket>, uint64_t>::iterator it = m_socketKeys.find (socket);
+  if (it == m_socketKeys.end ())
+    return;
+
+  ConnectionMap::iterator conn = m_connections.find (it->second);
+  if (conn == m_connections.end ())
+    return;
+
+  conn->second.reconnects = 0;
+  if (m_bpRouting)
+    m_bpRouting->NotifyLinkUp (conn->second.address.GetIpv4 ());
 } 
 
 void 
 BpTcpClaProtocol::ConnectionFailed (Ptr<Socket> socket)
 { 
   NS_LOG_FUNCTION (this << " " << socket);
+  ConnectionLost (socket);
 }
 
 void 
 BpTcpClaProtocol::NormalClose (Ptr<Socket> socket)
 { 
   NS_LOG_FUNCTION (this << " " << socket);
+  ConnectionLost (socket);
 }
 
 void 
 BpTcpClaProtocol::ErrorClose (Ptr<Socket> socket)
 { 
   NS_LOG_FUNCTION (this << " " << socket);
+  ConnectionLost (socket);
 }
 
 bool
@@ -293,6 +1163,16 @@ BpTcpClaProtocol::NewConnectionCreated (Ptr<Socket> socket, const Address &addre
 { 
   NS_LOG_FUNCTION (this << " " << socket << " " << address);
   SetL4SocketCallbacks (socket);  // reset the callbacks due to fork in TcpSocketBase
+  if (m_tcpcl)
+    CreateSession (socket, false);
+  else
+    {
+      // the bundles of each peer are extracted from its own byte stream
+      m_recvContexts.insert (std::make_pair (socket, RecvContext ()));
+    }
+
+  if (m_bpRouting && InetSocketAddress::IsMatchingType (address))
+    m_bpRouting->NotifyLinkUp (InetSocketAddress::ConvertFrom (address).GetIpv4 ());
 }
 
 void 
@@ -305,6 +1185,16 @@ void
 BpTcpClaProtocol::Sent (Ptr<Socket> socket, uint32_t size)
 { 
   NS_LOG_FUNCTION (this << " " << socket << " " << size);
+  Ptr<BpTcpclSession> session = FindSession (socket);
+  if (session)
+    session->Flush ();
+
+  std::map<Ptr<Socket>, uint64_t>::iterator it = m_socketKeys.find (socket);
+  if (it == m_socketKeys.end ())
+    return;     // not a sender socket
+
+  // the transmission buffer has free space, resume the backlog
+  SendBundles (it->second);
 }
 
 
@@ -314,10 +1204,162 @@ BpTcpClaProtocol::DataRecv (Ptr<Socket> socket)
   NS_LOG_FUNCTION (this << " " << socket);
   Ptr<Packet> packet;
   Address from;
+  RecvContext *context = NULL;
   while ((packet = socket->RecvFrom (from)))
    {
-     m_bp->ReceivePacket (packet);
+     // the session may be closed by the received bytes
+     Ptr<BpTcpclSession> session = FindSession (socket);
+     if (session)
+       {
+         session->Receive (packet);
+         continue;
+       }
+
+     if (context == NULL)
+       context = &m_recvContexts[socket];
+     context->decoder.Feed (packet);
    }
+
+  // one parse event for all the bundles completed by this burst
+  if (context && context->decoder.HasBundle () && !context->parseEvent.IsRunning ())
+    context->parseEvent = Simulator::ScheduleNow (&BpTcpClaProtocol::ParseBundles, this, socket);
+}
+
+void
+BpTcpClaProtocol::ParseBundles (Ptr<Socket> socket)
+{ 
+  NS_LOG_FUNCTION (this << " " << socket);
+  std::map<Ptr<Socket>, RecvContext>::iterator it = m_recvContexts.find (socket);
+  if (it == m_recvContexts.end ())
+    return;
+
+  Ptr<Packet> bundle;
+  while ((bundle = it->second.decoder.GetBundle ()))
+    m_bp->ReceiveBundle (bundle);
+}
+
+void
+BpTcpClaProtocol::CloseRecvContext (Ptr<Socket> socket)
+{ 
+  NS_LOG_FUNCTION (this << " " << socket);
+  std::map<Ptr<Socket>, RecvContext>::iterator it = m_recvContexts.find (socket);
+  if (it == m_recvContexts.end ())
+    return;
+
+  // the bundles received before the close are not lost with the socket
+  it->second.parseEvent.Cancel ();
+  ParseBundles (socket);
+  if (it->second.decoder.GetPendingSize () > 0)
+    NS_LOG_DEBUG ("BpTcpClaProtocol::CloseRecvContext (): drop " << it->second.decoder.GetPendingSize () << " bytes of a partial bundle");
+  m_recvContexts.erase (it);
+}
+
+Ptr<BpTcpclSession>
+BpTcpClaProtocol::CreateSession (Ptr<Socket> socket, bool active)
+{ 
+  NS_LOG_FUNCTION (this << " " << socket << " " << active);
+  Ptr<BpTcpclSession> session = Create<BpTcpclSession> (active, m_bp->GetBpEndpointId ().Uri ());
+  session->SetSegmentMru (m_segmentMru);
+  session->SetTransferMru (m_transferMru);
+  session->SetWindow (m_sessionWindow);
+  session->SetKeepalive ((uint16_t) std::min (m_keepaliveInterval.GetSeconds (), 65535.0));
+  session->SetSocket (socket);
+  session->SetSendCallback (MakeCallback (&BpTcpClaProtocol::SessionSend, this));
+  session->SetTxAvailableCallback (MakeCallback (&BpTcpClaProtocol::SessionTxAvailable, this));
+  session->SetReceiveCallback (MakeCallback (&BpTcpClaProtocol::SessionReceive, this));
+  session->SetEstablishedCallback (MakeCallback (&BpTcpClaProtocol::SessionEstablished, this));
+  session->SetAckCallback (MakeCallback (&BpTcpClaProtocol::SessionAcked, this));
+  session->SetClosedCallback (MakeCallback (&BpTcpClaProtocol::SessionClosed, this));
+  m_sessions[socket] = session;
+  session->Start ();
+
+  return session;
+}
+
+Ptr<BpTcpclSession>
+BpTcpClaProtocol::FindSession (Ptr<Socket> socket) const
+{ 
+  NS_LOG_FUNCTION (this << " " << socket);
+  std::map<Ptr<Socket>, Ptr<BpTcpclSession> >::const_iterator it = m_sessions.find (socket);
+  if (it == m_sessions.end ())
+    return NULL;
+
+  return it->second;
+}
+
+Ptr<BpTcpclSession>
+BpTcpClaProtocol::RemoveSession (Ptr<Socket> socket)
+{ 
+  NS_LOG_FUNCTION (this << " " << socket);
+  std::map<Ptr<Socket>, Ptr<BpTcpclSession> >::iterator it = m_sessions.find (socket);
+  if (it == m_sessions.end ())
+    return NULL;
+
+  Ptr<BpTcpclSession> session = it->second;
+  m_sessions.erase (it);
+  session->Close ();
+  return session;
+}
+
+void
+BpTcpClaProtocol::RetainIncoming (Ptr<BpTcpclSession> session)
+{ 
+  NS_LOG_FUNCTION (this << " " << session);
+  BpTcpclSession::Transfer transfer;
+  if (session->TakeIncoming (transfer) && !session->GetPeerNodeId ().empty ())
+    m_retained[session->GetPeerNodeId ()] = transfer;
+}
+
+int
+BpTcpClaProtocol::SessionSend (Ptr<BpTcpclSession> session, Ptr<Packet> packet)
+{ 
+  NS_LOG_FUNCTION (this << " " << session << " " << packet);
+  return session->GetSocket ()->Send (packet);
+}
+
+uint32_t
+BpTcpClaProtocol::SessionTxAvailable (Ptr<BpTcpclSession> session)
+{ 
+  NS_LOG_FUNCTION (this << " " << session);
+  return session->GetSocket ()->GetTxAvailable ();
+}
+
+void
+BpTcpClaProtocol::SessionReceive (Ptr<BpTcpclSession> session, Ptr<Packet> bundle)
+{ 
+  NS_LOG_FUNCTION (this << " " << session << " " << bundle);
+  m_bp->ReceiveBundle (bundle);
+}
+
+void
+BpTcpClaProtocol::SessionEstablished (Ptr<BpTcpclSession> session)
+{ 
+  NS_LOG_FUNCTION (this << " " << session);
+  // the peer may resume its transfer of the lost session
+  std::map<std::string, BpTcpclSession::Transfer>::iterator it = m_retained.find (session->GetPeerNodeId ());
+  if (it == m_retained.end ())
+    return;
+
+  session->AdoptIncoming (it->second);
+  m_retained.erase (it);
+}
+
+void
+BpTcpClaProtocol::SessionAcked (Ptr<BpTcpclSession> session)
+{ 
+  NS_LOG_FUNCTION (this << " " << session);
+  std::map<Ptr<Socket>, uint64_t>::iterator it = m_socketKeys.find (session->GetSocket ());
+  if (it != m_socketKeys.end ())
+    SendBundles (it->second);
+}
+
+void
+BpTcpClaProtocol::SessionClosed (Ptr<BpTcpclSession> session)
+{ 
+  NS_LOG_FUNCTION (this << " " << session);
+  Ptr<Socket> socket = session->GetSocket ();
+  ConnectionLost (socket);
+  socket->Close ();
 }
 
 void
@@ -29,7 +29,18 @@
 #include "ns3/packet.h"
 #include "bundle-protocol.h"
 #include "bp-routing-protocol.h"
+#include "bp-endpoint-map.h"
+#include "bp-tcpcl-session.h"
+#include "bp-bundle-decoder.h"
+#include "bp-contact-plan.h"
+#include "bp-stored-bundle.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
 #include <map>
+#include <deque>
+#include <vector>
+#include <string>
 
 namespace ns3 {
 
@@ -37,6 +48,66 @@ class Node;
 //class Socket;
 //class BpSocket;
 
+/**
+ * \brief The TCP convergence layer adapter
+ *
+ * The bundles are sent over a pool of TCP connections keyed by the address
+ * of the next hop, so all the source endpoint ids of a node share the
+ * connection to a next hop, and the bundles of a source endpoint id reach
+ * each destination through the connection of its own next hop.
+ *
+ * The number of sender sockets is bounded by the MaxConnections attribute:
+ * a new connection closes the least recently used idle connection, or waits
+ * until a socket is released. A connection without bundles to send is
+ * closed after the IdleTimeout attribute. A failed or lost connection is
+ * reconnected after ReconnectDelay, at most MaxReconnects times in a row,
+ * and its partially written bundle is sent again from its first byte.
+ *
+ * With the Tcpcl attribute, each connection runs a TCPCLv4 session (RFC 9174,
+ * see BpTcpclSession) instead of writing the raw bundles into the byte
+ * stream: the bundles are sent as transfers of at most SegmentMru bytes per
+ * segment, with at most SessionWindow segments not acknowledged. The
+ * transfers of a lost session are resumed from their acknowledged length by
+ * the next session with the same next hop, and the receiver keeps the
+ * partially received transfer of each peer node id until then.
+ *
+ * The Stripes attribute opens up to K parallel connections to each next
+ * hop, so that the bundles are not limited by the congestion window of a
+ * single TCP flow. Each bundle goes to the stripe with the least outstanding
+ * bytes: not yet written, in the transmission buffer, or not acknowledged
+ * by the TCPCL session. The bundles of a source endpoint id registered as
+ * ordered (see BpRegisterInfo) always take the same stripe for a given
+ * destination, so they arrive in order. GetStripeStats reports the bytes
+ * and the busy time of each stripe.
+ *
+ * Each connected socket delimits the bundles of its own byte stream with its
+ * own BpBundleDecoder, so the streams of different peers or stripes never
+ * mix. The bundles completed by a burst of received segments are handed to
+ * the bundle protocol by a single event.
+ *
+ * With a contact plan (the ContactPlan attribute, or SetContactPlan), a next
+ * hop with contacts in the plan is only reachable during its contacts. The
+ * plan may describe the whole network; the contacts sent from an address of
+ * this node are its contacts. Its
+ * bundles are held in a queue of the next hop until a contact starts; the
+ * connections to the next hop are opened when the contact starts, the held
+ * bundles are sent while they fit the volume left in the contact, and the
+ * connections are closed when the contact ends. The bundles which are not
+ * completely written at the end of a contact, or not acknowledged by the
+ * TCPCL session, are held again for the next contact. The held bundles stay
+ * in the storage of the bundle protocol, within its quotas and their
+ * lifetime, and the bundles without a later contact are dropped as expired.
+ * The bundle protocol sizes the bundles to the volume left in the next contact, see
+ * GetContactVolume. A next hop without contacts in the plan is always up.
+ *
+ * The AggregationSize attribute coalesces the raw bundles of a connection
+ * into transmission units of up to that many bytes, each written by one
+ * socket send: like the Nagle algorithm, a backlog smaller than a unit
+ * waits for more bundles for at most AggregationDelay, then it is written
+ * as it is. The receiver delimits the bundles of the byte stream as usual.
+ * The bundles of a TCPCL session are not aggregated, they are transfers
+ * of their own.
+ */
 class BpTcpClaProtocol : public BpClaProtocol
 {
 public:
@@ -88,18 +159,77 @@ public:
   /**
    * \brief Get the transport layer socket
    *
-   * This method finds the socket by the source endpoint id of the bundle. 
-   * If it cannot find, which means that this bundle is the first bundle required
-   * to be transmitted for this source endpoint id, it start a tcp connection with
-   * the destination endpoint id.
+   * This method finds the socket by the next hop of the destination endpoint
+   * id of the bundle. If it cannot find, which means that this bundle is the
+   * first bundle required to be transmitted to this next hop, it start a tcp
+   * connection with the next hop.
    *
    * \param packet the bundle required to be transmitted
    *
-   * \return return NULL if it cannot find a socket for the source endpoing id of 
-   * the bunle. Otherwise, it returns the socket.
+   * \return return NULL if there is no route for the destination endpoint id of 
+   * the bunle, or the connection waits for a free socket. Otherwise, it returns
+   * the socket.
    */
   virtual Ptr<Socket> GetL4Socket (Ptr<Packet> packet);
 
+  /**
+   * \brief the utilization of a striped connection to a next hop
+   */
+  struct StripeStats
+  {
+    StripeStats ()
+      : bytes (0),
+        bundles (0)
+    {
+    }
+
+    uint64_t bytes;       /// bundle bytes written into the connection
+    uint32_t bundles;     /// bundles written into the connection
+    Time busy;            /// total time with outstanding bytes
+  };
+
+  /**
+   * \param nextHop the address of a next hop
+   *
+   * \return the utilization of each stripe to the next hop, indexed by stripe
+   */
+  std::vector<StripeStats> GetStripeStats (const InetSocketAddress &nextHop) const;
+
+  /**
+   * \brief Get the bytes the current or next contact to the next hop of a
+   * destination can still carry, after the bundles already held for it
+   *
+   * \param dst the destination endpoint id
+   *
+   * \return the volume in bytes, or 0 if the next hop has no contact in the
+   * plan, or no contact with volume left
+   */
+  virtual uint64_t GetContactVolume (const BpEndpointId &dst);
+
+  /**
+   * \brief Append a copy of a bundle to the backlog of the first stripe to
+   * a next hop, the connection is opened if it is new; the contact plan
+   * does not hold the bundle
+   */
+  virtual int ForwardBundle (Ptr<Packet> bundle, const InetSocketAddress &nextHop);
+
+  /**
+   * \return the port listened on for a local endpoint id without route, DTN_BUNDLE_TCP_PORT
+   */
+  virtual uint16_t GetDefaultPort ();
+
+  /**
+   * \param plan the contact plan, which replaces the current one
+   */
+  void SetContactPlan (const BpContactPlan &plan);
+
+  /**
+   * \param nextHop the address of a next hop
+   *
+   * \return the number of bundles held for the next contact with the next hop
+   */
+  uint32_t GetHeldBundles (Ipv4Address nextHop) const;
+
   /**
    * Connect to routing protocol
    *
@@ -166,7 +296,7 @@ public:
   void DataSent (Ptr<Socket>,uint32_t size);
 
   /**
-   * \brief sent callback
+   * \brief sent callback, resumes the bundles waiting for transmission buffer space
    */
   void Sent (Ptr<Socket>,uint32_t size);
 
@@ -184,10 +314,366 @@ private:
    */
   virtual void SetL4SocketCallbacks (Ptr<Socket> socket);
 
+  /**
+   * \brief a pooled transport layer connection to a next hop
+   */
+  struct Connection {
+    Connection ();
+
+    InetSocketAddress address;            /// the address of next hop
+    uint32_t stripe;                      /// index of the connection among the stripes to the next hop
+    Ptr<Socket> socket;                   /// the sender socket, or NULL while waiting for a free socket or a reconnection
+    std::deque<Ptr<Packet> > backlog;     /// bundles dequeued from the bundle protocol, waiting for transmission buffer space
+    uint32_t offset;                      /// bytes of the first bundle of backlog already written into the socket
+    uint64_t queued;                      /// bytes of the bundles of backlog
+    uint32_t bufferSize;                  /// size of the transmission buffer of the socket
+    bool busy;                            /// the connection has outstanding bytes
+    Time busySince;                       /// the time the connection became busy
+    bool flush;                           /// the backlog is written without waiting for a full aggregation unit
+    EventId flushEvent;                   /// ends the wait for a full aggregation unit
+    Ptr<BpTcpclSession> session;          /// the TCPCL session of the socket, NULL without the Tcpcl attribute
+    std::vector<BpTcpclSession::Transfer> resume; /// transfers of the lost session, resumed by the next one
+    bool waiting;                         /// the stored bundles are dequeued again when this connection has space
+    uint32_t reconnects;                  /// reconnections since the last established connection
+    Time lastUsed;                        /// the last time a bundle was written into the socket
+    EventId idleEvent;                    /// closes the connection when it is idle
+    EventId reconnectEvent;               /// reopens the connection after a failure
+  };
+
+  typedef std::map<uint64_t, Connection> ConnectionMap;
+
+  /**
+   * \brief the bundles of a next hop held for its contacts
+   */
+  struct ContactQueue {
+    ContactQueue ();
+
+    std::deque<Ptr<BpStoredBundle> > bundles; /// bundles waiting for a contact, in order, held in the storage
+    uint64_t queued;                      /// bytes of bundles
+    bool open;                            /// a contact is in progress
+    BpContact contact;                    /// the contact in progress
+    uint64_t sent;                        /// bytes sent during the contact in progress
+    EventId startEvent;                   /// starts the next contact
+    EventId endEvent;                     /// ends the contact in progress
+  };
+
+  /**
+   * \brief the receive state of a connected socket
+   */
+  struct RecvContext {
+    BpBundleDecoder decoder;              /// delimits the bundles of the byte stream of the socket
+    EventId parseEvent;                   /// hands the complete bundles to the bundle protocol
+  };
+
+  /**
+   * \return the key of a stripe to a next hop address in the connection pool
+   */
+  static uint64_t GetKey (const InetSocketAddress &address, uint32_t stripe = 0);
+
+  /**
+   * \brief Find the address of the next hop of a destination endpoint id
+   *
+   * \param dst the destination endpoint id
+   * \param address set to the address of the next hop
+   * \param size the size of the bundle to route, 0 if the route is not for a bundle
+   *
+   * \return false if there is no route for dst
+   */
+  bool GetRoute (const BpEndpointId &dst, InetSocketAddress &address, uint32_t size = 0);
+
+  /**
+   * \brief Get the first stripe to the next hop of a destination endpoint id,
+   * the connection is opened if it is new
+   *
+   * \param dst the destination endpoint id
+   * \param key set to the key of the connection
+   *
+   * \return the connection, or NULL if there is no route for dst
+   */
+  Connection* GetConnection (const BpEndpointId &dst, uint64_t &key);
+
+  /**
+   * \brief Get the stripe to the next hop of the destination endpoint id of
+   * a bundle: the one of its flow for an ordered source endpoint id, the
+   * one with the least outstanding bytes otherwise
+   *
+   * \param src the source endpoint id
+   * \param dst the destination endpoint id
+   * \param size the size of the bundle
+   * \param key set to the key of the connection
+   *
+   * \return the connection, or NULL if there is no route for dst
+   */
+  Connection* SelectConnection (const BpEndpointId &src, const BpEndpointId &dst, uint32_t size, uint64_t &key);
+
+  /**
+   * \brief Get a stripe to a next hop, the connection is opened if it is new
+   *
+   * \return the connection, or NULL if its socket cannot be opened
+   */
+  Connection* OpenConnection (const InetSocketAddress &address, uint32_t stripe, uint64_t &key);
+
+  /**
+   * \return the bytes of a connection which are not written, or not
+   * acknowledged by the peer
+   */
+  uint64_t GetOutstanding (const Connection &connection) const;
+
+  /**
+   * \brief Account the busy time of a connection
+   *
+   * \param key the key of the connection
+   * \param busy true if the connection has outstanding bytes
+   */
+  void SetBusy (uint64_t key, bool busy);
+
+  /**
+   * \brief Account a bundle written into a connection
+   */
+  void CountBundle (uint64_t key, Ptr<Packet> bundle);
+
+  /**
+   * \brief Append a bundle to the backlog of its connection and write it
+   *
+   * \param src the source endpoint id
+   * \param bundle the bundle
+   * \param key set to the key of the connection
+   *
+   * \return false if there is no route for the destination endpoint id of the bundle
+   */
+  bool QueueBundle (const BpEndpointId &src, Ptr<Packet> bundle, uint64_t &key);
+
+  /**
+   * \brief Append a bundle to the backlog of a connection and write it
+   *
+   * \param key the key of the connection
+   * \param bundle the bundle
+   */
+  void AppendBundle (uint64_t key, Ptr<Packet> bundle);
+
+  /**
+   * \brief Hold a bundle to a next hop out of contact
+   *
+   * A bundle to a next hop with contacts in the plan is sent right away
+   * only during a contact, after the bundles held before it, and if it fits
+   * the volume left in the contact. A held bundle stays in the storage of
+   * the bundle protocol, so it is accounted by the storage quotas and
+   * dropped when its lifetime is over.
+   *
+   * \return true if the bundle is held for a later contact
+   */
+  bool HoldBundle (Ipv4Address nextHop, Ptr<BpStoredBundle> record);
+
+  /**
+   * \brief Schedule the start of the next contact with a next hop which has held bundles
+   *
+   * The held bundles are dropped, and reported by the BundleExpired trace
+   * source, if there is no later contact with the next hop.
+   */
+  void ScheduleContact (Ipv4Address nextHop);
+
+  /**
+   * \brief Start event of a contact: send the held bundles
+   */
+  void ContactStart (Ipv4Address nextHop);
+
+  /**
+   * \brief Send the held bundles of a next hop while they fit the volume
+   * left in the contact in progress
+   */
+  void DrainContact (Ipv4Address nextHop);
+
+  /**
+   * \brief End event of a contact: close the connections to the next hop
+   * and hold their bundles which are not delivered for the next contact
+   */
+  void ContactEnd (Ipv4Address nextHop);
+
+  void SetContactPlanFile (std::string fileName);
+  std::string GetContactPlanFile () const;
+
+  /**
+   * \brief Give the addresses of the node to the contact plan, so that the
+   * contacts of a network-wide plan sent from this node are its contacts
+   */
+  void SetLocalAddresses ();
+
+  /**
+   * \brief Dequeue the stored bundles of all source endpoint ids into the connections
+   *
+   * The bundles are dequeued in the class of service order of the bundle
+   * scheduler, until a bundle waits for the transmission buffer space of its
+   * connection; the dequeuing is resumed when the connection has space again,
+   * so an expedited bundle stored meanwhile overtakes the bulk bundles of
+   * the other source endpoint ids.
+   */
+  void PullBundles ();
+
+  /**
+   * \brief Write the backlog of a connection into its socket
+   *
+   * The bundles are written while the socket has transmission buffer space.
+   * A bundle larger than the space is written partially, and the rest is
+   * written when the Sent callback reports free space again. With
+   * aggregation, the bundles are written in units of up to AggregationSize
+   * bytes, and a smaller backlog waits for the flush timer. Once the backlog
+   * is empty, or only waits for more bundles, the stored bundles waiting
+   * for this connection are dequeued again.
+   *
+   * \param key the key of the connection
+   */
+  void SendBundles (uint64_t key);
+
+  /**
+   * \brief Flush timer of a connection, writes the backlog smaller than an aggregation unit
+   *
+   * \param key the key of the connection
+   */
+  void FlushTimeout (uint64_t key);
+
+  /**
+   * \brief Open the socket of a connection, or park the connection until a socket is free
+   *
+   * \param key the key of the connection
+   */
+  void Connect (uint64_t key);
+
+  /**
+   * \brief Close the least recently used idle connection
+   *
+   * \param exclude the key of a connection which is not closed
+   *
+   * \return false if there is no idle connection
+   */
+  bool CloseIdleConnection (uint64_t exclude);
+
+  /**
+   * \brief Close the socket of a connection and remove the connection
+   *
+   * \param key the key of the connection
+   */
+  void CloseConnection (uint64_t key);
+
+  /**
+   * \brief Open the parked connections while there are free sockets
+   */
+  void OpenParkedConnections ();
+
+  /**
+   * \brief Idle timeout of a connection
+   *
+   * \param key the key of the connection
+   */
+  void IdleTimeout (uint64_t key);
+
+  /**
+   * \brief Handle a sender socket which failed to connect or was closed
+   *
+   * \param socket the socket
+   */
+  void ConnectionLost (Ptr<Socket> socket);
+
+  /**
+   * \brief Schedule the reconnection of a connection without socket, or remove it
+   *
+   * \param key the key of the connection
+   */
+  void Retry (uint64_t key);
+
+  /**
+   * \brief Reconnection event of a connection
+   *
+   * \param key the key of the connection
+   */
+  void Reconnect (uint64_t key);
+
+  /**
+   * \return true if a connection has nothing to send nor to be acknowledged
+   */
+  bool IsIdle (const Connection &connection) const;
+
+  /**
+   * \brief Create the TCPCL session of a socket and start it
+   *
+   * \param socket the socket
+   * \param active true for a sender socket
+   */
+  Ptr<BpTcpclSession> CreateSession (Ptr<Socket> socket, bool active);
+
+  /**
+   * \return the TCPCL session of a socket, or NULL
+   */
+  Ptr<BpTcpclSession> FindSession (Ptr<Socket> socket) const;
+
+  /**
+   * \brief Remove and close the TCPCL session of a socket
+   *
+   * \return the session, or NULL
+   */
+  Ptr<BpTcpclSession> RemoveSession (Ptr<Socket> socket);
+
+  /**
+   * \brief Parse event of a socket: hand the bundles completed by the last
+   * burst of received segments to the bundle protocol
+   *
+   * \param socket the socket
+   */
+  void ParseBundles (Ptr<Socket> socket);
+
+  /**
+   * \brief Hand the complete bundles of a closed socket to the bundle
+   * protocol and drop its receive context
+   *
+   * \param socket the socket
+   */
+  void CloseRecvContext (Ptr<Socket> socket);
+
+  /**
+   * \brief Keep the partially received transfer of a lost receiver session
+   */
+  void RetainIncoming (Ptr<BpTcpclSession> session);
+
+  /**
+   *  Callbacks of the TCPCL sessions
+   */
+  int SessionSend (Ptr<BpTcpclSession> session, Ptr<Packet> packet);
+  uint32_t SessionTxAvailable (Ptr<BpTcpclSession> session);
+  void SessionReceive (Ptr<BpTcpclSession> session, Ptr<Packet> bundle);
+  void SessionEstablished (Ptr<BpTcpclSession> session);
+  void SessionAcked (Ptr<BpTcpclSession> session);
+  void SessionClosed (Ptr<BpTcpclSession> session);
+
 private:
   Ptr<BundleProtocol> m_bp;                             /// bundle protocol
-  std::map<BpEndpointId, Ptr<Socket> > m_l4SendSockets; /// the transport layer sender sockets
-  std::map<BpEndpointId, Ptr<Socket> > m_l4RecvSockets; /// the transport layer receiver sockets
+  BpEndpointMap<Ptr<Socket> > m_l4RecvSockets; /// the transport layer receiver sockets
+
+  ConnectionMap m_connections;                   /// the pooled sender connections, by next hop address
+  std::map<Ptr<Socket>, uint64_t> m_socketKeys;  /// the connection of each sender socket
+  std::deque<uint64_t> m_parked;                 /// connections waiting for a free socket
+  uint32_t m_sockets;                            /// number of sender sockets
+
+  uint32_t m_maxConnections;     /// maximum number of sender sockets
+  Time m_idleTimeout;            /// idle time after which a connection is closed
+  Time m_reconnectDelay;         /// delay before the first reconnection, the delay grows linearly
+  uint32_t m_maxReconnects;      /// reconnections before the bundles of a connection are dropped
+  uint32_t m_stripes;            /// connections to each next hop
+  uint32_t m_aggregationSize;    /// bytes of raw bundles written by one socket send, 0 if the bundles are not aggregated
+  Time m_aggregationDelay;       /// time a backlog waits for a full aggregation unit
+  std::map<uint64_t, StripeStats> m_stripeStats;  /// utilization of the connections, by key
+
+  bool m_tcpcl;                  /// run a TCPCL session on each connection
+  uint64_t m_segmentMru;         /// largest TCPCL segment
+  uint64_t m_transferMru;        /// largest received TCPCL transfer
+  uint32_t m_sessionWindow;      /// TCPCL segments sent without acknowledgement
+  Time m_keepaliveInterval;      /// proposed TCPCL keepalive interval
+  uint64_t m_transferId;         /// id of the next TCPCL transfer
+  std::map<Ptr<Socket>, Ptr<BpTcpclSession> > m_sessions;        /// the TCPCL sessions of the sender and receiver sockets
+  std::map<std::string, BpTcpclSession::Transfer> m_retained;    /// partially received transfers of the lost sessions, by peer node id
+  std::map<Ptr<Socket>, RecvContext> m_recvContexts;             /// the receive state of each socket carrying raw bundles
+
+  BpContactPlan m_contactPlan;                         /// the contacts with the next hops
+  std::string m_contactPlanFile;                       /// the file the contact plan is loaded from
+  std::map<Ipv4Address, ContactQueue> m_contactQueues; /// the bundles held for the contacts, by next hop
 
   Ptr<BpRoutingProtocol> m_bpRouting;                   /// bundle routing protocol
 };
@@ -0,0 +1,970 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "bp-tcpcl-session.h"
+#include <algorithm>
+#include <cstring>
+
+NS_LOG_COMPONENT_DEFINE ("BpTcpclSession");
+
+// contact header: magic "dtn!", version, flags
+#define TCPCL_VERSION 4
+#define TCPCL_CONTACT_HEADER_SIZE 6
+
+// fixed part of SESS_INIT: type, keepalive, segment mru, transfer mru, node id length
+#define TCPCL_SESS_INIT_SIZE 21
+
+// a message header larger than this is a protocol error
+#define TCPCL_MAX_HEADER_SIZE 0x30000
+
+// extension items
+#define TCPCL_EXTENSION_CRITICAL 0x01
+#define TCPCL_EXTENSION_ITEM_SIZE 5
+#define TCPCL_TRANSFER_LENGTH 0x0001
+#define TCPCL_TRANSFER_RESUME 0x8001     // private use: offset of the resumed transfer
+
+#define TCPCL_TERM_REPLY 0x01
+#define TCPCL_REJECT_TYPE_UNKNOWN 0x01
+#define TCPCL_REJECT_UNEXPECTED 0x03
+
+namespace ns3 {
+
+static const uint8_t g_tcpclMagic[4] = { 'd', 't', 'n', '!' };
+
+static void
+PutU16 (std::vector<uint8_t> &buf, uint16_t value)
+{
+  buf.push_back ((uint8_t)(value >> 8));
+  buf.push_back ((uint8_t)value);
+}
+
+static void
+PutU32 (std::vector<uint8_t> &buf, uint32_t value)
+{
+  PutU16 (buf, (uint16_t)(value >> 16));
+  PutU16 (buf, (uint16_t)value);
+}
+
+static void
+PutU64 (std::vector<uint8_t> &buf, uint64_t value)
+{
+  PutU32 (buf, (uint32_t)(value >> 32));
+  PutU32 (buf, (uint32_t)value);
+}
+
+static uint16_t
+GetU16 (const uint8_t *p)
+{
+  return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t
+GetU32 (const uint8_t *p)
+{
+  return ((uint32_t)GetU16 (p) << 16) | GetU16 (p + 2);
+}
+
+static uint64_t
+GetU64 (const uint8_t *p)
+{
+  return ((uint64_t)GetU32 (p) << 32) | GetU32 (p + 4);
+}
+
+BpTcpclSession::BpTcpclSession (bool active, const std::string &nodeId)
+  : m_active (active),
+    m_nodeId (nodeId),
+    m_segmentMru (65536),
+    m_transferMru (0xFFFFFFFF),
+    m_localKeepalive (0),
+    m_window (8),
+    m_socket (0),
+    m_state (CONTACT_WAIT),
+    m_termSent (false),
+    m_keepalive (0),
+    m_segmentSize (0),
+    m_peerTransferMru (0),
+    m_inFlight (0),
+    m_rxDataLeft (0),
+    m_rxSegment (0),
+    m_rxFlags (0),
+    m_rxSkip (false),
+    m_rxRefused (0),
+    m_rxHasRefused (false)
+{
+  NS_LOG_FUNCTION (this << " " << active << " " << nodeId);
+}
+
+BpTcpclSession::~BpTcpclSession ()
+{
+  NS_LOG_FUNCTION (this);
+  m_keepaliveEvent.Cancel ();
+}
+
+void
+BpTcpclSession::SetSegmentMru (uint64_t mru)
+{
+  NS_LOG_FUNCTION (this << " " << mru);
+  m_segmentMru = std::max<uint64_t> (mru, 1);
+}
+
+void
+BpTcpclSession::SetTransferMru (uint64_t mru)
+{
+  NS_LOG_FUNCTION (this << " " << mru);
+  m_transferMru = mru;
+}
+
+void
+BpTcpclSession::SetKeepalive (uint16_t seconds)
+{
+  NS_LOG_FUNCTION (this << " " << seconds);
+  m_localKeepalive = seconds;
+}
+
+void
+BpTcpclSession::SetWindow (uint32_t segments)
+{
+  NS_LOG_FUNCTION (this << " " << segments);
+  m_window = std::max<uint32_t> (segments, 1);
+}
+
+void
+BpTcpclSession::SetSocket (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << " " << socket);
+  m_socket = socket;
+}
+
+Ptr<Socket>
+BpTcpclSession::GetSocket () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_socket;
+}
+
+void
+BpTcpclSession::SetSendCallback (Callback<int, Ptr<BpTcpclSession>, Ptr<Packet> > callback)
+{
+  NS_LOG_FUNCTION (this);
+  m_send = callback;
+}
+
+void
+BpTcpclSession::SetTxAvailableCallback (Callback<uint32_t, Ptr<BpTcpclSession> > callback)
+{
+  NS_LOG_FUNCTION (this);
+  m_txAvailable = callback;
+}
+
+void
+BpTcpclSession::SetReceiveCallback (Callback<void, Ptr<BpTcpclSession>, Ptr<Packet> > callback)
+{
+  NS_LOG_FUNCTION (this);
+  m_receive = callback;
+}
+
+void
+BpTcpclSession::SetEstablishedCallback (Callback<void, Ptr<BpTcpclSession> > callback)
+{
+  NS_LOG_FUNCTION (this);
+  m_established = callback;
+}
+
+void
+BpTcpclSession::SetAckCallback (Callback<void, Ptr<BpTcpclSession> > callback)
+{
+  NS_LOG_FUNCTION (this);
+  m_ack = callback;
+}
+
+void
+BpTcpclSession::SetClosedCallback (Callback<void, Ptr<BpTcpclSession> > callback)
+{
+  NS_LOG_FUNCTION (this);
+  m_closed = callback;
+}
+
+void
+BpTcpclSession::Start ()
+{
+  NS_LOG_FUNCTION (this);
+  m_lastReceived = Simulator::Now ();
+  if (m_active)
+    SendContactHeader ();
+}
+
+void
+BpTcpclSession::Receive (Ptr<Packet> data)
+{
+  NS_LOG_FUNCTION (this << " " << data->GetSize ());
+  // the owner may drop the session in a callback
+  Ptr<BpTcpclSession> self = this;
+  if (m_state == CLOSED)
+    return;
+
+  m_lastReceived = Simulator::Now ();
+  uint32_t size = data->GetSize ();
+  uint32_t pos = 0;
+  while (pos < size && m_state != CLOSED)
+    {
+      if (m_rxDataLeft > 0)
+        {
+          // the segment data keeps referencing the received packet
+          uint32_t n = (uint32_t) std::min<uint64_t> (m_rxDataLeft, size - pos);
+          if (!m_rxSkip)
+            m_rxTransfer.bundle->AddAtEnd (data->CreateFragment (pos, n));
+          pos += n;
+          m_rxDataLeft -= n;
+          if (m_rxDataLeft == 0)
+            SegmentReceived ();
+          continue;
+        }
+
+      uint64_t headerSize = GetHeaderSize ();
+      if (headerSize > TCPCL_MAX_HEADER_SIZE)
+        {
+          NS_LOG_WARN ("BpTcpclSession::Receive (): message header of " << headerSize << " bytes");
+          Terminate (TERM_RESOURCE_EXHAUSTION);
+          Closed ();
+          return;
+        }
+
+      uint32_t n = (uint32_t) std::min<uint64_t> (headerSize - m_rxHeader.size (), size - pos);
+      uint32_t start = m_rxHeader.size ();
+      m_rxHeader.resize (start + n);
+      data->CreateFragment (pos, n)->CopyData (&m_rxHeader[start], n);
+      pos += n;
+
+      if (m_rxHeader.size () == GetHeaderSize ())
+        {
+          ProcessHeader ();
+          m_rxHeader.clear ();
+        }
+    }
+}
+
+uint64_t
+BpTcpclSession::GetHeaderSize () const
+{
+  if (m_state == CONTACT_WAIT)
+    return TCPCL_CONTACT_HEADER_SIZE;
+
+  if (m_rxHeader.empty ())
+    return 1;
+
+  const std::vector<uint8_t> &h = m_rxHeader;
+  uint64_t size;
+  switch (h[0])
+    {
+    case SESS_INIT:
+      size = TCPCL_SESS_INIT_SIZE;
+      if (h.size () < size)
+        return size;
+      size += GetU16 (&h[19]) + 4;
+      if (h.size () < size)
+        return size;
+      return size + GetU32 (&h[size - 4]);
+    case XFER_SEGMENT:
+      size = 10;
+      if (h.size () < size || !(h[1] & FLAG_START))
+        return size + 8;
+      size += 4;
+      if (h.size () < size)
+        return size;
+      return size + GetU32 (&h[size - 4]) + 8;
+    case XFER_ACK:
+      return 18;
+    case XFER_REFUSE:
+      return 10;
+    case SESS_TERM:
+    case MSG_REJECT:
+      return 3;
+    default:
+      return 1;
+    }
+}
+
+void
+BpTcpclSession::ProcessHeader ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_state == CONTACT_WAIT)
+    {
+      ProcessContactHeader ();
+      return;
+    }
+
+  uint8_t type = m_rxHeader[0];
+  if (type != SESS_INIT && type != SESS_TERM && type != MSG_REJECT && m_state == INIT_WAIT)
+    {
+      NS_LOG_WARN ("BpTcpclSession::ProcessHeader (): message " << (uint32_t) type << " before SESS_INIT");
+      Terminate (TERM_CONTACT_FAILURE);
+      Closed ();
+      return;
+    }
+
+  switch (type)
+    {
+    case SESS_INIT:
+      ProcessSessionInit ();
+      break;
+    case XFER_SEGMENT:
+      ProcessSegment ();
+      break;
+    case XFER_ACK:
+      ProcessAck ();
+      break;
+    case XFER_REFUSE:
+      ProcessRefuse ();
+      break;
+    case KEEPALIVE:
+      break;
+    case SESS_TERM:
+      ProcessTerm ();
+      break;
+    case MSG_REJECT:
+      NS_LOG_WARN ("BpTcpclSession::ProcessHeader (): message " << (uint32_t) m_rxHeader[2] <<
+                   " rejected, reason " << (uint32_t) m_rxHeader[1]);
+      break;
+    default:
+      {
+        // the length of an unknown message is unknown, the stream cannot be parsed any more
+        std::vector<uint8_t> message;
+        message.push_back (MSG_REJECT);
+        message.push_back (TCPCL_REJECT_TYPE_UNKNOWN);
+        message.push_back (type);
+        SendControl (message);
+        Terminate (TERM_UNKNOWN);
+        Closed ();
+      }
+      break;
+    }
+}
+
+void
+BpTcpclSession::ProcessContactHeader ()
+{
+  NS_LOG_FUNCTION (this);
+  if (std::memcmp (&m_rxHeader[0], g_tcpclMagic, sizeof (g_tcpclMagic)) != 0 || m_rxHeader[4] != TCPCL_VERSION)
+    {
+      NS_LOG_WARN ("BpTcpclSession::ProcessContactHeader (): not a TCPCLv4 contact header");
+      Closed ();
+      return;
+    }
+
+  if (!m_active)
+    SendContactHeader ();
+
+  m_state = INIT_WAIT;
+  SendSessionInit ();
+}
+
+void
+BpTcpclSession::ProcessSessionInit ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_state != INIT_WAIT)
+    {
+      std::vector<uint8_t> message;
+      message.push_back (MSG_REJECT);
+      message.push_back (TCPCL_REJECT_UNEXPECTED);
+      message.push_back (SESS_INIT);
+      SendControl (message);
+      return;
+    }
+
+  const uint8_t *h = &m_rxHeader[0];
+  uint16_t keepalive = GetU16 (h + 1);
+  uint64_t segmentMru = GetU64 (h + 3);
+  uint16_t nodeIdLength = GetU16 (h + 19);
+  m_peerTransferMru = GetU64 (h + 11);
+  m_peerNodeId.assign ((const char *)(h + TCPCL_SESS_INIT_SIZE), nodeIdLength);
+
+  // the session extension items are not used, a critical one fails the session
+  uint32_t pos = TCPCL_SESS_INIT_SIZE + nodeIdLength + 4;
+  while (pos + TCPCL_EXTENSION_ITEM_SIZE <= m_rxHeader.size ())
+    {
+      if (h[pos] & TCPCL_EXTENSION_CRITICAL)
+        {
+          NS_LOG_WARN ("BpTcpclSession::ProcessSessionInit (): unknown critical session extension " << GetU16 (h + pos + 1));
+          Terminate (TERM_CONTACT_FAILURE);
+          Closed ();
+          return;
+        }
+      pos += TCPCL_EXTENSION_ITEM_SIZE + GetU16 (h + pos + 3);
+    }
+
+  m_keepalive = std::min (keepalive, m_localKeepalive);
+  m_segmentSize = std::max<uint64_t> (std::min (segmentMru, m_segmentMru), 1);
+  m_state = ESTABLISHED;
+  NS_LOG_DEBUG ("Session established:" << " peer " << m_peerNodeId << " keepalive " << m_keepalive <<
+                " segment size " << m_segmentSize);
+
+  if (m_keepalive > 0)
+    m_keepaliveEvent = Simulator::Schedule (Seconds (m_keepalive / 2.0), &BpTcpclSession::Keepalive, this);
+
+  if (!m_established.IsNull ())
+    m_established (this);
+
+  Flush ();
+}
+
+void
+BpTcpclSession::ProcessSegment ()
+{
+  NS_LOG_FUNCTION (this);
+  const uint8_t *h = &m_rxHeader[0];
+  uint8_t flags = h[1];
+  uint64_t id = GetU64 (h + 2);
+  m_rxFlags = flags;
+  m_rxSegment = GetU64 (h + m_rxHeader.size () - 8);
+  m_rxDataLeft = m_rxSegment;
+  m_rxSkip = false;
+
+  if (flags & FLAG_START)
+    {
+      if (m_rxTransfer.bundle)
+        NS_LOG_WARN ("BpTcpclSession::ProcessSegment (): transfer " << m_rxTransfer.id << " is not complete");
+
+      m_rxTransfer = Transfer ();
+      m_rxTransfer.id = id;
+      m_rxTransfer.bundle = Create<Packet> ();
+
+      uint64_t total = 0;
+      uint64_t resume = 0;
+      bool hasResume = false;
+      bool unknown = false;
+      uint32_t pos = 14;
+      uint32_t end = m_rxHeader.size () - 8;
+      while (pos + TCPCL_EXTENSION_ITEM_SIZE <= end)
+        {
+          uint16_t type = GetU16 (h + pos + 1);
+          uint16_t length = GetU16 (h + pos + 3);
+          const uint8_t *value = h + pos + TCPCL_EXTENSION_ITEM_SIZE;
+          if (type == TCPCL_TRANSFER_LENGTH && length == 8)
+            total = GetU64 (value);
+          else if (type == TCPCL_TRANSFER_RESUME && length == 8)
+            {
+              hasResume = true;
+              resume = GetU64 (value);
+            }
+          else if (h[pos] & TCPCL_EXTENSION_CRITICAL)
+            unknown = true;
+          pos += TCPCL_EXTENSION_ITEM_SIZE + length;
+        }
+
+      if (unknown)
+        {
+          Refuse (REFUSE_EXTENSION_FAILURE, id);
+          return;
+        }
+
+      if (total > m_transferMru)
+        {
+          Refuse (REFUSE_NO_RESOURCES, id);
+          return;
+        }
+
+      if (hasResume)
+        {
+          // continue the transfer of the previous session, whose bytes after
+          // the acknowledged length may have been received or not
+          if (!m_retained.bundle || m_retained.id != id || m_retained.length < resume)
+            {
+              Refuse (REFUSE_RETRANSMIT, id);
+              return;
+            }
+
+          m_rxTransfer.bundle = m_retained.bundle->CreateFragment (0, resume);
+          m_rxTransfer.length = resume;
+          NS_LOG_DEBUG ("Resume transfer " << id << " at " << resume);
+        }
+      m_retained = Transfer ();
+    }
+  else if (!m_rxTransfer.bundle || m_rxTransfer.id != id)
+    {
+      m_rxSkip = true;
+      if (!m_rxHasRefused || m_rxRefused != id)
+        {
+          std::vector<uint8_t> message;
+          message.push_back (MSG_REJECT);
+          message.push_back (TCPCL_REJECT_UNEXPECTED);
+          message.push_back (XFER_SEGMENT);
+          SendControl (message);
+        }
+      if (m_rxDataLeft == 0)
+        m_rxSkip = false;
+      return;
+    }
+
+  if (m_rxTransfer.length + m_rxSegment > m_transferMru)
+    {
+      Refuse (REFUSE_NO_RESOURCES, id);
+      return;
+    }
+
+  if (m_rxDataLeft == 0)
+    SegmentReceived ();
+}
+
+void
+BpTcpclSession::Refuse (uint8_t reason, uint64_t id)
+{
+  NS_LOG_FUNCTION (this << " " << (uint32_t) reason << " " << id);
+  std::vector<uint8_t> message;
+  message.push_back (XFER_REFUSE);
+  message.push_back (reason);
+  PutU64 (message, id);
+  SendControl (message);
+
+  m_rxTransfer = Transfer ();
+  m_rxRefused = id;
+  m_rxHasRefused = true;
+  m_rxSkip = m_rxDataLeft > 0;
+}
+
+void
+BpTcpclSession::SegmentReceived ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_rxSkip)
+    {
+      m_rxSkip = false;
+      return;
+    }
+
+  m_rxTransfer.length += m_rxSegment;
+
+  std::vector<uint8_t> message;
+  message.push_back (XFER_ACK);
+  message.push_back (m_rxFlags);
+  PutU64 (message, m_rxTransfer.id);
+  PutU64 (message, m_rxTransfer.length);
+  SendControl (message);
+
+  if (!(m_rxFlags & FLAG_END))
+    return;
+
+  Ptr<Packet> bundle = m_rxTransfer.bundle;
+  NS_LOG_DEBUG ("Transfer " << m_rxTransfer.id << " received, " << bundle->GetSize () << " bytes");
+  m_rxTransfer = Transfer ();
+  if (!m_receive.IsNull ())
+    m_receive (this, bundle);
+}
+
+void
+BpTcpclSession::ProcessAck ()
+{
+  NS_LOG_FUNCTION (this);
+  const uint8_t *h = &m_rxHeader[0];
+  uint64_t id = GetU64 (h + 2);
+  uint64_t length = GetU64 (h + 10);
+
+  std::deque<OutTransfer>::iterator it;
+  for (it = m_outgoing.begin (); it != m_outgoing.end () && it->id != id; ++it)
+    ;
+  if (it == m_outgoing.end () || it->inFlight == 0)
+    {
+      NS_LOG_DEBUG ("BpTcpclSession::ProcessAck (): unexpected ack of transfer " << id);
+      return;
+    }
+
+  it->inFlight--;
+  m_inFlight--;
+  it->acked = std::max (it->acked, std::min<uint64_t> (length, it->sent));
+  if (it->acked == it->bundle->GetSize ())
+    {
+      NS_LOG_DEBUG ("Transfer " << id << " acknowledged");
+      m_inFlight -= it->inFlight;
+      m_outgoing.erase (it);
+      if (!m_ack.IsNull ())
+        m_ack (this);
+    }
+
+  Flush ();
+}
+
+void
+BpTcpclSession::ProcessRefuse ()
+{
+  NS_LOG_FUNCTION (this);
+  uint8_t reason = m_rxHeader[1];
+  uint64_t id = GetU64 (&m_rxHeader[2]);
+
+  std::deque<OutTransfer>::iterator it;
+  for (it = m_outgoing.begin (); it != m_outgoing.end () && it->id != id; ++it)
+    ;
+  if (it == m_outgoing.end ())
+    return;
+
+  OutTransfer transfer = *it;
+  m_inFlight -= transfer.inFlight;
+  m_outgoing.erase (it);
+
+  if (transfer.resume > 0 && (reason == REFUSE_RETRANSMIT || reason == REFUSE_EXTENSION_FAILURE))
+    {
+      // the peer cannot resume it, the whole bundle is sent again after the
+      // transfers already started
+      NS_LOG_DEBUG ("Transfer " << id << " is sent again from its first byte");
+      transfer.sent = transfer.acked = transfer.resume = 0;
+      transfer.inFlight = 0;
+      transfer.started = false;
+      std::deque<OutTransfer>::iterator pos = m_outgoing.begin ();
+      while (pos != m_outgoing.end () && pos->started)
+        ++pos;
+      m_outgoing.insert (pos, transfer);
+    }
+  else
+    {
+      if (reason != REFUSE_COMPLETED)
+        NS_LOG_WARN ("BpTcpclSession::ProcessRefuse (): transfer " << id << " refused, reason " << (uint32_t) reason);
+      if (!m_ack.IsNull ())
+        m_ack (this);
+    }
+
+  Flush ();
+}
+
+void
+BpTcpclSession::ProcessTerm ()
+{
+  NS_LOG_FUNCTION (this);
+  uint8_t flags = m_rxHeader[1];
+  uint8_t reason = m_rxHeader[2];
+  NS_LOG_DEBUG ("SESS_TERM received:" << " flags " << (uint32_t) flags << " reason " << (uint32_t) reason);
+  if (!m_termSent)
+    {
+      std::vector<uint8_t> message;
+      message.push_back (SESS_TERM);
+      message.push_back (TCPCL_TERM_REPLY);
+      message.push_back (reason);
+      SendControl (message);
+      m_termSent = true;
+    }
+
+  Closed ();
+}
+
+void
+BpTcpclSession::SendControl (const std::vector<uint8_t> &message)
+{
+  NS_LOG_FUNCTION (this << " " << (uint32_t) message[0]);
+  m_control.push_back (Create<Packet> (&message[0], message.size ()));
+  Flush ();
+}
+
+void
+BpTcpclSession::SendContactHeader ()
+{
+  NS_LOG_FUNCTION (this);
+  std::vector<uint8_t> message (g_tcpclMagic, g_tcpclMagic + sizeof (g_tcpclMagic));
+  message.push_back (TCPCL_VERSION);
+  message.push_back (0);      // TLS is not supported
+  SendControl (message);
+}
+
+void
+BpTcpclSession::SendSessionInit ()
+{
+  NS_LOG_FUNCTION (this);
+  uint16_t nodeIdLength = (uint16_t) std::min<size_t> (m_nodeId.size (), 0xFFFF);
+  std::vector<uint8_t> message;
+  message.push_back (SESS_INIT);
+  PutU16 (message, m_localKeepalive);
+  PutU64 (message, m_segmentMru);
+  PutU64 (message, m_transferMru);
+  PutU16 (message, nodeIdLength);
+  message.insert (message.end (), m_nodeId.begin (), m_nodeId.begin () + nodeIdLength);
+  PutU32 (message, 0);        // no session extension item
+  SendControl (message);
+}
+
+void
+BpTcpclSession::Send (Ptr<Packet> bundle, uint64_t id, uint64_t acked)
+{
+  NS_LOG_FUNCTION (this << " " << bundle << " " << id << " " << acked);
+  OutTransfer transfer;
+  transfer.id = id;
+  transfer.bundle = bundle;
+  transfer.sent = transfer.acked = transfer.resume = std::min<uint64_t> (acked, bundle->GetSize ());
+  m_outgoing.push_back (transfer);
+  Flush ();
+}
+
+BpTcpclSession::OutTransfer*
+BpTcpclSession::GetNextTransfer ()
+{
+  // the transfers are sent one after the other, their segments are never interleaved
+  for (std::deque<OutTransfer>::iterator it = m_outgoing.begin (); it != m_outgoing.end (); ++it)
+    {
+      if (!it->started || it->sent < it->bundle->GetSize ())
+        return &(*it);
+    }
+
+  return NULL;
+}
+
+uint32_t
+BpTcpclSession::GetTxAvailable ()
+{
+  if (m_txAvailable.IsNull ())
+    return 0xFFFFFFFF;
+
+  return m_txAvailable (this);
+}
+
+void
+BpTcpclSession::Flush ()
+{
+  NS_LOG_FUNCTION (this);
+  Ptr<BpTcpclSession> self = this;
+  if (m_state == CLOSED || m_send.IsNull ())
+    return;
+
+  while (!m_control.empty ())
+    {
+      Ptr<Packet> message = m_control.front ();
+      if (GetTxAvailable () < message->GetSize () || m_send (this, message) < 0)
+        return;     // resumed when the transmission buffer has space
+
+      m_control.pop_front ();
+      m_lastSent = Simulator::Now ();
+    }
+
+  if (m_state != ESTABLISHED)
+    return;
+
+  OutTransfer *transfer;
+  while (m_inFlight < m_window && (transfer = GetNextTransfer ()) != NULL)
+    {
+      uint64_t length = transfer->bundle->GetSize ();
+      bool start = !transfer->started;
+
+      std::vector<uint8_t> message;
+      message.push_back (XFER_SEGMENT);
+      message.push_back (0);
+      PutU64 (message, transfer->id);
+      if (start)
+        {
+          // the transfer length item, and the resume item of a resumed transfer
+          PutU32 (message, transfer->resume > 0 ? 2 * (TCPCL_EXTENSION_ITEM_SIZE + 8) : TCPCL_EXTENSION_ITEM_SIZE + 8);
+          message.push_back (0);
+          PutU16 (message, TCPCL_TRANSFER_LENGTH);
+          PutU16 (message, 8);
+          PutU64 (message, length);
+          if (transfer->resume > 0)
+            {
+              message.push_back (TCPCL_EXTENSION_CRITICAL);
+              PutU16 (message, TCPCL_TRANSFER_RESUME);
+              PutU16 (message, 8);
+              PutU64 (message, transfer->resume);
+            }
+        }
+
+      uint32_t available = GetTxAvailable ();
+      if (available <= message.size () + 8)
+        return;
+
+      uint64_t size = std::min (std::min (length - transfer->sent, m_segmentSize), (uint64_t)(available - message.size () - 8));
+      uint8_t flags = (start ? FLAG_START : 0) | (transfer->sent + size == length ? FLAG_END : 0);
+      message[1] = flags;
+      PutU64 (message, size);
+
+      // the stored bundle is never modified, the segment data is a fragment of it
+      Ptr<Packet> segment = Create<Packet> (&message[0], message.size ());
+      if (size == length)
+        segment->AddAtEnd (transfer->bundle);
+      else if (size > 0)
+        segment->AddAtEnd (transfer->bundle->CreateFragment (transfer->sent, size));
+
+      if (m_send (this, segment) < 0)
+        return;
+
+      transfer->started = true;
+      transfer->sent += size;
+      transfer->inFlight++;
+      m_inFlight++;
+      m_lastSent = Simulator::Now ();
+    }
+}
+
+void
+BpTcpclSession::Keepalive ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_state == CLOSED)
+    return;
+
+  Time interval = Seconds (m_keepalive);
+  if (Simulator::Now () - m_lastReceived > Seconds (2.0 * m_keepalive))
+    {
+      NS_LOG_DEBUG ("Session idle timeout:" << " peer " << m_peerNodeId);
+      Terminate (TERM_IDLE_TIMEOUT);
+      Closed ();
+      return;
+    }
+
+  if (Simulator::Now () - m_lastSent >= interval && m_control.empty ())
+    {
+      std::vector<uint8_t> message;
+      message.push_back (KEEPALIVE);
+      SendControl (message);
+    }
+
+  m_keepaliveEvent = Simulator::Schedule (Seconds (m_keepalive / 2.0), &BpTcpclSession::Keepalive, this);
+}
+
+void
+BpTcpclSession::Terminate (uint8_t reason)
+{
+  NS_LOG_FUNCTION (this << " " << (uint32_t) reason);
+  if (m_state == CLOSED || m_termSent)
+    return;
+
+  m_termSent = true;
+  if (m_state == ESTABLISHED)
+    m_state = ENDING;
+
+  // SESS_TERM is only sent after the contact headers
+  if (m_state == ENDING || m_state == INIT_WAIT)
+    {
+      std::vector<uint8_t> message;
+      message.push_back (SESS_TERM);
+      message.push_back (0);
+      message.push_back (reason);
+      SendControl (message);
+    }
+}
+
+void
+BpTcpclSession::Close ()
+{
+  NS_LOG_FUNCTION (this);
+  m_state = CLOSED;
+  m_keepaliveEvent.Cancel ();
+  m_control.clear ();
+}
+
+void
+BpTcpclSession::Closed ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_state == CLOSED)
+    return;
+
+  Ptr<BpTcpclSession> self = this;
+  Close ();
+  if (!m_closed.IsNull ())
+    m_closed (this);
+}
+
+std::vector<BpTcpclSession::Transfer>
+BpTcpclSession::TakeOutgoing ()
+{
+  NS_LOG_FUNCTION (this);
+  std::vector<Transfer> transfers;
+  for (std::deque<OutTransfer>::iterator it = m_outgoing.begin (); it != m_outgoing.end (); ++it)
+    {
+      Transfer transfer;
+      transfer.id = it->id;
+      transfer.bundle = it->bundle;
+      transfer.length = it->acked;
+      transfers.push_back (transfer);
+    }
+
+  m_outgoing.clear ();
+  m_inFlight = 0;
+  return transfers;
+}
+
+bool
+BpTcpclSession::TakeIncoming (Transfer &transfer)
+{
+  NS_LOG_FUNCTION (this);
+  if (!m_rxTransfer.bundle || m_rxTransfer.length == 0)
+    return false;
+
+  transfer = m_rxTransfer;
+  m_rxTransfer = Transfer ();
+  return true;
+}
+
+void
+BpTcpclSession::AdoptIncoming (const Transfer &transfer)
+{
+  NS_LOG_FUNCTION (this << " " << transfer.id << " " << transfer.length);
+  m_retained = transfer;
+}
+
+BpTcpclSession::State
+BpTcpclSession::GetState () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_state;
+}
+
+std::string
+BpTcpclSession::GetPeerNodeId () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_peerNodeId;
+}
+
+uint16_t
+BpTcpclSession::GetKeepalive () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_keepalive;
+}
+
+uint64_t
+BpTcpclSession::GetSegmentSize () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_segmentSize;
+}
+
+uint32_t
+BpTcpclSession::GetOutgoing () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_outgoing.size ();
+}
+
+uint64_t
+BpTcpclSession::GetOutgoingBytes () const
+{
+  NS_LOG_FUNCTION (this);
+  uint64_t bytes = 0;
+  for (std::deque<OutTransfer>::const_iterator it = m_outgoing.begin (); it != m_outgoing.end (); ++it)
+    bytes += it->bundle->GetSize () - it->acked;
+  return bytes;
+}
+
+uint32_t
+BpTcpclSession::GetInFlight () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_inFlight;
+}
+
+} // namespace ns3
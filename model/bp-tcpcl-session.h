@@ -0,0 +1,425 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+#ifndef BP_TCPCL_SESSION_H
+#define BP_TCPCL_SESSION_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include "ns3/ptr.h"
+#include "ns3/packet.h"
+#include "ns3/socket.h"
+#include "ns3/callback.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/simple-ref-count.h"
+
+namespace ns3 {
+
+/**
+ * \brief A session of the TCP convergence layer protocol version 4, RFC 9174
+ *
+ * The session exchanges the contact headers and the SESS_INIT messages, then
+ * sends each bundle as a transfer of XFER_SEGMENT messages of at most the
+ * negotiated segment size, the first one with the START flag and the last
+ * one with the END flag. The receiver acknowledges each segment with the
+ * XFER_ACK message of the cumulative length received, and at most Window
+ * segments are sent without acknowledgement. KEEPALIVE messages are sent
+ * when nothing was sent for the negotiated keepalive interval, and the
+ * session is terminated when nothing was received for twice that interval.
+ *
+ * A transfer is kept by the sender until its last byte is acknowledged. The
+ * owner of a lost session takes its transfers with TakeOutgoing and
+ * TakeIncoming, and hands them to the next session with the same peer: the
+ * sender restarts a transfer from its acknowledged length with a START
+ * segment carrying the private transfer extension item TRANSFER_RESUME, and
+ * a receiver which kept the first bytes of the transfer continues it, or
+ * refuses it with the Retransmit reason so that it is sent again whole.
+ *
+ * The session is independent of the transport layer: the messages are
+ * written with the send callback, and the received bytes are given to
+ * Receive in the order of the byte stream, in pieces of any size.
+ */
+class BpTcpclSession : public SimpleRefCount<BpTcpclSession>
+{
+public:
+  /**
+   * message types
+   */
+  typedef enum {
+    XFER_SEGMENT = 0x01,
+    XFER_ACK = 0x02,
+    XFER_REFUSE = 0x03,
+    KEEPALIVE = 0x04,
+    SESS_TERM = 0x05,
+    MSG_REJECT = 0x06,
+    SESS_INIT = 0x07
+  } MessageType;
+
+  /**
+   * flags of the XFER_SEGMENT and XFER_ACK messages
+   */
+  typedef enum {
+    FLAG_END = 0x01,
+    FLAG_START = 0x02
+  } SegmentFlag;
+
+  /**
+   * reason codes of the XFER_REFUSE message
+   */
+  typedef enum {
+    REFUSE_UNKNOWN = 0x00,
+    REFUSE_COMPLETED = 0x01,
+    REFUSE_NO_RESOURCES = 0x02,
+    REFUSE_RETRANSMIT = 0x03,
+    REFUSE_NOT_ACCEPTABLE = 0x04,
+    REFUSE_EXTENSION_FAILURE = 0x05,
+    REFUSE_SESSION_TERMINATING = 0x06
+  } RefuseReason;
+
+  /**
+   * reason codes of the SESS_TERM message
+   */
+  typedef enum {
+    TERM_UNKNOWN = 0x00,
+    TERM_IDLE_TIMEOUT = 0x01,
+    TERM_VERSION_MISMATCH = 0x02,
+    TERM_BUSY = 0x03,
+    TERM_CONTACT_FAILURE = 0x04,
+    TERM_RESOURCE_EXHAUSTION = 0x05
+  } TermReason;
+
+  /**
+   * states of the session
+   */
+  typedef enum {
+    CONTACT_WAIT = 0,    /// waiting for the contact header of the peer
+    INIT_WAIT,           /// waiting for the SESS_INIT of the peer
+    ESTABLISHED,         /// transfers are sent and received
+    ENDING,              /// SESS_TERM sent, no new transfer is started
+    CLOSED               /// nothing is sent or received
+  } State;
+
+  /**
+   * \brief a transfer handed from a lost session to the next one
+   */
+  struct Transfer
+  {
+    Transfer ()
+      : id (0),
+        length (0)
+    {
+    }
+
+    uint64_t id;           /// transfer id
+    Ptr<Packet> bundle;    /// the whole bundle of a sent transfer, the received bytes of a received transfer
+    uint64_t length;       /// the acknowledged bytes of a sent transfer, the received bytes of a received transfer
+  };
+
+  /**
+   * \param active true if this node opened the transport connection and
+   * sends its contact header first
+   * \param nodeId the node id sent in the SESS_INIT message
+   */
+  BpTcpclSession (bool active, const std::string &nodeId);
+  virtual ~BpTcpclSession ();
+
+  /**
+   * \param mru the largest segment received, which is also the largest
+   * segment sent
+   */
+  void SetSegmentMru (uint64_t mru);
+
+  /**
+   * \param mru the largest transfer received
+   */
+  void SetTransferMru (uint64_t mru);
+
+  /**
+   * \param seconds the proposed keepalive interval, 0 disables the keepalive
+   */
+  void SetKeepalive (uint16_t seconds);
+
+  /**
+   * \param segments the maximum number of segments sent without acknowledgement
+   */
+  void SetWindow (uint32_t segments);
+
+  /**
+   * \param socket the transport layer socket of the session, which is only
+   * kept for the owner of the session
+   */
+  void SetSocket (Ptr<Socket> socket);
+
+  /**
+   * \return the transport layer socket of the session
+   */
+  Ptr<Socket> GetSocket () const;
+
+  /**
+   * \param callback writes a message into the transport connection, returns
+   * -1 on error
+   */
+  void SetSendCallback (Callback<int, Ptr<BpTcpclSession>, Ptr<Packet> > callback);
+
+  /**
+   * \param callback returns the free space of the transmission buffer, the
+   * space is unlimited without callback
+   */
+  void SetTxAvailableCallback (Callback<uint32_t, Ptr<BpTcpclSession> > callback);
+
+  /**
+   * \param callback called with each received bundle
+   */
+  void SetReceiveCallback (Callback<void, Ptr<BpTcpclSession>, Ptr<Packet> > callback);
+
+  /**
+   * \param callback called when the SESS_INIT messages are exchanged
+   */
+  void SetEstablishedCallback (Callback<void, Ptr<BpTcpclSession> > callback);
+
+  /**
+   * \param callback called when the last byte of a sent transfer is acknowledged
+   */
+  void SetAckCallback (Callback<void, Ptr<BpTcpclSession> > callback);
+
+  /**
+   * \param callback called when the session ends by itself, after which the
+   * owner closes the transport connection
+   */
+  void SetClosedCallback (Callback<void, Ptr<BpTcpclSession> > callback);
+
+  /**
+   * \brief Start the session, the active node sends its contact header
+   */
+  void Start ();
+
+  /**
+   * \brief Parse the bytes received from the transport connection
+   *
+   * \param data the next bytes of the stream
+   */
+  void Receive (Ptr<Packet> data);
+
+  /**
+   * \brief Queue a bundle to be sent once the session is established
+   *
+   * \param bundle the bundle
+   * \param id the transfer id, unique for all the sessions of this node
+   * \param acked the bytes already acknowledged by the peer in a previous
+   * session, from which the transfer is resumed
+   */
+  void Send (Ptr<Packet> bundle, uint64_t id, uint64_t acked = 0);
+
+  /**
+   * \brief Write the pending messages and segments while the window and the
+   * transmission buffer allow
+   */
+  void Flush ();
+
+  /**
+   * \brief Send SESS_TERM, after which no new transfer is started
+   *
+   * \param reason the reason code
+   */
+  void Terminate (uint8_t reason);
+
+  /**
+   * \brief Stop the session without sending anything, no callback is called
+   */
+  void Close ();
+
+  /**
+   * \brief Remove the sent transfers which are not completely acknowledged
+   */
+  std::vector<Transfer> TakeOutgoing ();
+
+  /**
+   * \brief Remove the partially received transfer
+   *
+   * \return false if there is none
+   */
+  bool TakeIncoming (Transfer &transfer);
+
+  /**
+   * \brief Keep the partially received transfer of a previous session with
+   * the same peer, which the peer may resume
+   */
+  void AdoptIncoming (const Transfer &transfer);
+
+  /**
+   * \return the state of the session
+   */
+  State GetState () const;
+
+  /**
+   * \return the node id of the peer, empty before the SESS_INIT of the peer
+   */
+  std::string GetPeerNodeId () const;
+
+  /**
+   * \return the negotiated keepalive interval in seconds
+   */
+  uint16_t GetKeepalive () const;
+
+  /**
+   * \return the negotiated size of the sent segments
+   */
+  uint64_t GetSegmentSize () const;
+
+  /**
+   * \return the number of sent transfers which are not completely acknowledged
+   */
+  uint32_t GetOutgoing () const;
+
+  /**
+   * \return the bytes of the sent transfers which are not acknowledged yet
+   */
+  uint64_t GetOutgoingBytes () const;
+
+  /**
+   * \return the number of sent segments which are not acknowledged
+   */
+  uint32_t GetInFlight () const;
+
+private:
+  /**
+   * \brief a transfer being sent
+   */
+  struct OutTransfer
+  {
+    OutTransfer ()
+      : id (0),
+        sent (0),
+        acked (0),
+        resume (0),
+        inFlight (0),
+        started (false)
+    {
+    }
+
+    uint64_t id;           /// transfer id
+    Ptr<Packet> bundle;    /// the bundle
+    uint64_t sent;         /// bytes sent
+    uint64_t acked;        /// bytes acknowledged
+    uint64_t resume;       /// the offset of the START segment
+    uint32_t inFlight;     /// segments not acknowledged
+    bool started;          /// true once the START segment is sent
+  };
+
+  /**
+   * \return the size of the message header being received, as far as it is
+   * known from the bytes received so far
+   */
+  uint64_t GetHeaderSize () const;
+
+  /**
+   * \brief Handle a complete message header
+   */
+  void ProcessHeader ();
+  void ProcessContactHeader ();
+  void ProcessSessionInit ();
+  void ProcessSegment ();
+  void ProcessAck ();
+  void ProcessRefuse ();
+  void ProcessTerm ();
+
+  /**
+   * \brief Handle the end of the data of a received segment
+   */
+  void SegmentReceived ();
+
+  /**
+   * \brief Refuse the transfer being received and skip its segments
+   */
+  void Refuse (uint8_t reason, uint64_t id);
+
+  /**
+   * \brief Queue a message before the segments
+   */
+  void SendControl (const std::vector<uint8_t> &message);
+  void SendContactHeader ();
+  void SendSessionInit ();
+
+  /**
+   * \return the first transfer which is not completely sent, or NULL
+   */
+  OutTransfer* GetNextTransfer ();
+
+  /**
+   * \return the free space of the transmission buffer
+   */
+  uint32_t GetTxAvailable ();
+
+  /**
+   * \brief Keepalive timer
+   */
+  void Keepalive ();
+
+  /**
+   * \brief Close the session and notify the owner
+   */
+  void Closed ();
+
+  bool m_active;                      /// true if the contact header is sent first
+  std::string m_nodeId;               /// local node id
+  uint64_t m_segmentMru;              /// largest received segment
+  uint64_t m_transferMru;             /// largest received transfer
+  uint16_t m_localKeepalive;          /// proposed keepalive interval
+  uint32_t m_window;                  /// maximum segments in flight
+  Ptr<Socket> m_socket;               /// the socket of the owner
+
+  State m_state;                      /// session state
+  bool m_termSent;                    /// SESS_TERM is sent
+  std::string m_peerNodeId;           /// node id of the peer
+  uint16_t m_keepalive;               /// negotiated keepalive interval
+  uint64_t m_segmentSize;             /// negotiated size of the sent segments
+  uint64_t m_peerTransferMru;         /// largest transfer the peer receives
+
+  std::deque<Ptr<Packet> > m_control; /// messages waiting for transmission buffer space
+  std::deque<OutTransfer> m_outgoing; /// sent transfers not completely acknowledged, in order
+  uint32_t m_inFlight;                /// segments not acknowledged
+
+  std::vector<uint8_t> m_rxHeader;    /// the bytes of the message header being received
+  uint64_t m_rxDataLeft;              /// bytes left of the data of the segment being received
+  uint64_t m_rxSegment;               /// data length of the segment being received
+  uint8_t m_rxFlags;                  /// flags of the segment being received
+  bool m_rxSkip;                      /// the data of the segment being received is dropped
+  Transfer m_rxTransfer;              /// the transfer being received, its bundle is NULL if there is none
+  uint64_t m_rxRefused;               /// the id of the last refused transfer
+  bool m_rxHasRefused;                /// a transfer was refused
+  Transfer m_retained;                /// the partial transfer of the previous session, its bundle is NULL if there is none
+
+  Time m_lastSent;                    /// the last time a message was written
+  Time m_lastReceived;                /// the last time bytes were received
+  EventId m_keepaliveEvent;           /// keepalive timer
+
+  Callback<int, Ptr<BpTcpclSession>, Ptr<Packet> > m_send;        /// send callback
+  Callback<uint32_t, Ptr<BpTcpclSession> > m_txAvailable;         /// transmission buffer space callback
+  Callback<void, Ptr<BpTcpclSession>, Ptr<Packet> > m_receive;    /// received bundle callback
+  Callback<void, Ptr<BpTcpclSession> > m_established;             /// established callback
+  Callback<void, Ptr<BpTcpclSession> > m_ack;                     /// completed transfer callback
+  Callback<void, Ptr<BpTcpclSession> > m_closed;                  /// closed callback
+};
+
+} // namespace ns3
+
+#endif /* BP_TCPCL_SESSION_H */
@@ -0,0 +1,374 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+#ifndef BP_TIMING_WHEEL_H
+#define BP_TIMING_WHEEL_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/nstime.h"
+#include "ns3/simulator.h"
+#include "ns3/event-id.h"
+#include "ns3/callback.h"
+
+namespace ns3 {
+
+/**
+ * \brief A hierarchical timing wheel
+ *
+ * The wheel holds a large number of timers with a coarse granularity and
+ * drives all of them with a single simulator event per tick, which is only
+ * scheduled while the wheel holds timers. It has 4 levels of 64 slots: level l
+ * holds the timers expiring within 64^(l+1) ticks, and the slots of a level
+ * are moved down to the lower levels when the lower level wraps around.
+ * Timers farther than 64^4 ticks are parked in the top level and moved down
+ * again until they are due.
+ *
+ * Adding and cancelling a timer are O(1): the timers are nodes of doubly
+ * linked lists, one list per slot, stored in a vector and recycled.
+ *
+ * The expired timers are notified in the order of their slots, i.e., timers
+ * expiring in the same tick are notified in no particular order.
+ */
+template <typename T>
+class BpTimingWheel
+{
+public:
+  enum
+  {
+    NO_TIMER = 0xFFFFFFFF      /// timer id of no timer
+  };
+
+  BpTimingWheel ()
+    : m_granularity (Seconds (1)),
+      m_next (0),
+      m_free (NIL),
+      m_count (0)
+  {
+    m_heads.assign (LEVELS * SLOTS, NIL);
+  }
+
+  virtual ~BpTimingWheel ()
+  {
+    m_tickEvent.Cancel ();
+  }
+
+  /**
+   * \param granularity the duration of a tick; timers expire at the first
+   * tick at or after their expiration time
+   *
+   * The pending timers are moved to the ticks of the new granularity.
+   */
+  void SetGranularity (Time granularity)
+  {
+    if (granularity == m_granularity)
+      return;
+
+    m_granularity = granularity;
+    if (m_count == 0)
+      return;
+
+    // restart the wheel at the current simulation time and link the timers again
+    int64_t step = m_granularity.GetTimeStep ();
+    m_tickEvent.Cancel ();
+    m_next = (Simulator::Now ().GetTimeStep () + step - 1) / step;
+    m_heads.assign (LEVELS * SLOTS, NIL);
+    for (uint32_t id = 0; id < m_nodes.size (); id++)
+      {
+        if (m_nodes[id].slot == NIL)
+          continue;
+        m_nodes[id].expiration = GetTick (m_nodes[id].time);
+        Link (id);
+      }
+
+    ScheduleTick ();
+  }
+
+  /**
+   * \return the duration of a tick
+   */
+  Time GetGranularity () const
+  {
+    return m_granularity;
+  }
+
+  /**
+   * \param callback the function called with the value of each expired timer
+   */
+  void SetExpireCallback (Callback<void, T> callback)
+  {
+    m_expire = callback;
+  }
+
+  /**
+   * \brief Add a timer
+   *
+   * \param expiration the absolute simulation time of expiration
+   * \param value the value passed to the expire callback
+   *
+   * \return the id of the timer
+   */
+  uint32_t Add (Time expiration, const T &value)
+  {
+    if (m_count == 0)
+      {
+        // the wheel was idle, catch up with the simulation time
+        int64_t step = m_granularity.GetTimeStep ();
+        m_tickEvent.Cancel ();
+        m_next = (Simulator::Now ().GetTimeStep () + step - 1) / step;
+      }
+
+    uint32_t id = m_free;
+    if (id == NIL)
+      {
+        id = m_nodes.size ();
+        m_nodes.push_back (Node ());
+      }
+    else
+      m_free = m_nodes[id].next;
+
+    m_nodes[id].value = value;
+    m_nodes[id].time = expiration.GetTimeStep ();
+    m_nodes[id].expiration = GetTick (m_nodes[id].time);
+    Link (id);
+    m_count++;
+
+    if (!m_tickEvent.IsRunning ())
+      ScheduleTick ();
+
+    return id;
+  }
+
+  /**
+   * \brief Remove a timer before it expires
+   *
+   * \param id the id returned by Add ()
+   */
+  void Cancel (uint32_t id)
+  {
+    if (id == NO_TIMER || id >= m_nodes.size () || m_nodes[id].slot == NIL)
+      return;
+
+    Unlink (id);
+    Release (id);
+    m_count--;
+
+    if (m_count == 0)
+      m_tickEvent.Cancel ();
+  }
+
+  /**
+   * \return the number of timers
+   */
+  uint32_t GetSize () const
+  {
+    return m_count;
+  }
+
+  /**
+   * \brief Remove all timers, no callback is called
+   */
+  void Clear ()
+  {
+    m_tickEvent.Cancel ();
+    m_nodes.clear ();
+    m_heads.assign (LEVELS * SLOTS, NIL);
+    m_free = NIL;
+    m_count = 0;
+  }
+
+private:
+  enum
+  {
+    LEVELS = 4,           /// number of levels
+    SLOT_BITS = 6,        /// log2 of the number of slots per level
+    SLOTS = 64,           /// number of slots per level
+    NIL = 0xFFFFFFFF      /// end of list
+  };
+
+  /**
+   * \brief a timer
+   */
+  struct Node
+  {
+    Node ()
+      : time (0),
+        expiration (0),
+        prev (NIL),
+        next (NIL),
+        slot (NIL)
+    {
+    }
+
+    T value;              /// value passed to the expire callback
+    int64_t time;         /// expiration time in time steps
+    uint64_t expiration;  /// expiration tick
+    uint32_t prev;        /// previous timer in the slot
+    uint32_t next;        /// next timer in the slot, or next free node
+    uint32_t slot;        /// the slot holding the timer, or NIL if the node is free
+  };
+
+  /**
+   * \brief Round a time up to the next tick
+   *
+   * \param ts the time in time steps
+   * \return the tick
+   */
+  uint64_t GetTick (int64_t ts) const
+  {
+    int64_t step = m_granularity.GetTimeStep ();
+    return (ts <= 0) ? 0 : (uint64_t) ((ts + step - 1) / step);
+  }
+
+  /**
+   * \brief Insert a timer into the slot of its expiration tick
+   */
+  void Link (uint32_t id)
+  {
+    Node &node = m_nodes[id];
+    uint64_t tick = node.expiration;
+    if (tick < m_next)
+      tick = m_next;       // already due, expire at the next tick
+
+    uint64_t delta = tick - m_next;
+    uint32_t level = 0;
+    while (level < LEVELS - 1 && delta >= ((uint64_t) 1 << (SLOT_BITS * (level + 1))))
+      level++;
+
+    if (delta >= ((uint64_t) 1 << (SLOT_BITS * LEVELS)))
+      tick = m_next + ((uint64_t) 1 << (SLOT_BITS * LEVELS)) - 1;    // parked in the top level
+
+    uint32_t slot = level * SLOTS + ((tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+    node.slot = slot;
+    node.prev = NIL;
+    node.next = m_heads[slot];
+    if (node.next != NIL)
+      m_nodes[node.next].prev = id;
+    m_heads[slot] = id;
+  }
+
+  /**
+   * \brief Remove a timer from its slot
+   */
+  void Unlink (uint32_t id)
+  {
+    Node &node = m_nodes[id];
+    if (node.prev == NIL)
+      m_heads[node.slot] = node.next;
+    else
+      m_nodes[node.prev].next = node.next;
+
+    if (node.next != NIL)
+      m_nodes[node.next].prev = node.prev;
+
+    node.slot = NIL;
+  }
+
+  /**
+   * \brief Put a node into the free list
+   */
+  void Release (uint32_t id)
+  {
+    m_nodes[id].value = T ();
+    m_nodes[id].next = m_free;
+    m_free = id;
+  }
+
+  /**
+   * \brief Move the timers of a slot of level to the lower levels
+   *
+   * \return the index of the slot
+   */
+  uint32_t Cascade (uint32_t level, uint64_t tick)
+  {
+    uint32_t index = (tick >> (SLOT_BITS * level)) & (SLOTS - 1);
+    uint32_t id = m_heads[level * SLOTS + index];
+    m_heads[level * SLOTS + index] = NIL;
+    while (id != NIL)
+      {
+        uint32_t next = m_nodes[id].next;
+        Link (id);
+        id = next;
+      }
+
+    return index;
+  }
+
+  /**
+   * \brief Schedule the simulator event of the next tick
+   */
+  void ScheduleTick ()
+  {
+    int64_t step = m_granularity.GetTimeStep ();
+    Time delay = TimeStep (m_next * step) - Simulator::Now ();
+    if (delay.IsStrictlyPositive () == false)
+      delay = TimeStep (0);
+    m_tickEvent = Simulator::Schedule (delay, &BpTimingWheel<T>::Tick, this);
+  }
+
+  /**
+   * \brief Process the tick m_next: expire the due timers and advance the wheel
+   */
+  void Tick ()
+  {
+    // move the timers of the upper levels down when a level wraps around
+    for (uint32_t level = 1; level < LEVELS; level++)
+      {
+        if (((m_next >> (SLOT_BITS * (level - 1))) & (SLOTS - 1)) != 0)
+          break;
+        Cascade (level, m_next);
+      }
+
+    uint32_t slot = m_next & (SLOTS - 1);
+    while (m_heads[slot] != NIL)
+      {
+        uint32_t id = m_heads[slot];
+        Unlink (id);
+        if (m_nodes[id].expiration > m_next)
+          {
+            // parked timer which is not due yet
+            Link (id);
+            continue;
+          }
+
+        T value = m_nodes[id].value;
+        Release (id);
+        m_count--;
+        if (!m_expire.IsNull ())
+          m_expire (value);
+      }
+
+    m_next++;
+    if (m_count > 0 && !m_tickEvent.IsRunning ())
+      ScheduleTick ();
+  }
+
+  Time m_granularity;               /// duration of a tick
+  uint64_t m_next;                  /// the next tick to process
+  std::vector<Node> m_nodes;        /// the timers
+  std::vector<uint32_t> m_heads;    /// the first timer of each slot, LEVELS * SLOTS slots
+  uint32_t m_free;                  /// the first free node
+  uint32_t m_count;                 /// number of timers
+  EventId m_tickEvent;              /// the event of the next tick
+  Callback<void, T> m_expire;       /// expire callback
+};
+
+} // namespace ns3
+
+#endif /* BP_TIMING_WHEEL_H */
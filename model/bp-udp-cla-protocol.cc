@@ -0,0 +1,312 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#include "ns3/log.h"
+#include "ns3/packet.h"
+#include "ns3/nstime.h"
+#include "ns3/uinteger.h"
+#include "ns3/node.h"
+#include "ns3/simulator.h"
+#include "ns3/socket.h"
+#include "ns3/socket-factory.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/inet-socket-address.h"
+#include <algorithm>
+
+#include "bp-udp-cla-protocol.h"
+#include "bundle-protocol.h"
+#include "bp-header.h"
+#include "bp-endpoint-id.h"
+
+// default port number of dtn bundle udp convergence layer, which is
+// defined in draft-irtf-dtnrg-udp-clayer-00
+#define DTN_BUNDLE_UDP_PORT 4556
+
+// IPv4 and UDP headers
+#define UDP_IPV4_HEADER_SIZE 28
+
+NS_LOG_COMPONENT_DEFINE ("BpUdpClaProtocol");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (BpUdpClaProtocol);
+
+TypeId
+BpUdpClaProtocol::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpUdpClaProtocol")
+    .SetParent<BpClaProtocol> ()
+    .AddConstructor<BpUdpClaProtocol> ()
+    .AddAttribute ("Mtu", "Path MTU, which bounds the size of the bundles with the IPv4 and UDP headers",
+           UintegerValue (1500),
+           MakeUintegerAccessor (&BpUdpClaProtocol::m_mtu),
+           MakeUintegerChecker<uint32_t> (UDP_IPV4_HEADER_SIZE + 1))
+    .AddAttribute ("BatchInterval", "Delay of the send event after the first stored bundle, the bundles stored meanwhile are sent in the same event",
+           TimeValue (Seconds (0.0)),
+           MakeTimeAccessor (&BpUdpClaProtocol::m_batchInterval),
+           MakeTimeChecker ())
+    .AddAttribute ("MaxBatch", "Max number of datagrams written by a send event",
+           UintegerValue (64),
+           MakeUintegerAccessor (&BpUdpClaProtocol::m_maxBatch),
+           MakeUintegerChecker<uint32_t> (1))
+  ;
+  return tid;
+}
+
+BpUdpClaProtocol::BpUdpClaProtocol ()
+  : m_bp (0),
+    m_bpRouting (0),
+    m_socket (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpUdpClaProtocol::~BpUdpClaProtocol ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BpUdpClaProtocol::SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol)
+{
+  NS_LOG_FUNCTION (this << " " << bundleProtocol);
+  m_bp = bundleProtocol;
+}
+
+bool
+BpUdpClaProtocol::GetRoute (const BpEndpointId &dst, InetSocketAddress &address, uint32_t size)
+{
+  NS_LOG_FUNCTION (this << " " << dst.Uri () << " " << size);
+  if (!m_bpRouting)
+    NS_FATAL_ERROR ("BpUdpClaProtocol::GetRoute (): cannot find bundle routing protocol");
+
+  if (!m_bpRouting->GetBundleNextHop (dst, size, address))
+    {
+      NS_LOG_DEBUG ("BpUdpClaProtocol::GetRoute (): cannot find route for destination endpoint id " << dst.Uri ());
+      return false;
+    }
+
+  return true;
+}
+
+Ptr<Socket>
+BpUdpClaProtocol::GetL4Socket (Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << " " << packet);
+  BpHeader bph;
+  packet->PeekHeader (bph);
+
+  InetSocketAddress address (Ipv4Address::GetAny (), 0);
+  if (!GetRoute (bph.GetDestinationEid (), address) || !OpenSocket ())
+    return NULL;
+
+  return m_socket;
+}
+
+bool
+BpUdpClaProtocol::OpenSocket ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_socket)
+    return true;
+
+  m_socket = Socket::CreateSocket (m_bp->GetNode (), UdpSocketFactory::GetTypeId ());
+  if (m_socket->Bind () < 0)
+    {
+      NS_LOG_WARN ("BpUdpClaProtocol::OpenSocket (): socket error " << m_socket->GetErrno ());
+      m_socket = 0;
+      return false;
+    }
+
+  return true;
+}
+
+uint32_t
+BpUdpClaProtocol::GetMaxBundleSize ()
+{
+  NS_LOG_FUNCTION (this);
+  return m_mtu - UDP_IPV4_HEADER_SIZE;
+}
+
+int
+BpUdpClaProtocol::SendPacket (Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << " " << packet);
+  BpHeader bph;
+  packet->PeekHeader (bph);
+
+  if (GetL4Socket (packet) == 0)
+    return -1;
+
+  // the bundles stored until the send event are sent together
+  if (!m_sendEvent.IsRunning ())
+    m_sendEvent = Simulator::Schedule (m_batchInterval, &BpUdpClaProtocol::SendBundles, this);
+
+  return 0;
+}
+
+void
+BpUdpClaProtocol::SendBundles ()
+{
+  NS_LOG_FUNCTION (this);
+  uint32_t sent = 0;
+  Ptr<Packet> bundle;
+  while (sent < m_maxBatch && (bundle = m_bp->GetBundle ()))
+    {
+      // the bundle scheduler serves the classes of service across the source endpoint ids
+      SendBundle (bundle);
+      sent++;
+    }
+
+  NS_LOG_DEBUG ("Send event:" << " datagrams " << sent);
+  if (sent == m_maxBatch)
+    m_sendEvent = Simulator::Schedule (m_batchInterval, &BpUdpClaProtocol::SendBundles, this);
+}
+
+void
+BpUdpClaProtocol::SendBundle (Ptr<Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << bundle);
+  BpHeader bph;
+  bundle->PeekHeader (bph);
+
+  InetSocketAddress address (Ipv4Address::GetAny (), 0);
+  if (!GetRoute (bph.GetDestinationEid (), address, bundle->GetSize ()))
+    {
+      NS_LOG_WARN ("BpUdpClaProtocol::SendBundle (): drop bundle without route to " << bph.GetDestinationEid ().Uri ());
+      return;
+    }
+
+  if (bundle->GetSize () > GetMaxBundleSize ())
+    {
+      NS_LOG_WARN ("BpUdpClaProtocol::SendBundle (): drop bundle of " << bundle->GetSize () << " bytes larger than the MTU");
+      return;
+    }
+
+  m_bpRouting->NotifyForward (bundle, address);
+  if (m_socket->SendTo (bundle, 0, address) < 0)
+    NS_LOG_WARN ("BpUdpClaProtocol::SendBundle (): socket error " << m_socket->GetErrno ());
+}
+
+uint16_t
+BpUdpClaProtocol::GetDefaultPort ()
+{
+  NS_LOG_FUNCTION (this);
+  return DTN_BUNDLE_UDP_PORT;
+}
+
+int
+BpUdpClaProtocol::ForwardBundle (Ptr<Packet> bundle, const InetSocketAddress &nextHop)
+{
+  NS_LOG_FUNCTION (this << " " << bundle << " " << nextHop.GetIpv4 ());
+  if (!m_bpRouting)
+    NS_FATAL_ERROR ("BpUdpClaProtocol::ForwardBundle (): cannot find bundle routing protocol");
+
+  if (!OpenSocket ())
+    return -1;
+
+  if (bundle->GetSize () > GetMaxBundleSize ())
+    {
+      NS_LOG_WARN ("BpUdpClaProtocol::ForwardBundle (): bundle of " << bundle->GetSize () << " bytes larger than the MTU");
+      return -1;
+    }
+
+  m_bpRouting->NotifyForward (bundle, nextHop);
+  if (m_socket->SendTo (bundle->Copy (), 0, nextHop) < 0)
+    {
+      NS_LOG_WARN ("BpUdpClaProtocol::ForwardBundle (): socket error " << m_socket->GetErrno ());
+      return -1;
+    }
+
+  return 0;
+}
+
+int
+BpUdpClaProtocol::EnableReceive (const BpEndpointId &local)
+{
+  NS_LOG_FUNCTION (this << " " << local.Uri ());
+  InetSocketAddress addr (Ipv4Address::GetAny (), 0);
+  uint16_t port;
+  if (GetRoute (local, addr))
+    port = addr.GetPort ();
+  else
+    port = GetDefaultPort ();
+
+  Ptr<Socket> socket = Socket::CreateSocket (m_bp->GetNode (), UdpSocketFactory::GetTypeId ());
+  if (socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), port)) < 0)
+    return -1;
+
+  socket->SetRecvCallback (MakeCallback (&BpUdpClaProtocol::DataRecv, this));
+
+  if (!m_l4RecvSockets.Insert (local, socket))
+    return -1;
+
+  return 0;
+}
+
+int
+BpUdpClaProtocol::DisableReceive (const BpEndpointId &local)
+{
+  NS_LOG_FUNCTION (this << " " << local.Uri ());
+  Ptr<Socket> *socket = m_l4RecvSockets.Find (local);
+  if (socket == NULL)
+    return -1;
+
+  return (*socket)->Close ();
+}
+
+int
+BpUdpClaProtocol::EnableSend (const BpEndpointId &src, const BpEndpointId &dst)
+{
+  NS_LOG_FUNCTION (this << " " << src.Uri () << " " << dst.Uri ());
+  InetSocketAddress address (Ipv4Address::GetAny (), 0);
+  if (!GetRoute (dst, address) || !OpenSocket ())
+    return -1;
+
+  return 0;
+}
+
+void
+BpUdpClaProtocol::DataRecv (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << " " << socket);
+  Ptr<Packet> packet;
+  Address from;
+  while ((packet = socket->RecvFrom (from)))
+    {
+      m_bp->ReceiveBundle (packet);
+    }
+}
+
+void
+BpUdpClaProtocol::SetRoutingProtocol (Ptr<BpRoutingProtocol> route)
+{
+  NS_LOG_FUNCTION (this << " " << route);
+  m_bpRouting = route;
+}
+
+Ptr<BpRoutingProtocol>
+BpUdpClaProtocol::GetRoutingProtocol ()
+{
+  NS_LOG_FUNCTION (this);
+  return m_bpRouting;
+}
+
+} // namespace ns3
@@ -0,0 +1,197 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#ifndef BP_UDP_CLA_PROTOCOL_H
+#define BP_UDP_CLA_PROTOCOL_H
+
+#include "ns3/ptr.h"
+#include "bp-cla-protocol.h"
+#include "bp-endpoint-id.h"
+#include "ns3/socket.h"
+#include "ns3/packet.h"
+#include "bundle-protocol.h"
+#include "bp-routing-protocol.h"
+#include "bp-endpoint-map.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include <deque>
+
+namespace ns3 {
+
+/**
+ * \brief The UDP convergence layer adapter
+ *
+ * Each bundle is sent in one UDP datagram, without connection setup, so the
+ * largest bundle is the path MTU (the Mtu attribute) less the IPv4 and UDP
+ * headers; the bundle protocol fragments the ADUs to fit it, and a larger
+ * bundle is dropped.
+ *
+ * The bundles are not written when they are stored: the first stored bundle
+ * schedules a send event after the BatchInterval attribute, which dequeues
+ * the stored bundles of all the source endpoint ids in the class of service
+ * order of the bundle scheduler, and writes at most MaxBatch datagrams. The bundles left wait for the next
+ * send event.
+ */
+class BpUdpClaProtocol : public BpClaProtocol
+{
+public:
+
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief Constructor
+   */
+  BpUdpClaProtocol ();
+
+  /**
+   * Destroy
+   */
+  virtual ~BpUdpClaProtocol ();
+
+  /**
+   * \brief Schedule the send event of the stored bundles of the source
+   * endpoint id of a bundle
+   *
+   * \param packet the stored bundle
+   *
+   * \return -1 if there is no route for the destination endpoint id of the bundle
+   */
+  virtual int SendPacket (Ptr<Packet> packet);
+
+  /**
+   * Bind a UDP socket to the port of the local endpoint id
+   *
+   * \param local the local endpoint id
+   */
+  virtual int EnableReceive (const BpEndpointId &local);
+
+  /**
+   * Close the UDP socket of the local endpoint id
+   *
+   * \param local the endpoint id of registration
+   */
+  virtual int DisableReceive (const BpEndpointId &local);
+
+  /**
+   * Open the sender socket, there is no connection setup
+   *
+   * \param src the source endpoint id
+   * \param dst the destination endpoint id
+   */
+  virtual int EnableSend (const BpEndpointId &src, const BpEndpointId &dst);
+
+  /**
+   * \brief Get the sender socket, which is shared by all the bundles
+   *
+   * \param packet the bundle required to be transmitted
+   *
+   * \return NULL if there is no route for the destination endpoint id of the bundle
+   */
+  virtual Ptr<Socket> GetL4Socket (Ptr<Packet> packet);
+
+  /**
+   * \return the path MTU less the IPv4 and UDP headers
+   */
+  virtual uint32_t GetMaxBundleSize ();
+
+  /**
+   * \brief Send a copy of a bundle to a next hop chosen by the routing
+   * protocol, in a datagram of its own
+   *
+   * \return -1 if the socket cannot be opened, or the bundle is larger than the MTU
+   */
+  virtual int ForwardBundle (Ptr<Packet> bundle, const InetSocketAddress &nextHop);
+
+  /**
+   * \return the port listened on for a local endpoint id without route, DTN_BUNDLE_UDP_PORT
+   */
+  virtual uint16_t GetDefaultPort ();
+
+  /**
+   * Connect to routing protocol
+   *
+   * \param route routing protocol
+   */
+  void SetRoutingProtocol (Ptr<BpRoutingProtocol> route);
+
+  /**
+   * Get routing protocol
+   *
+   * \return routing protocol
+   */
+  virtual Ptr<BpRoutingProtocol> GetRoutingProtocol ();
+
+  /**
+   * Connect to bundle protocol
+   *
+   * \param bundleProtocol bundle protocol
+   */
+  void SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol);
+
+  /**
+   * \brief data receive callback, each datagram holds one bundle
+   */
+  void DataRecv (Ptr<Socket> socket);
+
+private:
+  /**
+   * \brief Find the address of the next hop of a destination endpoint id
+   *
+   * \param dst the destination endpoint id
+   * \param address set to the address of the next hop
+   * \param size the size of the bundle to route, 0 if the route is not for a bundle
+   *
+   * \return false if there is no route for dst
+   */
+  bool GetRoute (const BpEndpointId &dst, InetSocketAddress &address, uint32_t size = 0);
+
+  /**
+   * \brief Open the sender socket if it is not open yet
+   *
+   * \return false on socket error
+   */
+  bool OpenSocket ();
+
+  /**
+   * \brief Send event: write up to MaxBatch stored bundles, in the class of
+   * service order of the bundle scheduler across all source endpoint ids
+   */
+  void SendBundles ();
+
+  /**
+   * \brief Write a bundle in one datagram to the next hop of its destination endpoint id
+   */
+  void SendBundle (Ptr<Packet> bundle);
+
+  Ptr<BundleProtocol> m_bp;                       /// bundle protocol
+  Ptr<BpRoutingProtocol> m_bpRouting;             /// bundle routing protocol
+  Ptr<Socket> m_socket;                           /// the sender socket
+  BpEndpointMap<Ptr<Socket> > m_l4RecvSockets;    /// the receiver sockets
+  EventId m_sendEvent;                            /// the next send event
+
+  uint32_t m_mtu;                /// path MTU
+  Time m_batchInterval;          /// delay of a send event after the first stored bundle
+  uint32_t m_maxBatch;           /// maximum number of datagrams written by a send event
+};
+
+} // namespace ns3
+
+#endif /* BP_UDP_CLA_PROTOCOL_H */
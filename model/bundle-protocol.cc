@@ -25,13 +25,16 @@
 #include "ns3/uinteger.h"
 #include "ns3/simulator.h"
 #include "ns3/string.h"
+#include "ns3/boolean.h"
+#include "ns3/enum.h"
 #include "ns3/buffer.h"
 #include "bp-tcp-cla-protocol.h"
+#include "bp-udp-cla-protocol.h"
+#include "bp-ltp-cla-protocol.h"
 #include "bundle-protocol.h"
 #include "bp-header.h"
 #include "bp-payload-header.h"
 #include <algorithm>
-#include <map>
 #include <ctime>
 
 NS_LOG_COMPONENT_DEFINE ("BundleProtocol");
@@ -50,10 +53,57 @@ BundleProtocol::GetTypeId (void)
            UintegerValue (512),
            MakeUintegerAccessor (&BundleProtocol::m_bundleSize),
            MakeUintegerChecker<uint32_t> ())
-    .AddAttribute ("L4Type", "The type of transport layer protocol",
+    .AddAttribute ("L4Type", "The type of transport layer protocol, \"Tcp\", \"Udp\" or \"Ltp\"",
            StringValue ("Tcp"),
            MakeStringAccessor (&BundleProtocol::m_l4Type),
            MakeStringChecker ())
+    .AddAttribute ("WeightedFairQueuing", "Serve the sent bundles of the same class of service by weighted fair queuing across source endpoint ids",
+           BooleanValue (false),
+           MakeBooleanAccessor (&BundleProtocol::SetWeightedFairQueuing,
+                                &BundleProtocol::GetWeightedFairQueuing),
+           MakeBooleanChecker ())
+    .AddAttribute ("WfqQuantum", "Bytes credited to a source endpoint id of weight 1 in each round of weighted fair queuing",
+           UintegerValue (1500),
+           MakeUintegerAccessor (&BundleProtocol::SetWfqQuantum,
+                                 &BundleProtocol::GetWfqQuantum),
+           MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("ExpirationGranularity", "Tick of the timing wheel expiring the stored bundles",
+           TimeValue (Seconds (1.0)),
+           MakeTimeAccessor (&BundleProtocol::SetExpirationGranularity,
+                             &BundleProtocol::GetExpirationGranularity),
+           MakeTimeChecker ())
+    .AddAttribute ("ReassemblyTimeout", "Time after the first received fragment of a bundle when its partial state is dropped",
+           TimeValue (Seconds (60.0)),
+           MakeTimeAccessor (&BundleProtocol::SetReassemblyTimeout,
+                             &BundleProtocol::GetReassemblyTimeout),
+           MakeTimeChecker ())
+    .AddAttribute ("EvictionPolicy", "The order in which the stored bundles are evicted when a storage quota is exceeded",
+           EnumValue (BpStorageManager::DROP_OLDEST),
+           MakeEnumAccessor (&BundleProtocol::SetEvictionPolicy,
+                             &BundleProtocol::GetEvictionPolicy),
+           MakeEnumChecker (BpStorageManager::DROP_OLDEST, "DropOldest",
+                            BpStorageManager::DROP_LOWEST_PRIORITY, "DropLowestPriority",
+                            BpStorageManager::DROP_SOONEST_EXPIRING, "DropSoonestExpiring"))
+    .AddAttribute ("StorageMaxBytes", "Max bytes of the bundles stored by the node, 0 if unlimited",
+           UintegerValue (0),
+           MakeUintegerAccessor (&BundleProtocol::SetStorageMaxBytes,
+                                 &BundleProtocol::GetStorageMaxBytes),
+           MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("StorageMaxBundles", "Max number of bundles stored by the node, 0 if unlimited",
+           UintegerValue (0),
+           MakeUintegerAccessor (&BundleProtocol::SetStorageMaxBundles,
+                                 &BundleProtocol::GetStorageMaxBundles),
+           MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("EidStorageMaxBytes", "Max bytes of the bundles stored for an endpoint id, 0 if unlimited",
+           UintegerValue (0),
+           MakeUintegerAccessor (&BundleProtocol::SetEidStorageMaxBytes,
+                                 &BundleProtocol::GetEidStorageMaxBytes),
+           MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("EidStorageMaxBundles", "Max number of bundles stored for an endpoint id, 0 if unlimited",
+           UintegerValue (0),
+           MakeUintegerAccessor (&BundleProtocol::SetEidStorageMaxBundles,
+                                 &BundleProtocol::GetEidStorageMaxBundles),
+           MakeUintegerChecker<uint32_t> ())
     .AddAttribute ("StartTime", "Time at which the bundle protocol will start",
                    TimeValue (Seconds (0.0)),
                    MakeTimeAccessor (&BundleProtocol::m_startTime),
@@ -62,6 +112,12 @@ BundleProtocol::GetTypeId (void)
                    TimeValue (TimeStep (0)),
                    MakeTimeAccessor (&BundleProtocol::m_stopTime),
                    MakeTimeChecker ())
+    .AddTraceSource ("BundleExpired", "A stored bundle is dropped because its lifetime is over, or because no later contact can forward it",
+                     MakeTraceSourceAccessor (&BundleProtocol::m_expireTrace))
+    .AddTraceSource ("BundleEvicted", "A stored bundle is dropped to store a new bundle within the storage quotas",
+                     MakeTraceSourceAccessor (&BundleProtocol::m_evictTrace))
+    .AddTraceSource ("BundleRejected", "A new bundle is not stored because it does not fit the storage quotas",
+                     MakeTraceSourceAccessor (&BundleProtocol::m_rejectTrace))
   ;
   return tid;
 }
@@ -69,13 +125,15 @@ BundleProtocol::GetTypeId (void)
 BundleProtocol::BundleProtocol ()
   : m_node (0),
     m_cla (0),
-    m_bpRxBufferPacket (Create<Packet> (0)),
+    m_expiredBundles (0),
     m_seq (0),
     m_eid ("dtn:none"),
     m_bpRegInfo (),
     m_bpRoutingProtocol (0)
 { 
   NS_LOG_FUNCTION (this);
+  m_expirationWheel.SetExpireCallback (MakeCallback (&BundleProtocol::ExpireBundle, this));
+  m_storageManager.SetEvictCallback (MakeCallback (&BundleProtocol::EvictBundle, this));
 }
 
 BundleProtocol::~BundleProtocol ()
@@ -96,6 +154,18 @@ BundleProtocol::Open (Ptr<Node> node)
       m_cla = cla;
       m_cla->SetBundleProtocol (this);
     }
+  else if (m_l4Type == "Udp")
+    {
+      Ptr<BpUdpClaProtocol> cla = CreateObject<BpUdpClaProtocol>();
+      m_cla = cla;
+      m_cla->SetBundleProtocol (this);
+    }
+  else if (m_l4Type == "Ltp")
+    {
+      Ptr<BpLtpClaProtocol> cla = CreateObject<BpLtpClaProtocol>();
+      m_cla = cla;
+      m_cla->SetBundleProtocol (this);
+    }
   else
     {
       NS_FATAL_ERROR ("BundleProtocol::Open (): unkonw tranport layer protocol type! " << m_l4Type);   
@@ -136,15 +206,15 @@ int
 BundleProtocol::Register (const BpEndpointId &eid, const struct BpRegisterInfo &info)
 { 
   NS_LOG_FUNCTION (this << " " << eid.Uri ());
-  std::map<BpEndpointId, BpRegisterInfo>::iterator it = BpRegistration.end ();
-  it = BpRegistration.find (eid);
-  if (it == BpRegistration.end ())
+  if (BpRegistration.Find (eid) == NULL)
     {
       // insert a registration of local endpoint id in the registration storage
       BpRegisterInfo rInfo;
       rInfo.lifetime = info.lifetime;
       rInfo.state = info.state;
-      BpRegistration.insert (std::pair<BpEndpointId, BpRegisterInfo> (eid, rInfo));
+      rInfo.ordered = info.ordered;
+      BpRegistration.Insert (eid, rInfo);
+      BpSendBundleStore.SetWeight (eid, info.weight);
 
       if (info.state)
         {
@@ -167,14 +237,13 @@ int
 BundleProtocol::Unregister (const BpEndpointId &eid)
 { 
   NS_LOG_FUNCTION (this << " " << eid.Uri ());
-  std::map<BpEndpointId, BpRegisterInfo>::iterator it = BpRegistration.end ();
-  it = BpRegistration.find (eid);
-  if (it == BpRegistration.end ())
+  BpRegisterInfo *info = BpRegistration.Find (eid);
+  if (info == NULL)
     {
       return -1;
     } 
 
-  (*it).second.state = false;
+  info->state = false;
   return m_cla->DisableReceive (eid);
 }
 
@@ -182,16 +251,15 @@ int
 BundleProtocol::Bind (const BpEndpointId &eid)
 { 
   NS_LOG_FUNCTION (this << " " << eid.Uri ());
-  std::map<BpEndpointId, BpRegisterInfo>::iterator it = BpRegistration.end ();
-  it = BpRegistration.find (eid);
-  if (it == BpRegistration.end ())
+  BpRegisterInfo *info = BpRegistration.Find (eid);
+  if (info == NULL)
     {
       return -1;
     } 
   else
     {
       // set the registeration of this eid to active
-      (*it).second.state = true;
+      info->state = true;
 
       return m_cla->EnableReceive (eid);
     }
@@ -201,28 +269,74 @@ int
 BundleProtocol::Send (Ptr<Packet> p, const BpEndpointId &src, const BpEndpointId &dst)
 { 
   NS_LOG_FUNCTION (this << " " << src.Uri () << " " << dst.Uri ());
+  return Send (p, src, dst, BpHeader::PRIORITY_BULK);
+}
+
+int 
+BundleProtocol::Send (Ptr<Packet> p, const BpEndpointId &src, const BpEndpointId &dst, uint8_t priority)
+{ 
+  NS_LOG_FUNCTION (this << " " << src.Uri () << " " << dst.Uri () << " " << (uint16_t) priority);
   // check the source eid is registered or not
-  std::map<BpEndpointId, BpRegisterInfo>::iterator it = BpRegistration.end ();
-  it = BpRegistration.find (src);
-  if (it == BpRegistration.end ())
+  BpRegisterInfo *info = BpRegistration.Find (src);
+  if (info == NULL)
     {
       // the local eid is not registered
       return -1;
     } 
-  else
+
+  uint32_t total = p->GetSize ();
+
+  // all the fragments of an ADU carry the same source eid, creation timestamp and
+  // sequence number, so that the receiver can reassemble them; the simulation
+  // starts at the epoch of creation timestamps
+  std::time_t timestamp = RFC_DATE_2000 + (std::time_t) Simulator::Now ().GetSeconds ();
+  SequenceNumber32 seq = m_seq;
+  m_seq++;
+
+  uint32_t payloadSize = m_bundleSize;
+  uint32_t maxBundleSize = m_cla ? m_cla->GetMaxBundleSize () : 0;
+  uint64_t volume = m_cla ? m_cla->GetContactVolume (dst) : 0;
+  if (maxBundleSize > 0 || volume > 0)
     {
-      // TBD: the lifetime of the eid is expired?
+      // the blocks of a fragment whose length fields are the largest ones,
+      // so that every bundle of the ADU fits the transport layer
+      BpHeader bph;
+      bph.SetDestinationEid (dst);
+      bph.SetSourceEid (src);
+      bph.SetCreateTimestamp (timestamp);
+      bph.SetSequenceNumber (seq);
+      bph.SetPriority (priority);
+      bph.SetLifeTime (info->lifetime);
+      bph.SetIsFragment (true);
+      bph.SetFragOffset (total);
+      bph.SetAduLength (total);
+      bph.SetBlockLength (total);
+      BpPayloadHeader bpph;
+      bpph.SetBlockLength (total);
+
+      uint32_t overhead = bph.GetSerializedSize () + bpph.GetSerializedSize ();
+      if (maxBundleSize > 0 && overhead >= maxBundleSize)
+        {
+          NS_LOG_WARN ("BundleProtocol::Send (): bundle blocks of " << overhead << " bytes exceed the max bundle size " << maxBundleSize);
+          return -1;
+        }
+      if (maxBundleSize > 0)
+        payloadSize = std::min (payloadSize, maxBundleSize - overhead);
+
+      // the bundles fit the volume left in the next contact, a volume too
+      // small for the blocks is left unused and the bundles wait for a later contact
+      if (volume > overhead)
+        payloadSize = (uint32_t) std::min ((uint64_t) payloadSize, volume - overhead);
     }
 
-  uint32_t total = p->GetSize ();
-  bool fragment =  ( total > m_bundleSize ) ? true : false;
+  bool fragment =  ( total > payloadSize ) ? true : false;
 
-  // a simple fragementation: ensure a bundle is transmittd by one packet at the transport layer
-  uint32_t num = 0;
+  // fragmentation: ensure a bundle is transmittd by one packet at the transport layer
   while ( total > 0 )   
     { 
       Ptr<Packet> packet = NULL;
       uint32_t size = 0;;
+      uint32_t offset = p->GetSize () - total;
 
       // build bundle payload header
       BpPayloadHeader bpph;
@@ -231,19 +345,19 @@ BundleProtocol::Send (Ptr<Packet> p, const BpEndpointId &src, const BpEndpointId
       BpHeader bph;
       bph.SetDestinationEid (dst);
       bph.SetSourceEid (src);
-      bph.SetCreateTimestamp (std::time(NULL));
-      bph.SetSequenceNumber (m_seq);
-      m_seq++;
+      bph.SetCreateTimestamp (timestamp);
+      bph.SetSequenceNumber (seq);
+      bph.SetPriority (priority);
 
-      size = std::min (total, m_bundleSize);
+      size = std::min (total, payloadSize);
 
       bph.SetBlockLength (size);       
-      bph.SetLifeTime (0);
+      bph.SetLifeTime (info->lifetime);
 
       if (fragment)
         {
           bph.SetIsFragment (true);
-          bph.SetFragOffset (p->GetSize () - size);
+          bph.SetFragOffset (offset);
           bph.SetAduLength (p->GetSize ());
         }
       else
@@ -252,8 +366,10 @@ BundleProtocol::Send (Ptr<Packet> p, const BpEndpointId &src, const BpEndpointId
         }
 
       bpph.SetBlockLength (size);
+      bpph.SetLastBlock (true);
 
-      packet = Create<Packet> (size);
+      // the payload block data references the application data, it is not copied
+      packet = p->CreateFragment (offset, size);
       packet->AddHeader (bpph);
       packet->AddHeader (bph);
 
@@ -263,34 +379,15 @@ BundleProtocol::Send (Ptr<Packet> p, const BpEndpointId &src, const BpEndpointId
                                  " pkt size " << packet->GetSize ());
 
       // store the bundle into persistant sent storage
-      std::map<BpEndpointId, std::queue<Ptr<Packet> > >::iterator it = BpSendBundleStore.end ();
-      it = BpSendBundleStore.find (src);
-      if ( it == BpSendBundleStore.end ())
-        {
-          // this is the first packet sent by this source endpoint id
-          std::queue<Ptr<Packet> > qu;
-          qu.push (packet);
-          BpSendBundleStore.insert (std::pair<BpEndpointId, std::queue<Ptr<Packet> > > (src, qu) );
-        }
-      else
-        {
-          // ongoing packet
-          (*it).second.push (packet);
-        }
+      StartLifetime (Create<BpStoredBundle> (packet, src, priority, BpStoredBundle::SEND_STORE), bph);
 
+      // the convergence layer writes the stored bundles while its transmission buffer has space
       if (m_cla)
-        {
-           m_cla->SendPacket (packet);                             
-           num++;
-        }
+        m_cla->SendPacket (packet);
       else
         NS_FATAL_ERROR ("BundleProtocol::Send (): undefined m_cla");
 
       total = total - size;
-
-      // force the convergence layer to send the packet
-      if (num == 1)
-        m_cla->SendPacket (packet);                             
     }
 
   return 0;
@@ -300,9 +397,7 @@ int
 BundleProtocol::Close (const BpEndpointId &eid)
 {
   NS_LOG_FUNCTION (this << " " << eid.Uri ());
-  std::map<BpEndpointId, BpRegisterInfo>::iterator it = BpRegistration.end ();
-  it = BpRegistration.find (eid);
-  if (it == BpRegistration.end ())
+  if (BpRegistration.Find (eid) == NULL)
     {
       return -1;
     } 
@@ -310,77 +405,17 @@ BundleProtocol::Close (const BpEndpointId &eid)
     {
       // TBD: call cla to close transport layer connection
 
-      BpRegistration.erase (it);
+      BpRegistration.Erase (eid);
     }
 
   return 0;
 }
 
 void
-BundleProtocol::RetreiveBundle ()
+BundleProtocol::ReceiveBundle (Ptr<Packet> bundle)
 { 
-  NS_LOG_FUNCTION (this);
-  BpHeader bpHeader;         // primary bundle header
-  BpPayloadHeader bppHeader; // bundle payload header
- 
-  // continue to retreive a bundle from buffer until the buffer size is smaller than a bundle or a bundle header 
-  if (m_bpRxBufferPacket->GetSize () > (bpHeader.GetSerializedSize () + bppHeader.GetSerializedSize ()))
-    {
-      // since BpHeader's length is a variable, we must also read data buffer size to guarantee that the node 
-      // receives a complete primary bundle header and bundle payload header
-
-      // copy m_bpRxBufferPacket into a Buffer
-      uint32_t size = m_bpRxBufferPacket->GetSize();
-      uint8_t *buffer = (uint8_t*)std::malloc(size);
-      m_bpRxBufferPacket->CopyData (buffer, size); 
-      Buffer buf;
-      buf.AddAtStart (size);
-      Buffer::Iterator start = buf.Begin ();
-      start.Write (buffer, size);
- 
-      // if there is not data, we cannot call PeekHeader, since we cannot guarantee a complete primary bundle header and 
-      // bundle header is received
-      if (buf.GetSize () == 0 )
-        return;
-
-      m_bpRxBufferPacket->PeekHeader (bpHeader);
-      m_bpRxBufferPacket->PeekHeader (bppHeader);
-
-      uint32_t total =  bpHeader.GetBlockLength ()
-                      + bpHeader.GetSerializedSize () 
-                      + bppHeader.GetSerializedSize ();
-
-      if (m_bpRxBufferPacket->GetSize () >= total)
-        {
-          Ptr<Packet> bundle = m_bpRxBufferPacket->CreateFragment (0, total) ;
-          m_bpRxBufferPacket->RemoveAtStart (total);
-
-          ProcessBundle (bundle);
-          
-          // continue to check bundles
-          Simulator::ScheduleNow (&BundleProtocol::RetreiveBundle, this);
-        }
-      else
-        {
-          //NS_LOG_DEBUG ("no enough space for a bundle");
-        }
-
-    } 
-  else
-    {
-      //NS_LOG_DEBUG ("no enough space for a bundle header");
-    }
-
-}
-
-void 
-BundleProtocol::ReceivePacket (Ptr<Packet> packet)
-{ 
-  NS_LOG_FUNCTION (this << " " << packet);
-  // add packets ino receive buffer
-  m_bpRxBufferPacket->AddAtEnd (packet);
-
-  Simulator::ScheduleNow (&BundleProtocol::RetreiveBundle, this);
+  NS_LOG_FUNCTION (this << " " << bundle);
+  ProcessBundle (bundle);
 }
 
 void 
@@ -388,49 +423,167 @@ BundleProtocol::ProcessBundle (Ptr<Packet> bundle)
 { 
   NS_LOG_FUNCTION (this << " " << bundle);
   BpHeader bpHeader;         // primary bundle header
-  BpPayloadHeader bppHeader; // bundle payload header
 
+  // the payload block is not needed to dispatch the bundle
   bundle->PeekHeader (bpHeader);
-  bundle->PeekHeader (bppHeader);
   
   BpEndpointId dst = bpHeader.GetDestinationEid ();
   BpEndpointId src = bpHeader.GetSourceEid ();
   
   NS_LOG_DEBUG ("Recv bundle:" << " seq " << bpHeader.GetSequenceNumber ().GetValue () << 
-                              " src eid " << bpHeader.GetSourceEid ().Uri () << 
-                              " dst eid " << bpHeader.GetDestinationEid ().Uri () << 
+                              " src eid " << src.Uri () << 
+                              " dst eid " << dst.Uri () << 
                               " packet size " << bundle->GetSize ());
 
+  Ptr<BpRoutingProtocol> routing;
+  if (m_cla)
+    routing = m_cla->GetRoutingProtocol ();
+
+  if (routing && !routing->NotifyReceive (bundle))
+    {
+      NS_LOG_DEBUG ("Drop duplicate bundle:" << " seq " << bpHeader.GetSequenceNumber ().GetValue ());
+      return;
+    }
+
   // the destination endpoint eid is registered? 
-  // TBD: forwarding case
-  std::map<BpEndpointId, BpRegisterInfo>::iterator it = BpRegistration.end ();
-  it = BpRegistration.find (dst);
-  if (it == BpRegistration.end ())
+  if (BpRegistration.Find (dst) == NULL)
     {
-      // the destination endpoint id is not registered, drop packet
+      // a relay routing protocol forwards the bundles of the other nodes from
+      // the send storage, the other ones drop them
+      if (routing && routing->IsRelay ())
+        StartLifetime (Create<BpStoredBundle> (bundle, src, bpHeader.Priority (), BpStoredBundle::SEND_STORE), bpHeader);
+
       return;
     } 
-  else
+
+  // the extension blocks are processed by the routing protocol of each node,
+  // the reassembler and the applications only read the payload block
+  bundle = RemoveExtensionBlocks (bundle);
+
+  if (bpHeader.IsFragment ())
     {
-      // TBD: the lifetime of the eid is expired?
+      // wait for the other fragments of the ADU
+      bundle = m_bpReassembler.Add (bundle);
+      if (bundle == 0)
+        return;
+
+      bundle->PeekHeader (bpHeader);
     }
 
   // store the bundle into persistant received storage
-  std::map<BpEndpointId, std::queue<Ptr<Packet> > >::iterator itMap = BpRecvBundleStore.end ();
-  itMap = BpRecvBundleStore.find (dst);
-  if ( itMap == BpRecvBundleStore.end ())
+  StartLifetime (Create<BpStoredBundle> (bundle, dst, bpHeader.Priority (), BpStoredBundle::RECV_STORE), bpHeader);
+}
+
+Ptr<Packet>
+BundleProtocol::RemoveExtensionBlocks (Ptr<Packet> bundle) const
+{ 
+  NS_LOG_FUNCTION (this << " " << bundle);
+  Ptr<Packet> packet = bundle->Copy ();
+  BpHeader bph;
+  BpPayloadHeader block;
+  packet->RemoveHeader (bph);
+  packet->PeekHeader (block);
+  if (block.GetBlockType () == BP_PAYLOAD_BLOCK_TYPE)
+    return bundle;
+
+  while (block.GetBlockType () != BP_PAYLOAD_BLOCK_TYPE)
     {
-      // this is the first bundle received by this destination endpoint id
-      std::queue<Ptr<Packet> > qu;
-      qu.push (bundle);
-      BpRecvBundleStore.insert (std::pair<BpEndpointId, std::queue<Ptr<Packet> > > (dst, qu) );
+      uint32_t size = block.GetSerializedSize () + block.GetBlockLength ();
+      if (size >= packet->GetSize ())
+        {
+          NS_LOG_WARN ("BundleProtocol::RemoveExtensionBlocks (): no payload block after block type " << (uint16_t) block.GetBlockType ());
+          return bundle;
+        }
+
+      packet->RemoveAtStart (size);
+      packet->PeekHeader (block);
     }
-  else
+
+  packet->AddHeader (bph);
+  return packet;
+}
+
+bool
+BundleProtocol::StartLifetime (Ptr<BpStoredBundle> record, const BpHeader &bph)
+{ 
+  NS_LOG_FUNCTION (this << " " << record->bundle);
+  if (bph.GetLifeTime () > 0)
+    {
+      // creation timestamps are counted from the start of the simulation
+      record->expiration = Seconds (bph.GetCreateTimestamp () + bph.GetLifeTime ());
+      if (record->expiration <= Simulator::Now ())
+        {
+          NS_LOG_DEBUG ("Drop expired bundle:" << " seq " << bph.GetSequenceNumber ().GetValue ());
+          m_expireTrace (record->bundle);
+          m_expiredBundles++;
+          return false;
+        }
+    }
+
+  if (record->priority > BpHeader::PRIORITY_EXPEDITED)
+    {
+      NS_LOG_WARN ("BundleProtocol::StartLifetime (): unknown priority " << (uint16_t) record->priority << ", the bundle is stored as bulk");
+      record->priority = BpHeader::PRIORITY_BULK;
+    }
+
+  if (!m_storageManager.Admit (record))
     {
-      // ongoing bundles
-      (*itMap).second.push (bundle);
+      NS_LOG_DEBUG ("Reject bundle:" << " seq " << bph.GetSequenceNumber ().GetValue () << " size " << record->size);
+      m_rejectTrace (record->bundle);
+      return false;
     }
 
+  if (!record->expiration.IsZero ())
+    record->timer = m_expirationWheel.Add (record->expiration, record);
+
+  if (record->storage == BpStoredBundle::SEND_STORE)
+    {
+      BpSendBundleStore.Enqueue (record);
+    }
+  else if (record->storage == BpStoredBundle::RECV_STORE)
+    {
+      // the queue is created by the first bundle received by this destination endpoint id
+      record->enqueued = Simulator::Now ();
+      BpRecvBundleStore[record->eid].push_back (record);
+    }
+
+  return true;
+}
+
+void
+BundleProtocol::ExpireBundle (Ptr<BpStoredBundle> record)
+{ 
+  NS_LOG_FUNCTION (this << " " << record->bundle);
+  record->timer = BpTimingWheel<Ptr<BpStoredBundle> >::NO_TIMER;
+  if (!record->IsStored ())
+    return;
+
+  NS_LOG_DEBUG ("Expire bundle:" << " eid " << record->eid.Uri () << " size " << record->size);
+  m_expireTrace (record->bundle);
+  m_expiredBundles++;
+  m_storageManager.Release (record);
+  DiscardBundle (record);
+}
+
+void
+BundleProtocol::EvictBundle (Ptr<BpStoredBundle> record)
+{ 
+  NS_LOG_FUNCTION (this << " " << record->bundle);
+  m_expirationWheel.Cancel (record->timer);
+  record->timer = BpTimingWheel<Ptr<BpStoredBundle> >::NO_TIMER;
+  m_evictTrace (record->bundle);
+  DiscardBundle (record);
+}
+
+void
+BundleProtocol::DiscardBundle (Ptr<BpStoredBundle> record)
+{ 
+  NS_LOG_FUNCTION (this << " " << record->bundle);
+  // the packet is released now, the empty record is dropped when it reaches the head of its queue
+  if (record->storage == BpStoredBundle::SEND_STORE)
+    BpSendBundleStore.Remove (record);
+  else
+    record->bundle = 0;
 }
 
 Ptr<Packet>
@@ -439,42 +592,49 @@ BundleProtocol::Receive (const BpEndpointId &eid)
   NS_LOG_FUNCTION (this << " " << eid.Uri ());
   Ptr<Packet> emptyPacket = NULL;
 
-  std::map<BpEndpointId, BpRegisterInfo>::iterator it = BpRegistration.end ();
-  it = BpRegistration.find (eid);
-  if (it == BpRegistration.end ())
+  if (BpRegistration.Find (eid) == NULL)
     {
       // the eid is not registered
       return emptyPacket;
     } 
   else
     {
-      // TBD: the lifetime of the eid is expired?
-     
       // return all the bundles with dst eid = eid
-      std::map<BpEndpointId, std::queue<Ptr<Packet> > >::iterator itMap = BpRecvBundleStore.end ();
-      itMap = BpRecvBundleStore.find (eid);
-      if ( itMap == BpRecvBundleStore.end ())
+      std::deque<Ptr<BpStoredBundle> > *qu = BpRecvBundleStore.Find (eid);
+      if (qu == NULL)
         {
           // do not receive any bundle with this dst eid
           return emptyPacket;
         }
-      else if ( (*itMap).second.size () > 0)
+
+      // skip the expired bundles
+      while (qu->size () > 0 && !qu->front ()->IsStored ())
+        qu->pop_front ();
+
+      if (qu->size () > 0)
         {
-          Ptr<Packet> packet = ((*itMap).second).front ();
-          ((*itMap).second).pop ();
+          Ptr<BpStoredBundle> record = qu->front ();
+          qu->pop_front ();
+          m_expirationWheel.Cancel (record->timer);
+          m_storageManager.Release (record);
+          Ptr<Packet> packet = record->bundle;
 
           // remove bundle header before forwarding to applications
           BpHeader bpHeader;         // primary bundle header
           BpPayloadHeader bppHeader; // bundle payload header
           packet->RemoveHeader (bpHeader);
           packet->RemoveHeader (bppHeader);
+
+          // the payload is the rest of the bundle, still sharing the received buffer
+          if (packet->GetSize () > bppHeader.GetBlockLength ())
+            packet->RemoveAtEnd (packet->GetSize () - bppHeader.GetBlockLength ());
     
           return packet;
         }
       else
         {
           // has already fetched all bundles with this dst eid
-          BpRecvBundleStore.erase (itMap);
+          BpRecvBundleStore.Erase (eid);
           return emptyPacket;
         }
     }
@@ -493,6 +653,7 @@ void
 BundleProtocol::SetRoutingProtocol (Ptr<BpRoutingProtocol> route)
 { 
   NS_LOG_FUNCTION (this << " " << route);
+  route->SetBundleProtocol (this);
   m_cla->SetRoutingProtocol (route);
 }
 
@@ -503,6 +664,13 @@ BundleProtocol::GetRoutingProtocol ()
   return m_cla->GetRoutingProtocol ();
 }
 
+Ptr<BpClaProtocol>
+BundleProtocol::GetCla () const
+{ 
+  NS_LOG_FUNCTION (this);
+  return m_cla;
+}
+
 Ptr<Node> 
 BundleProtocol::GetNode () const
 { 
@@ -514,22 +682,277 @@ Ptr<Packet>
 BundleProtocol::GetBundle (const BpEndpointId &src)
 { 
   NS_LOG_FUNCTION (this << " " << src.Uri ());
-  std::map<BpEndpointId, std::queue<Ptr<Packet> > >::iterator it = BpSendBundleStore.end ();
-  it = BpSendBundleStore.find (src);
-  if ( it == BpSendBundleStore.end ())
+  Ptr<BpStoredBundle> record = BpSendBundleStore.Dequeue (src);
+  if (record == 0)
+    return NULL;
+
+  m_expirationWheel.Cancel (record->timer);
+  m_storageManager.Release (record);
+  return record->bundle;
+}
+
+Ptr<Packet> 
+BundleProtocol::GetBundle ()
+{ 
+  NS_LOG_FUNCTION (this);
+  Ptr<BpStoredBundle> record = BpSendBundleStore.Dequeue ();
+  if (record == 0)
+    return NULL;
+
+  m_expirationWheel.Cancel (record->timer);
+  m_storageManager.Release (record);
+  return record->bundle;
+}
+
+Ptr<BpStoredBundle>
+BundleProtocol::HoldBundle ()
+{ 
+  NS_LOG_FUNCTION (this);
+  Ptr<BpStoredBundle> record = BpSendBundleStore.Dequeue ();
+  if (record == 0)
+    return NULL;
+
+  // the bundle keeps its storage and its expiration timer
+  record->storage = BpStoredBundle::HELD_STORE;
+  return record;
+}
+
+Ptr<BpStoredBundle>
+BundleProtocol::HoldBundle (Ptr<Packet> bundle)
+{ 
+  NS_LOG_FUNCTION (this << " " << bundle);
+  BpHeader bph;
+  bundle->PeekHeader (bph);
+  Ptr<BpStoredBundle> record = Create<BpStoredBundle> (bundle, bph.GetSourceEid (), bph.Priority (), BpStoredBundle::HELD_STORE);
+  if (!StartLifetime (record, bph))
+    return NULL;
+
+  return record;
+}
+
+Ptr<Packet>
+BundleProtocol::ReleaseBundle (Ptr<BpStoredBundle> record)
+{ 
+  NS_LOG_FUNCTION (this << " " << record->bundle);
+  if (!record->IsStored ())
+    return NULL;
+
+  m_expirationWheel.Cancel (record->timer);
+  record->timer = BpTimingWheel<Ptr<BpStoredBundle> >::NO_TIMER;
+  m_storageManager.Release (record);
+  Ptr<Packet> bundle = record->bundle;
+  record->bundle = 0;
+  return bundle;
+}
+
+void
+BundleProtocol::DropBundle (Ptr<BpStoredBundle> record)
+{ 
+  NS_LOG_FUNCTION (this << " " << record->bundle);
+  Ptr<Packet> bundle = ReleaseBundle (record);
+  if (bundle == 0)
+    return;
+
+  NS_LOG_DEBUG ("Drop held bundle:" << " eid " << record->eid.Uri () << " size " << record->size);
+  m_expireTrace (bundle);
+  m_expiredBundles++;
+}
+
+void
+BundleProtocol::GetStoredBundles (std::vector<Ptr<Packet> > &bundles) const
+{ 
+  NS_LOG_FUNCTION (this);
+  std::vector<Ptr<BpStoredBundle> > records;
+  BpSendBundleStore.GetRecords (records);
+  bundles.clear ();
+  for (uint32_t i = 0; i < records.size (); i++)
+    bundles.push_back (records[i]->bundle);
+}
+
+bool
+BundleProtocol::RemoveBundle (Ptr<const Packet> bundle)
+{ 
+  NS_LOG_FUNCTION (this << " " << bundle);
+  std::vector<Ptr<BpStoredBundle> > records;
+  BpSendBundleStore.GetRecords (records);
+  for (uint32_t i = 0; i < records.size (); i++)
     {
-      return NULL;
+      if (records[i]->bundle != bundle)
+        continue;
+
+      m_expirationWheel.Cancel (records[i]->timer);
+      records[i]->timer = BpTimingWheel<Ptr<BpStoredBundle> >::NO_TIMER;
+      m_storageManager.Release (records[i]);
+      DiscardBundle (records[i]);
+      return true;
     }
-  else
-    {
-      if ( ((*it).second).size () == 0)
-        return NULL;
 
-      Ptr<Packet> packet = ((*it).second).front ();
-      ((*it).second).pop ();
+  return false;
+}
 
-      return packet;
-    }
+int
+BundleProtocol::ForwardBundle (Ptr<Packet> bundle, const InetSocketAddress &nextHop)
+{ 
+  NS_LOG_FUNCTION (this << " " << bundle << " " << nextHop.GetIpv4 ());
+  if (!m_cla)
+    NS_FATAL_ERROR ("BundleProtocol::ForwardBundle (): undefined m_cla");
+
+  return m_cla->ForwardBundle (bundle, nextHop);
+}
+
+uint32_t
+BundleProtocol::GetExpiredBundles () const
+{ 
+  NS_LOG_FUNCTION (this);
+  return m_expiredBundles;
+}
+
+bool
+BundleProtocol::IsOrdered (const BpEndpointId &src) const
+{ 
+  NS_LOG_FUNCTION (this << " " << src.Uri ());
+  const BpRegisterInfo *info = BpRegistration.Find (src);
+  return info != NULL && info->ordered;
+}
+
+void
+BundleProtocol::SetExpirationGranularity (Time granularity)
+{ 
+  NS_LOG_FUNCTION (this << " " << granularity.GetSeconds ());
+  m_expirationWheel.SetGranularity (granularity);
+}
+
+Time
+BundleProtocol::GetExpirationGranularity () const
+{ 
+  NS_LOG_FUNCTION (this);
+  return m_expirationWheel.GetGranularity ();
+}
+
+const BpStorageManager&
+BundleProtocol::GetStorageManager () const
+{ 
+  NS_LOG_FUNCTION (this);
+  return m_storageManager;
+}
+
+void
+BundleProtocol::SetEvictionPolicy (BpStorageManager::EvictionPolicy policy)
+{ 
+  NS_LOG_FUNCTION (this << " " << policy);
+  m_storageManager.SetPolicy (policy);
+}
+
+BpStorageManager::EvictionPolicy
+BundleProtocol::GetEvictionPolicy () const
+{ 
+  NS_LOG_FUNCTION (this);
+  return m_storageManager.GetPolicy ();
+}
+
+void
+BundleProtocol::SetStorageMaxBytes (uint64_t bytes)
+{ 
+  NS_LOG_FUNCTION (this << " " << bytes);
+  m_storageManager.SetMaxBytes (bytes);
+}
+
+uint64_t
+BundleProtocol::GetStorageMaxBytes () const
+{ 
+  NS_LOG_FUNCTION (this);
+  return m_storageManager.GetMaxBytes ();
+}
+
+void
+BundleProtocol::SetStorageMaxBundles (uint32_t bundles)
+{ 
+  NS_LOG_FUNCTION (this << " " << bundles);
+  m_storageManager.SetMaxBundles (bundles);
+}
+
+uint32_t
+BundleProtocol::GetStorageMaxBundles () const
+{ 
+  NS_LOG_FUNCTION (this);
+  return m_storageManager.GetMaxBundles ();
+}
+
+void
+BundleProtocol::SetEidStorageMaxBytes (uint64_t bytes)
+{ 
+  NS_LOG_FUNCTION (this << " " << bytes);
+  m_storageManager.SetEidMaxBytes (bytes);
+}
+
+uint64_t
+BundleProtocol::GetEidStorageMaxBytes () const
+{ 
+  NS_LOG_FUNCTION (this);
+  return m_storageManager.GetEidMaxBytes ();
+}
+
+void
+BundleProtocol::SetEidStorageMaxBundles (uint32_t bundles)
+{ 
+  NS_LOG_FUNCTION (this << " " << bundles);
+  m_storageManager.SetEidMaxBundles (bundles);
+}
+
+uint32_t
+BundleProtocol::GetEidStorageMaxBundles () const
+{ 
+  NS_LOG_FUNCTION (this);
+  return m_storageManager.GetEidMaxBundles ();
+}
+
+void
+BundleProtocol::SetReassemblyTimeout (Time timeout)
+{ 
+  NS_LOG_FUNCTION (this << " " << timeout.GetSeconds ());
+  m_bpReassembler.SetTimeout (timeout);
+}
+
+Time
+BundleProtocol::GetReassemblyTimeout () const
+{ 
+  NS_LOG_FUNCTION (this);
+  return m_bpReassembler.GetTimeout ();
+}
+
+BpLatencyStats
+BundleProtocol::GetSendLatencyStats (uint8_t priority) const
+{ 
+  NS_LOG_FUNCTION (this << " " << (uint16_t) priority);
+  return BpSendBundleStore.GetLatencyStats (priority);
+}
+
+void
+BundleProtocol::SetWeightedFairQueuing (bool enable)
+{ 
+  NS_LOG_FUNCTION (this << " " << enable);
+  BpSendBundleStore.SetWeightedFairQueuing (enable);
+}
+
+bool
+BundleProtocol::GetWeightedFairQueuing () const
+{ 
+  NS_LOG_FUNCTION (this);
+  return BpSendBundleStore.GetWeightedFairQueuing ();
+}
+
+void
+BundleProtocol::SetWfqQuantum (uint32_t quantum)
+{ 
+  NS_LOG_FUNCTION (this << " " << quantum);
+  BpSendBundleStore.SetQuantum (quantum);
+}
+
+uint32_t
+BundleProtocol::GetWfqQuantum () const
+{ 
+  NS_LOG_FUNCTION (this);
+  return BpSendBundleStore.GetQuantum ();
 }
 
 void 
@@ -593,6 +1016,11 @@ BundleProtocol::DoDispose (void)
   m_node = 0;
   m_cla = 0;
   m_bpRoutingProtocol = 0;
+  m_bpReassembler.Clear ();
+  BpSendBundleStore.Clear ();
+  BpRecvBundleStore.Clear ();
+  m_expirationWheel.Clear ();
+  m_storageManager.Clear ();
   m_startEvent.Cancel ();
   m_stopEvent.Cancel ();
   Object::DoDispose ();
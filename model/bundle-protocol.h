@@ -23,28 +23,42 @@
 #include "bp-cla-protocol.h"
 #include "bp-endpoint-id.h"
 #include "bp-routing-protocol.h"
+#include "bp-bundle-reassembler.h"
+#include "bp-endpoint-map.h"
+#include "bp-bundle-scheduler.h"
+#include "bp-stored-bundle.h"
+#include "bp-timing-wheel.h"
+#include "bp-storage-manager.h"
 #include "ns3/sequence-number.h"
 #include "ns3/object.h"
 #include "ns3/event-id.h"
 #include "ns3/nstime.h"
+#include "ns3/traced-callback.h"
 #include <string>
-#include <map>
+#include <deque>
+#include <vector>
 #include <queue>
 
 namespace ns3 {
 
+class BpHeader;
+
 /**
  * \brief the bundle protocol register information of a endpoint id
  */
 struct BpRegisterInfo {
   BpRegisterInfo () 
     : lifetime (0),
-      state (true)
+      state (true),
+      weight (1),
+      ordered (false)
     {
     }
 
-  double lifetime;   /// the lifetime of a bundle in seconds
+  double lifetime;   /// the lifetime of a bundle in seconds, 0 if the bundles never expire
   bool state;        /// the register state of registration
+  uint32_t weight;   /// the weight of the sent bundles in weighted fair queuing
+  bool ordered;      /// the sent bundles reach each destination in order, even over striped connections
 };
 
 /**
@@ -160,8 +174,9 @@ public:
    * Send the packet p from the source bundle node
    *
    * This methods fragments the data from application layer into several bundles and 
-   * stores the bundles into persistent bundle storage. The bundles are sent in a FIFO
-   * order once the transport layer connection is available to send packets.
+   * stores the bundles into persistent bundle storage. The bundles are sent as bulk
+   * bundles, in a FIFO order once the transport layer connection is available to 
+   * send packets.
    *
    * \param p the bundle to be sent
    * \param src source endpoint id
@@ -172,6 +187,23 @@ public:
    */
   virtual int Send (Ptr<Packet> p, const BpEndpointId &src, const BpEndpointId &dst);
 
+  /**
+   * Send the packet p from the source bundle node with a class of service
+   *
+   * The stored bundles are sent in the order of their class of service, i.e., 
+   * expedited bundles first, then normal bundles, then bulk bundles. Bundles of 
+   * the same class are sent in a FIFO order.
+   *
+   * \param p the bundle to be sent
+   * \param src source endpoint id
+   * \param dst destination endpoint id
+   * \param priority class of service of the bundles, see BpHeader::PriorityClass
+   *
+   * \return returns -1 if the source endpoint id is not registered. Otherwise, it 
+   * returns 0.
+   */
+  virtual int Send (Ptr<Packet> p, const BpEndpointId &src, const BpEndpointId &dst, uint8_t priority);
+
   /**
    * Remove the registration with the eid and close the transport layer connection
    *
@@ -183,7 +215,8 @@ public:
    *  \brief Receive bundle with dst eid
    *
    *  This methods stores the received bundles in a persistent bundle storage. The 
-   *  application can use this method to get the bundles in a FIFO order.
+   *  application can use this method to get the bundles in a FIFO order. A
+   *  fragmented bundle is stored once all its fragments are reassembled.
    *
    *  \param eid destination endpoint id
    *
@@ -194,18 +227,23 @@ public:
   // interfaces to convergence layer (CLA)
 
   /**
-   * Receive bundle from the convergence layer and store the bundle into persistent
-   * bundle storage
+   * Receive a whole bundle from the convergence layer and store the bundle into
+   * persistent bundle storage
    *
-   * \param packet packet received from the transport layer
+   * The convergence layer delimits the bundles itself: a byte stream is
+   * decoded by a BpBundleDecoder of its own connection, so the bundles of
+   * different peers are extracted independently
+   *
+   * \param bundle the received bundle
    */
-  void ReceivePacket (Ptr<Packet> packet);
+  void ReceiveBundle (Ptr<Packet> bundle);
 
   /**
    * Get and delete a bundle from the persistant storage
    *
-   * This method is called by BpClaProtocol to get the first stored bundle 
-   * from the persistant bundle storage for the source endpoint id
+   * This method gets the first stored bundle from the persistant bundle
+   * storage for the source endpoint id; the CLAs drain the storage with
+   * GetBundle (), which serves all the source endpoint ids
    *
    * \param src the source endpoint id
    *
@@ -213,6 +251,112 @@ public:
    */
   virtual Ptr<Packet> GetBundle (const BpEndpointId &src);
 
+  /**
+   * Get and delete the next bundle of all source endpoint ids from the persistant storage
+   *
+   * The bundles are served in the order of their class of service. Within a
+   * class, the source endpoint ids are served in round robin order, or by
+   * weighted fair queuing if the WeightedFairQueuing attribute is set.
+   *
+   * \return the bundle, or NULL if there is no stored bundle
+   */
+  virtual Ptr<Packet> GetBundle ();
+
+  /**
+   * Get the next bundle of all source endpoint ids, which stays in the storage
+   *
+   * The bundle leaves the send queues in the same order as GetBundle (), but
+   * it is still accounted by the storage quotas and still expires, until it
+   * is taken by ReleaseBundle (). A CLA holds the bundles waiting for a
+   * contact this way.
+   *
+   * \return the record of the held bundle, or NULL if there is no stored bundle
+   */
+  Ptr<BpStoredBundle> HoldBundle ();
+
+  /**
+   * Store again a bundle given to the CLA, held out of the send queues
+   *
+   * \param bundle the bundle, e.g., not delivered before the end of a contact
+   *
+   * \return the record of the held bundle, or NULL if the bundle is expired or
+   * does not fit the storage quotas
+   */
+  Ptr<BpStoredBundle> HoldBundle (Ptr<Packet> bundle);
+
+  /**
+   * Take a held bundle out of the storage
+   *
+   * \param record the record returned by HoldBundle ()
+   *
+   * \return the bundle, or NULL if the bundle is expired or evicted meanwhile
+   */
+  Ptr<Packet> ReleaseBundle (Ptr<BpStoredBundle> record);
+
+  /**
+   * Drop a held bundle which can not be forwarded before its lifetime is
+   * over, e.g., without a later contact; the drop is reported by the
+   * BundleExpired trace source
+   *
+   * \param record the record returned by HoldBundle ()
+   */
+  void DropBundle (Ptr<BpStoredBundle> record);
+
+  /**
+   * Get the bundles of the persistant send storage, without removing them
+   *
+   * \param bundles set to the stored bundles, the bundles received for the
+   * other nodes and kept by a relay routing protocol included
+   */
+  void GetStoredBundles (std::vector<Ptr<Packet> > &bundles) const;
+
+  /**
+   * Delete a bundle of the persistant send storage before its turn, e.g., a
+   * bundle a relay routing protocol does not forward any more
+   *
+   * \param bundle a bundle returned by GetStoredBundles ()
+   *
+   * \return false if the bundle is not in the send storage
+   */
+  bool RemoveBundle (Ptr<const Packet> bundle);
+
+  /**
+   * Send a copy of a bundle to a given next hop through the convergence layer,
+   * the bundle is left in the storage
+   *
+   * \param bundle the bundle
+   * \param nextHop the address of the next hop
+   *
+   * \return -1 if the convergence layer cannot send bundles to a given next hop
+   */
+  int ForwardBundle (Ptr<Packet> bundle, const InetSocketAddress &nextHop);
+
+  /**
+   * \param priority class of service, see BpHeader::PriorityClass
+   *
+   * \return the statistics of the time spent by the sent bundles of this class
+   * in the persistant storage
+   */
+  BpLatencyStats GetSendLatencyStats (uint8_t priority) const;
+
+  /**
+   * \return the number of stored bundles dropped because their lifetime is over
+   */
+  uint32_t GetExpiredBundles () const;
+
+  /**
+   * \param src a local endpoint id
+   *
+   * \return true if the sent bundles of src must reach each destination in
+   * the order they are sent, see BpRegisterInfo
+   */
+  bool IsOrdered (const BpEndpointId &src) const;
+
+  /**
+   * \return the quotas and the usage of the persistant storages
+   */
+  const BpStorageManager& GetStorageManager () const;
+
   /**
    * Get node of this bundle protocol
    *
@@ -243,6 +387,14 @@ public:
    */
   Ptr<BpRoutingProtocol> GetRoutingProtocol ();
 
+  /**
+   * Get the convergence layer adapter, which exists once the bundle protocol
+   * is opened
+   *
+   * \return convergence layer adapter
+   */
+  Ptr<BpClaProtocol> GetCla () const;
+
   /**
    * Set the register information
    *
@@ -281,9 +433,14 @@ private:
   void ProcessBundle (Ptr<Packet> bundle);
 
   /**
-   * Retreive bundle from rx buffer
+   * \brief Remove the extension blocks between the primary block and the
+   * payload block of a bundle delivered to a local endpoint id
+   *
+   * \param bundle the bundle
+   *
+   * \return the bundle itself if it has no extension block, a copy otherwise
    */
-  void RetreiveBundle ();
+  Ptr<Packet> RemoveExtensionBlocks (Ptr<Packet> bundle) const;
 
   /**
    * \brief Bundle protocol specific startup code
@@ -302,6 +459,60 @@ private:
    */
   void StopBundleProtocol ();
 
+  // attribute accessors of the sent bundle storage
+  void SetWeightedFairQueuing (bool enable);
+  bool GetWeightedFairQueuing () const;
+  void SetWfqQuantum (uint32_t quantum);
+  uint32_t GetWfqQuantum () const;
+  void SetExpirationGranularity (Time granularity);
+  Time GetExpirationGranularity () const;
+  void SetReassemblyTimeout (Time timeout);
+  Time GetReassemblyTimeout () const;
+  void SetEvictionPolicy (BpStorageManager::EvictionPolicy policy);
+  BpStorageManager::EvictionPolicy GetEvictionPolicy () const;
+  void SetStorageMaxBytes (uint64_t bytes);
+  uint64_t GetStorageMaxBytes () const;
+  void SetStorageMaxBundles (uint32_t bundles);
+  uint32_t GetStorageMaxBundles () const;
+  void SetEidStorageMaxBytes (uint64_t bytes);
+  uint64_t GetEidStorageMaxBytes () const;
+  void SetEidStorageMaxBundles (uint32_t bundles);
+  uint32_t GetEidStorageMaxBundles () const;
+
+  /**
+   * \brief Store a bundle and start its lifetime timer
+   *
+   * The bundle is not stored if its lifetime is already over, or if it is
+   * rejected by the storage quotas.
+   *
+   * \param record the bundle to be stored
+   * \param bph the primary bundle header of the bundle
+   *
+   * \return true if the bundle is stored
+   */
+  bool StartLifetime (Ptr<BpStoredBundle> record, const BpHeader &bph);
+
+  /**
+   * \brief Drop a stored bundle whose lifetime is over
+   *
+   * \param record the expired bundle
+   */
+  void ExpireBundle (Ptr<BpStoredBundle> record);
+
+  /**
+   * \brief Drop a stored bundle evicted by the storage quotas
+   *
+   * \param record the evicted bundle
+   */
+  void EvictBundle (Ptr<BpStoredBundle> record);
+
+  /**
+   * \brief Remove a bundle from its storage before its turn
+   *
+   * \param record the stored bundle
+   */
+  void DiscardBundle (Ptr<BpStoredBundle> record);
+
 private:
   Ptr<Node>           m_node;  /// bundle node            
   Ptr<BpClaProtocol>  m_cla;   /// convergence layer adapter (CLA)
@@ -310,11 +521,19 @@ private:
   std::string m_l4Type;        /// the transport layer type
   std::string m_rtType;        /// the bundle routing protocol type
 
-  std::map<BpEndpointId, std::queue<Ptr<Packet> > > BpSendBundleStore; /// persistant storage of sent bundles: map (source endpoint id, bundle packet queue )
-  std::map<BpEndpointId, std::queue<Ptr<Packet> > > BpRecvBundleStore; /// persistant storage of received bundles: map (destination endpoint id, bundle packet queue )
-  std::map<BpEndpointId, BpRegisterInfo> BpRegistration; /// persistant storage of registrations: map (local endpoint id, registration information)
+  BpBundleScheduler BpSendBundleStore;                          /// persistant storage of sent bundles: queues of (source endpoint id, class of service)
+  BpEndpointMap<std::deque<Ptr<BpStoredBundle> > > BpRecvBundleStore; /// persistant storage of received bundles: map (destination endpoint id, bundle packet queue )
+  BpEndpointMap<BpRegisterInfo> BpRegistration; /// persistant storage of registrations: map (local endpoint id, registration information)
+
+  BpTimingWheel<Ptr<BpStoredBundle> > m_expirationWheel; /// lifetime timers of the stored bundles
+  uint32_t m_expiredBundles;                              /// number of expired bundles
+  TracedCallback<Ptr<const Packet> > m_expireTrace;       /// a stored bundle is dropped because its lifetime is over
+
+  BpStorageManager m_storageManager;                      /// quotas of the persistant storages
+  TracedCallback<Ptr<const Packet> > m_evictTrace;        /// a stored bundle is dropped to store a new bundle
+  TracedCallback<Ptr<const Packet> > m_rejectTrace;       /// a new bundle is not stored because of the quotas
 
-  Ptr<Packet> m_bpRxBufferPacket; /// a buffer for all packets received from the CLA; bundles are retreived from this buffer
+  BpBundleReassembler m_bpReassembler; /// reassembly of the received fragments
 
   SequenceNumber32 m_seq;         /// the bundle sequence number
 
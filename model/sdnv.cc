@@ -22,13 +22,66 @@
 
 #include <algorithm>
 #include <stdint.h>
+#include <string.h>
 #include "ns3/log.h"
 #include "sdnv.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 NS_LOG_COMPONENT_DEFINE ("SDNV");
 
 namespace ns3 {
 
+/**
+ * \brief Collect the high bits of 16 bytes
+ *
+ * \param data 16 bytes
+ * \return bit k is set if byte k is followed by another byte of the same integer
+ */
+static inline uint32_t
+ContinuationMask (const uint8_t *data)
+{
+#if defined(__SSE2__)
+  return _mm_movemask_epi8 (_mm_loadu_si128 ((const __m128i *) data));
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  // gather the high bit of each byte of a word into its top byte
+  uint64_t low, high;
+  memcpy (&low, data, 8);
+  memcpy (&high, data + 8, 8);
+  low = (((low & 0x8080808080808080ULL) >> 7) * 0x0102040810204080ULL) >> 56;
+  high = (((high & 0x8080808080808080ULL) >> 7) * 0x0102040810204080ULL) >> 56;
+  return (uint32_t) (low | (high << 8));
+#else
+  uint32_t mask = 0;
+  for (uint32_t k = 0; k < 16; k++)
+  {
+    mask |= (uint32_t) (data[k] >> 7) << k;
+  }
+  return mask;
+#endif
+}
+
+/**
+ * \return the index of the lowest set bit of a non zero mask
+ */
+static inline uint32_t
+LowestBit (uint32_t mask)
+{
+#if defined(__GNUC__)
+  return __builtin_ctz (mask);
+#else
+  uint32_t k = 0;
+  while ((mask & 1) == 0)
+  {
+    mask >>= 1;
+    k++;
+  }
+  return k;
+#endif
+}
+
 SDNV::SDNV ()
 {
   NS_LOG_FUNCTION (this);
@@ -67,6 +120,37 @@ SDNV::Encode (uint64_t val)
   return data;
 }
 
+uint32_t
+SDNV::Encode (uint64_t val, uint8_t *buf)
+{
+  NS_LOG_FUNCTION (this << " " << val);
+  uint32_t len = EncodingLength (val);
+
+  // the last byte is the only one without the high bit set
+  uint8_t *p = buf + len - 1;
+  *p = val & 0x7F;
+  val >>= 7;
+  while (val)
+  {
+    --p;
+    *p = (val & 0x7F) | 0x80;
+    val >>= 7;
+  }
+
+  return len;
+}
+
+uint32_t
+SDNV::Encode (uint64_t val, Buffer::Iterator &start)
+{
+  NS_LOG_FUNCTION (this << " " << val);
+  uint8_t encoded[SDNV_MAX_LENGTH];
+  uint32_t len = Encode (val, encoded);
+  start.Write (encoded, len);
+
+  return len;
+}
+
 uint32_t
 SDNV::EncodingLength(uint64_t val)
 {
@@ -105,18 +189,76 @@ uint64_t
 SDNV::Decode (Buffer::Iterator &start)
 {
   NS_LOG_FUNCTION (this);
-  std::vector<uint8_t> vec;
+  uint64_t decoded = 0;
+  uint8_t val;
 
-  // check the last byte of a variable in the buffer
+  // accumulate until the last byte of a variable in the buffer
   do {
-    uint8_t val = start.ReadU8 ();
-    vec.push_back (val);
+    val = start.ReadU8 ();
+    decoded = (decoded << 7) | (val & 0x7F);
+  } while (!IsLast (val));
 
-    if (IsLast (val))
-      break;
-  } while (1);
+  return decoded;
+}
+
+uint32_t
+SDNV::Decode (const uint8_t *data, uint32_t len, uint64_t *values, uint32_t count)
+{
+  NS_LOG_FUNCTION (this << " " << len << " " << count);
+  uint32_t pos = 0;       // next byte to accumulate
+  uint32_t n = 0;         // decoded integers
+  uint64_t decoded = 0;
+  uint32_t decodedLen = 0;
+
+  // 16 bytes at a time: the clear high bits mark the end of the integers
+  uint32_t chunk = 0;
+  while (n < count && chunk + 16 <= len)
+  {
+    uint32_t ends = ~ContinuationMask (data + chunk) & 0xFFFF;
+    while (ends && n < count)
+    {
+      uint32_t end = chunk + LowestBit (ends);
+      decodedLen += end + 1 - pos;
+      if (decodedLen > SDNV_MAX_LENGTH)
+        return 0;
+      for (; pos <= end; pos++)
+      {
+        decoded = (decoded << 7) | (data[pos] & 0x7F);
+      }
+      values[n++] = decoded;
+      decoded = 0;
+      decodedLen = 0;
+      ends &= ends - 1;
+    }
+    if (n == count)
+      return pos;
+
+    // the integer continues in the next chunk
+    chunk += 16;
+    decodedLen += chunk - pos;
+    if (decodedLen > SDNV_MAX_LENGTH)
+      return 0;
+    for (; pos < chunk; pos++)
+    {
+      decoded = (decoded << 7) | (data[pos] & 0x7F);
+    }
+  }
+
+  // scalar tail
+  for (; n < count && pos < len; pos++)
+  {
+    decoded = (decoded << 7) | (data[pos] & 0x7F);
+    if (++decodedLen > SDNV_MAX_LENGTH)
+      return 0;
+    if ((data[pos] & 0x80) == 0)
+    {
+      values[n++] = decoded;
+      decoded = 0;
+      decodedLen = 0;
+    }
+  }
 
-  return Decode (vec);
+  return (n == count) ? pos : 0;
 }
 
 uint32_t 
@@ -27,6 +27,11 @@
 
 namespace ns3 {
 
+/**
+ * the maximum number of bytes of an encoded 64 bits integer
+ */
+#define SDNV_MAX_LENGTH 10
+
 /**
  * \brief an implementation class of self-delimiting numeric values based on RFC 6256
  */
@@ -54,9 +59,31 @@ public:
   std::vector<uint8_t> Encode (uint64_t val);
 
   /**
-   * [EncodingLength description]
-   * @param  val [description]
-   * @return     [description]
+   * \brief SDNV encoding algorithm writing into a Buffer
+   *
+   * The length of the encoded integer is computed first, so the bytes are
+   * written in their final order without any temporary storage.
+   *
+   * \param val value need to be encoded
+   * \param start buffer iterator reference; it is moved after the encoded integer
+   * \return the number of bytes written
+   */
+  uint32_t Encode (uint64_t val, Buffer::Iterator &start);
+
+  /**
+   * \brief SDNV encoding algorithm writing into a byte array
+   *
+   * \param val value need to be encoded
+   * \param buf destination, at least EncodingLength (val) bytes long
+   * \return the number of bytes written
+   */
+  uint32_t Encode (uint64_t val, uint8_t *buf);
+
+  /**
+   * \brief Number of bytes of an encoded integer
+   *
+   * \param val value need to be encoded
+   * \return the number of bytes of the encoded integer
    */
   uint32_t EncodingLength(uint64_t val);
 
@@ -83,6 +110,23 @@ public:
    */
   uint64_t Decode (Buffer::Iterator &start);
 
+  /**
+   * \brief SDNV decoding algorithm for consecutive integers
+   *
+   * This method decodes count consecutive integers from a contiguous byte
+   * array in a single pass. The bytes that end an integer are located 16 at
+   * a time from their high bits (a SSE2 movemask when available, a SWAR bit
+   * gather or a plain loop otherwise).
+   *
+   * \param data the encoded integers
+   * \param len the number of bytes available in data
+   * \param values the decoded integers, at least count entries
+   * \param count the number of integers to decode
+   * \return the number of bytes consumed, or 0 if the data is truncated or
+   *         holds an integer longer than SDNV_MAX_LENGTH bytes
+   */
+  uint32_t Decode (const uint8_t *data, uint32_t len, uint64_t *values, uint32_t count);
+
   /**
    * [Length description]
    * @param  val [description]
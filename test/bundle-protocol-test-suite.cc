@@ -20,6 +20,10 @@
 
 #include <string>
 #include <fstream>
+#include <algorithm>
+#include <ctime>
+#include <sstream>
+#include <set>
 #include <tgmath.h>
 #include "ns3/bp-endpoint-id.h"
 #include "ns3/bundle-protocol.h"
@@ -30,8 +34,27 @@
 #include "ns3/bp-endpoint-id.h"
 #include "ns3/bundle-protocol.h"
 #include "ns3/bp-static-routing-protocol.h"
+#include "ns3/bp-tcp-cla-protocol.h"
+#include "ns3/bp-cgr-routing-protocol.h"
 #include "ns3/bundle-protocol-helper.h"
 #include "ns3/bundle-protocol-container.h"
+#include "ns3/bp-header.h"
+#include "ns3/bp-payload-header.h"
+#include "ns3/bp-bundle-decoder.h"
+#include "ns3/sdnv.h"
+#include "ns3/bp-endpoint-map.h"
+#include "ns3/bp-bundle-scheduler.h"
+#include "ns3/bp-timing-wheel.h"
+#include "ns3/bp-storage-manager.h"
+#include "ns3/bp-bundle-reassembler.h"
+#include "ns3/bp-tcpcl-session.h"
+#include "ns3/bp-ltp-engine.h"
+#include "ns3/bp-contact-plan.h"
+#include "ns3/bp-prefix-trie.h"
+#include "ns3/bp-bloom-filter.h"
+#include "ns3/bp-epidemic-routing-protocol.h"
+#include "ns3/bp-spray-and-wait-routing-protocol.h"
+#include "ns3/bp-copy-count-header.h"
 #include "ns3/test.h"
 
 NS_LOG_COMPONENT_DEFINE ("BundleProtocolTestSuite");
@@ -41,7 +64,8 @@ using namespace ns3;
 class BundleProtocolTestCase : public TestCase
 {
 public:
-  BundleProtocolTestCase (uint32_t sentBundleSize, uint32_t bundleSize, uint32_t segmentSize, std::string claType);
+  BundleProtocolTestCase (uint32_t sentBundleSize, uint32_t bundleSize, uint32_t segmentSize, std::string claType,
+                          uint32_t sndBufSize = 131072, uint32_t stripes = 1, uint32_t aggregationSize = 0);
   virtual ~BundleProtocolTestCase ();
 
 private:
@@ -56,6 +80,367 @@ private:
   uint32_t m_bundleSize;
   uint32_t m_tcpSegmentSize;
   std::string m_claType;
+  uint32_t m_tcpSndBufSize;
+  uint32_t m_stripes;
+  uint32_t m_aggregationSize;
+};
+
+class BundleProtocolMultiPeerTestCase : public TestCase
+{
+public:
+  BundleProtocolMultiPeerTestCase ();
+  virtual ~BundleProtocolMultiPeerTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Send (Ptr<BundleProtocol> sender, uint32_t size, BpEndpointId src, BpEndpointId dst);
+  void Receive (Ptr<BundleProtocol> receiver, BpEndpointId eid);
+
+  uint32_t m_receivedBundleSize;
+  uint32_t m_receivedBundleNumber;
+};
+
+class BpBundleDecoderTestCase : public TestCase
+{
+public:
+  BpBundleDecoderTestCase (uint32_t payloadSize, uint32_t segmentSize);
+  virtual ~BpBundleDecoderTestCase ();
+
+private:
+  virtual void DoRun (void);
+  Ptr<Packet> BuildBundle (uint32_t seq);
+
+private:
+  uint32_t m_payloadSize;
+  uint32_t m_segmentSize;
+};
+
+class SdnvTestCase : public TestCase
+{
+public:
+  SdnvTestCase ();
+  virtual ~SdnvTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+class SdnvBenchmarkTestCase : public TestCase
+{
+public:
+  SdnvBenchmarkTestCase (uint32_t count);
+  virtual ~SdnvBenchmarkTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+private:
+  uint32_t m_count;
+};
+
+class BpEndpointMapTestCase : public TestCase
+{
+public:
+  BpEndpointMapTestCase (uint32_t count);
+  virtual ~BpEndpointMapTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+private:
+  uint32_t m_count;
+};
+
+class BpBundleSchedulerTestCase : public TestCase
+{
+public:
+  BpBundleSchedulerTestCase ();
+  virtual ~BpBundleSchedulerTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+class BpTimingWheelTestCase : public TestCase
+{
+public:
+  BpTimingWheelTestCase (uint32_t count);
+  virtual ~BpTimingWheelTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Expire (uint32_t timer);
+
+private:
+  uint32_t m_count;
+  std::vector<Time> m_fired;
+};
+
+class BpStorageManagerTestCase : public TestCase
+{
+public:
+  BpStorageManagerTestCase ();
+  virtual ~BpStorageManagerTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Evict (Ptr<BpStoredBundle> record);
+
+private:
+  std::vector<Ptr<BpStoredBundle> > m_evicted;
+};
+
+class BpBundleReassemblerTestCase : public TestCase
+{
+public:
+  BpBundleReassemblerTestCase ();
+  virtual ~BpBundleReassemblerTestCase ();
+
+private:
+  virtual void DoRun (void);
+  Ptr<Packet> BuildFragment (const std::vector<uint8_t> &adu, uint32_t offset, uint32_t size, uint32_t seq);
+};
+
+class BpTcpclSessionTestCase : public TestCase
+{
+public:
+  BpTcpclSessionTestCase ();
+  virtual ~BpTcpclSessionTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Connect ();
+  int Transmit (Ptr<BpTcpclSession> from, Ptr<Packet> packet);
+  void Deliver (Ptr<BpTcpclSession> to, Ptr<Packet> packet);
+  void Received (Ptr<BpTcpclSession> session, Ptr<Packet> bundle);
+  bool IsReceived (const std::vector<uint8_t> &data);
+
+  Ptr<BpTcpclSession> m_a;              /// sender session
+  Ptr<BpTcpclSession> m_b;              /// receiver session
+  bool m_linkUp;                        /// false once the link is cut
+  uint32_t m_cutAfter;                  /// bytes sent by m_a before the link is cut, 0 if never
+  uint32_t m_sent;                      /// bytes sent by m_a
+  uint32_t m_maxInFlight;               /// the most segments of m_a not acknowledged
+  std::vector<Ptr<Packet> > m_received; /// bundles received by m_b
+};
+
+class BpLtpEngineTestCase : public TestCase
+{
+public:
+  BpLtpEngineTestCase ();
+  virtual ~BpLtpEngineTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Reset ();
+  void TransmitA (uint64_t peer, Ptr<Packet> segment);
+  void TransmitB (uint64_t peer, Ptr<Packet> segment);
+  void Received (uint64_t peer, Ptr<Packet> block);
+  bool IsReceived (const std::vector<uint8_t> &data);
+
+  BpLtpEngine m_a;                      /// sender engine, id 1
+  BpLtpEngine m_b;                      /// receiver engine, id 2
+  bool m_linkUp;                        /// false if all the segments are lost
+  std::set<uint32_t> m_drop;            /// indexes of the lost segments of m_a
+  uint32_t m_segments;                  /// segments sent by m_a
+  std::vector<Ptr<Packet> > m_received; /// blocks received by m_b
+};
+
+class BpContactPlanTestCase : public TestCase
+{
+public:
+  BpContactPlanTestCase ();
+  virtual ~BpContactPlanTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+class BpRoutingProtocolTestCase : public TestCase
+{
+public:
+  BpRoutingProtocolTestCase ();
+  virtual ~BpRoutingProtocolTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Forward (Ptr<const Packet> bundle, const InetSocketAddress &nextHop);
+
+  std::vector<InetSocketAddress> m_forwarded;   /// next hops reported by the forward callback
+};
+
+class BpPrefixTrieTestCase : public TestCase
+{
+public:
+  BpPrefixTrieTestCase ();
+  virtual ~BpPrefixTrieTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * \return the value of the longest prefix of key by a linear search, or -1
+   */
+  int32_t FindLongestPrefix (const std::map<std::string, int32_t> &prefixes, const std::string &key);
+};
+
+class BpCgrRoutingProtocolTestCase : public TestCase
+{
+public:
+  BpCgrRoutingProtocolTestCase ();
+  virtual ~BpCgrRoutingProtocolTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void CheckExpiry (void);
+
+  Ptr<BpCgrRoutingProtocol> m_cgr;   /// the routing protocol of the local node
+  BpEndpointId m_dst;                /// the endpoint id on the destination node
+};
+
+/**
+ * \brief Test the Bloom filter of the summary vectors and the duplicate
+ * detection of the epidemic routing protocol
+ */
+class BpEpidemicRoutingProtocolTestCase : public TestCase
+{
+public:
+  BpEpidemicRoutingProtocolTestCase ();
+  virtual ~BpEpidemicRoutingProtocolTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+/**
+ * \brief Test the copy count block and the copies handed to the peers by
+ * the spray and wait routing protocol
+ */
+class BpSprayAndWaitRoutingProtocolTestCase : public TestCase
+{
+public:
+  BpSprayAndWaitRoutingProtocolTestCase ();
+  virtual ~BpSprayAndWaitRoutingProtocolTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+/**
+ * \brief Test that the expedited bundles of a source endpoint id overtake the
+ * bulk bundles of another one stored in the same node, through the TCP CLA
+ */
+class BundleProtocolPriorityTestCase : public TestCase
+{
+public:
+  BundleProtocolPriorityTestCase ();
+  virtual ~BundleProtocolPriorityTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Send (Ptr<BundleProtocol> sender, uint32_t count, uint32_t size, BpEndpointId src, BpEndpointId dst, uint8_t priority);
+  void Receive (Ptr<BundleProtocol> receiver, BpEndpointId eid);
+
+  std::vector<uint32_t> m_receivedSizes;   /// the sizes of the received ADUs, in order
+};
+
+/**
+ * \brief Test the striped TCP connections: an ordered flow stays on one
+ * stripe and keeps its order, the other bundles spread over all the stripes
+ */
+class BundleProtocolStripeTestCase : public TestCase
+{
+public:
+  BundleProtocolStripeTestCase ();
+  virtual ~BundleProtocolStripeTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Send (Ptr<BundleProtocol> sender, uint32_t count, uint32_t size, BpEndpointId src, BpEndpointId dst);
+  void Receive (Ptr<BundleProtocol> receiver, BpEndpointId eid);
+  void SaveStats (Ptr<BundleProtocol> sender, InetSocketAddress nextHop, std::vector<BpTcpClaProtocol::StripeStats> *stats);
+
+  std::vector<uint32_t> m_orderedSequence;   /// the sequence numbers of the received ADUs of the ordered flow
+  uint32_t m_receivedBundleNumber;           /// the received ADUs of the unordered source
+  std::vector<BpTcpClaProtocol::StripeStats> m_orderedStats;   /// the stripe stats after the ordered flow
+  std::vector<BpTcpClaProtocol::StripeStats> m_stats;          /// the stripe stats after both sources
+};
+
+/**
+ * \brief Test the delivery of bundles between two nodes of the epidemic
+ * routing protocol, which meet through their beacons, over a convergence
+ * layer which does not report the links
+ */
+class BpEpidemicEndToEndTestCase : public TestCase
+{
+public:
+  BpEpidemicEndToEndTestCase (std::string claType);
+  virtual ~BpEpidemicEndToEndTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Send (Ptr<BundleProtocol> sender, uint32_t count, uint32_t size, BpEndpointId src, BpEndpointId dst);
+  void Receive (Ptr<BundleProtocol> receiver, BpEndpointId eid);
+
+  std::string m_claType;             /// the convergence layer, "Udp" or "Ltp"
+  uint32_t m_receivedBundleSize;     /// the bytes of the received ADUs
+  uint32_t m_receivedBundleNumber;   /// the number of received ADUs
+};
+
+/**
+ * \brief Test the spray and wait routing protocol along a chain of a
+ * source, two relays and a destination, which meet through their beacons
+ */
+class BpSprayAndWaitEndToEndTestCase : public TestCase
+{
+public:
+  BpSprayAndWaitEndToEndTestCase (std::string claType);
+  virtual ~BpSprayAndWaitEndToEndTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Send (Ptr<BundleProtocol> sender, uint32_t size, BpEndpointId src, BpEndpointId dst);
+  void Receive (Ptr<BundleProtocol> receiver, BpEndpointId eid);
+
+  std::string m_claType;             /// the convergence layer, "Udp" or "Ltp"
+  uint32_t m_receivedBundleSize;     /// the bytes of the received ADUs
+  uint32_t m_receivedBundleNumber;   /// the number of received ADUs
+  BpHeader m_sent;                   /// the primary bundle header of the bundle sent
+};
+
+/**
+ * \brief Test that a received primary bundle header which is modified is
+ * serialized again with the new values
+ */
+class BpHeaderTestCase : public TestCase
+{
+public:
+  BpHeaderTestCase ();
+  virtual ~BpHeaderTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+/**
+ * \brief Test that the bundles held for a contact stay within the storage
+ * quotas and the lifetime of the stored bundles
+ */
+class BundleProtocolContactTestCase : public TestCase
+{
+public:
+  BundleProtocolContactTestCase ();
+  virtual ~BundleProtocolContactTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Send (Ptr<BundleProtocol> sender, uint32_t count, uint32_t size, BpEndpointId src, BpEndpointId dst);
+  void Receive (Ptr<BundleProtocol> receiver, BpEndpointId eid);
+  void SaveHeld (Ptr<BundleProtocol> sender, Ipv4Address nextHop);
+
+  uint32_t m_receivedBundleNumber;    /// the number of received ADUs
+  std::vector<uint32_t> m_held;       /// the bundles held for the next hop at each check
+  std::vector<uint32_t> m_expired;    /// the expired bundles of the sender at each check
 };
 
 static class BundleProtocolTestSuite : public TestSuite
@@ -69,19 +454,55 @@ public:
       AddTestCase (new BundleProtocolTestCase (1000, 400, 512, "Tcp"), TestCase::QUICK);
       AddTestCase (new BundleProtocolTestCase (1000, 512, 512, "Tcp"), TestCase::QUICK);
       AddTestCase (new BundleProtocolTestCase (1000, 1000, 512, "Tcp"), TestCase::QUICK);
+      AddTestCase (new BundleProtocolTestCase (20000, 400, 512, "Tcp", 4096), TestCase::QUICK);
+      AddTestCase (new BundleProtocolTestCase (20000, 400, 512, "Tcp", 4096, 4), TestCase::QUICK);
+      AddTestCase (new BundleProtocolTestCase (5000, 100, 512, "Tcp", 131072, 1, 1400), TestCase::QUICK);
+      AddTestCase (new BundleProtocolTestCase (1000, 400, 512, "Udp"), TestCase::QUICK);
+      AddTestCase (new BundleProtocolTestCase (5000, 2000, 512, "Udp"), TestCase::QUICK);
+      AddTestCase (new BundleProtocolTestCase (5000, 2000, 512, "Ltp"), TestCase::QUICK);
+      AddTestCase (new BundleProtocolMultiPeerTestCase (), TestCase::QUICK);
+      AddTestCase (new BundleProtocolPriorityTestCase (), TestCase::QUICK);
+      AddTestCase (new BundleProtocolStripeTestCase (), TestCase::QUICK);
+      AddTestCase (new BundleProtocolContactTestCase (), TestCase::QUICK);
+      AddTestCase (new BpBundleDecoderTestCase (400, 1), TestCase::QUICK);
+      AddTestCase (new BpBundleDecoderTestCase (400, 7), TestCase::QUICK);
+      AddTestCase (new BpBundleDecoderTestCase (400, 1500), TestCase::QUICK);
+      AddTestCase (new BpHeaderTestCase (), TestCase::QUICK);
+      AddTestCase (new SdnvTestCase (), TestCase::QUICK);
+      AddTestCase (new BpEndpointMapTestCase (10000), TestCase::QUICK);
+      AddTestCase (new BpBundleSchedulerTestCase (), TestCase::QUICK);
+      AddTestCase (new BpTimingWheelTestCase (1000), TestCase::QUICK);
+      AddTestCase (new BpStorageManagerTestCase (), TestCase::QUICK);
+      AddTestCase (new BpBundleReassemblerTestCase (), TestCase::QUICK);
+      AddTestCase (new BpTcpclSessionTestCase (), TestCase::QUICK);
+      AddTestCase (new BpLtpEngineTestCase (), TestCase::QUICK);
+      AddTestCase (new BpContactPlanTestCase (), TestCase::QUICK);
+      AddTestCase (new BpRoutingProtocolTestCase (), TestCase::QUICK);
+      AddTestCase (new BpPrefixTrieTestCase (), TestCase::QUICK);
+      AddTestCase (new BpCgrRoutingProtocolTestCase (), TestCase::QUICK);
+      AddTestCase (new BpEpidemicRoutingProtocolTestCase (), TestCase::QUICK);
+      AddTestCase (new BpEpidemicEndToEndTestCase ("Udp"), TestCase::QUICK);
+      AddTestCase (new BpEpidemicEndToEndTestCase ("Ltp"), TestCase::QUICK);
+      AddTestCase (new BpSprayAndWaitRoutingProtocolTestCase (), TestCase::QUICK);
+      AddTestCase (new BpSprayAndWaitEndToEndTestCase ("Udp"), TestCase::QUICK);
+      AddTestCase (new BpSprayAndWaitEndToEndTestCase ("Ltp"), TestCase::QUICK);
+      AddTestCase (new SdnvBenchmarkTestCase (1000000), TestCase::EXTENSIVE);
     }
 
 } g_bundleProtocolTestSuite;
 
 BundleProtocolTestCase::BundleProtocolTestCase (uint32_t sentBundleSize, uint32_t bundleSize, uint32_t segmentSize, 
-    std::string claType)
+    std::string claType, uint32_t sndBufSize, uint32_t stripes, uint32_t aggregationSize)
   : TestCase ("Test that all the bundles generated by a sender bundle node are correctly received by a receiver bundle node"),
     m_sentBundleSize (sentBundleSize),
     m_receivedBundleSize (0),
     m_receivedBundleNumber (0),
     m_bundleSize (bundleSize),
     m_tcpSegmentSize (segmentSize),
-    m_claType (claType)
+    m_claType (claType),
+    m_tcpSndBufSize (sndBufSize),
+    m_stripes (stripes),
+    m_aggregationSize (aggregationSize)
 {
 }
 
@@ -116,6 +537,9 @@ BundleProtocolTestCase::DoRun (void)
   Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue (l4type.str ()));
   Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (m_bundleSize)); 
   Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (m_tcpSegmentSize));
+  Config::SetDefault ("ns3::TcpSocket::SndBufSize", UintegerValue (m_tcpSndBufSize));
+  Config::SetDefault ("ns3::BpTcpClaProtocol::Stripes", UintegerValue (m_stripes));
+  Config::SetDefault ("ns3::BpTcpClaProtocol::AggregationSize", UintegerValue (m_aggregationSize));
 
   // build endpoint ids
   BpEndpointId eidSender ("dtn", "node0");
@@ -151,11 +575,8 @@ BundleProtocolTestCase::DoRun (void)
   Simulator::Run ();
   Simulator::Destroy ();
 
-  double received = m_receivedBundleSize;
-  double bundleSize = m_bundleSize;
-  uint32_t num = ceil (received/bundleSize);
   NS_TEST_EXPECT_MSG_EQ (m_receivedBundleSize, m_sentBundleSize, "All bundles are received at the receiver");
-  NS_TEST_EXPECT_MSG_EQ (m_receivedBundleNumber, num , "Correct number of bundles are received at the receiver");
+  NS_TEST_EXPECT_MSG_EQ (m_receivedBundleNumber, 1, "The fragments are reassembled into one bundle at the receiver");
 
 }
 
@@ -179,3 +600,2200 @@ BundleProtocolTestCase::Receive (Ptr<BundleProtocol> receiver, BpEndpointId eid)
     }
 }
 
+
+BpBundleDecoderTestCase::BpBundleDecoderTestCase (uint32_t payloadSize, uint32_t segmentSize)
+  : TestCase ("Test that the bundle decoder delimits bundles split across transport layer segments"),
+    m_payloadSize (payloadSize),
+    m_segmentSize (segmentSize)
+{
+}
+
+BpBundleDecoderTestCase::~BpBundleDecoderTestCase ()
+{
+}
+
+Ptr<Packet>
+BpBundleDecoderTestCase::BuildBundle (uint32_t seq)
+{
+  BpHeader bph;
+  bph.SetDestinationEid (BpEndpointId ("dtn", "node1"));
+  bph.SetSourceEid (BpEndpointId ("dtn", "node0"));
+  bph.SetSequenceNumber (SequenceNumber32 (seq));
+
+  BpPayloadHeader bpph;
+  bpph.SetBlockLength (m_payloadSize);
+
+  Ptr<Packet> bundle = Create<Packet> (m_payloadSize);
+  bundle->AddHeader (bpph);
+  bundle->AddHeader (bph);
+
+  return bundle;
+}
+
+void
+BpBundleDecoderTestCase::DoRun (void)
+{
+  // two bundles back to back in a single byte stream
+  Ptr<Packet> first = BuildBundle (0);
+  Ptr<Packet> second = BuildBundle (1);
+  Ptr<Packet> stream = first->Copy ();
+  stream->AddAtEnd (second);
+
+  BpBundleDecoder decoder;
+  uint32_t completed = 0;
+  for (uint32_t offset = 0; offset < stream->GetSize (); offset += m_segmentSize)
+    {
+      uint32_t len = std::min (m_segmentSize, stream->GetSize () - offset);
+      completed += decoder.Feed (stream->CreateFragment (offset, len));
+    }
+
+  NS_TEST_ASSERT_MSG_EQ (completed, 2, "Both bundles are delimited");
+  NS_TEST_EXPECT_MSG_EQ (decoder.GetPendingSize (), 0, "No partial bundle is left in the decoder");
+
+  Ptr<Packet> bundle = decoder.GetBundle ();
+  NS_TEST_ASSERT_MSG_EQ ((bundle != 0), true, "First bundle is available");
+  NS_TEST_EXPECT_MSG_EQ (bundle->GetSize (), first->GetSize (), "First bundle has the sent size");
+
+  BpHeader bph;
+  BpPayloadHeader bpph;
+  bundle->RemoveHeader (bph);
+  bundle->RemoveHeader (bpph);
+  NS_TEST_EXPECT_MSG_EQ (bph.GetSequenceNumber ().GetValue (), 0, "First bundle is received first");
+  NS_TEST_EXPECT_MSG_EQ (bph.GetDestinationEid ().Uri (), "dtn:node1", "Destination endpoint id is decoded");
+  NS_TEST_EXPECT_MSG_EQ (bph.GetSourceEid ().Uri (), "dtn:node0", "Source endpoint id is decoded");
+
+  // a received header is serialized again from its encoded image
+  Ptr<Packet> forwarded = Create<Packet> (0);
+  forwarded->AddHeader (bph);
+  NS_TEST_EXPECT_MSG_EQ (forwarded->GetSize (), bph.GetSerializedSize (), "Received header keeps its size");
+  BpHeader copy;
+  forwarded->RemoveHeader (copy);
+  NS_TEST_EXPECT_MSG_EQ (copy.GetSequenceNumber ().GetValue (), 0, "Serialized image matches the received header");
+  NS_TEST_EXPECT_MSG_EQ (bundle->GetSize (), m_payloadSize, "First bundle carries the whole payload");
+
+  bundle = decoder.GetBundle ();
+  NS_TEST_ASSERT_MSG_EQ ((bundle != 0), true, "Second bundle is available");
+  bundle->PeekHeader (bph);
+  NS_TEST_EXPECT_MSG_EQ (bph.GetSequenceNumber ().GetValue (), 1, "Second bundle is received second");
+
+  // the payload block data is referenced in the bundle, not carried by the header
+  bundle->RemoveHeader (bph);
+  bundle->PeekHeader (bpph);
+  NS_TEST_EXPECT_MSG_EQ (bpph.GetSerializedSize () + m_payloadSize, bundle->GetSize (), "Payload block header does not hold the payload");
+  NS_TEST_EXPECT_MSG_EQ (bpph.GetPayload (bundle)->GetSize (), m_payloadSize, "Payload is a fragment of the bundle");
+  NS_TEST_EXPECT_MSG_EQ ((decoder.GetBundle () == 0), true, "No other bundle is decoded");
+
+  // a primary block length past the end of the packet is a malformed block
+  uint8_t forged[] = { 0x06, 0x00, 0x8F, 0xFF, 0xFF, 0x7F, 0x00, 0x00 };
+  Ptr<Packet> corrupted = Create<Packet> (forged, sizeof (forged));
+  BpHeader malformed;
+  NS_TEST_EXPECT_MSG_EQ (corrupted->RemoveHeader (malformed), 6, "Only the fields before the block are read");
+  NS_TEST_EXPECT_MSG_EQ (malformed.GetBlockLength (), 0, "The block length is not trusted");
+
+  // the decoder drops a too long SDNV and decodes the bundle right after it
+  uint8_t garbage[] = { 0x06, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+  Ptr<Packet> resync = Create<Packet> (garbage, sizeof (garbage));
+  resync->AddAtEnd (first);
+  BpBundleDecoder resyncDecoder;
+  NS_TEST_EXPECT_MSG_EQ (resyncDecoder.Feed (resync), 1, "The bundle after the corrupted field is delimited");
+  NS_TEST_EXPECT_MSG_EQ (resyncDecoder.GetPendingSize (), 0, "No byte is left in the decoder");
+
+  bundle = resyncDecoder.GetBundle ();
+  NS_TEST_ASSERT_MSG_EQ ((bundle != 0), true, "The bundle after the corrupted field is available");
+  NS_TEST_ASSERT_MSG_EQ (bundle->GetSize (), first->GetSize (), "The bundle keeps its first bytes");
+  std::vector<uint8_t> expected (first->GetSize ());
+  std::vector<uint8_t> decoded (bundle->GetSize ());
+  first->CopyData (&expected[0], expected.size ());
+  bundle->CopyData (&decoded[0], decoded.size ());
+  NS_TEST_EXPECT_MSG_EQ ((decoded == expected), true, "The bundle is decoded byte for byte");
+  NS_TEST_EXPECT_MSG_EQ ((resyncDecoder.GetBundle () == 0), true, "No empty bundle is decoded");
+}
+
+SdnvTestCase::SdnvTestCase ()
+  : TestCase ("Test that SDNV encoding into a buffer matches the vector encoding and decodes back, one by one and in batch")
+{
+}
+
+SdnvTestCase::~SdnvTestCase ()
+{
+}
+
+void
+SdnvTestCase::DoRun (void)
+{
+  SDNV sdnv;
+  uint64_t values[] = { 0, 1, 127, 128, 16383, 16384, 0xFFFFFFFFULL, 0xFFFFFFFFFFFFFFFFULL };
+
+  for (uint32_t k = 0; k < sizeof (values) / sizeof (values[0]); k++)
+    {
+      std::vector<uint8_t> expected = sdnv.Encode (values[k]);
+
+      uint8_t encoded[SDNV_MAX_LENGTH];
+      uint32_t len = sdnv.Encode (values[k], encoded);
+      NS_TEST_ASSERT_MSG_EQ (len, expected.size (), "Same encoding length for " << values[k]);
+      NS_TEST_EXPECT_MSG_EQ (len, sdnv.EncodingLength (values[k]), "Encoding length is known in advance for " << values[k]);
+      for (uint32_t b = 0; b < len; b++)
+        {
+          NS_TEST_EXPECT_MSG_EQ ((uint16_t) encoded[b], (uint16_t) expected[b], "Same encoded byte for " << values[k]);
+        }
+
+      Buffer buffer;
+      buffer.AddAtStart (len);
+      Buffer::Iterator i = buffer.Begin ();
+      NS_TEST_EXPECT_MSG_EQ (sdnv.Encode (values[k], i), len, "Same length written into a buffer for " << values[k]);
+      i = buffer.Begin ();
+      NS_TEST_EXPECT_MSG_EQ (sdnv.Decode (i), values[k], "Decoded value matches for " << values[k]);
+    }
+
+  // batch decoding of the values repeated across several 16 bytes chunks
+  uint32_t count = sizeof (values) / sizeof (values[0]);
+  std::vector<uint8_t> stream;
+  for (uint32_t r = 0; r < 4; r++)
+    {
+      for (uint32_t k = 0; k < count; k++)
+        {
+          std::vector<uint8_t> encoded = sdnv.Encode (values[k]);
+          stream.insert (stream.end (), encoded.begin (), encoded.end ());
+        }
+    }
+
+  std::vector<uint64_t> decoded (4 * count);
+  uint32_t used = sdnv.Decode (&stream[0], stream.size (), &decoded[0], decoded.size ());
+  NS_TEST_EXPECT_MSG_EQ (used, stream.size (), "Batch decoding consumes all the encoded bytes");
+  for (uint32_t k = 0; k < decoded.size (); k++)
+    {
+      NS_TEST_EXPECT_MSG_EQ (decoded[k], values[k % count], "Batch decoded value matches at " << k);
+    }
+  NS_TEST_EXPECT_MSG_EQ (sdnv.Decode (&stream[0], stream.size () - 1, &decoded[0], decoded.size ()), 0,
+                         "Batch decoding detects truncated data");
+}
+
+SdnvBenchmarkTestCase::SdnvBenchmarkTestCase (uint32_t count)
+  : TestCase ("Compare the throughput of SDNV encoding into vectors and into buffers"),
+    m_count (count)
+{
+}
+
+SdnvBenchmarkTestCase::~SdnvBenchmarkTestCase ()
+{
+}
+
+void
+SdnvBenchmarkTestCase::DoRun (void)
+{
+  SDNV sdnv;
+  uint64_t checksum = 0;
+
+  // vector encoding, as used by the header serialization before
+  std::clock_t begin = std::clock ();
+  for (uint32_t k = 0; k < m_count; k++)
+    {
+      std::vector<uint8_t> encoded = sdnv.Encode (k * 2654435761ULL);
+      checksum += encoded.back ();
+    }
+  double vectorSeconds = double (std::clock () - begin) / CLOCKS_PER_SEC;
+
+  // in place encoding
+  uint64_t inPlaceChecksum = 0;
+  uint8_t encoded[SDNV_MAX_LENGTH];
+  begin = std::clock ();
+  for (uint32_t k = 0; k < m_count; k++)
+    {
+      uint32_t len = sdnv.Encode (k * 2654435761ULL, encoded);
+      inPlaceChecksum += encoded[len - 1];
+    }
+  double inPlaceSeconds = double (std::clock () - begin) / CLOCKS_PER_SEC;
+
+  NS_TEST_EXPECT_MSG_EQ (inPlaceChecksum, checksum, "Both encoders produce the same bytes");
+
+  NS_LOG_INFO ("SDNV encoding of " << m_count << " values: "
+               << "vector " << m_count / std::max (vectorSeconds, 1e-9) << " values/s, "
+               << "in place " << m_count / std::max (inPlaceSeconds, 1e-9) << " values/s");
+}
+
+BpEndpointMapTestCase::BpEndpointMapTestCase (uint32_t count)
+  : TestCase ("Test that endpoint ids are interned and looked up in the endpoint hash table"),
+    m_count (count)
+{
+}
+
+BpEndpointMapTestCase::~BpEndpointMapTestCase ()
+{
+}
+
+void
+BpEndpointMapTestCase::DoRun (void)
+{
+  BpEndpointId a ("dtn", "node0");
+  BpEndpointId b ("dtn:node0");
+  BpEndpointId c ("dtn", "node1");
+  NS_TEST_EXPECT_MSG_EQ (a.Handle (), b.Handle (), "Same uri has the same handle");
+  NS_TEST_EXPECT_MSG_EQ ((a == b), true, "Same uri is the same endpoint id");
+  NS_TEST_EXPECT_MSG_EQ ((a != c), true, "Different uris are different endpoint ids");
+
+  BpEndpointMap<uint32_t> table;
+  std::vector<BpEndpointId> eids;
+  for (uint32_t k = 0; k < m_count; k++)
+    {
+      std::ostringstream ssp;
+      ssp << "node" << k;
+      eids.push_back (BpEndpointId ("dtn", ssp.str ()));
+      NS_TEST_ASSERT_MSG_EQ (table.Insert (eids.back (), k), true, "New endpoint id is inserted");
+    }
+  NS_TEST_EXPECT_MSG_EQ (table.Insert (eids[0], 0), false, "Duplicate endpoint id is not inserted");
+  NS_TEST_EXPECT_MSG_EQ (table.GetSize (), m_count, "All endpoint ids are stored");
+
+  // erase every other entry, the rest must be still reachable
+  for (uint32_t k = 0; k < m_count; k += 2)
+    NS_TEST_ASSERT_MSG_EQ (table.Erase (eids[k]), true, "Stored endpoint id is erased");
+
+  for (uint32_t k = 0; k < m_count; k++)
+    {
+      uint32_t *value = table.Find (eids[k]);
+      if (k % 2 == 0)
+        {
+          NS_TEST_ASSERT_MSG_EQ ((value == NULL), true, "Erased endpoint id is not found");
+        }
+      else
+        {
+          NS_TEST_ASSERT_MSG_EQ ((value != NULL), true, "Endpoint id is found");
+          NS_TEST_ASSERT_MSG_EQ (*value, k, "Endpoint id has its value");
+        }
+    }
+  NS_TEST_EXPECT_MSG_EQ (table.GetSize (), m_count / 2, "Half of the endpoint ids are left");
+
+  table[eids[0]] = 7;
+  NS_TEST_EXPECT_MSG_EQ (*table.Find (eids[0]), 7, "operator [] inserts a missing endpoint id");
+  table.Clear ();
+  NS_TEST_EXPECT_MSG_EQ (table.IsEmpty (), true, "Table is empty after clear");
+  NS_TEST_EXPECT_MSG_EQ ((table.Find (eids[1]) == NULL), true, "Nothing is found after clear");
+}
+
+// the bundle of a stored bundle record, or NULL
+static Ptr<Packet>
+BundleOf (Ptr<BpStoredBundle> record)
+{
+  if (record == 0)
+    return NULL;
+  return record->bundle;
+}
+
+BpBundleSchedulerTestCase::BpBundleSchedulerTestCase ()
+  : TestCase ("Test that the sent bundles are served by class of service, and fairly across source endpoint ids")
+{
+}
+
+BpBundleSchedulerTestCase::~BpBundleSchedulerTestCase ()
+{
+}
+
+void
+BpBundleSchedulerTestCase::DoRun (void)
+{
+  BpEndpointId a ("dtn", "a");
+  BpEndpointId b ("dtn", "b");
+
+  // the class of service is carried in the primary bundle block
+  BpHeader bph;
+  bph.SetPriority (BpHeader::PRIORITY_EXPEDITED);
+  bph.SetDestinationEid (b);
+  bph.SetSourceEid (a);
+  Ptr<Packet> packet = Create<Packet> (10);
+  packet->AddHeader (bph);
+  BpHeader received;
+  packet->RemoveHeader (received);
+  NS_TEST_EXPECT_MSG_EQ ((uint16_t) received.Priority (), (uint16_t) BpHeader::PRIORITY_EXPEDITED, "Priority is serialized");
+
+  // strict priority within a source endpoint id
+  BpBundleScheduler scheduler;
+  Ptr<Packet> bulk1 = Create<Packet> (100);
+  Ptr<Packet> bulk2 = Create<Packet> (100);
+  Ptr<Packet> normal = Create<Packet> (100);
+  Ptr<Packet> expedited = Create<Packet> (100);
+  scheduler.Enqueue (Create<BpStoredBundle> (bulk1, a, BpHeader::PRIORITY_BULK, BpStoredBundle::SEND_STORE));
+  scheduler.Enqueue (Create<BpStoredBundle> (bulk2, a, BpHeader::PRIORITY_BULK, BpStoredBundle::SEND_STORE));
+  scheduler.Enqueue (Create<BpStoredBundle> (normal, a, BpHeader::PRIORITY_NORMAL, BpStoredBundle::SEND_STORE));
+  scheduler.Enqueue (Create<BpStoredBundle> (expedited, a, BpHeader::PRIORITY_EXPEDITED, BpStoredBundle::SEND_STORE));
+  NS_TEST_EXPECT_MSG_EQ (scheduler.GetSize (a), 4, "All bundles are stored");
+  NS_TEST_EXPECT_MSG_EQ ((BundleOf (scheduler.Dequeue (a)) == expedited), true, "Expedited bundle is sent first");
+  NS_TEST_EXPECT_MSG_EQ ((BundleOf (scheduler.Dequeue (a)) == normal), true, "Normal bundle is sent second");
+  NS_TEST_EXPECT_MSG_EQ ((BundleOf (scheduler.Dequeue (a)) == bulk1), true, "Bulk bundles are sent last");
+  NS_TEST_EXPECT_MSG_EQ ((BundleOf (scheduler.Dequeue (a)) == bulk2), true, "Bulk bundles are sent in FIFO order");
+  NS_TEST_EXPECT_MSG_EQ ((BundleOf (scheduler.Dequeue (a)) == 0), true, "No bundle is left");
+  NS_TEST_EXPECT_MSG_EQ (scheduler.GetLatencyStats (BpHeader::PRIORITY_BULK).bundles, 2, "Bulk bundles are counted");
+  NS_TEST_EXPECT_MSG_EQ (scheduler.GetLatencyStats (BpHeader::PRIORITY_EXPEDITED).bundles, 1, "Expedited bundles are counted");
+
+  // expedited bundle of another source overtakes the stored bulk bundles
+  std::vector<Ptr<Packet> > bulkA;
+  for (uint32_t k = 0; k < 4; k++)
+    {
+      bulkA.push_back (Create<Packet> (100));
+      scheduler.Enqueue (Create<BpStoredBundle> (bulkA.back (), a, BpHeader::PRIORITY_BULK, BpStoredBundle::SEND_STORE));
+    }
+  scheduler.Enqueue (Create<BpStoredBundle> (expedited, b, BpHeader::PRIORITY_EXPEDITED, BpStoredBundle::SEND_STORE));
+  NS_TEST_EXPECT_MSG_EQ ((BundleOf (scheduler.Dequeue ()) == expedited), true, "Expedited bundle overtakes bulk bundles of other sources");
+
+  // round robin across sources
+  std::vector<Ptr<Packet> > bulkB;
+  for (uint32_t k = 0; k < 4; k++)
+    {
+      bulkB.push_back (Create<Packet> (100));
+      scheduler.Enqueue (Create<BpStoredBundle> (bulkB.back (), b, BpHeader::PRIORITY_BULK, BpStoredBundle::SEND_STORE));
+    }
+  for (uint32_t k = 0; k < 4; k++)
+    {
+      NS_TEST_EXPECT_MSG_EQ ((BundleOf (scheduler.Dequeue ()) == bulkA[k]), true, "Source a is served in its turn");
+      NS_TEST_EXPECT_MSG_EQ ((BundleOf (scheduler.Dequeue ()) == bulkB[k]), true, "Source b is served in its turn");
+    }
+  NS_TEST_EXPECT_MSG_EQ (scheduler.GetSize (), 0, "All bundles are sent");
+
+  // weighted fair queuing: source a has twice the share of source b
+  scheduler.SetWeightedFairQueuing (true);
+  scheduler.SetQuantum (100);
+  scheduler.SetWeight (a, 2);
+  for (uint32_t k = 0; k < 4; k++)
+    {
+      scheduler.Enqueue (Create<BpStoredBundle> (bulkA[k], a, BpHeader::PRIORITY_BULK, BpStoredBundle::SEND_STORE));
+      scheduler.Enqueue (Create<BpStoredBundle> (bulkB[k], b, BpHeader::PRIORITY_BULK, BpStoredBundle::SEND_STORE));
+    }
+  NS_TEST_EXPECT_MSG_EQ ((BundleOf (scheduler.Dequeue ()) == bulkA[0]), true, "Source a sends its quantum");
+  NS_TEST_EXPECT_MSG_EQ ((BundleOf (scheduler.Dequeue ()) == bulkA[1]), true, "Source a sends twice the quantum");
+  NS_TEST_EXPECT_MSG_EQ ((BundleOf (scheduler.Dequeue ()) == bulkB[0]), true, "Source b sends once");
+  NS_TEST_EXPECT_MSG_EQ ((BundleOf (scheduler.Dequeue ()) == bulkA[2]), true, "Source a sends its quantum again");
+  NS_TEST_EXPECT_MSG_EQ ((BundleOf (scheduler.Dequeue ()) == bulkA[3]), true, "Source a sends its last bundle");
+  NS_TEST_EXPECT_MSG_EQ ((BundleOf (scheduler.Dequeue ()) == bulkB[1]), true, "Source b sends once again");
+  NS_TEST_EXPECT_MSG_EQ ((BundleOf (scheduler.Dequeue ()) == bulkB[2]), true, "Source b is the only backlogged source");
+  NS_TEST_EXPECT_MSG_EQ ((BundleOf (scheduler.Dequeue ()) == bulkB[3]), true, "Source b sends its last bundle");
+  NS_TEST_EXPECT_MSG_EQ ((BundleOf (scheduler.Dequeue ()) == 0), true, "No bundle is left");
+
+  // a removed bundle is skipped
+  Ptr<BpStoredBundle> removed = Create<BpStoredBundle> (bulk1, a, BpHeader::PRIORITY_BULK, BpStoredBundle::SEND_STORE);
+  scheduler.Enqueue (removed);
+  scheduler.Enqueue (Create<BpStoredBundle> (bulk2, a, BpHeader::PRIORITY_BULK, BpStoredBundle::SEND_STORE));
+  NS_TEST_EXPECT_MSG_EQ (scheduler.Remove (removed), true, "Stored bundle is removed");
+  NS_TEST_EXPECT_MSG_EQ (scheduler.Remove (removed), false, "Removed bundle is not stored");
+  NS_TEST_EXPECT_MSG_EQ (scheduler.GetSize (a), 1, "Removed bundle is not counted");
+  NS_TEST_EXPECT_MSG_EQ ((BundleOf (scheduler.Dequeue ()) == bulk2), true, "Removed bundle is skipped");
+}
+
+BpTimingWheelTestCase::BpTimingWheelTestCase (uint32_t count)
+  : TestCase ("Test that the timing wheel expires each timer at the first tick after its expiration time"),
+    m_count (count)
+{
+}
+
+BpTimingWheelTestCase::~BpTimingWheelTestCase ()
+{
+}
+
+void
+BpTimingWheelTestCase::Expire (uint32_t timer)
+{
+  m_fired[timer] = Simulator::Now ();
+}
+
+void
+BpTimingWheelTestCase::DoRun (void)
+{
+  Time granularity = MilliSeconds (100);
+  BpTimingWheel<uint32_t> wheel;
+  wheel.SetGranularity (granularity);
+  wheel.SetExpireCallback (MakeCallback (&BpTimingWheelTestCase::Expire, this));
+
+  // expirations up to 3000 s, i.e., timers in the first three levels of the wheel
+  std::vector<Time> expiration;
+  std::vector<uint32_t> ids;
+  m_fired.assign (m_count, Seconds (-1));
+  for (uint32_t k = 0; k < m_count; k++)
+    {
+      expiration.push_back (MilliSeconds ((k * 7919) % 3000000));
+      ids.push_back (wheel.Add (expiration.back (), k));
+    }
+
+  // cancel every third timer
+  for (uint32_t k = 0; k < m_count; k += 3)
+    wheel.Cancel (ids[k]);
+  NS_TEST_EXPECT_MSG_EQ (wheel.GetSize (), m_count - (m_count + 2) / 3, "Cancelled timers are removed");
+
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_EXPECT_MSG_EQ (wheel.GetSize (), 0, "All timers are expired");
+  for (uint32_t k = 0; k < m_count; k++)
+    {
+      if (k % 3 == 0)
+        {
+          NS_TEST_ASSERT_MSG_EQ ((m_fired[k] == Seconds (-1)), true, "Cancelled timer does not expire");
+        }
+      else
+        {
+          NS_TEST_ASSERT_MSG_EQ ((m_fired[k] >= expiration[k]), true, "Timer does not expire early");
+          NS_TEST_ASSERT_MSG_EQ ((m_fired[k] < expiration[k] + granularity), true, "Timer expires within a tick");
+        }
+    }
+
+  // a new granularity moves the pending timers to the new ticks
+  Time coarse = Seconds (10);
+  BpTimingWheel<uint32_t> regranular;
+  regranular.SetGranularity (granularity);
+  regranular.SetExpireCallback (MakeCallback (&BpTimingWheelTestCase::Expire, this));
+  m_fired.assign (m_count, Seconds (-1));
+  for (uint32_t k = 0; k < m_count; k++)
+    regranular.Add (expiration[k], k);
+  Simulator::Schedule (Seconds (15), &BpTimingWheel<uint32_t>::SetGranularity, &regranular, coarse);
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_EXPECT_MSG_EQ (regranular.GetSize (), 0, "All timers are expired");
+  NS_TEST_EXPECT_MSG_EQ (regranular.GetGranularity (), coarse, "Granularity is changed");
+  for (uint32_t k = 0; k < m_count; k++)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((m_fired[k] >= expiration[k]), true, "Timer does not expire early");
+      Time tick = (expiration[k] + granularity <= Seconds (15)) ? granularity : coarse;
+      NS_TEST_ASSERT_MSG_EQ ((m_fired[k] < expiration[k] + tick), true, "Timer expires within a tick of its granularity");
+    }
+}
+
+BpStorageManagerTestCase::BpStorageManagerTestCase ()
+  : TestCase ("Test that the storage quotas evict the bundles in the order of the eviction policy")
+{
+}
+
+BpStorageManagerTestCase::~BpStorageManagerTestCase ()
+{
+}
+
+void
+BpStorageManagerTestCase::Evict (Ptr<BpStoredBundle> record)
+{
+  m_evicted.push_back (record);
+}
+
+void
+BpStorageManagerTestCase::DoRun (void)
+{
+  BpEndpointId a ("dtn", "a");
+  BpEndpointId b ("dtn", "b");
+  std::vector<Ptr<BpStoredBundle> > records;
+  for (uint32_t i = 0; i < 6; i++)
+    records.push_back (Create<BpStoredBundle> (Create<Packet> (100), (i < 3) ? a : b,
+                                               i % 3, BpStoredBundle::SEND_STORE));
+
+  // drop oldest with a node quota
+  BpStorageManager storage;
+  storage.SetEvictCallback (MakeCallback (&BpStorageManagerTestCase::Evict, this));
+  storage.SetMaxBundles (4);
+  for (uint32_t i = 0; i < 6; i++)
+    NS_TEST_EXPECT_MSG_EQ (storage.Admit (records[i]), true, "Bundle is admitted");
+  NS_TEST_EXPECT_MSG_EQ (m_evicted.size (), 2, "Two bundles are evicted");
+  NS_TEST_EXPECT_MSG_EQ ((m_evicted[0] == records[0] && m_evicted[1] == records[1]), true, "Oldest bundles are evicted");
+  NS_TEST_EXPECT_MSG_EQ (storage.GetBundles (), 4, "Node quota is kept");
+  NS_TEST_EXPECT_MSG_EQ (storage.GetBytes (a), 100, "Usage of endpoint id a");
+  NS_TEST_EXPECT_MSG_EQ (storage.GetBytes (b), 300, "Usage of endpoint id b");
+
+  storage.Release (records[2]);
+  NS_TEST_EXPECT_MSG_EQ (storage.GetBundles (a), 0, "Released bundle is not accounted");
+
+  // drop lowest priority with an endpoint id quota: b holds a bulk (records[3]),
+  // a normal (records[4]) and an expedited (records[5]) bundle
+  m_evicted.clear ();
+  storage.SetPolicy (BpStorageManager::DROP_LOWEST_PRIORITY);
+  storage.SetEidMaxBundles (2);
+  Ptr<BpStoredBundle> bulk = Create<BpStoredBundle> (Create<Packet> (100), b, BpHeader::PRIORITY_BULK, BpStoredBundle::SEND_STORE);
+  NS_TEST_EXPECT_MSG_EQ (storage.Admit (bulk), false, "New bulk bundle is rejected once the older one is evicted");
+  NS_TEST_EXPECT_MSG_EQ ((m_evicted.size () == 1 && m_evicted[0] == records[3]), true, "Older bulk bundle is evicted first");
+  Ptr<BpStoredBundle> expedited = Create<BpStoredBundle> (Create<Packet> (100), b, BpHeader::PRIORITY_EXPEDITED, BpStoredBundle::SEND_STORE);
+  NS_TEST_EXPECT_MSG_EQ (storage.Admit (expedited), true, "Expedited bundle is admitted");
+  NS_TEST_EXPECT_MSG_EQ ((m_evicted.size () == 2 && m_evicted[1] == records[4]), true, "Normal bundle is evicted");
+  NS_TEST_EXPECT_MSG_EQ (storage.GetBundles (b), 2, "Endpoint id quota is kept");
+
+  // drop soonest expiring with a byte quota
+  m_evicted.clear ();
+  storage.Clear ();
+  storage.SetPolicy (BpStorageManager::DROP_SOONEST_EXPIRING);
+  storage.SetEidMaxBundles (0);
+  storage.SetMaxBundles (0);
+  storage.SetMaxBytes (300);
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      records[i]->expiration = Seconds (i == 0 ? 0 : 10 - i);
+      storage.Admit (records[i]);
+    }
+  Ptr<BpStoredBundle> large = Create<BpStoredBundle> (Create<Packet> (400), a, BpHeader::PRIORITY_BULK, BpStoredBundle::SEND_STORE);
+  NS_TEST_EXPECT_MSG_EQ (storage.Admit (large), false, "Bundle larger than the quota is rejected");
+  NS_TEST_EXPECT_MSG_EQ (m_evicted.size (), 0, "Rejected bundle evicts no bundle");
+  records[3]->expiration = Seconds (20);
+  storage.Admit (records[3]);
+  NS_TEST_EXPECT_MSG_EQ ((m_evicted.size () == 1 && m_evicted[0] == records[2]), true, "Soonest expiring bundle is evicted");
+  NS_TEST_EXPECT_MSG_EQ (storage.GetBytes (), 300, "Byte quota is kept");
+
+  // the endpoint ids are forgotten with their last bundle
+  NS_TEST_EXPECT_MSG_EQ (storage.GetEids (), 2, "Endpoint ids with bundles are accounted");
+  storage.Release (records[3]);
+  NS_TEST_EXPECT_MSG_EQ (storage.GetEids (), 1, "Endpoint id without bundles is removed");
+  NS_TEST_EXPECT_MSG_EQ (storage.GetBundles (b), 0, "No bundle is stored for the removed endpoint id");
+  storage.Release (records[0]);
+  storage.Release (records[1]);
+  NS_TEST_EXPECT_MSG_EQ (storage.GetEids (), 0, "No endpoint id is left");
+  NS_TEST_EXPECT_MSG_EQ (storage.Admit (records[3]), true, "Bundle of a removed endpoint id is admitted again");
+  NS_TEST_EXPECT_MSG_EQ (storage.GetBundles (b), 1, "Endpoint id is accounted again");
+}
+
+BpBundleReassemblerTestCase::BpBundleReassemblerTestCase ()
+  : TestCase ("Test that the fragments of an ADU are reassembled in any order and dropped on timeout")
+{
+}
+
+BpBundleReassemblerTestCase::~BpBundleReassemblerTestCase ()
+{
+}
+
+Ptr<Packet>
+BpBundleReassemblerTestCase::BuildFragment (const std::vector<uint8_t> &adu, uint32_t offset, uint32_t size, uint32_t seq)
+{
+  BpHeader bph;
+  bph.SetDestinationEid (BpEndpointId ("dtn", "b"));
+  bph.SetSourceEid (BpEndpointId ("dtn", "a"));
+  bph.SetCreateTimestamp (RFC_DATE_2000);
+  bph.SetSequenceNumber (SequenceNumber32 (seq));
+  bph.SetIsFragment (true);
+  bph.SetFragOffset (offset);
+  bph.SetAduLength (adu.size ());
+
+  BpPayloadHeader bpph;
+  bpph.SetBlockLength (size);
+  bpph.SetLastBlock (true);
+
+  Ptr<Packet> packet = Create<Packet> (&adu[offset], size);
+  packet->AddHeader (bpph);
+  packet->AddHeader (bph);
+
+  return packet;
+}
+
+void
+BpBundleReassemblerTestCase::DoRun (void)
+{
+  std::vector<uint8_t> adu (1000);
+  for (uint32_t i = 0; i < adu.size (); i++)
+    adu[i] = i % 251;
+
+  BpBundleReassembler reassembler;
+  reassembler.SetTimeout (Seconds (10));
+
+  // a bundle which is not a fragment is passed through
+  BpHeader whole;
+  whole.SetSourceEid (BpEndpointId ("dtn", "a"));
+  Ptr<Packet> bundle = Create<Packet> (10);
+  bundle->AddHeader (whole);
+  NS_TEST_EXPECT_MSG_EQ ((reassembler.Add (bundle) == bundle), true, "Bundle is not a fragment");
+
+  // out of order, overlapping and duplicated fragments
+  NS_TEST_EXPECT_MSG_EQ ((reassembler.Add (BuildFragment (adu, 600, 400, 1)) == 0), true, "Last fragment is kept");
+  NS_TEST_EXPECT_MSG_EQ ((reassembler.Add (BuildFragment (adu, 0, 300, 1)) == 0), true, "First fragment is kept");
+  NS_TEST_EXPECT_MSG_EQ ((reassembler.Add (BuildFragment (adu, 0, 300, 1)) == 0), true, "Duplicated fragment is dropped");
+  NS_TEST_EXPECT_MSG_EQ ((reassembler.Add (BuildFragment (adu, 200, 200, 1)) == 0), true, "Overlapping fragment is kept");
+  NS_TEST_EXPECT_MSG_EQ (reassembler.GetSize (), 1, "One ADU is partially received");
+  Ptr<Packet> reassembled = reassembler.Add (BuildFragment (adu, 350, 300, 1));
+  NS_TEST_EXPECT_MSG_EQ ((reassembled != 0), true, "ADU is complete");
+  NS_TEST_EXPECT_MSG_EQ (reassembler.GetSize (), 0, "Complete ADU is released");
+
+  BpHeader bph;
+  BpPayloadHeader bpph;
+  reassembled->RemoveHeader (bph);
+  reassembled->RemoveHeader (bpph);
+  NS_TEST_EXPECT_MSG_EQ (bph.IsFragment (), false, "Reassembled bundle is not a fragment");
+  NS_TEST_EXPECT_MSG_EQ (bpph.GetBlockLength (), adu.size (), "Payload block holds the ADU");
+  std::vector<uint8_t> payload (reassembled->GetSize ());
+  reassembled->CopyData (&payload[0], payload.size ());
+  NS_TEST_EXPECT_MSG_EQ ((payload == adu), true, "ADU bytes are reassembled in order");
+
+  // an incomplete ADU is dropped after the timeout
+  reassembler.Add (BuildFragment (adu, 0, 500, 2));
+  Simulator::Run ();
+  Simulator::Destroy ();
+  NS_TEST_EXPECT_MSG_EQ (reassembler.GetSize (), 0, "Incomplete ADU is dropped");
+  NS_TEST_EXPECT_MSG_EQ (reassembler.GetTimeouts (), 1, "Reassembly timeout is counted");
+}
+
+BpTcpclSessionTestCase::BpTcpclSessionTestCase ()
+  : TestCase ("Test that the TCPCL session segments, acknowledges and resumes the transfers"),
+    m_linkUp (true),
+    m_cutAfter (0),
+    m_sent (0),
+    m_maxInFlight (0)
+{
+}
+
+BpTcpclSessionTestCase::~BpTcpclSessionTestCase ()
+{
+}
+
+void
+BpTcpclSessionTestCase::Connect ()
+{
+  if (m_a)
+    m_a->Close ();
+  if (m_b)
+    m_b->Close ();
+
+  m_a = Create<BpTcpclSession> (true, "dtn://a");
+  m_b = Create<BpTcpclSession> (false, "dtn://b");
+  m_a->SetSegmentMru (2000);
+  m_b->SetSegmentMru (1000);
+  m_a->SetWindow (4);
+  m_a->SetKeepalive (10);
+  m_b->SetKeepalive (5);
+
+  m_a->SetSendCallback (MakeCallback (&BpTcpclSessionTestCase::Transmit, this));
+  m_b->SetSendCallback (MakeCallback (&BpTcpclSessionTestCase::Transmit, this));
+  m_b->SetReceiveCallback (MakeCallback (&BpTcpclSessionTestCase::Received, this));
+
+  m_linkUp = true;
+  m_sent = 0;
+  m_maxInFlight = 0;
+  m_received.clear ();
+  m_a->Start ();
+  m_b->Start ();
+}
+
+int
+BpTcpclSessionTestCase::Transmit (Ptr<BpTcpclSession> from, Ptr<Packet> packet)
+{
+  if (from == m_a)
+    {
+      m_sent += packet->GetSize ();
+      if (m_cutAfter > 0 && m_sent > m_cutAfter)
+        m_linkUp = false;
+    }
+
+  Ptr<BpTcpclSession> to = (from == m_a) ? m_b : m_a;
+  Simulator::Schedule (MilliSeconds (10), &BpTcpclSessionTestCase::Deliver, this, to, packet);
+  return packet->GetSize ();
+}
+
+void
+BpTcpclSessionTestCase::Deliver (Ptr<BpTcpclSession> to, Ptr<Packet> packet)
+{
+  m_maxInFlight = std::max (m_maxInFlight, m_a->GetInFlight ());
+  if (m_linkUp)
+    to->Receive (packet);
+}
+
+void
+BpTcpclSessionTestCase::Received (Ptr<BpTcpclSession> session, Ptr<Packet> bundle)
+{
+  m_received.push_back (bundle);
+}
+
+bool
+BpTcpclSessionTestCase::IsReceived (const std::vector<uint8_t> &data)
+{
+  if (m_received.size () != 1 || m_received[0]->GetSize () != data.size ())
+    return false;
+
+  std::vector<uint8_t> bytes (data.size ());
+  m_received[0]->CopyData (&bytes[0], bytes.size ());
+  return bytes == data;
+}
+
+void
+BpTcpclSessionTestCase::DoRun (void)
+{
+  std::vector<uint8_t> data (10000);
+  for (uint32_t i = 0; i < data.size (); i++)
+    data[i] = i % 251;
+  Ptr<Packet> bundle = Create<Packet> (&data[0], data.size ());
+
+  // session parameters and a transfer of 10 segments
+  Connect ();
+  m_a->Send (bundle, 1);
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (m_a->GetState (), BpTcpclSession::ESTABLISHED, "Sender session is established");
+  NS_TEST_EXPECT_MSG_EQ (m_b->GetState (), BpTcpclSession::ESTABLISHED, "Receiver session is established");
+  NS_TEST_EXPECT_MSG_EQ (m_a->GetPeerNodeId (), "dtn://b", "Node id of the peer");
+  NS_TEST_EXPECT_MSG_EQ (m_a->GetKeepalive (), 5, "Keepalive is the smallest proposed interval");
+  NS_TEST_EXPECT_MSG_EQ (m_a->GetSegmentSize (), 1000, "Segments fit the segment MRU of the peer");
+  NS_TEST_EXPECT_MSG_EQ (IsReceived (data), true, "Bundle is received");
+  NS_TEST_EXPECT_MSG_EQ (m_a->GetOutgoing (), 0, "Transfer is acknowledged");
+  NS_TEST_EXPECT_MSG_EQ (m_maxInFlight, 4, "Segments in flight are bounded by the window");
+
+  // the link is cut in the middle of a transfer
+  m_cutAfter = 5000;
+  Connect ();
+  m_a->Send (bundle, 2);
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+  std::vector<BpTcpclSession::Transfer> outgoing = m_a->TakeOutgoing ();
+  BpTcpclSession::Transfer incoming;
+  NS_TEST_EXPECT_MSG_EQ (m_received.size (), 0, "Bundle is not received");
+  NS_TEST_ASSERT_MSG_EQ (outgoing.size (), 1, "Transfer is not acknowledged");
+  NS_TEST_ASSERT_MSG_EQ (m_b->TakeIncoming (incoming), true, "Transfer is partially received");
+  NS_TEST_EXPECT_MSG_EQ ((outgoing[0].length > 0 && outgoing[0].length < data.size ()), true, "First segments are acknowledged");
+  NS_TEST_EXPECT_MSG_EQ ((incoming.length >= outgoing[0].length), true, "Acknowledged bytes are received");
+
+  // the next session resumes it from the acknowledged length
+  m_cutAfter = 0;
+  Connect ();
+  m_b->AdoptIncoming (incoming);
+  m_a->Send (outgoing[0].bundle, outgoing[0].id, outgoing[0].length);
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (IsReceived (data), true, "Resumed bundle is received");
+  NS_TEST_EXPECT_MSG_LT (m_sent, data.size () - outgoing[0].length + 1000, "Only the bytes not acknowledged are sent again");
+
+  // a receiver without the first bytes refuses the resumption, the whole bundle is sent again
+  Connect ();
+  m_a->Send (bundle, 3, 5000);
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (IsReceived (data), true, "Retransmitted bundle is received");
+  NS_TEST_EXPECT_MSG_GT (m_sent, data.size (), "Whole bundle is sent again");
+
+  m_a->Close ();
+  m_b->Close ();
+  Simulator::Destroy ();
+}
+
+BpLtpEngineTestCase::BpLtpEngineTestCase ()
+  : TestCase ("Test that the LTP engine acknowledges the red part and sends again only the lost segments"),
+    m_linkUp (true),
+    m_segments (0)
+{
+}
+
+BpLtpEngineTestCase::~BpLtpEngineTestCase ()
+{
+}
+
+void
+BpLtpEngineTestCase::Reset ()
+{
+  m_a.SetEngineId (1);
+  m_b.SetEngineId (2);
+  m_a.SetSegmentSize (1000);
+  m_a.SetRetransmissionTimeout (MilliSeconds (100));
+  m_b.SetRetransmissionTimeout (MilliSeconds (100));
+  m_a.SetMaxRetransmissions (3);
+  m_b.SetMaxRetransmissions (3);
+  m_a.SetSendCallback (MakeCallback (&BpLtpEngineTestCase::TransmitA, this));
+  m_b.SetSendCallback (MakeCallback (&BpLtpEngineTestCase::TransmitB, this));
+  m_b.SetReceiveCallback (MakeCallback (&BpLtpEngineTestCase::Received, this));
+
+  m_linkUp = true;
+  m_drop.clear ();
+  m_segments = 0;
+  m_received.clear ();
+}
+
+void
+BpLtpEngineTestCase::TransmitA (uint64_t peer, Ptr<Packet> segment)
+{
+  // the handle of engine 1 at engine 2 is 1
+  uint32_t index = m_segments++;
+  if (m_linkUp && m_drop.find (index) == m_drop.end ())
+    Simulator::Schedule (MilliSeconds (10), &BpLtpEngine::Receive, &m_b, (uint64_t) 1, segment);
+}
+
+void
+BpLtpEngineTestCase::TransmitB (uint64_t peer, Ptr<Packet> segment)
+{
+  if (m_linkUp)
+    Simulator::Schedule (MilliSeconds (10), &BpLtpEngine::Receive, &m_a, (uint64_t) 2, segment);
+}
+
+void
+BpLtpEngineTestCase::Received (uint64_t peer, Ptr<Packet> block)
+{
+  m_received.push_back (block);
+}
+
+bool
+BpLtpEngineTestCase::IsReceived (const std::vector<uint8_t> &data)
+{
+  if (m_received.size () != 1 || m_received[0]->GetSize () != data.size ())
+    return false;
+
+  std::vector<uint8_t> bytes (data.size ());
+  m_received[0]->CopyData (&bytes[0], bytes.size ());
+  return bytes == data;
+}
+
+void
+BpLtpEngineTestCase::DoRun (void)
+{
+  std::vector<uint8_t> data (10000);
+  for (uint32_t i = 0; i < data.size (); i++)
+    data[i] = i % 251;
+  Ptr<Packet> block = Create<Packet> (&data[0], data.size ());
+
+  // a red block of 10 segments, one checkpoint answered by one report;
+  // m_segments also counts the report acknowledgments
+  Reset ();
+  m_a.Send (2, block, data.size ());
+  Simulator::Stop (Seconds (5));
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (IsReceived (data), true, "Red block is received");
+  NS_TEST_EXPECT_MSG_EQ (m_segments, 10 + 1, "Block is sent in segments of the segment size, and the report is acknowledged");
+  NS_TEST_EXPECT_MSG_EQ (m_a.GetCompleted (), 1, "Red part is acknowledged");
+  NS_TEST_EXPECT_MSG_EQ (m_a.GetExportSessions (), 0, "Export session is closed");
+  NS_TEST_EXPECT_MSG_EQ (m_b.GetImportSessions (), 0, "Import session is closed by the report acknowledgment");
+
+  // the lost segments are reported and only they are sent again
+  Reset ();
+  m_drop.insert (2);
+  m_drop.insert (5);
+  m_drop.insert (6);
+  m_a.Send (2, block, data.size ());
+  Simulator::Stop (Seconds (5));
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (IsReceived (data), true, "Block with lost segments is received");
+  NS_TEST_EXPECT_MSG_EQ (m_a.GetRetransmissions (), 3, "Only the lost segments are sent again");
+  NS_TEST_EXPECT_MSG_EQ (m_segments, 10 + 3 + 2, "No other segment is sent again");
+  NS_TEST_EXPECT_MSG_EQ (m_a.GetExportSessions () + m_b.GetImportSessions (), 0, "Sessions are closed");
+
+  // a lost checkpoint is sent again on timeout
+  Reset ();
+  m_drop.insert (9);
+  m_a.Send (2, block, data.size ());
+  Simulator::Stop (Seconds (5));
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (IsReceived (data), true, "Block with a lost checkpoint is received");
+  NS_TEST_EXPECT_MSG_EQ (m_segments, 10 + 1 + 1, "Only the checkpoint is sent again");
+
+  // the green part is not acknowledged
+  Reset ();
+  uint32_t completed = m_a.GetCompleted ();
+  m_a.Send (2, block, 6000);
+  Simulator::Stop (Seconds (5));
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (IsReceived (data), true, "Red and green block is received");
+  NS_TEST_EXPECT_MSG_EQ (m_a.GetCompleted (), completed + 1, "Red part is acknowledged");
+
+  // a block with a lost green segment is dropped
+  Reset ();
+  m_drop.insert (8);
+  m_a.Send (2, block, 6000);
+  Simulator::Stop (Seconds (5));
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (m_received.size (), 0, "Block with a lost green segment is dropped");
+  NS_TEST_EXPECT_MSG_EQ (m_b.GetImportSessions (), 0, "Incomplete import session is closed");
+
+  // without answer the session is cancelled after the retransmissions
+  Reset ();
+  m_linkUp = false;
+  m_a.Send (2, block, data.size ());
+  Simulator::Stop (Seconds (5));
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (m_a.GetCancelled (), 1, "Session is cancelled");
+  NS_TEST_EXPECT_MSG_EQ (m_segments, 10 + 3 + 1, "Checkpoint is sent again up to the limit, then the cancel segment");
+  NS_TEST_EXPECT_MSG_EQ (m_a.GetExportSessions (), 0, "Cancelled session is closed");
+
+  m_a.Clear ();
+  m_b.Clear ();
+  Simulator::Destroy ();
+}
+
+BundleProtocolMultiPeerTestCase::BundleProtocolMultiPeerTestCase ()
+  : TestCase ("Test that the bundles of two senders connected to the same receiver are extracted independently"),
+    m_receivedBundleSize (0),
+    m_receivedBundleNumber (0)
+{
+}
+
+BundleProtocolMultiPeerTestCase::~BundleProtocolMultiPeerTestCase ()
+{
+}
+
+void
+BundleProtocolMultiPeerTestCase::DoRun (void)
+{
+  // node 0 and node 1 send to node 2 over their own links
+  NodeContainer nodes;
+  nodes.Create (3);
+
+  PointToPointHelper pointToPoint;
+  pointToPoint.SetDeviceAttribute ("DataRate", StringValue ("500Kbps"));
+  pointToPoint.SetChannelAttribute ("Delay", StringValue ("5ms"));
+  NetDeviceContainer devices0 = pointToPoint.Install (nodes.Get (0), nodes.Get (2));
+  NetDeviceContainer devices1 = pointToPoint.Install (nodes.Get (1), nodes.Get (2));
+
+  InternetStackHelper internet;
+  internet.Install (nodes);
+
+  Ipv4AddressHelper ipv4;
+  ipv4.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer i0 = ipv4.Assign (devices0);
+  ipv4.SetBase ("10.1.2.0", "255.255.255.0");
+  Ipv4InterfaceContainer i1 = ipv4.Assign (devices1);
+
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (400));
+  Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (512));
+  Config::SetDefault ("ns3::TcpSocket::SndBufSize", UintegerValue (131072));
+  Config::SetDefault ("ns3::BpTcpClaProtocol::Stripes", UintegerValue (1));
+  Config::SetDefault ("ns3::BpTcpClaProtocol::AggregationSize", UintegerValue (0));
+
+  BpEndpointId eidSender0 ("dtn", "node0");
+  BpEndpointId eidSender1 ("dtn", "node1");
+  BpEndpointId eidRecv ("dtn", "node2");
+
+  // each sender reaches the receiver through its own link
+  Ptr<BpStaticRoutingProtocol> route0 = CreateObject<BpStaticRoutingProtocol> ();
+  route0->AddRoute (eidSender0, InetSocketAddress (i0.GetAddress (0), 9));
+  route0->AddRoute (eidRecv, InetSocketAddress (i0.GetAddress (1), 9));
+  Ptr<BpStaticRoutingProtocol> route1 = CreateObject<BpStaticRoutingProtocol> ();
+  route1->AddRoute (eidSender1, InetSocketAddress (i1.GetAddress (0), 9));
+  route1->AddRoute (eidRecv, InetSocketAddress (i1.GetAddress (1), 9));
+
+  BundleProtocolHelper bpSender0Helper;
+  bpSender0Helper.SetRoutingProtocol (route0);
+  bpSender0Helper.SetBpEndpointId (eidSender0);
+  BundleProtocolContainer bpSender0 = bpSender0Helper.Install (nodes.Get (0));
+  bpSender0.Start (Seconds (0.1));
+  bpSender0.Stop (Seconds (2.0));
+
+  BundleProtocolHelper bpSender1Helper;
+  bpSender1Helper.SetRoutingProtocol (route1);
+  bpSender1Helper.SetBpEndpointId (eidSender1);
+  BundleProtocolContainer bpSender1 = bpSender1Helper.Install (nodes.Get (1));
+  bpSender1.Start (Seconds (0.1));
+  bpSender1.Stop (Seconds (2.0));
+
+  BundleProtocolHelper bpReceiverHelper;
+  bpReceiverHelper.SetRoutingProtocol (route0);
+  bpReceiverHelper.SetBpEndpointId (eidRecv);
+  BundleProtocolContainer bpReceivers = bpReceiverHelper.Install (nodes.Get (2));
+  bpReceivers.Start (Seconds (0.0));
+  bpReceivers.Stop (Seconds (2.0));
+
+  // the segments of both connections interleave at the receiver
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolMultiPeerTestCase::Send, this, bpSender0.Get (0),
+                       20000, eidSender0, eidRecv);
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolMultiPeerTestCase::Send, this, bpSender1.Get (0),
+                       20000, eidSender1, eidRecv);
+  Simulator::Schedule (Seconds (1.8), &BundleProtocolMultiPeerTestCase::Receive, this, bpReceivers.Get (0),
+                       eidRecv);
+
+  Simulator::Stop (Seconds (2.0));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_EXPECT_MSG_EQ (m_receivedBundleSize, 40000, "All bundles of both senders are received");
+  NS_TEST_EXPECT_MSG_EQ (m_receivedBundleNumber, 2, "The fragments of each sender are reassembled into one bundle");
+}
+
+void
+BundleProtocolMultiPeerTestCase::Send (Ptr<BundleProtocol> sender, uint32_t size, BpEndpointId src, BpEndpointId dst)
+{
+  Ptr<Packet> packet = Create<Packet> (size);
+  sender->Send (packet, src, dst);
+}
+
+void
+BundleProtocolMultiPeerTestCase::Receive (Ptr<BundleProtocol> receiver, BpEndpointId eid)
+{
+  Ptr<Packet> p = receiver->Receive (eid);
+  while (p != NULL)
+    {
+      m_receivedBundleSize += p->GetSize ();
+      m_receivedBundleNumber++;
+      p = receiver->Receive (eid);
+    }
+}
+
+BpContactPlanTestCase::BpContactPlanTestCase ()
+  : TestCase ("Test the contacts of a contact plan file")
+{
+}
+
+BpContactPlanTestCase::~BpContactPlanTestCase ()
+{
+}
+
+void
+BpContactPlanTestCase::DoRun (void)
+{
+  Ipv4Address hop1 ("10.1.1.2");
+  Ipv4Address hop2 ("10.1.2.2");
+
+  // the contacts are sorted by start time, whatever their order in the file
+  std::istringstream file ("# start end next-hop rate\n"
+                           "contact 20 30 10.1.1.2 8000\n"
+                           "\n"
+                           "contact 0 10 10.1.1.2 8000\n"
+                           "contact 5 15 10.1.2.2 16000\n");
+  BpContactPlan plan;
+  NS_TEST_ASSERT_MSG_EQ (plan.Load (file), true, "The contact plan is valid");
+  NS_TEST_EXPECT_MSG_EQ (plan.HasContacts (hop1), true, "The first next hop has contacts");
+  NS_TEST_EXPECT_MSG_EQ (plan.HasContacts (Ipv4Address ("10.1.3.2")), false, "An unknown next hop has no contacts");
+
+  const BpContact *contact = plan.GetContact (hop1, Seconds (5));
+  NS_TEST_ASSERT_MSG_EQ ((contact != NULL), true, "The first contact is in progress");
+  NS_TEST_EXPECT_MSG_EQ (contact->start, Seconds (0), "The first contact starts at 0 s");
+  NS_TEST_EXPECT_MSG_EQ (contact->GetVolume (), 10000, "The contact carries 10 s at 1000 bytes/s");
+  NS_TEST_EXPECT_MSG_EQ (contact->GetVolume (Seconds (5)), 5000, "Half of the contact is left");
+  NS_TEST_EXPECT_MSG_EQ ((plan.GetContact (hop1, Seconds (10)) == NULL), true, "The end of a contact is excluded");
+  NS_TEST_EXPECT_MSG_EQ ((plan.GetContact (hop1, Seconds (15)) == NULL), true, "The link is down between the contacts");
+  NS_TEST_EXPECT_MSG_EQ (plan.GetContact (hop2, Seconds (10))->GetVolume (Seconds (10)), 10000, "The second next hop has its own rate");
+
+  std::vector<BpContact> contacts = plan.GetContacts (hop1, Seconds (12));
+  NS_TEST_ASSERT_MSG_EQ (contacts.size (), 1, "One contact is not over");
+  NS_TEST_EXPECT_MSG_EQ (contacts[0].start, Seconds (20), "The next contact starts at 20 s");
+  NS_TEST_EXPECT_MSG_EQ (plan.GetContacts (hop1, Seconds (30)).size (), 0, "All the contacts are over");
+
+  // the contacts of a next hop do not overlap
+  BpContact overlap;
+  overlap.start = Seconds (8);
+  overlap.end = Seconds (21);
+  overlap.nextHop = hop1;
+  overlap.rate = 8000;
+  NS_TEST_EXPECT_MSG_EQ (plan.AddContact (overlap), false, "An overlapping contact is rejected");
+  overlap.nextHop = Ipv4Address ("10.1.3.2");
+  NS_TEST_EXPECT_MSG_EQ (plan.AddContact (overlap), true, "The contacts of other next hops do not overlap");
+  overlap.end = overlap.start;
+  NS_TEST_EXPECT_MSG_EQ (plan.AddContact (overlap), false, "An empty contact is rejected");
+
+  const char *invalid[] = { "contact 0 10 10.1.1.300 8000",
+                            "contact 0 10 10.1.1.2",
+                            "contact 0 10 10.1.1.2 8000 extra",
+                            "link 0 10 10.1.1.2 8000" };
+  for (uint32_t i = 0; i < sizeof (invalid) / sizeof (invalid[0]); i++)
+    {
+      std::istringstream line (invalid[i]);
+      BpContactPlan bad;
+      NS_TEST_EXPECT_MSG_EQ (bad.Load (line), false, "An invalid line is rejected: " << invalid[i]);
+      NS_TEST_EXPECT_MSG_EQ (bad.IsEmpty (), true, "An invalid line adds no contact");
+    }
+}
+
+/**
+ * \brief a routing protocol with several candidate next hops per destination
+ */
+class BpMultiPathRoutingProtocol : public BpRoutingProtocol
+{
+public:
+  virtual void SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol)
+  {
+  }
+
+  virtual bool GetNextHops (const BpEndpointId &dst, std::vector<BpNextHop> &nextHops)
+  {
+    nextHops.clear ();
+    if (!(dst == BpEndpointId ("dtn", "node2")))
+      return false;
+
+    nextHops.push_back (BpNextHop (InetSocketAddress ("10.1.1.2", 9), 20));
+    nextHops.push_back (BpNextHop (InetSocketAddress ("10.1.2.2", 9), 5));
+    nextHops.push_back (BpNextHop (InetSocketAddress ("10.1.3.2", 9), 10));
+    return true;
+  }
+};
+
+BpRoutingProtocolTestCase::BpRoutingProtocolTestCase ()
+  : TestCase ("Test the next hop lookup and the forward callback of the routing protocols")
+{
+}
+
+BpRoutingProtocolTestCase::~BpRoutingProtocolTestCase ()
+{
+}
+
+void
+BpRoutingProtocolTestCase::Forward (Ptr<const Packet> bundle, const InetSocketAddress &nextHop)
+{
+  m_forwarded.push_back (nextHop);
+}
+
+void
+BpRoutingProtocolTestCase::DoRun (void)
+{
+  BpEndpointId known ("dtn", "node2");
+  BpEndpointId unknown ("dtn", "node3");
+  InetSocketAddress address (Ipv4Address::GetAny (), 0);
+
+  // the static route is the only candidate
+  Ptr<BpRoutingProtocol> route = CreateObject<BpStaticRoutingProtocol> ();
+  DynamicCast<BpStaticRoutingProtocol> (route)->AddRoute (known, InetSocketAddress ("10.1.1.2", 9));
+  NS_TEST_ASSERT_MSG_EQ (route->GetNextHop (known, address), true, "The static route is found");
+  NS_TEST_EXPECT_MSG_EQ ((address == InetSocketAddress ("10.1.1.2", 9)), true, "The next hop is the static route");
+  NS_TEST_EXPECT_MSG_EQ (route->GetNextHop (unknown, address), false, "There is no route for an unknown destination");
+
+  std::vector<BpNextHop> nextHops;
+  NS_TEST_ASSERT_MSG_EQ (route->GetNextHops (known, nextHops), true, "The static route is a candidate");
+  NS_TEST_EXPECT_MSG_EQ (nextHops.size (), 1, "The static route is the only candidate");
+  NS_TEST_EXPECT_MSG_EQ (route->GetNextHops (unknown, nextHops), false, "There is no candidate for an unknown destination");
+  NS_TEST_EXPECT_MSG_EQ (nextHops.size (), 0, "The candidates are cleared");
+
+  // the default lookup takes the candidate with the lowest cost
+  Ptr<BpRoutingProtocol> multiPath = CreateObject<BpMultiPathRoutingProtocol> ();
+  NS_TEST_ASSERT_MSG_EQ (multiPath->GetNextHop (known, address), true, "A candidate is found");
+  NS_TEST_EXPECT_MSG_EQ ((address == InetSocketAddress ("10.1.2.2", 9)), true, "The cheapest candidate is taken");
+  NS_TEST_EXPECT_MSG_EQ (multiPath->GetNextHop (unknown, address), false, "There is no candidate for an unknown destination");
+
+  // the forwarding decisions reach the callback, if any
+  multiPath->NotifyForward (Create<Packet> (10), address);
+  NS_TEST_EXPECT_MSG_EQ (m_forwarded.size (), 0, "There is no forward callback");
+  multiPath->SetForwardCallback (MakeCallback (&BpRoutingProtocolTestCase::Forward, this));
+  multiPath->NotifyForward (Create<Packet> (10), address);
+  NS_TEST_ASSERT_MSG_EQ (m_forwarded.size (), 1, "The forwarding decision is reported");
+  NS_TEST_EXPECT_MSG_EQ ((m_forwarded[0] == address), true, "The next hop of the decision is reported");
+}
+
+BpPrefixTrieTestCase::BpPrefixTrieTestCase ()
+  : TestCase ("Test the longest prefix match of the radix trie and of the static routes")
+{
+}
+
+BpPrefixTrieTestCase::~BpPrefixTrieTestCase ()
+{
+}
+
+int32_t
+BpPrefixTrieTestCase::FindLongestPrefix (const std::map<std::string, int32_t> &prefixes, const std::string &key)
+{
+  int32_t value = -1;
+  uint32_t length = 0;
+  for (std::map<std::string, int32_t>::const_iterator it = prefixes.begin (); it != prefixes.end (); ++it)
+    {
+      if (key.compare (0, it->first.size (), it->first) == 0 && (value < 0 || it->first.size () >= length))
+        {
+          value = it->second;
+          length = it->first.size ();
+        }
+    }
+
+  return value;
+}
+
+void
+BpPrefixTrieTestCase::DoRun (void)
+{
+  // nested and sibling prefixes, which split and merge the edges
+  std::map<std::string, int32_t> prefixes;
+  BpPrefixTrie<int32_t> trie;
+  for (int32_t i = 0; i < 200; i++)
+    {
+      std::ostringstream prefix;
+      prefix << "ipn:" << i % 7 << "." << i % 13;
+      if (i % 3 == 0)
+        prefix << "." << i;
+      if (prefixes.find (prefix.str ()) != prefixes.end ())
+        {
+          NS_TEST_EXPECT_MSG_EQ (trie.Insert (prefix.str (), i), false, "A duplicate prefix is rejected");
+          continue;
+        }
+
+      prefixes[prefix.str ()] = i;
+      NS_TEST_EXPECT_MSG_EQ (trie.Insert (prefix.str (), i), true, "A new prefix is inserted");
+    }
+  NS_TEST_EXPECT_MSG_EQ (trie.GetSize (), prefixes.size (), "All the prefixes are stored");
+  NS_TEST_EXPECT_MSG_EQ ((trie.GetNodes () <= 2 * prefixes.size () + 1), true, "The nodes grow with the number of prefixes");
+
+  for (uint32_t round = 0; round < 2; round++)
+    {
+      for (int32_t i = 0; i < 300; i++)
+        {
+          std::ostringstream key;
+          key << "ipn:" << i % 8 << "." << i % 14 << "." << i;
+          const int32_t *value = trie.FindLongestPrefix (key.str ());
+          int32_t expected = FindLongestPrefix (prefixes, key.str ());
+          NS_TEST_EXPECT_MSG_EQ ((value ? *value : -1), expected, "The longest prefix of " << key.str ());
+        }
+
+      // remove every other prefix, the remaining ones are still found
+      std::vector<std::string> erased;
+      uint32_t i = 0;
+      for (std::map<std::string, int32_t>::iterator it = prefixes.begin (); it != prefixes.end (); ++it, ++i)
+        {
+          if (i % 2 == 0)
+            erased.push_back (it->first);
+        }
+      for (i = 0; i < erased.size (); i++)
+        {
+          NS_TEST_EXPECT_MSG_EQ (trie.Erase (erased[i]), true, "A stored prefix is erased");
+          NS_TEST_EXPECT_MSG_EQ (trie.Erase (erased[i]), false, "An erased prefix is not found");
+          prefixes.erase (erased[i]);
+        }
+      NS_TEST_EXPECT_MSG_EQ (trie.GetSize (), prefixes.size (), "The erased prefixes are removed");
+      NS_TEST_EXPECT_MSG_EQ ((trie.GetNodes () <= 2 * prefixes.size () + 1), true, "The nodes of the erased prefixes are merged");
+    }
+
+  NS_TEST_EXPECT_MSG_EQ (trie.Erase ("ipn:"), false, "An inner node without value is not a prefix");
+  NS_TEST_EXPECT_MSG_EQ ((trie.FindLongestPrefix ("dtn:none") == NULL), true, "A key without prefix is not found");
+  trie.Insert ("", -2);
+  NS_TEST_EXPECT_MSG_EQ (*trie.FindLongestPrefix ("dtn:none"), -2, "The empty prefix matches every key");
+  trie.Clear ();
+  NS_TEST_EXPECT_MSG_EQ (trie.GetNodes (), 1, "Only the root is left");
+
+  // an exact route, then the longest pattern, then the default route
+  Ptr<BpStaticRoutingProtocol> route = CreateObject<BpStaticRoutingProtocol> ();
+  InetSocketAddress region ("10.1.1.2", 9);
+  InetSocketAddress subregion ("10.1.2.2", 9);
+  InetSocketAddress exact ("10.1.3.2", 9);
+  InetSocketAddress fallback ("10.1.4.2", 9);
+  NS_TEST_EXPECT_MSG_EQ (route->AddPrefixRoute ("dtn://region-a/*", region), 0, "A pattern is routed");
+  NS_TEST_EXPECT_MSG_EQ (route->AddPrefixRoute ("dtn://region-a/sub/*", subregion), 0, "A longer pattern is routed");
+  NS_TEST_EXPECT_MSG_EQ (route->AddPrefixRoute ("dtn://region-a/*", exact), -1, "A duplicate pattern is rejected");
+  NS_TEST_EXPECT_MSG_EQ (route->AddPrefixRoute ("dtn://region-a/", exact), -1, "A pattern ends with '*'");
+  NS_TEST_EXPECT_MSG_EQ (route->AddRoute (BpEndpointId ("dtn", "//region-a/sub/node1"), exact), 0, "An exact route is added");
+
+  InetSocketAddress address (Ipv4Address::GetAny (), 0);
+  NS_TEST_EXPECT_MSG_EQ (route->GetNextHop (BpEndpointId ("dtn", "//region-b/node1"), address), false, "There is no route yet");
+  NS_TEST_EXPECT_MSG_EQ (route->SetDefaultRoute (fallback), 0, "The default route is added");
+
+  route->GetNextHop (BpEndpointId ("dtn", "//region-a/node1"), address);
+  NS_TEST_EXPECT_MSG_EQ ((address == region), true, "The pattern of the region matches");
+  route->GetNextHop (BpEndpointId ("dtn", "//region-a/sub/node2"), address);
+  NS_TEST_EXPECT_MSG_EQ ((address == subregion), true, "The longest pattern matches");
+  route->GetNextHop (BpEndpointId ("dtn", "//region-a/sub/node1"), address);
+  NS_TEST_EXPECT_MSG_EQ ((address == exact), true, "The exact route is preferred");
+  route->GetNextHop (BpEndpointId ("dtn", "//region-b/node1"), address);
+  NS_TEST_EXPECT_MSG_EQ ((address == fallback), true, "The default route matches the other endpoint ids");
+
+  NS_TEST_EXPECT_MSG_EQ (route->RemovePrefixRoute ("dtn://region-a/sub/*"), 0, "A pattern is removed");
+  route->GetNextHop (BpEndpointId ("dtn", "//region-a/sub/node2"), address);
+  NS_TEST_EXPECT_MSG_EQ ((address == region), true, "The shorter pattern matches again");
+}
+
+BpCgrRoutingProtocolTestCase::BpCgrRoutingProtocolTestCase ()
+  : TestCase ("Test the routes of earliest arrival of the contact graph routing protocol and their cache"),
+    m_dst ("dtn", "node4")
+{
+}
+
+BpCgrRoutingProtocolTestCase::~BpCgrRoutingProtocolTestCase ()
+{
+}
+
+void
+BpCgrRoutingProtocolTestCase::DoRun (void)
+{
+  Ipv4Address a ("10.0.0.1");
+  Ipv4Address b ("10.0.0.2");
+  Ipv4Address c ("10.0.0.3");
+  Ipv4Address d ("10.0.0.4");
+
+  // the local node a reaches d through b from 20 s, or through c from 10 s
+  std::istringstream file ("# start end from next-hop rate owlt\n"
+                           "contact 0 10 10.0.0.1 10.0.0.2 8000 1\n"
+                           "contact 20 30 10.0.0.2 10.0.0.4 8000\n"
+                           "contact 5 15 10.0.0.1 10.0.0.3 8000\n"
+                           "contact 10 40 10.0.0.3 10.0.0.4 8000\n");
+  BpContactPlan plan;
+  NS_TEST_ASSERT_MSG_EQ (plan.Load (file), true, "The contact plan is valid");
+  NS_TEST_EXPECT_MSG_EQ (plan.GetAllContacts ().size (), 4, "All the contacts are loaded");
+  NS_TEST_EXPECT_MSG_EQ (plan.HasContacts (b), false, "The contacts between two nodes are not contacts of an unknown local node");
+
+  // the same network-wide plan gives the contacts of the local node to its convergence layer
+  BpContactPlan local = plan;
+  local.SetLocalAddresses (std::vector<Ipv4Address> (1, a));
+  NS_TEST_EXPECT_MSG_EQ (local.HasContacts (b), true, "The contacts sent from the local address are contacts of the local node");
+  NS_TEST_EXPECT_MSG_EQ (local.HasContacts (d), false, "The contacts sent from the other nodes are not contacts of the local node");
+  NS_TEST_EXPECT_MSG_EQ ((local.GetContact (c, Seconds (7)) != NULL), true, "The link to c is up during its contact");
+  NS_TEST_EXPECT_MSG_EQ ((local.GetContact (c, Seconds (15)) == NULL), true, "The link to c is down after its contact");
+  NS_TEST_EXPECT_MSG_EQ (local.GetContacts (b, Seconds (0)).size (), 1, "The contact with b is not over");
+
+  m_cgr = CreateObject<BpCgrRoutingProtocol> ();
+  m_cgr->SetLocalAddress (a);
+  m_cgr->SetContactPlan (plan);
+  NS_TEST_EXPECT_MSG_EQ (m_cgr->AddEndpoint (m_dst, d), 0, "The endpoint id is mapped to its node");
+  NS_TEST_EXPECT_MSG_EQ (m_cgr->AddEndpoint (m_dst, c), -1, "An endpoint id is mapped once");
+  m_cgr->AddEndpoint (BpEndpointId ("dtn", "node1"), a);
+
+  InetSocketAddress address (Ipv4Address::GetAny (), 0);
+  NS_TEST_EXPECT_MSG_EQ (m_cgr->GetNextHop (BpEndpointId ("dtn", "node5"), address), false, "There is no route to an unknown endpoint id");
+  NS_TEST_EXPECT_MSG_EQ (m_cgr->GetNextHop (BpEndpointId ("dtn", "node1"), address), false, "There is no route to the local node");
+
+  // the route through c, then the route through b without the contact with c
+  NS_TEST_ASSERT_MSG_EQ (m_cgr->GetNextHop (m_dst, address), true, "A route is found");
+  NS_TEST_EXPECT_MSG_EQ ((address == InetSocketAddress (c, 4556)), true, "The route of earliest arrival goes through c");
+  NS_TEST_EXPECT_MSG_EQ (m_cgr->GetCachedRoutes (d), 2, "The two routes are cached");
+  uint32_t searches = m_cgr->GetRouteSearches ();
+
+  std::vector<BpNextHop> nextHops;
+  NS_TEST_ASSERT_MSG_EQ (m_cgr->GetNextHops (m_dst, nextHops), true, "The candidates are found");
+  NS_TEST_ASSERT_MSG_EQ (nextHops.size (), 2, "Each route is a candidate");
+  NS_TEST_EXPECT_MSG_EQ ((nextHops[0].address.GetIpv4 () == c), true, "The earliest arrival is the cheapest");
+  NS_TEST_EXPECT_MSG_EQ (nextHops[0].cost, 10000, "The route through c arrives at 10 s");
+  NS_TEST_EXPECT_MSG_EQ (nextHops[1].cost, 20000, "The route through b arrives at 20 s");
+  NS_TEST_EXPECT_MSG_EQ (m_cgr->GetRouteSearches (), searches, "The cached routes are reused");
+
+  // a bundle consumes the volume of the contacts of its route
+  BpHeader bph;
+  bph.SetDestinationEid (m_dst);
+  Ptr<Packet> bundle = Create<Packet> (5000);
+  bundle->AddHeader (bph);
+  uint32_t size = bundle->GetSize ();
+  NS_TEST_ASSERT_MSG_EQ (m_cgr->GetBundleNextHop (m_dst, size, address), true, "A route carries the bundle");
+  NS_TEST_EXPECT_MSG_EQ ((address.GetIpv4 () == c), true, "The bundle goes through c");
+  m_cgr->NotifyForward (bundle, address);
+  NS_TEST_ASSERT_MSG_EQ (m_cgr->GetBundleNextHop (m_dst, size, address), true, "A route carries the next bundle");
+  NS_TEST_EXPECT_MSG_EQ ((address.GetIpv4 () == b), true, "The contact with c cannot carry the next bundle");
+  NS_TEST_EXPECT_MSG_EQ (m_cgr->GetRouteSearches (), searches, "The cached route through b is taken");
+
+  // the routes through a contact without volume left are recomputed
+  Ptr<Packet> rest = Create<Packet> (10000 - 2 * size + 5000);
+  rest->AddHeader (bph);
+  NS_TEST_ASSERT_MSG_EQ (m_cgr->GetBundleNextHop (m_dst, rest->GetSize (), address), true, "A route carries the rest of the volume");
+  NS_TEST_EXPECT_MSG_EQ ((address.GetIpv4 () == c), true, "The rest of the volume goes through c");
+  m_cgr->NotifyForward (rest, address);
+  NS_TEST_EXPECT_MSG_EQ (m_cgr->GetCachedRoutes (d), 0, "The routes through the contact with c are dropped");
+  NS_TEST_ASSERT_MSG_EQ (m_cgr->GetNextHop (m_dst, address), true, "A route is left");
+  NS_TEST_EXPECT_MSG_EQ ((address.GetIpv4 () == b), true, "The route left goes through b");
+  NS_TEST_EXPECT_MSG_EQ (m_cgr->GetCachedRoutes (d), 1, "The route through b is cached");
+  NS_TEST_EXPECT_MSG_EQ ((m_cgr->GetRouteSearches () > searches), true, "The routes are recomputed");
+
+  Simulator::Schedule (Seconds (12), &BpCgrRoutingProtocolTestCase::CheckExpiry, this);
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+BpCgrRoutingProtocolTestCase::CheckExpiry (void)
+{
+  // the contact with b is over, and the contact with c has no volume left
+  InetSocketAddress address (Ipv4Address::GetAny (), 0);
+  NS_TEST_EXPECT_MSG_EQ (m_cgr->GetNextHop (m_dst, address), false, "There is no route left");
+  NS_TEST_EXPECT_MSG_EQ (m_cgr->GetCachedRoutes (Ipv4Address ("10.0.0.4")), 0, "The routes over are dropped");
+}
+
+BpEpidemicRoutingProtocolTestCase::BpEpidemicRoutingProtocolTestCase ()
+  : TestCase ("Test the epidemic routing protocol")
+{
+}
+
+BpEpidemicRoutingProtocolTestCase::~BpEpidemicRoutingProtocolTestCase ()
+{
+}
+
+void
+BpEpidemicRoutingProtocolTestCase::DoRun (void)
+{
+  // no false negative, and about the configured false positive rate
+  BpBloomFilter filter (1000, 0.01);
+  NS_TEST_EXPECT_MSG_EQ (filter.GetBits (), 9586, "The filter has about 9.6 bits per key");
+  NS_TEST_EXPECT_MSG_EQ (filter.GetHashes (), 7, "The filter has 7 hashes");
+  for (uint32_t i = 0; i < 1000; i++)
+    {
+      std::ostringstream key;
+      key << "dtn://node0 " << i << " 0";
+      filter.Add (key.str ());
+    }
+
+  uint32_t missing = 0;
+  uint32_t positives = 0;
+  for (uint32_t i = 0; i < 1000; i++)
+    {
+      std::ostringstream key;
+      key << "dtn://node0 " << i << " 0";
+      missing += filter.Contains (key.str ()) ? 0 : 1;
+    }
+  for (uint32_t i = 0; i < 10000; i++)
+    {
+      std::ostringstream key;
+      key << "dtn://node1 " << i << " 0";
+      positives += filter.Contains (key.str ()) ? 1 : 0;
+    }
+  NS_TEST_EXPECT_MSG_EQ (missing, 0, "All the keys added are found");
+  NS_TEST_EXPECT_MSG_EQ ((positives < 200), true, "The false positive rate is about 1%");
+
+  // the filter is sent in a summary vector
+  std::vector<uint8_t> buffer (filter.GetSerializedSize ());
+  NS_TEST_EXPECT_MSG_EQ (buffer.size (), 5 + 1199, "The filter takes a byte per 8 bits");
+  filter.Serialize (&buffer[0]);
+  BpBloomFilter copy;
+  NS_TEST_EXPECT_MSG_EQ (copy.Contains ("dtn://node0 0 0"), false, "An empty filter contains no key");
+  NS_TEST_EXPECT_MSG_EQ (copy.Deserialize (&buffer[0], buffer.size () - 1), false, "A truncated filter is rejected");
+  NS_TEST_ASSERT_MSG_EQ (copy.Deserialize (&buffer[0], buffer.size ()), true, "The filter is read");
+  NS_TEST_EXPECT_MSG_EQ (copy.GetHashes (), filter.GetHashes (), "The hashes are read");
+  NS_TEST_EXPECT_MSG_EQ (copy.Contains ("dtn://node0 999 0"), true, "The keys are read");
+  copy.Clear ();
+  NS_TEST_EXPECT_MSG_EQ (copy.Contains ("dtn://node0 999 0"), false, "The keys are removed");
+
+  // a bundle is received once, whatever the peer it comes from
+  Ptr<BpEpidemicRoutingProtocol> epidemic = CreateObject<BpEpidemicRoutingProtocol> ();
+  NS_TEST_EXPECT_MSG_EQ (epidemic->IsRelay (), true, "The bundles of the other nodes are relayed");
+  std::vector<BpNextHop> nextHops;
+  NS_TEST_EXPECT_MSG_EQ (epidemic->GetNextHops (BpEndpointId ("dtn", "node1"), nextHops), false, "There is no route");
+
+  BpHeader bph;
+  bph.SetSourceEid (BpEndpointId ("dtn", "node0"));
+  bph.SetCreateTimestamp (RFC_DATE_2000);
+  bph.SetSequenceNumber (SequenceNumber32 (1));
+  bph.SetLifeTime (10);
+  Ptr<Packet> bundle = Create<Packet> (100);
+  bundle->AddHeader (bph);
+  NS_TEST_EXPECT_MSG_EQ (epidemic->NotifyReceive (bundle), true, "A new bundle is received");
+  NS_TEST_EXPECT_MSG_EQ (epidemic->NotifyReceive (bundle->Copy ()), false, "A copy of the bundle is a duplicate");
+
+  bph.SetSequenceNumber (SequenceNumber32 (2));
+  Ptr<Packet> next = Create<Packet> (100);
+  next->AddHeader (bph);
+  NS_TEST_EXPECT_MSG_EQ (epidemic->NotifyReceive (next), true, "The next bundle is new");
+
+  BpBloomFilter summary = epidemic->GetSummaryVector ();
+  NS_TEST_EXPECT_MSG_EQ (summary.Contains (BpEpidemicRoutingProtocol::GetBundleId (bph)), true, "The bundles received are in the summary vector");
+  bph.SetSequenceNumber (SequenceNumber32 (3));
+  NS_TEST_EXPECT_MSG_EQ (summary.Contains (BpEpidemicRoutingProtocol::GetBundleId (bph)), false, "The other bundles are not");
+
+  // a summary vector larger than a datagram is split into partitions of the bundle ids
+  for (uint32_t i = 10; i < 2010; i++)
+    {
+      bph.SetSequenceNumber (SequenceNumber32 (i));
+      Ptr<Packet> received = Create<Packet> (100);
+      received->AddHeader (bph);
+      epidemic->NotifyReceive (received);
+    }
+
+  std::vector<BpBloomFilter> summaries;
+  epidemic->GetSummaryVectors (65507, summaries);
+  NS_TEST_EXPECT_MSG_EQ (summaries.size (), 1, "A small summary vector takes a single datagram");
+  epidemic->GetSummaryVectors (1000, summaries);
+  NS_TEST_ASSERT_MSG_EQ ((summaries.size () >= 3), true, "A summary vector of 2002 ids at 1% takes at least 3 partitions of 1000 bytes");
+
+  missing = 0;
+  for (uint32_t p = 0; p < summaries.size (); p++)
+    NS_TEST_EXPECT_MSG_EQ ((summaries[p].GetSerializedSize () <= 1000), true, "Each partition fits its datagram");
+  for (uint32_t i = 10; i < 2010; i++)
+    {
+      bph.SetSequenceNumber (SequenceNumber32 (i));
+      std::string id = BpEpidemicRoutingProtocol::GetBundleId (bph);
+      uint32_t partition = BpEpidemicRoutingProtocol::GetPartition (id, summaries.size ());
+      missing += summaries[partition].Contains (id) ? 0 : 1;
+    }
+  NS_TEST_EXPECT_MSG_EQ (missing, 0, "Each id is in the filter of its partition");
+}
+
+BpSprayAndWaitRoutingProtocolTestCase::BpSprayAndWaitRoutingProtocolTestCase ()
+  : TestCase ("Test the spray and wait routing protocol")
+{
+}
+
+BpSprayAndWaitRoutingProtocolTestCase::~BpSprayAndWaitRoutingProtocolTestCase ()
+{
+}
+
+void
+BpSprayAndWaitRoutingProtocolTestCase::DoRun (void)
+{
+  Ipv4Address b ("10.0.0.2");
+  Ipv4Address c ("10.0.0.3");
+  Ipv4Address d ("10.0.0.4");
+  Ipv4Address e ("10.0.0.5");
+  BpEndpointId dst ("dtn", "node4");
+
+  BpHeader bph;
+  bph.SetSourceEid (BpEndpointId ("dtn", "node1"));
+  bph.SetDestinationEid (dst);
+  bph.SetCreateTimestamp (RFC_DATE_2000);
+  bph.SetSequenceNumber (SequenceNumber32 (1));
+  BpPayloadHeader bpph;
+  bpph.SetBlockLength (100);
+  bpph.SetLastBlock (true);
+  Ptr<Packet> bundle = Create<Packet> (100);
+  bundle->AddHeader (bpph);
+  bundle->AddHeader (bph);
+
+  // the copy count block is inserted before the payload block, or replaced
+  uint32_t copies = 0;
+  NS_TEST_EXPECT_MSG_EQ (BpSprayAndWaitRoutingProtocol::GetCopyCount (bundle, copies), false, "A bundle has no copy count block");
+  Ptr<Packet> copy = BpSprayAndWaitRoutingProtocol::SetCopyCount (bundle, 200);
+  NS_TEST_ASSERT_MSG_EQ (BpSprayAndWaitRoutingProtocol::GetCopyCount (copy, copies), true, "The copy count block is added");
+  NS_TEST_EXPECT_MSG_EQ (copies, 200, "The copy count block carries the copies");
+  uint32_t size = copy->GetSize ();
+  copy = BpSprayAndWaitRoutingProtocol::SetCopyCount (copy, 4);
+  NS_TEST_ASSERT_MSG_EQ (BpSprayAndWaitRoutingProtocol::GetCopyCount (copy, copies), true, "The copy count block is kept");
+  NS_TEST_EXPECT_MSG_EQ (copies, 4, "The copies are replaced");
+  NS_TEST_EXPECT_MSG_EQ (copy->GetSize (), size - 1, "A single copy count block is sent");
+  NS_TEST_EXPECT_MSG_EQ (bundle->GetSize (), size - BpCopyCountHeader (200).GetSerializedSize (), "The bundle stored is not changed");
+
+  BpHeader header;
+  BpCopyCountHeader cch;
+  BpPayloadHeader block;
+  copy->RemoveHeader (header);
+  copy->RemoveHeader (cch);
+  copy->RemoveHeader (block);
+  NS_TEST_EXPECT_MSG_EQ ((uint16_t) block.GetBlockType (), BP_PAYLOAD_BLOCK_TYPE, "The payload block follows the copy count block");
+  NS_TEST_EXPECT_MSG_EQ (copy->GetSize (), 100, "The payload is left");
+
+  // the source hands half of its copies to each new peer
+  Ptr<BpSprayAndWaitRoutingProtocol> source = CreateObject<BpSprayAndWaitRoutingProtocol> ();
+  source->AddEndpoint (dst, d);
+  NS_TEST_EXPECT_MSG_EQ (source->AddEndpoint (dst, e), -1, "An endpoint id is mapped once");
+  NS_TEST_EXPECT_MSG_EQ (source->GetCopies (bph), 8, "The source is in charge of all the copies");
+  NS_TEST_EXPECT_MSG_EQ (source->TakeCopies (bph, b), 4, "Half of the copies are handed to a peer");
+  NS_TEST_EXPECT_MSG_EQ (source->TakeCopies (bph, b), 0, "A peer gets the copies once");
+  NS_TEST_EXPECT_MSG_EQ (source->TakeCopies (bph, c), 2, "Half of the copies left are handed to the next peer");
+  NS_TEST_EXPECT_MSG_EQ (source->TakeCopies (bph, e), 1, "The last but one copy is handed");
+  NS_TEST_EXPECT_MSG_EQ (source->GetCopies (bph), 1, "The source keeps a copy");
+  NS_TEST_EXPECT_MSG_EQ (source->TakeCopies (bph, Ipv4Address ("10.0.0.6")), 0, "The last copy waits for the destination");
+  NS_TEST_EXPECT_MSG_EQ (source->TakeCopies (bph, d), 1, "The bundle is delivered to its destination node");
+  NS_TEST_EXPECT_MSG_EQ (source->TakeCopies (bph, d), 0, "The bundle is delivered once");
+
+  // a relay takes charge of the copies of the copy count block
+  Ptr<BpSprayAndWaitRoutingProtocol> relay = CreateObject<BpSprayAndWaitRoutingProtocol> ();
+  relay->AddEndpoint (dst, d);
+  NS_TEST_EXPECT_MSG_EQ (relay->IsRelay (), true, "The bundles of the other nodes are relayed");
+  NS_TEST_EXPECT_MSG_EQ (relay->NotifyReceive (BpSprayAndWaitRoutingProtocol::SetCopyCount (bundle, 2)), true, "A new bundle is received");
+  NS_TEST_EXPECT_MSG_EQ (relay->GetCopies (bph), 2, "The relay is in charge of the copies received");
+  NS_TEST_EXPECT_MSG_EQ (relay->NotifyReceive (BpSprayAndWaitRoutingProtocol::SetCopyCount (bundle, 1)), false, "A copy of the bundle is a duplicate");
+  NS_TEST_EXPECT_MSG_EQ (relay->GetCopies (bph), 3, "The copies of a duplicate are kept");
+  NS_TEST_EXPECT_MSG_EQ (relay->TakeCopies (bph, c), 1, "The relay sprays its copies");
+
+  bph.SetSequenceNumber (SequenceNumber32 (2));
+  Ptr<Packet> next = Create<Packet> (100);
+  next->AddHeader (bpph);
+  next->AddHeader (bph);
+  NS_TEST_EXPECT_MSG_EQ (relay->NotifyReceive (next), true, "The next bundle is new");
+  NS_TEST_EXPECT_MSG_EQ (relay->GetCopies (bph), 1, "A bundle without copy count block is a single copy");
+  NS_TEST_EXPECT_MSG_EQ (relay->TakeCopies (bph, b), 0, "A single copy is not sprayed");
+  NS_TEST_EXPECT_MSG_EQ (relay->TakeCopies (bph, d), 1, "A single copy goes to the destination node");
+}
+
+BundleProtocolPriorityTestCase::BundleProtocolPriorityTestCase ()
+  : TestCase ("Test that the expedited bundles overtake the bulk bundles of the other source endpoint ids")
+{
+}
+
+BundleProtocolPriorityTestCase::~BundleProtocolPriorityTestCase ()
+{
+}
+
+void
+BundleProtocolPriorityTestCase::DoRun (void)
+{
+  NodeContainer nodes;
+  nodes.Create (2);
+
+  PointToPointHelper pointToPoint;
+  pointToPoint.SetDeviceAttribute ("DataRate", StringValue ("500Kbps"));
+  pointToPoint.SetChannelAttribute ("Delay", StringValue ("5ms"));
+  NetDeviceContainer devices = pointToPoint.Install (nodes);
+
+  InternetStackHelper internet;
+  internet.Install (nodes);
+
+  Ipv4AddressHelper ipv4;
+  ipv4.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer i = ipv4.Assign (devices);
+
+  // a small transmission buffer, so that the bundles wait in the storage
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (512));
+  Config::SetDefault ("ns3::TcpSocket::SndBufSize", UintegerValue (4096));
+  Config::SetDefault ("ns3::BpTcpClaProtocol::Stripes", UintegerValue (1));
+  Config::SetDefault ("ns3::BpTcpClaProtocol::AggregationSize", UintegerValue (0));
+
+  BpEndpointId eidBulk ("dtn", "node0");
+  BpEndpointId eidExpedited ("dtn", "node2");
+  BpEndpointId eidRecv ("dtn", "node1");
+
+  Ptr<BpStaticRoutingProtocol> route = CreateObject<BpStaticRoutingProtocol> ();
+  route->AddRoute (eidBulk, InetSocketAddress (i.GetAddress (0), 9));
+  route->AddRoute (eidRecv, InetSocketAddress (i.GetAddress (1), 9));
+
+  BundleProtocolHelper bpSenderHelper;
+  bpSenderHelper.SetRoutingProtocol (route);
+  bpSenderHelper.SetBpEndpointId (eidBulk);
+  BundleProtocolContainer bpSenders = bpSenderHelper.Install (nodes.Get (0));
+  bpSenders.Start (Seconds (0.1));
+  bpSenders.Stop (Seconds (2.0));
+
+  BundleProtocolHelper bpReceiverHelper;
+  bpReceiverHelper.SetRoutingProtocol (route);
+  bpReceiverHelper.SetBpEndpointId (eidRecv);
+  BundleProtocolContainer bpReceivers = bpReceiverHelper.Install (nodes.Get (1));
+  bpReceivers.Start (Seconds (0.0));
+  bpReceivers.Stop (Seconds (2.0));
+
+  // the second source endpoint id of the sender only sends
+  BpRegisterInfo info;
+  info.state = false;
+  bpSenders.Get (0)->Register (eidExpedited, info);
+
+  // the expedited bundles are stored after the bulk ones
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolPriorityTestCase::Send, this, bpSenders.Get (0),
+                       20, 1000, eidBulk, eidRecv, BpHeader::PRIORITY_BULK);
+  Simulator::Schedule (Seconds (0.21), &BundleProtocolPriorityTestCase::Send, this, bpSenders.Get (0),
+                       10, 500, eidExpedited, eidRecv, BpHeader::PRIORITY_EXPEDITED);
+  Simulator::Schedule (Seconds (1.8), &BundleProtocolPriorityTestCase::Receive, this, bpReceivers.Get (0),
+                       eidRecv);
+
+  Simulator::Stop (Seconds (2.0));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_receivedSizes.size (), 30, "All the bundles of both sources are received");
+  uint32_t last = 0;
+  for (uint32_t k = 0; k < m_receivedSizes.size (); k++)
+    {
+      if (m_receivedSizes[k] == 500)
+        last = k;
+    }
+
+  // the bulk bundles of the other source interleaved with the expedited ones
+  // would leave about half of them after the last expedited bundle
+  NS_TEST_EXPECT_MSG_EQ ((m_receivedSizes.size () - 1 - last >= 10), true, "The expedited bundles overtake the stored bulk bundles");
+}
+
+void
+BundleProtocolPriorityTestCase::Send (Ptr<BundleProtocol> sender, uint32_t count, uint32_t size, BpEndpointId src, BpEndpointId dst, uint8_t priority)
+{
+  for (uint32_t k = 0; k < count; k++)
+    sender->Send (Create<Packet> (size), src, dst, priority);
+}
+
+void
+BundleProtocolPriorityTestCase::Receive (Ptr<BundleProtocol> receiver, BpEndpointId eid)
+{
+  Ptr<Packet> p = receiver->Receive (eid);
+  while (p != NULL)
+    {
+      m_receivedSizes.push_back (p->GetSize ());
+      p = receiver->Receive (eid);
+    }
+}
+
+BundleProtocolStripeTestCase::BundleProtocolStripeTestCase ()
+  : TestCase ("Test the spread and the per-flow order of the striped TCP connections"),
+    m_receivedBundleNumber (0)
+{
+}
+
+BundleProtocolStripeTestCase::~BundleProtocolStripeTestCase ()
+{
+}
+
+void
+BundleProtocolStripeTestCase::DoRun (void)
+{
+  NodeContainer nodes;
+  nodes.Create (2);
+
+  PointToPointHelper pointToPoint;
+  pointToPoint.SetDeviceAttribute ("DataRate", StringValue ("500Kbps"));
+  pointToPoint.SetChannelAttribute ("Delay", StringValue ("5ms"));
+  NetDeviceContainer devices = pointToPoint.Install (nodes);
+
+  InternetStackHelper internet;
+  internet.Install (nodes);
+
+  Ipv4AddressHelper ipv4;
+  ipv4.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer i = ipv4.Assign (devices);
+
+  // small transmission buffers, so that the bundles wait for a stripe
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (512));
+  Config::SetDefault ("ns3::TcpSocket::SndBufSize", UintegerValue (4096));
+  Config::SetDefault ("ns3::BpTcpClaProtocol::Stripes", UintegerValue (4));
+  Config::SetDefault ("ns3::BpTcpClaProtocol::AggregationSize", UintegerValue (0));
+
+  BpEndpointId eidSender ("dtn", "node0");
+  BpEndpointId eidOrdered ("dtn", "node2");
+  BpEndpointId eidRecv ("dtn", "node1");
+
+  Ptr<BpStaticRoutingProtocol> route = CreateObject<BpStaticRoutingProtocol> ();
+  route->AddRoute (eidSender, InetSocketAddress (i.GetAddress (0), 9));
+  route->AddRoute (eidRecv, InetSocketAddress (i.GetAddress (1), 9));
+
+  BundleProtocolHelper bpSenderHelper;
+  bpSenderHelper.SetRoutingProtocol (route);
+  bpSenderHelper.SetBpEndpointId (eidSender);
+  BundleProtocolContainer bpSenders = bpSenderHelper.Install (nodes.Get (0));
+  bpSenders.Start (Seconds (0.1));
+  bpSenders.Stop (Seconds (3.0));
+
+  BundleProtocolHelper bpReceiverHelper;
+  bpReceiverHelper.SetRoutingProtocol (route);
+  bpReceiverHelper.SetBpEndpointId (eidRecv);
+  BundleProtocolContainer bpReceivers = bpReceiverHelper.Install (nodes.Get (1));
+  bpReceivers.Start (Seconds (0.0));
+  bpReceivers.Stop (Seconds (3.0));
+
+  // the second source endpoint id of the sender only sends, in order
+  BpRegisterInfo info;
+  info.state = false;
+  info.ordered = true;
+  bpSenders.Get (0)->Register (eidOrdered, info);
+
+  InetSocketAddress nextHop (i.GetAddress (1), 9);
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolStripeTestCase::Send, this, bpSenders.Get (0),
+                       20, 600, eidOrdered, eidRecv);
+  Simulator::Schedule (Seconds (1.0), &BundleProtocolStripeTestCase::SaveStats, this, bpSenders.Get (0),
+                       nextHop, &m_orderedStats);
+  Simulator::Schedule (Seconds (1.0), &BundleProtocolStripeTestCase::Send, this, bpSenders.Get (0),
+                       40, 1000, eidSender, eidRecv);
+  Simulator::Schedule (Seconds (2.8), &BundleProtocolStripeTestCase::Receive, this, bpReceivers.Get (0),
+                       eidRecv);
+  Simulator::Schedule (Seconds (2.8), &BundleProtocolStripeTestCase::SaveStats, this, bpSenders.Get (0),
+                       nextHop, &m_stats);
+
+  Simulator::Stop (Seconds (2.9));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_orderedStats.size (), 4, "There are stats for each stripe");
+  NS_TEST_ASSERT_MSG_EQ (m_stats.size (), 4, "There are stats for each stripe");
+
+  // the ordered flow is written into a single stripe
+  uint32_t used = 0;
+  uint32_t orderedBundles = 0;
+  for (uint32_t k = 0; k < m_orderedStats.size (); k++)
+    {
+      if (m_orderedStats[k].bundles > 0)
+        used++;
+      orderedBundles += m_orderedStats[k].bundles;
+    }
+  NS_TEST_ASSERT_MSG_EQ (used, 1, "The bundles of an ordered flow share one stripe");
+  NS_TEST_ASSERT_MSG_EQ (orderedBundles, 20, "All the bundles of the ordered flow are written");
+
+  // the least outstanding bytes stripe gets the next bundle of the other source
+  for (uint32_t k = 0; k < m_stats.size (); k++)
+    NS_TEST_EXPECT_MSG_GT (m_stats[k].bundles - m_orderedStats[k].bundles, 0, "Each stripe carries bundles of the unordered source");
+
+  NS_TEST_ASSERT_MSG_EQ (m_receivedBundleNumber, 40, "All the bundles of the unordered source are received");
+  NS_TEST_ASSERT_MSG_EQ (m_orderedSequence.size (), 20, "All the bundles of the ordered flow are received");
+  for (uint32_t k = 0; k < m_orderedSequence.size (); k++)
+    NS_TEST_EXPECT_MSG_EQ (m_orderedSequence[k], k, "The bundles of the ordered flow are received in order");
+}
+
+void
+BundleProtocolStripeTestCase::Send (Ptr<BundleProtocol> sender, uint32_t count, uint32_t size, BpEndpointId src, BpEndpointId dst)
+{
+  // the first byte of each ADU carries its sequence number
+  std::vector<uint8_t> buffer (size, 0);
+  for (uint32_t k = 0; k < count; k++)
+    {
+      buffer[0] = k;
+      sender->Send (Create<Packet> (&buffer[0], size), src, dst);
+    }
+}
+
+void
+BundleProtocolStripeTestCase::Receive (Ptr<BundleProtocol> receiver, BpEndpointId eid)
+{
+  Ptr<Packet> p = receiver->Receive (eid);
+  while (p != NULL)
+    {
+      if (p->GetSize () == 600)
+        {
+          uint8_t sequence;
+          p->CopyData (&sequence, 1);
+          m_orderedSequence.push_back (sequence);
+        }
+      else
+        m_receivedBundleNumber++;
+
+      p = receiver->Receive (eid);
+    }
+}
+
+void
+BundleProtocolStripeTestCase::SaveStats (Ptr<BundleProtocol> sender, InetSocketAddress nextHop, std::vector<BpTcpClaProtocol::StripeStats> *stats)
+{
+  Ptr<BpTcpClaProtocol> cla = DynamicCast<BpTcpClaProtocol> (sender->GetCla ());
+  NS_TEST_ASSERT_MSG_EQ ((cla != NULL), true, "The sender uses the TCP convergence layer");
+  *stats = cla->GetStripeStats (nextHop);
+}
+
+BpEpidemicEndToEndTestCase::BpEpidemicEndToEndTestCase (std::string claType)
+  : TestCase ("Test the delivery of bundles through the summary vectors of the epidemic routing protocol"),
+    m_claType (claType),
+    m_receivedBundleSize (0),
+    m_receivedBundleNumber (0)
+{
+}
+
+BpEpidemicEndToEndTestCase::~BpEpidemicEndToEndTestCase ()
+{
+}
+
+void
+BpEpidemicEndToEndTestCase::DoRun (void)
+{
+  NodeContainer nodes;
+  nodes.Create (2);
+
+  PointToPointHelper pointToPoint;
+  pointToPoint.SetDeviceAttribute ("DataRate", StringValue ("500Kbps"));
+  pointToPoint.SetChannelAttribute ("Delay", StringValue ("5ms"));
+  NetDeviceContainer devices = pointToPoint.Install (nodes);
+
+  InternetStackHelper internet;
+  internet.Install (nodes);
+
+  Ipv4AddressHelper ipv4;
+  ipv4.SetBase ("10.1.1.0", "255.255.255.0");
+  ipv4.Assign (devices);
+
+  // the udp and ltp convergence layers do not report any link, the beacons do
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue (m_claType));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+
+  BpEndpointId eidSender ("dtn", "node0");
+  BpEndpointId eidRecv ("dtn", "node1");
+
+  // each node has its own routing protocol, which has no route, so the
+  // bundles are forwarded to the default port of the convergence layer
+  Ptr<BpEpidemicRoutingProtocol> senderRouting = CreateObject<BpEpidemicRoutingProtocol> ();
+  BundleProtocolHelper bpSenderHelper;
+  bpSenderHelper.SetRoutingProtocol (senderRouting);
+  bpSenderHelper.SetBpEndpointId (eidSender);
+  BundleProtocolContainer bpSenders = bpSenderHelper.Install (nodes.Get (0));
+  bpSenders.Start (Seconds (0.1));
+  bpSenders.Stop (Seconds (5.0));
+
+  Ptr<BpEpidemicRoutingProtocol> receiverRouting = CreateObject<BpEpidemicRoutingProtocol> ();
+  BundleProtocolHelper bpReceiverHelper;
+  bpReceiverHelper.SetRoutingProtocol (receiverRouting);
+  bpReceiverHelper.SetBpEndpointId (eidRecv);
+  BundleProtocolContainer bpReceivers = bpReceiverHelper.Install (nodes.Get (1));
+  bpReceivers.Start (Seconds (0.0));
+  bpReceivers.Stop (Seconds (5.0));
+
+  // the bundles are stored, then sent in return of the next summary vector of the receiver
+  Simulator::Schedule (Seconds (1.0), &BpEpidemicEndToEndTestCase::Send, this, bpSenders.Get (0),
+                       3, 500, eidSender, eidRecv);
+  Simulator::Schedule (Seconds (4.5), &BpEpidemicEndToEndTestCase::Receive, this, bpReceivers.Get (0),
+                       eidRecv);
+
+  Simulator::Stop (Seconds (5.0));
+  Simulator::Run ();
+
+  NS_TEST_EXPECT_MSG_GT (senderRouting->GetBeaconsSent (), 0, "The sender sends beacons");
+  NS_TEST_EXPECT_MSG_GT (receiverRouting->GetSummariesSent (), 0, "The beacon of the sender starts the exchange of the summary vectors");
+  NS_TEST_EXPECT_MSG_EQ (senderRouting->GetBundlesForwarded (), 3, "The bundles in the summary vector of the receiver are not sent again");
+  NS_TEST_EXPECT_MSG_EQ (receiverRouting->GetBundlesForwarded (), 0, "The receiver does not send back the bundles it received");
+
+  Simulator::Destroy ();
+
+  NS_TEST_EXPECT_MSG_EQ (m_receivedBundleNumber, 3, "All the bundles are delivered");
+  NS_TEST_EXPECT_MSG_EQ (m_receivedBundleSize, 1500, "All the bytes are delivered");
+}
+
+void
+BpEpidemicEndToEndTestCase::Send (Ptr<BundleProtocol> sender, uint32_t count, uint32_t size, BpEndpointId src, BpEndpointId dst)
+{
+  for (uint32_t k = 0; k < count; k++)
+    sender->Send (Create<Packet> (size), src, dst);
+}
+
+void
+BpEpidemicEndToEndTestCase::Receive (Ptr<BundleProtocol> receiver, BpEndpointId eid)
+{
+  Ptr<Packet> p = receiver->Receive (eid);
+  while (p != NULL)
+    {
+      m_receivedBundleSize += p->GetSize ();
+      m_receivedBundleNumber++;
+      p = receiver->Receive (eid);
+    }
+}
+
+BpSprayAndWaitEndToEndTestCase::BpSprayAndWaitEndToEndTestCase (std::string claType)
+  : TestCase ("Test the spray and wait phases from a source to a destination through two relays"),
+    m_claType (claType),
+    m_receivedBundleSize (0),
+    m_receivedBundleNumber (0)
+{
+}
+
+BpSprayAndWaitEndToEndTestCase::~BpSprayAndWaitEndToEndTestCase ()
+{
+}
+
+void
+BpSprayAndWaitEndToEndTestCase::DoRun (void)
+{
+  // source - relay1 - relay2 - destination, a link between each pair of neighbors
+  NodeContainer nodes;
+  nodes.Create (4);
+
+  PointToPointHelper pointToPoint;
+  pointToPoint.SetDeviceAttribute ("DataRate", StringValue ("500Kbps"));
+  pointToPoint.SetChannelAttribute ("Delay", StringValue ("5ms"));
+
+  InternetStackHelper internet;
+  internet.Install (nodes);
+
+  Ipv4AddressHelper ipv4;
+  ipv4.SetBase ("10.1.1.0", "255.255.255.0");
+  std::vector<Ipv4InterfaceContainer> links;
+  for (uint32_t k = 0; k < 3; k++)
+    {
+      links.push_back (ipv4.Assign (pointToPoint.Install (nodes.Get (k), nodes.Get (k + 1))));
+      ipv4.NewNetwork ();
+    }
+
+  // the bundles are forwarded to the default port of the convergence layer
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue (m_claType));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  Config::SetDefault ("ns3::BpSprayAndWaitRoutingProtocol::Copies", UintegerValue (4));
+
+  std::vector<BpEndpointId> eids;
+  std::vector<Ptr<BpSprayAndWaitRoutingProtocol> > routings;
+  BundleProtocolContainer bps;
+  for (uint32_t k = 0; k < 4; k++)
+    {
+      std::ostringstream ssp;
+      ssp << "node" << k;
+      eids.push_back (BpEndpointId ("dtn", ssp.str ()));
+      routings.push_back (CreateObject<BpSprayAndWaitRoutingProtocol> ());
+    }
+
+  // every node knows the node of the source and of the destination
+  for (uint32_t k = 0; k < 4; k++)
+    {
+      routings[k]->AddEndpoint (eids[0], links[0].GetAddress (0));
+      routings[k]->AddEndpoint (eids[3], links[2].GetAddress (1));
+
+      BundleProtocolHelper bpHelper;
+      bpHelper.SetRoutingProtocol (routings[k]);
+      bpHelper.SetBpEndpointId (eids[k]);
+      bps.Add (bpHelper.Install (nodes.Get (k)));
+    }
+  bps.Start (Seconds (0.0));
+  bps.Stop (Seconds (6.0));
+
+  Simulator::Schedule (Seconds (1.0), &BpSprayAndWaitEndToEndTestCase::Send, this, bps.Get (0),
+                       500, eids[0], eids[3]);
+  Simulator::Schedule (Seconds (5.5), &BpSprayAndWaitEndToEndTestCase::Receive, this, bps.Get (3),
+                       eids[3]);
+
+  Simulator::Stop (Seconds (6.0));
+  Simulator::Run ();
+
+  // the spray phase halves the copies at each handoff, the relay2 with a
+  // single copy waits for the destination, and the copies are never handed
+  // back to the source
+  NS_TEST_EXPECT_MSG_GT (routings[0]->GetBeaconsSent (), 0, "The source sends beacons");
+  NS_TEST_EXPECT_MSG_EQ (routings[0]->GetCopies (m_sent), 2, "The source keeps half of its copies");
+  NS_TEST_EXPECT_MSG_EQ (routings[1]->GetCopies (m_sent), 1, "The relay1 keeps half of the copies it took");
+  NS_TEST_EXPECT_MSG_EQ (routings[2]->GetCopies (m_sent), 0, "The relay2 handed its single copy to the destination");
+  NS_TEST_EXPECT_MSG_EQ (routings[0]->GetBundlesForwarded (), 1, "The source hands the bundle to the relay1 only");
+  NS_TEST_EXPECT_MSG_EQ (routings[1]->GetBundlesForwarded (), 1, "The relay1 hands the bundle to the relay2 only");
+  NS_TEST_EXPECT_MSG_EQ (routings[2]->GetBundlesForwarded (), 1, "The relay2 in the wait phase only delivers the bundle directly");
+  NS_TEST_EXPECT_MSG_EQ (routings[3]->GetBundlesForwarded (), 0, "The destination does not forward the bundle");
+
+  // the bundle which never expires leaves the storage of the relay2 with its last copy
+  std::vector<Ptr<Packet> > stored;
+  bps.Get (1)->GetStoredBundles (stored);
+  NS_TEST_EXPECT_MSG_EQ (stored.size (), 1, "The relay1 keeps the bundle of its copy");
+  bps.Get (2)->GetStoredBundles (stored);
+  NS_TEST_EXPECT_MSG_EQ (stored.size (), 0, "The relay2 removes the bundle delivered to the destination");
+
+  Simulator::Destroy ();
+
+  // the copy count block is removed before the delivery
+  NS_TEST_EXPECT_MSG_EQ (m_receivedBundleNumber, 1, "The bundle is delivered once");
+  NS_TEST_EXPECT_MSG_EQ (m_receivedBundleSize, 500, "The delivered ADU has no copy count block");
+}
+
+void
+BpSprayAndWaitEndToEndTestCase::Send (Ptr<BundleProtocol> sender, uint32_t size, BpEndpointId src, BpEndpointId dst)
+{
+  sender->Send (Create<Packet> (size), src, dst);
+
+  // the id of the bundle, to look up its copies on each node
+  std::vector<Ptr<Packet> > bundles;
+  sender->GetStoredBundles (bundles);
+  NS_TEST_ASSERT_MSG_EQ (bundles.size (), 1, "The bundle waits in the storage of the source");
+  bundles[0]->PeekHeader (m_sent);
+}
+
+void
+BpSprayAndWaitEndToEndTestCase::Receive (Ptr<BundleProtocol> receiver, BpEndpointId eid)
+{
+  Ptr<Packet> p = receiver->Receive (eid);
+  while (p != NULL)
+    {
+      m_receivedBundleSize += p->GetSize ();
+      m_receivedBundleNumber++;
+      p = receiver->Receive (eid);
+    }
+}
+
+BpHeaderTestCase::BpHeaderTestCase ()
+  : TestCase ("Test that a modified received primary bundle header is encoded with its new values")
+{
+}
+
+BpHeaderTestCase::~BpHeaderTestCase ()
+{
+}
+
+void
+BpHeaderTestCase::DoRun (void)
+{
+  BpHeader bph;
+  bph.SetDestinationEid (BpEndpointId ("dtn", "node1"));
+  bph.SetSourceEid (BpEndpointId ("dtn", "node0"));
+  bph.SetCreateTimestamp (RFC_DATE_2000);
+  bph.SetSequenceNumber (SequenceNumber32 (7));
+  bph.SetLifeTime (10);
+  bph.SetBlockLength (100);
+
+  Ptr<Packet> packet = Create<Packet> (100);
+  packet->AddHeader (bph);
+  uint32_t sentSize = packet->GetSize ();
+
+  // the received header keeps the image it was read from
+  BpHeader received;
+  packet->RemoveHeader (received);
+  NS_TEST_EXPECT_MSG_EQ (received.GetSerializedSize (), bph.GetSerializedSize (), "The received header has the sent size");
+
+  // a setter invalidates the image, the header is encoded again
+  received.SetDestinationEid (BpEndpointId ("dtn", "a-much-longer-destination"));
+  received.SetLifeTime (100000);
+  packet->AddHeader (received);
+  NS_TEST_EXPECT_MSG_EQ (packet->GetSize (), 100 + received.GetSerializedSize (), "The modified header is written with its new size");
+  NS_TEST_EXPECT_MSG_EQ ((packet->GetSize () > sentSize), true, "The longer fields take more bytes");
+
+  BpHeader forwarded;
+  NS_TEST_EXPECT_MSG_EQ (packet->RemoveHeader (forwarded), received.GetSerializedSize (), "The whole modified header is read");
+  NS_TEST_EXPECT_MSG_EQ (forwarded.GetDestinationEid ().Uri (), "dtn:a-much-longer-destination", "The new destination endpoint id is encoded");
+  NS_TEST_EXPECT_MSG_EQ (forwarded.GetLifeTime (), 100000, "The new lifetime is encoded");
+  NS_TEST_EXPECT_MSG_EQ (forwarded.GetSourceEid ().Uri (), "dtn:node0", "The other fields are kept");
+  NS_TEST_EXPECT_MSG_EQ (forwarded.GetSequenceNumber ().GetValue (), 7, "The sequence number is kept");
+  NS_TEST_EXPECT_MSG_EQ (packet->GetSize (), 100, "The payload follows the header");
+
+  // only the lifetime changes, the size is kept
+  forwarded.SetLifeTime (200000);
+  packet->AddHeader (forwarded);
+  BpHeader again;
+  packet->RemoveHeader (again);
+  NS_TEST_EXPECT_MSG_EQ (again.GetLifeTime (), 200000, "A changed field of the same length is encoded");
+  NS_TEST_EXPECT_MSG_EQ (again.GetDestinationEid ().Uri (), "dtn:a-much-longer-destination", "The destination endpoint id is kept");
+}
+
+BundleProtocolContactTestCase::BundleProtocolContactTestCase ()
+  : TestCase ("Test that the bundles held for a contact are accounted by the storage and expire"),
+    m_receivedBundleNumber (0)
+{
+}
+
+BundleProtocolContactTestCase::~BundleProtocolContactTestCase ()
+{
+}
+
+void
+BundleProtocolContactTestCase::DoRun (void)
+{
+  NodeContainer nodes;
+  nodes.Create (2);
+
+  PointToPointHelper pointToPoint;
+  pointToPoint.SetDeviceAttribute ("DataRate", StringValue ("5Mbps"));
+  pointToPoint.SetChannelAttribute ("Delay", StringValue ("2ms"));
+  NetDeviceContainer devices = pointToPoint.Install (nodes);
+
+  InternetStackHelper internet;
+  internet.Install (nodes);
+
+  Ipv4AddressHelper ipv4;
+  ipv4.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer i = ipv4.Assign (devices);
+
+  // the held bundles count against a quota of 4 bundles, the oldest are evicted
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  Config::SetDefault ("ns3::BundleProtocol::StorageMaxBundles", UintegerValue (4));
+  Config::SetDefault ("ns3::BundleProtocol::EvictionPolicy", StringValue ("DropOldest"));
+
+  BpEndpointId eidSender ("dtn", "node0");
+  BpEndpointId eidShort ("dtn", "node2");
+  BpEndpointId eidRecv ("dtn", "node1");
+
+  Ptr<BpStaticRoutingProtocol> route = CreateObject<BpStaticRoutingProtocol> ();
+  route->AddRoute (eidSender, InetSocketAddress (i.GetAddress (0), 9));
+  route->AddRoute (eidRecv, InetSocketAddress (i.GetAddress (1), 9));
+
+  BundleProtocolHelper bpSenderHelper;
+  bpSenderHelper.SetRoutingProtocol (route);
+  bpSenderHelper.SetBpEndpointId (eidSender);
+  BundleProtocolContainer bpSenders = bpSenderHelper.Install (nodes.Get (0));
+  bpSenders.Start (Seconds (0.1));
+  bpSenders.Stop (Seconds (40.0));
+
+  BundleProtocolHelper bpReceiverHelper;
+  bpReceiverHelper.SetRoutingProtocol (route);
+  bpReceiverHelper.SetBpEndpointId (eidRecv);
+  BundleProtocolContainer bpReceivers = bpReceiverHelper.Install (nodes.Get (1));
+  bpReceivers.Start (Seconds (0.0));
+  bpReceivers.Stop (Seconds (40.0));
+
+  // the receiver is only reachable during a single contact
+  std::istringstream file ("contact 10 20 10.1.1.2 80000\n");
+  BpContactPlan plan;
+  NS_TEST_ASSERT_MSG_EQ (plan.Load (file), true, "The contact plan is valid");
+  Ptr<BpTcpClaProtocol> cla = DynamicCast<BpTcpClaProtocol> (bpSenders.Get (0)->GetCla ());
+  NS_TEST_ASSERT_MSG_EQ ((cla != 0), true, "The sender runs the TCP CLA");
+  cla->SetContactPlan (plan);
+
+  // the second source endpoint id sends bundles which expire before the contact
+  BpRegisterInfo info;
+  info.lifetime = 5;
+  info.state = false;
+  bpSenders.Get (0)->Register (eidShort, info);
+
+  Simulator::Schedule (Seconds (1.0), &BundleProtocolContactTestCase::Send, this, bpSenders.Get (0),
+                       3, 500, eidShort, eidRecv);
+  Simulator::Schedule (Seconds (1.1), &BundleProtocolContactTestCase::Send, this, bpSenders.Get (0),
+                       3, 500, eidSender, eidRecv);
+  Simulator::Schedule (Seconds (2.0), &BundleProtocolContactTestCase::SaveHeld, this, bpSenders.Get (0),
+                       i.GetAddress (1));
+  Simulator::Schedule (Seconds (8.0), &BundleProtocolContactTestCase::SaveHeld, this, bpSenders.Get (0),
+                       i.GetAddress (1));
+  Simulator::Schedule (Seconds (25.0), &BundleProtocolContactTestCase::Receive, this, bpReceivers.Get (0),
+                       eidRecv);
+
+  // a bundle sent after the last contact has no way to the receiver
+  Simulator::Schedule (Seconds (30.0), &BundleProtocolContactTestCase::Send, this, bpSenders.Get (0),
+                       1, 500, eidSender, eidRecv);
+  Simulator::Schedule (Seconds (31.0), &BundleProtocolContactTestCase::SaveHeld, this, bpSenders.Get (0),
+                       i.GetAddress (1));
+
+  Simulator::Stop (Seconds (40.0));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_held.size (), 3, "The held bundles are checked three times");
+  NS_TEST_EXPECT_MSG_EQ (m_held[0], 4, "The held bundles are within the storage quota");
+  NS_TEST_EXPECT_MSG_EQ (m_expired[0], 0, "No bundle is expired before its lifetime is over");
+  NS_TEST_EXPECT_MSG_EQ (m_held[1], 3, "The held bundle is dropped when its lifetime is over");
+  NS_TEST_EXPECT_MSG_EQ (m_expired[1], 1, "The expired held bundle is reported");
+  NS_TEST_EXPECT_MSG_EQ (m_receivedBundleNumber, 3, "The bundles which never expire are delivered in the contact");
+  NS_TEST_EXPECT_MSG_EQ (m_held[2], 0, "A bundle without a later contact is not held");
+  NS_TEST_EXPECT_MSG_EQ (m_expired[2], 2, "The bundle without a later contact is reported as expired");
+}
+
+void
+BundleProtocolContactTestCase::Send (Ptr<BundleProtocol> sender, uint32_t count, uint32_t size, BpEndpointId src, BpEndpointId dst)
+{
+  for (uint32_t k = 0; k < count; k++)
+    sender->Send (Create<Packet> (size), src, dst);
+}
+
+void
+BundleProtocolContactTestCase::Receive (Ptr<BundleProtocol> receiver, BpEndpointId eid)
+{
+  Ptr<Packet> p = receiver->Receive (eid);
+  while (p != NULL)
+    {
+      m_receivedBundleNumber++;
+      p = receiver->Receive (eid);
+    }
+}
+
+void
+BundleProtocolContactTestCase::SaveHeld (Ptr<BundleProtocol> sender, Ipv4Address nextHop)
+{
+  Ptr<BpTcpClaProtocol> cla = DynamicCast<BpTcpClaProtocol> (sender->GetCla ());
+  m_held.push_back (cla->GetHeldBundles (nextHop));
+  m_expired.push_back (sender->GetExpiredBundles ());
+}